@@ -0,0 +1,248 @@
+﻿#include "coalescer.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace IMD {
+
+	// Returns true if the set contains the register
+	static bool contains(const std::vector<uint64_t>& set, size_t number) noexcept {
+		return (set[number / 64] >> (number % 64)) & 1;
+	}
+
+	// Adds the register to the set
+	static void insert(std::vector<uint64_t>& set, size_t number) noexcept {
+		set[number / 64] |= uint64_t{ 1 } << (number % 64);
+	}
+
+	// Returns true if the sets have a common register
+	static bool intersects(const std::vector<uint64_t>& first, const std::vector<uint64_t>& second) noexcept {
+		for (size_t i{ 0 }; i < first.size(); ++i)
+			if (first[i] & second[i])
+				return true;
+		return false;
+	}
+
+	// Constructor: loads the program, which must consist of a single stage
+	register_coalescer::register_coalescer(const std::string& filename) :
+		_machine(), _names(), _numbers(), _fixed(0), _uses(), _defs(), _successors(), _sources(), _live(), _entry(), _interference(), _copies(), _colors(), _count(0) {
+		extended_register_machine erm(filename);
+		auto stages = erm.load_stages();
+		if (stages.size() != 1)
+			throw std::runtime_error("Filename: " + filename + ". The coalesced program must not be a composition");
+		this->_machine = std::move(stages.front());
+
+		for (const auto& x : this->_machine->_input_registers)
+			this->number(x);
+		for (const auto& x : this->_machine->_output_registers)
+			this->number(x);
+		this->_fixed = this->_names.size();
+
+		this->collect();
+		this->analyze_liveness();
+		this->build_interference();
+		this->color();
+	}
+
+	// Returns the program with the coalesced registers
+	// The instructions are written by their descriptions with every register replaced by the first register of its color
+	register_coalescer::coalesced_program register_coalescer::coalesce() const {
+		std::vector<std::string> names(this->_count);
+		for (size_t i{ this->_names.size() }; i-- > 0; )
+			names[this->_colors[i]] = this->_names[i];
+
+		coalesced_program result{ this->_machine->_input_registers, {}, this->_machine->_output_registers };
+		for (const auto* x : this->_machine->_instructions) {
+			std::istringstream iss(x->description());
+			std::string text{};
+			for (std::string word{}; iss >> word; ) {
+				if (auto it = this->_numbers.find(word); it != this->_numbers.end())
+					word = names[this->_colors[it->second]];
+				text += (text.empty() ? "" : " ") + word;
+			}
+			result.code.push_back(std::move(text));
+		}
+		return result;
+	}
+
+	// Returns the number of registers of the program
+	size_t register_coalescer::registers() const noexcept {
+		return this->_names.size();
+	}
+
+	// Returns the number of registers of the coalesced program
+	size_t register_coalescer::coalesced_registers() const noexcept {
+		return this->_count;
+	}
+
+	// Returns the number of the register, a new register is numbered after the others
+	size_t register_coalescer::number(const std::string& name) {
+		auto [it, is_inserted] = this->_numbers.try_emplace(name, this->_names.size());
+		if (is_inserted)
+			this->_names.push_back(name);
+		return it->second;
+	}
+
+	// Collects the registers read and written by the instructions and the instructions following them
+	// A move writes both of its registers: the source becomes 0; the stop reads the output registers
+	void register_coalescer::collect() {
+		using basic = basic_register_machine;
+		const auto& machine = *this->_machine;
+		auto size = machine._instructions.size();
+		this->_uses.assign(size, {});
+		this->_defs.assign(size, {});
+		this->_successors.assign(size, {});
+		this->_sources.assign(size, std::numeric_limits<size_t>::max());
+
+		auto use = [this](size_t i, const std::string& operand) {
+			if (is_register(operand))
+				this->_uses[i].push_back(this->number(operand));
+		};
+		for (size_t i{ 0 }; i < size; ++i) {
+			const auto* pointer = machine._instructions[i];
+			auto& successors = this->_successors[i];
+
+			if (auto copy = dynamic_cast<const basic::copy_assignment_instruction*>(pointer)) {
+				use(i, copy->left_operand());
+				if (copy->operation_type() != basic::operation::none)
+					use(i, copy->right_operand());
+				this->_defs[i].push_back(this->number(copy->target_register()));
+				if (copy->operation_type() == basic::operation::none && is_register(copy->left_operand())) {
+					this->_sources[i] = this->_uses[i].front();
+					this->_copies.emplace_back(this->_defs[i].front(), this->_sources[i]);
+				}
+				successors.push_back(i + 1);
+			}
+			else if (auto move = dynamic_cast<const basic::move_assignment_instruction*>(pointer)) {
+				use(i, move->from_register());
+				this->_defs[i].push_back(this->number(move->to_register()));
+				this->_defs[i].push_back(this->number(move->from_register()));
+				successors.push_back(i + 1);
+			}
+			else if (auto condition = dynamic_cast<const basic::condition_instruction*>(pointer)) {
+				use(i, condition->compared_register());
+				if (auto comparison = dynamic_cast<const basic::comparison_instruction*>(pointer))
+					use(i, comparison->compared_operand());
+				successors.push_back(condition->goto_true());
+				successors.push_back(condition->goto_false());
+			}
+			else if (auto jump = dynamic_cast<const basic::goto_instruction*>(pointer))
+				successors.push_back(jump->target_mark());
+			else if (auto call = dynamic_cast<const basic::call_instruction*>(pointer)) {
+				for (const auto* x : call->arguments())
+					use(i, *x);
+				for (const auto* x : call->results())
+					this->_defs[i].push_back(this->number(*x));
+				successors.push_back(i + 1);
+			}
+			else if (dynamic_cast<const basic::stop_instruction*>(pointer)) {
+				for (const auto& x : machine._output_registers)
+					use(i, x);
+			}
+			else
+				throw std::runtime_error("Filename: " + machine._filename + ". The instruction is not supported by the coalescer: " + pointer->description());
+
+			for (auto x : successors)
+				if (x >= size)
+					throw std::runtime_error("Filename: " + machine._filename + ". The instruction " + std::to_string(i) + " passes control outside the program");
+		}
+	}
+
+	// Computes the registers live after every instruction and at the entry, iterating backwards to the fixed point
+	void register_coalescer::analyze_liveness() {
+		auto size = this->_uses.size();
+		auto words = (this->_names.size() + 63) / 64;
+		this->_live.assign(size, register_set(words, 0));
+		std::vector<register_set> live_in(size, register_set(words, 0));
+
+		for (bool is_changed{ true }; is_changed; ) {
+			is_changed = false;
+			for (size_t i{ size }; i-- > 0; ) {
+				auto& out = this->_live[i];
+				for (auto x : this->_successors[i])
+					for (size_t w{ 0 }; w < words; ++w)
+						out[w] |= live_in[x][w];
+
+				auto in = out;
+				for (auto x : this->_defs[i])
+					in[x / 64] &= ~(uint64_t{ 1 } << (x % 64));
+				for (auto x : this->_uses[i])
+					insert(in, x);
+				if (in != live_in[i]) {
+					live_in[i] = std::move(in);
+					is_changed = true;
+				}
+			}
+		}
+		this->_entry = size != 0 ? std::move(live_in.front()) : register_set(words, 0);
+	}
+
+	// Builds the interference graph
+	// A written register interferes with the registers live after the instruction, except the source of a copy;
+	// the registers of a move and the results of a call interfere with each other, since they are written by one instruction.
+	// The input registers are written at the entry: they interfere with the registers live there,
+	// while the other registers live at the entry hold 0 together, like copies of each other
+	void register_coalescer::build_interference() {
+		auto count = this->_names.size();
+		this->_interference.assign(count, register_set((count + 63) / 64, 0));
+		for (const auto& x : this->_machine->_input_registers)
+			for (size_t y{ 0 }; y < count; ++y)
+				if (contains(this->_entry, y))
+					this->interfere(this->_numbers.at(x), y);
+
+		for (size_t i{ 0 }; i < this->_defs.size(); ++i) {
+			const auto& defs = this->_defs[i];
+			auto copied = this->_sources[i];
+			for (auto x : defs) {
+				for (size_t y{ 0 }; y < this->_names.size(); ++y)
+					if (y != copied && contains(this->_live[i], y))
+						this->interfere(x, y);
+				for (auto y : defs)
+					this->interfere(x, y);
+			}
+		}
+	}
+
+	// Adds the interference of two different registers
+	void register_coalescer::interfere(size_t first, size_t second) {
+		if (first == second)
+			return;
+		insert(this->_interference[first], second);
+		insert(this->_interference[second], first);
+	}
+
+	// Colors the registers, the copied registers are coalesced when they do not interfere
+	// The input and output registers have colors of their own; every other register takes the color of a register it is copied
+	// from or into, otherwise the first color it does not interfere with, otherwise a new color
+	void register_coalescer::color() {
+		auto count = this->_names.size();
+		auto words = (count + 63) / 64;
+		this->_colors.assign(count, count);
+		std::vector<register_set> members{};
+		for (size_t x{ 0 }; x < this->_fixed; ++x) {
+			this->_colors[x] = x;
+			insert(members.emplace_back(words, 0), x);
+		}
+
+		for (size_t x{ this->_fixed }; x < count; ++x) {
+			std::vector<size_t> candidates{};
+			for (const auto& [target, source] : this->_copies) {
+				auto partner = target == x ? source : source == x ? target : count;
+				if (partner != count && this->_colors[partner] != count)
+					candidates.push_back(this->_colors[partner]);
+			}
+			for (size_t c{ 0 }; c < members.size(); ++c)
+				candidates.push_back(c);
+
+			auto it = std::find_if(candidates.begin(), candidates.end(), [&](size_t c) { return !intersects(members[c], this->_interference[x]); });
+			auto c = it != candidates.end() ? *it : members.size();
+			if (c == members.size())
+				members.emplace_back(words, 0);
+			insert(members[c], x);
+			this->_colors[x] = c;
+		}
+		this->_count = members.size();
+	}
+}
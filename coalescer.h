@@ -0,0 +1,93 @@
+﻿#ifndef __REGISTER_MACHINE_COALESCER_
+#define __REGISTER_MACHINE_COALESCER_
+
+#include "register_machine.h"
+#include "specializer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace IMD {
+
+	// Register coalescing: renames the registers of a program, so that registers whose values are never needed at the same time
+	// share a name, in the manner of a graph-coloring register allocator
+	// The liveness of the registers is computed over the instructions, two registers interfere when one of them is written
+	// while the other is live; the registers are colored greedily, a register copied from or into another one takes its color
+	// when it can. The input and output registers keep their names, and the other registers take the name of the first
+	// register of their color. Only the names change: the program executes the same instructions in the same number of steps
+	class register_coalescer {
+	public:
+		// Program with the coalesced registers
+		using coalesced_program = specializer::residual_program;
+
+	private:
+		// Set of registers by their numbers
+		using register_set = std::vector<uint64_t>;
+
+		// Machine holding the loaded instructions
+		std::unique_ptr<extended_register_machine> _machine;
+		// Names of the registers by their numbers: the input and the output registers first, then in the order of appearance
+		std::vector<std::string> _names;
+		std::unordered_map<std::string, size_t> _numbers;
+		// Number of the registers keeping their names
+		size_t _fixed;
+
+		// Registers read and written by every instruction and the numbers of the instructions following it
+		std::vector<std::vector<size_t>> _uses;
+		std::vector<std::vector<size_t>> _defs;
+		std::vector<std::vector<size_t>> _successors;
+		// Register copied by every instruction, the maximum size_t for the other instructions
+		std::vector<size_t> _sources;
+		// Registers live after every instruction and at the entry
+		std::vector<register_set> _live;
+		register_set _entry;
+		// Registers interfering with every register
+		std::vector<register_set> _interference;
+		// Pairs of registers copied one into another
+		std::vector<std::pair<size_t, size_t>> _copies;
+		// Color of every register and the number of the colors
+		std::vector<size_t> _colors;
+		size_t _count;
+
+	public:
+		// Constructor: loads the program, which must consist of a single stage
+		explicit register_coalescer(const std::string& filename);
+
+		// Copy constructor
+		register_coalescer(const register_coalescer&) = delete;
+		// Assignment operator
+		register_coalescer& operator=(const register_coalescer&) = delete;
+
+		// Destructor
+		~register_coalescer() = default;
+
+		// Returns the program with the coalesced registers
+		coalesced_program coalesce() const;
+
+		// Returns the number of registers of the program
+		size_t registers() const noexcept;
+		// Returns the number of registers of the coalesced program
+		size_t coalesced_registers() const noexcept;
+
+	private:
+		// Returns the number of the register, a new register is numbered after the others
+		size_t number(const std::string& name);
+		// Collects the registers read and written by the instructions and the instructions following them
+		void collect();
+		// Computes the registers live after every instruction and at the entry, iterating backwards to the fixed point
+		void analyze_liveness();
+		// Builds the interference graph
+		void build_interference();
+		// Adds the interference of two different registers
+		void interfere(size_t first, size_t second);
+		// Colors the registers, the copied registers are coalesced when they do not interfere
+		void color();
+	};
+}
+
+#endif
@@ -0,0 +1,712 @@
+﻿#ifndef __REGISTER_MACHINE_CONSTEXPR_
+#define __REGISTER_MACHINE_CONSTEXPR_
+
+#if __cplusplus < 202002L
+#error "The compile-time register machine requires C++20"
+#endif
+
+#include "grammar.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Compile-time RM: a program in a string literal is parsed, verified and executed in constant expressions
+// Tokens, keywords, literals and the values of the operations and relations are taken from the grammar shared with the runtime machines,
+// the productions and the verification rules are those of basic_parser, extended_parser and basic_register_machine::verify.
+// A program fixed at build time consists of a single stage: call and composition instructions are not supported
+namespace IMD::compile_time {
+
+	// No limit on the number of steps
+	inline constexpr size_t NO_LIMIT{ std::numeric_limits<size_t>::max() };
+
+	// Reports an error of the program; the function is not constexpr, so an error met during constant evaluation
+	// stops the compilation with the message in the diagnostic, and an error met at run time throws
+	[[noreturn]] inline void fail(const char* message, size_t line = NO_LIMIT) {
+		if (line == NO_LIMIT)
+			throw std::runtime_error(std::string("Compile-time program. ") + message);
+		throw std::runtime_error("Compile-time program. Invalid instruction at line " + std::to_string(line) + ": " + message);
+	}
+
+	// Operation codes of the decoded instructions
+	enum class opcode : unsigned char {
+		copy, // target <- left, or target <- left operation right
+		move, // target <<- left
+		compare, // if target relation right then goto goto_true else goto goto_false
+		jump, // goto goto_true
+		stop // stop
+	};
+
+	// Operand of an instruction: a literal or the number of a register
+	struct operand {
+		bool is_literal{ false };
+		size_t index{ 0 };
+		int value{ 0 };
+	};
+
+	// Decoded instruction; the conditions of the basic and the extended RM are comparisons with a literal for equality
+	struct instruction {
+		opcode code{ opcode::stop };
+		// Target register of a copy or a move, compared register of a comparison
+		size_t target{ 0 };
+		grammar::operation operation{ grammar::operation::none };
+		grammar::relation relation{ grammar::relation::equal };
+		operand left{};
+		operand right{};
+		size_t goto_true{ 0 };
+		size_t goto_false{ 0 };
+	};
+
+	// Program decoded from its text
+	struct program_image {
+		std::vector<instruction> code;
+		// Names of the registers by their numbers, the views refer to the text of the program
+		std::vector<std::string_view> names;
+		// Numbers of the input and output registers
+		std::vector<size_t> inputs;
+		std::vector<size_t> outputs;
+
+		// Returns the number of the register, a new register gets the next number
+		constexpr size_t register_of(std::string_view name) {
+			for (size_t i{ 0 }; i < this->names.size(); ++i)
+				if (this->names[i] == name)
+					return i;
+			this->names.push_back(name);
+			return this->names.size() - 1;
+		}
+	};
+
+	// Token of an instruction
+	struct token {
+		grammar::token_type type;
+		std::string_view text;
+	};
+
+	// Splits the instruction into tokens by the rules of basic_lexer or extended_lexer
+	constexpr std::vector<token> tokenize(std::string_view line, bool is_extended, size_t number) {
+		std::vector<token> tokens{};
+		size_t carriage{ 0 };
+		while (true) {
+			grammar::skip_spaces(line, carriage);
+			if (carriage >= line.size())
+				break;
+
+			auto keyword = is_extended ? grammar::match_keyword(line, carriage, grammar::extended_keywords) : grammar::match_keyword(line, carriage, grammar::basic_keywords);
+			if (keyword) {
+				carriage += keyword->text.size();
+				tokens.push_back({ keyword->type, keyword->text });
+				continue;
+			}
+
+			auto text = grammar::next_word(line, carriage);
+			auto type = grammar::classify(text);
+			if (type == grammar::token_type::unknown)
+				fail(grammar::is_negative_literal(text) ? "Expected a non-negative integer literal" : "Unknown token", number);
+			tokens.push_back({ type, text });
+		}
+		return tokens;
+	}
+
+	// Parser of an instruction by the productions of basic_parser or extended_parser; the tokens after a complete instruction are ignored
+	class parser {
+	private:
+		using token_type = grammar::token_type;
+
+		const std::vector<token>& _tokens;
+		size_t _carriage;
+		program_image& _image;
+		// Number of the instruction, for the messages
+		size_t _number;
+
+	public:
+		// Constructor
+		constexpr parser(const std::vector<token>& tokens, program_image& image, size_t number) noexcept : _tokens(tokens), _carriage(0), _image(image), _number(number) {}
+
+		// Returns the instruction of the basic RM
+		constexpr instruction make_basic_instruction() {
+			if (this->eof())
+				this->fail("Empty instruction");
+
+			if (this->is_type_match(token_type::keyword_stop))
+				return { opcode::stop };
+
+			if (this->is_type_match(token_type::keyword_if)) { // if R == 0 then goto A else goto B
+				++this->_carriage;
+				auto compared = this->expect(token_type::variable, "Expected register after if");
+				this->expect(token_type::operator_equal, "Expected '==' after register");
+				if (!this->is_type_match(token_type::literal) || this->preview().text != "0")
+					this->fail("Expected number 0 after '=='");
+				++this->_carriage;
+				return this->make_jump_targets({ opcode::compare, this->_image.register_of(compared.text), grammar::operation::none, grammar::relation::equal, {}, { true, 0, 0 } });
+			}
+
+			if (!this->is_type_match(token_type::variable))
+				this->fail("Unknown instruction start");
+
+			// R <- R + 1, R <- R - 1 or R <- literal
+			auto target = this->preview();
+			++this->_carriage;
+			this->expect(token_type::operator_copy_assignment, "Expected '<-' after target register");
+			if (this->eof() || (this->preview().type != token_type::variable && this->preview().type != token_type::literal))
+				this->fail("Expected register after '<-'");
+			auto left = this->preview();
+			if (left.type == token_type::variable && left.text != target.text)
+				this->fail("Left operand must be the same register as target in addition");
+			++this->_carriage;
+
+			instruction x{ opcode::copy, this->_image.register_of(target.text), grammar::operation::none, grammar::relation::equal, this->make_operand(left), {} };
+			if (this->is_type_match(token_type::operator_plus) || this->is_type_match(token_type::operator_minus)) {
+				x.operation = *grammar::operation_of(this->preview().type);
+				++this->_carriage;
+				if (this->eof() || this->preview().type != token_type::literal)
+					this->fail("Expected number after the operator");
+				if (this->preview().text != "1")
+					this->fail("Only increment and decrement by 1 are allowed");
+				x.right = this->make_operand(this->preview());
+				return x;
+			}
+
+			if (left.type != token_type::literal)
+				this->fail("Simple assignment only allows positive integer literals");
+			return x;
+		}
+
+		// Returns the instruction of the extended RM
+		constexpr instruction make_extended_instruction() {
+			if (this->eof())
+				this->fail("Empty instruction");
+
+			auto type = this->preview().type;
+			if (type == token_type::keyword_composition)
+				this->fail("Call and composition instructions are not supported at compile time");
+
+			if (type == token_type::keyword_stop)
+				return { opcode::stop };
+
+			if (type == token_type::keyword_if) { // if R relation operand then goto A else goto B
+				++this->_carriage;
+				auto compared = this->expect(token_type::variable, "Expected register after if");
+				auto relation = this->eof() ? std::nullopt : grammar::relation_of(this->preview().type);
+				if (!relation.has_value())
+					this->fail("Expected comparison operator after register");
+				++this->_carriage;
+				if (!this->is_type_match(token_type::variable) && !this->is_type_match(token_type::literal))
+					this->fail("Expected register or literal after comparison operator");
+				auto right = this->make_operand(this->preview());
+				++this->_carriage;
+				return this->make_jump_targets({ opcode::compare, this->_image.register_of(compared.text), grammar::operation::none, *relation, {}, right });
+			}
+
+			if (type == token_type::keyword_goto) { // goto A
+				++this->_carriage;
+				instruction x{ opcode::jump };
+				x.goto_true = this->make_target();
+				return x;
+			}
+
+			if (type != token_type::variable || this->_carriage + 1 >= this->_tokens.size())
+				this->fail("Expected assignment operator after register");
+
+			auto target = this->preview();
+			++this->_carriage;
+
+			if (this->is_type_match(token_type::operator_move_assignment)) { // R <<- S
+				++this->_carriage;
+				auto from = this->expect(token_type::variable, "Expected register after '<<-'");
+				return { opcode::move, this->_image.register_of(target.text), grammar::operation::none, grammar::relation::equal, { false, this->_image.register_of(from.text), 0 } };
+			}
+
+			// R <- operand, or R <- operand operator operand
+			this->expect(token_type::operator_copy_assignment, "Expected assignment operator after register");
+			if (this->eof() || (this->preview().type != token_type::variable && this->preview().type != token_type::literal))
+				this->fail("Expected register or literal after '<-'");
+			instruction x{ opcode::copy, this->_image.register_of(target.text), grammar::operation::none, grammar::relation::equal, this->make_operand(this->preview()) };
+			++this->_carriage;
+
+			if (auto operation = this->eof() ? std::nullopt : grammar::operation_of(this->preview().type)) {
+				++this->_carriage;
+				if (this->eof() || (this->preview().type != token_type::variable && this->preview().type != token_type::literal))
+					this->fail("Expected number or literal after the operator");
+				x.operation = *operation;
+				x.right = this->make_operand(this->preview());
+			}
+			return x;
+		}
+
+	private:
+		// Checks for the end of the tokens
+		constexpr bool eof() const noexcept {
+			return this->_carriage >= this->_tokens.size();
+		}
+		// Returns the current token
+		constexpr const token& preview() const {
+			return this->_tokens[this->_carriage];
+		}
+		// Checks if the current token has the given type
+		constexpr bool is_type_match(token_type type) const noexcept {
+			return !this->eof() && this->preview().type == type;
+		}
+		// Returns the current token of the given type and moves past it
+		constexpr token expect(token_type type, const char* message) {
+			if (!this->is_type_match(type))
+				this->fail(message);
+			return this->_tokens[this->_carriage++];
+		}
+		// Reports an error of the instruction
+		[[noreturn]] void fail(const char* message) const {
+			compile_time::fail(message, this->_number);
+		}
+
+		// Returns the operand of a register or a literal within the register range
+		constexpr operand make_operand(const token& x) {
+			if (x.type == token_type::variable)
+				return { false, this->_image.register_of(x.text), 0 };
+			auto value = grammar::literal_value(x.text);
+			if (!value)
+				this->fail("The literal is out of the register range");
+			return { true, 0, *value };
+		}
+		// Returns the number of the instruction after goto
+		constexpr size_t make_target() {
+			if (!this->is_type_match(token_type::literal))
+				this->fail("Expected number after 'goto'");
+			auto target = grammar::literal_value(this->preview().text);
+			if (!target)
+				this->fail("The jump target is out of range");
+			++this->_carriage;
+			return static_cast<size_t>(*target);
+		}
+		// Completes the condition with its jump targets: then goto A else goto B
+		constexpr instruction make_jump_targets(instruction x) {
+			this->expect(token_type::keyword_then, "Expected 'then'");
+			this->expect(token_type::keyword_goto, "Expected 'goto' after 'then'");
+			x.goto_true = this->make_target();
+			this->expect(token_type::keyword_else, "Expected 'else'");
+			this->expect(token_type::keyword_goto, "Expected 'goto' after 'else'");
+			x.goto_false = this->make_target();
+			return x;
+		}
+	};
+
+	// Appends the registers listed in the line
+	constexpr void parse_registers(program_image& image, std::string_view line, std::vector<size_t>& registers, const char* message) {
+		size_t carriage{ 0 };
+		while (true) {
+			grammar::skip_spaces(line, carriage);
+			if (carriage >= line.size())
+				break;
+			auto name = grammar::next_word(line, carriage);
+			if (!grammar::is_register(name))
+				fail(message);
+			registers.push_back(image.register_of(name));
+		}
+	}
+
+	// Decodes the program in the format of a program file: the input registers, the numbered instructions and the output registers
+	constexpr program_image parse(std::string_view text, bool is_extended = true) {
+		program_image image{};
+
+		// Returns the next line without the comment and the surrounding whitespace, std::nullopt at the end of the text
+		size_t position{ 0 };
+		auto next_line = [&text, &position]() -> std::optional<std::string_view> {
+			if (position >= text.size())
+				return std::nullopt;
+			auto line_end = text.find('\n', position);
+			if (line_end == std::string_view::npos)
+				line_end = text.size();
+			auto line = text.substr(position, line_end - position);
+			position = line_end + 1;
+			return grammar::strip(line);
+		};
+
+		std::optional<std::string_view> line{};
+		while ((line = next_line()))
+			if (!line->empty()) break;
+		if (!line || line->empty())
+			fail("No input registers");
+		parse_registers(image, *line, image.inputs, "The input register string contains a non-register value");
+
+		size_t expected_number{ 0 }; // Instructions must be numbered sequentially
+		while ((line = next_line())) {
+			if (line->empty()) continue;
+
+			auto separator_position = line->find(grammar::separator);
+			if (separator_position == std::string_view::npos)
+				break;
+
+			auto number = grammar::strip(line->substr(0, separator_position));
+			if (number.empty())
+				fail("Expected an instruction with the next number");
+			if (!grammar::is_non_negative_literal(number))
+				fail("The instruction must be numbered with a non-negative integer");
+			if (auto value = grammar::literal_value(number); !value || static_cast<size_t>(*value) != expected_number)
+				fail("Instructions must be numbered sequentially");
+
+			auto tokens = tokenize(grammar::strip(line->substr(separator_position + grammar::separator.size())), is_extended, expected_number);
+			parser parser(tokens, image, expected_number);
+			image.code.push_back(is_extended ? parser.make_extended_instruction() : parser.make_basic_instruction());
+			++expected_number;
+		}
+
+		if (!line || line->empty())
+			fail("No output registers");
+		parse_registers(image, *line, image.outputs, "The output register string contains a non-register value");
+
+		// There should be no extra entries after the output registers
+		while ((line = next_line()))
+			if (!line->empty())
+				fail("There should be no extra entries after the output registers");
+
+		return image;
+	}
+
+	// Verifies the decoded program by the rules of the runtime verifier: the jump targets are in range, the last instruction
+	// does not fall through, a stop instruction is reachable and every register is assigned on every path before it is read
+	constexpr void verify(const program_image& image) {
+		auto size = image.code.size();
+
+		bool is_stop_present{ false };
+		for (size_t i{ 0 }; i < size; ++i) {
+			const auto& x = image.code[i];
+			if (x.code == opcode::stop)
+				is_stop_present = true;
+			else if ((x.code == opcode::copy || x.code == opcode::move) && i + 1 >= size)
+				fail("the last instruction must be stop or a jump", i);
+			else if ((x.code == opcode::compare || x.code == opcode::jump) && x.goto_true >= size)
+				fail("the jump target is out of range", i);
+			else if (x.code == opcode::compare && x.goto_false >= size)
+				fail("the jump target is out of range", i);
+		}
+		if (!is_stop_present)
+			fail("Verification failed: the program has no stop instruction");
+
+		// Definite assignment: the registers existing before an instruction are the intersection over the paths leading to it
+		std::vector<std::vector<bool>> assigned(size);
+		std::vector<bool> is_reached(size, false);
+		std::vector<bool> initial(image.names.size(), false);
+		for (auto r : image.inputs)
+			initial[r] = true;
+		for (auto r : image.outputs)
+			initial[r] = true;
+		assigned[0] = initial;
+		is_reached[0] = true;
+
+		std::vector<size_t> worklist{ 0 };
+		while (!worklist.empty()) {
+			auto i = worklist.back();
+			worklist.pop_back();
+
+			const auto& x = image.code[i];
+			auto state = assigned[i];
+			size_t next[2]{ i + 1, NO_LIMIT };
+			switch (x.code) {
+			case opcode::stop:
+				continue;
+			case opcode::copy:
+				state[x.target] = true;
+				break;
+			case opcode::move: // Both registers are created by the move
+				state[x.target] = true;
+				state[x.left.index] = true;
+				break;
+			case opcode::compare: // The compared registers are created by the condition
+				state[x.target] = true;
+				if (!x.right.is_literal)
+					state[x.right.index] = true;
+				next[0] = x.goto_true;
+				next[1] = x.goto_false;
+				break;
+			case opcode::jump:
+				next[0] = x.goto_true;
+				break;
+			}
+
+			for (auto target : next) {
+				if (target == NO_LIMIT)
+					continue;
+				bool is_changed{ !is_reached[target] };
+				if (!is_reached[target])
+					assigned[target] = state;
+				else
+					for (size_t r{ 0 }; r < state.size(); ++r)
+						if (assigned[target][r] && !state[r]) {
+							assigned[target][r] = false;
+							is_changed = true;
+						}
+				is_reached[target] = true;
+				if (is_changed)
+					worklist.push_back(target);
+			}
+		}
+
+		bool is_stop_reached{ false };
+		for (size_t i{ 0 }; i < size; ++i) { // The sets are final: the reads are checked on the reachable code
+			if (!is_reached[i])
+				continue;
+			const auto& x = image.code[i];
+			if (x.code == opcode::stop)
+				is_stop_reached = true;
+			if (x.code != opcode::copy)
+				continue;
+			if (!x.left.is_literal && !assigned[i][x.left.index])
+				fail("a register may be read before it is assigned", i);
+			if (x.operation != grammar::operation::none && !x.right.is_literal && !assigned[i][x.right.index])
+				fail("a register may be read before it is assigned", i);
+		}
+		if (!is_stop_reached)
+			fail("Verification failed: no stop instruction is reachable from line 0");
+	}
+
+	// Result of a launch
+	template <typename Values>
+	struct result {
+		// The machine has stopped within the step limit
+		bool is_stopped;
+		// Number of executed instructions, the stop instruction included
+		size_t steps;
+		// Values of the output registers
+		Values outputs;
+	};
+
+	// Executes the verified code on the registers from the instruction 0, at most max_steps instructions;
+	// returns true if the machine has stopped and the number of executed instructions
+	template <typename Code, typename Registers>
+	constexpr std::pair<bool, size_t> execute(const Code& code, Registers& registers, size_t max_steps = NO_LIMIT) {
+		auto value = [&registers](const operand& x) { return x.is_literal ? x.value : registers[x.index]; };
+
+		size_t carriage{ 0 };
+		for (size_t steps{ 0 }; steps < max_steps; ++steps) {
+			const auto& x = code[carriage];
+			switch (x.code) {
+			case opcode::copy:
+				registers[x.target] = x.operation == grammar::operation::none ? value(x.left) : grammar::apply(x.operation, value(x.left), value(x.right));
+				++carriage;
+				break;
+			case opcode::move:
+				registers[x.target] = registers[x.left.index];
+				registers[x.left.index] = 0;
+				++carriage;
+				break;
+			case opcode::compare:
+				carriage = grammar::holds(x.relation, registers[x.target], value(x.right)) ? x.goto_true : x.goto_false;
+				break;
+			case opcode::jump:
+				carriage = x.goto_true;
+				break;
+			case opcode::stop:
+				return { true, steps + 1 };
+			}
+		}
+		return { false, max_steps };
+	}
+
+	// Launches the decoded program on the values of its input registers
+	constexpr result<std::vector<int>> evaluate(const program_image& image, const std::vector<int>& arguments, size_t max_steps = NO_LIMIT) {
+		if (arguments.size() < image.inputs.size())
+			fail("Not enough input values for arguments");
+
+		std::vector<int> registers(image.names.size(), 0);
+		for (size_t i{ 0 }; i < image.inputs.size(); ++i)
+			registers[image.inputs[i]] = arguments[i];
+
+		auto [is_stopped, steps] = execute(image.code, registers, max_steps);
+		std::vector<int> outputs{};
+		for (auto r : image.outputs)
+			outputs.push_back(registers[r]);
+		return { is_stopped, steps, outputs };
+	}
+
+	// Program compiled in a constant expression: the decoded instructions in arrays sized by the program
+	template <size_t N, size_t R, size_t I, size_t O>
+	struct program {
+		// Number of registers
+		static constexpr size_t registers{ R };
+
+		std::array<instruction, N> code{};
+		std::array<size_t, I> inputs{};
+		std::array<size_t, O> outputs{};
+
+		// Launches the program on the values of its input registers
+		constexpr result<std::array<int, O>> run(const std::array<int, I>& arguments, size_t max_steps = NO_LIMIT) const {
+			std::array<int, R> values{};
+			for (size_t i{ 0 }; i < I; ++i)
+				values[this->inputs[i]] = arguments[i];
+
+			auto [is_stopped, steps] = execute(this->code, values, max_steps);
+			std::array<int, O> outputs{};
+			for (size_t i{ 0 }; i < O; ++i)
+				outputs[i] = values[this->outputs[i]];
+			return { is_stopped, steps, outputs };
+		}
+
+		// Returns true for the instruction 0 and the targets of backward jumps
+		constexpr bool is_loop_head(size_t number) const noexcept {
+			if (number == 0)
+				return true;
+			for (size_t i{ number }; i < N; ++i) {
+				const auto& x = this->code[i];
+				if ((x.code == opcode::jump || x.code == opcode::compare) && x.goto_true == number)
+					return true;
+				if (x.code == opcode::compare && x.goto_false == number)
+					return true;
+			}
+			return false;
+		}
+
+		// Returns the values of the output registers; a program that does not stop is limited only by the compiler
+		template <typename... Arguments> requires (sizeof...(Arguments) == I && (std::is_convertible_v<Arguments, int> && ...))
+		constexpr std::array<int, O> operator()(Arguments... arguments) const {
+			return this->run({ static_cast<int>(arguments)... }).outputs;
+		}
+	};
+
+	// Text of a program as a template argument
+	template <size_t N>
+	struct source {
+		char text[N]{};
+
+		// Constructor from a string literal
+		constexpr source(const char (&text)[N]) {
+			std::copy_n(text, N, this->text);
+		}
+
+		// Returns the text without the terminating zero
+		constexpr std::string_view view() const noexcept {
+			return { this->text, N - 1 };
+		}
+	};
+
+	// Parses and verifies the program at compile time, an invalid program does not compile;
+	// the text is parsed from a local copy: with -fsanitize=undefined the null checks GCC adds to the search
+	// in a string_view over the template argument object itself are not constant expressions
+	template <source Source, bool IsExtended = true>
+	consteval auto compile() {
+		constexpr auto sizes = []() {
+			auto text = Source;
+			auto image = parse(text.view(), IsExtended);
+			verify(image);
+			return std::array<size_t, 4>{ image.code.size(), image.names.size(), image.inputs.size(), image.outputs.size() };
+		}();
+
+		auto text = Source;
+		auto image = parse(text.view(), IsExtended);
+		program<sizes[0], sizes[1], sizes[2], sizes[3]> result{};
+		std::copy(image.code.begin(), image.code.end(), result.code.begin());
+		std::copy(image.inputs.begin(), image.inputs.end(), result.inputs.begin());
+		std::copy(image.outputs.begin(), image.outputs.end(), result.outputs.begin());
+		return result;
+	}
+
+	// Program turned into code by the compiler: every instruction is a function template instantiated for its number,
+	// straight-line code, conditions and forward jumps call their successors directly, so that they are inlined and the operands are constants;
+	// only the instruction 0 and the targets of backward jumps are dispatched by number, once per iteration of a loop
+	template <source Source, bool IsExtended = true>
+	class compiled_program {
+	private:
+		static constexpr auto _program = compile<Source, IsExtended>();
+		static constexpr size_t SIZE{ _program.code.size() };
+		// Number of the dispatched instruction returned when the machine stops
+		static constexpr size_t STOPPED{ SIZE };
+
+		using registers_type = std::array<int, decltype(_program)::registers>;
+
+		// Numbers of the instructions dispatched by number: the instruction 0 and the targets of backward jumps
+		static constexpr size_t HEADS = []() {
+			size_t count{ 0 };
+			for (size_t i{ 0 }; i < SIZE; ++i)
+				count += _program.is_loop_head(i);
+			return count;
+		}();
+		static constexpr auto _heads = []() {
+			std::array<size_t, HEADS> heads{};
+			for (size_t i{ 0 }, k{ 0 }; i < SIZE; ++i)
+				if (_program.is_loop_head(i))
+					heads[k++] = i;
+			return heads;
+		}();
+
+		// Returns the value of the operand
+		template <operand X>
+		static constexpr int value(const registers_type& registers) noexcept {
+			if constexpr (X.is_literal)
+				return X.value;
+			else
+				return registers[X.index];
+		}
+
+		// Executes the instructions from the given one up to a dispatched one, returns its number or STOPPED
+		template <size_t Carriage>
+		static constexpr size_t block(registers_type& registers) noexcept {
+			constexpr auto x = _program.code[Carriage];
+			if constexpr (x.code == opcode::stop)
+				return STOPPED;
+			else if constexpr (x.code == opcode::copy) {
+				if constexpr (x.operation == grammar::operation::none)
+					registers[x.target] = value<x.left>(registers);
+				else
+					registers[x.target] = grammar::apply(x.operation, value<x.left>(registers), value<x.right>(registers));
+				return next<Carriage, Carriage + 1>(registers);
+			}
+			else if constexpr (x.code == opcode::move) {
+				registers[x.target] = registers[x.left.index];
+				registers[x.left.index] = 0;
+				return next<Carriage, Carriage + 1>(registers);
+			}
+			else if constexpr (x.code == opcode::compare) {
+				if (grammar::holds(x.relation, registers[x.target], value<x.right>(registers)))
+					return next<Carriage, x.goto_true>(registers);
+				return next<Carriage, x.goto_false>(registers);
+			}
+			else
+				return next<Carriage, x.goto_true>(registers);
+		}
+
+		// Continues with the target: a forward target is executed directly, a backward one is returned to the dispatcher
+		template <size_t Carriage, size_t Target>
+		static constexpr size_t next(registers_type& registers) noexcept {
+			if constexpr (Target > Carriage)
+				return block<Target>(registers);
+			else
+				return Target;
+		}
+
+		// Executes the block of the dispatched instruction with the given number
+		template <size_t... K>
+		static constexpr size_t dispatch(size_t carriage, registers_type& registers, std::index_sequence<K...>) noexcept {
+			size_t next{ STOPPED };
+			(void)((carriage == _heads[K] && (next = block<_heads[K]>(registers), true)) || ...);
+			return next;
+		}
+
+	public:
+		// Number of the input and output registers
+		static constexpr size_t INPUTS{ _program.inputs.size() };
+		static constexpr size_t OUTPUTS{ _program.outputs.size() };
+
+		// Returns the values of the output registers for the values of the input registers
+		template <typename... Arguments> requires (sizeof...(Arguments) == INPUTS && (std::is_convertible_v<Arguments, int> && ...))
+		constexpr std::array<int, OUTPUTS> operator()(Arguments... arguments) const noexcept {
+			registers_type registers{};
+			size_t i{ 0 };
+			((registers[_program.inputs[i++]] = static_cast<int>(arguments)), ...);
+
+			for (size_t carriage{ 0 }; carriage != STOPPED; )
+				carriage = dispatch(carriage, registers, std::make_index_sequence<HEADS>{});
+
+			std::array<int, OUTPUTS> outputs{};
+			for (size_t k{ 0 }; k < OUTPUTS; ++k)
+				outputs[k] = registers[_program.outputs[k]];
+			return outputs;
+		}
+	};
+}
+
+#endif
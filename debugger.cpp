@@ -0,0 +1,411 @@
+﻿#include "debugger.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace IMD {
+
+	// Constructor
+	debugger::trap::trap(debugger& debugger, const basic_register_machine* program, size_t line, instruction* original) noexcept :
+		instruction(), _debugger(debugger), program(program), line(line), original(original), is_breakpoint(false), watchpoints(), is_return(false) {}
+
+	// Executing the trap
+	void debugger::trap::execute(basic_register_machine& brm) {
+		this->_debugger.on_trap(brm, *this, false);
+	}
+
+	void debugger::trap::execute_verified(basic_register_machine& brm) {
+		this->_debugger.on_trap(brm, *this, true);
+	}
+
+	// Returns the description of the original instruction
+	std::string debugger::trap::description() const {
+		return this->original->description();
+	}
+
+	// Returns the kind of the original instruction
+	auto debugger::trap::kind() const noexcept -> basic_register_machine::instruction_kind {
+		return this->original->kind();
+	}
+
+	// Constructor: loads the program
+	debugger::debugger(const std::string& filename) :
+		_filename(filename), _stages(), _stage(0), _is_started(false), _programs(), _breakpoints(), _watchpoints(), _next_id(1), _traps(), _resumed_at(0), _event() {
+		extended_register_machine erm(filename);
+		this->_stages = erm.load_stages();
+		if (this->_stages.empty())
+			throw std::runtime_error("Filename: " + filename + ". The program has no stages");
+		for (const auto& x : this->_stages)
+			this->add_program(*x);
+	}
+
+	// Adds the program and the programs it calls
+	void debugger::add_program(const basic_register_machine& program) {
+		if (!this->_programs.try_emplace(&program, program._instructions).second)
+			return;
+		for (const auto* x : program._instructions)
+			if (x->kind() == basic_register_machine::instruction_kind::call)
+				if (const auto* callee = static_cast<const basic_register_machine::call_instruction*>(x)->callee(); callee != nullptr)
+					this->add_program(*callee);
+	}
+
+	// Swaps the traps for the current breakpoints and watchpoints
+	void debugger::rearm() {
+		// Returns true if the instruction writes the register
+		auto writes = [](const basic_register_machine::instruction* x, const std::string& name) {
+			switch (x->kind()) {
+			case basic_register_machine::instruction_kind::copy_assignment:
+				return static_cast<const basic_register_machine::copy_assignment_instruction*>(x)->target_register() == name;
+			case basic_register_machine::instruction_kind::move_assignment: {
+				const auto* move = static_cast<const basic_register_machine::move_assignment_instruction*>(x);
+				return move->to_register() == name || move->from_register() == name;
+			}
+			default:
+				return false;
+			}
+		};
+
+		for (const auto& [program, instructions] : this->_programs) {
+			bool is_callee = std::none_of(this->_stages.begin(), this->_stages.end(), [program](const auto& x) { return x.get() == program; });
+			for (size_t line{ 0 }; line < instructions.size(); ++line) {
+				auto* x = instructions[line];
+				bool is_breakpoint = std::any_of(this->_breakpoints.begin(), this->_breakpoints.end(),
+					[&](const breakpoint& b) { return b.line == line && matches(program, b.filename); });
+				std::vector<size_t> watched{};
+				for (size_t i{ 0 }; i < this->_watchpoints.size(); ++i)
+					if (matches(program, this->_watchpoints[i].filename) && writes(x, this->_watchpoints[i].name))
+						watched.push_back(i);
+				// The results of a call are written by the stop instruction of the called program
+				bool is_return = is_callee && !this->_watchpoints.empty() && x->kind() == basic_register_machine::instruction_kind::stop;
+
+				auto it = this->_traps.find({ program, line });
+				if (!is_breakpoint && watched.empty() && !is_return) {
+					if (it != this->_traps.end()) {
+						this->patch(program, line, x);
+						this->_traps.erase(it);
+					}
+					continue;
+				}
+				if (it == this->_traps.end()) {
+					it = this->_traps.emplace(std::make_pair(program, line), std::make_unique<trap>(*this, program, line, x)).first;
+					this->patch(program, line, it->second.get());
+				}
+				it->second->is_breakpoint = is_breakpoint;
+				it->second->watchpoints = std::move(watched);
+				it->second->is_return = is_return;
+			}
+		}
+	}
+
+	// Writes the instruction into every table of the program: its own, of the active calls and of the cached frames
+	// A called program is owned by the stages loaded by the debugger, so its table may be written
+	void debugger::patch(const basic_register_machine* program, size_t line, basic_register_machine::instruction* instruction) {
+		if (std::none_of(this->_stages.begin(), this->_stages.end(), [program](const auto& x) { return x.get() == program; }))
+			const_cast<basic_register_machine*>(program)->_instructions[line] = instruction;
+
+		for (auto& x : this->_stages) {
+			auto& stage = *x;
+			// The table of the running program is in the machine, the tables of the calling programs are in the active frames
+			for (size_t depth{ 0 }; depth <= stage._depth; ++depth)
+				if (program_at(stage, depth) == program)
+					(depth == stage._depth ? stage._instructions : stage._frames[depth].instructions)[line] = instruction;
+			// An inactive frame keeps a copy of the table of its called program for the next call
+			for (size_t i{ stage._depth }; i < stage._frames.size(); ++i)
+				if (stage._frames[i].callee == program)
+					stage._frames[i].instructions[line] = instruction;
+		}
+	}
+
+	// Executes a trap
+	void debugger::on_trap(basic_register_machine& brm, trap& trap, bool is_verified) {
+		if (trap.is_breakpoint && brm._steps != this->_resumed_at) {
+			--brm._steps; // The loop counts the trap as a step, though its instruction is not executed
+			brm._is_stopped = true;
+			auto it = std::find_if(this->_breakpoints.begin(), this->_breakpoints.end(),
+				[&](const breakpoint& b) { return b.line == trap.line && matches(trap.program, b.filename); });
+			this->_event = stop_event{ stop_reason::breakpoint, "breakpoint " + std::to_string(it->id) + " at " + location(trap.program, trap.line) };
+			return;
+		}
+
+		auto depth = brm._depth;
+		if (is_verified)
+			trap.original->execute_verified(brm);
+		else
+			trap.original->execute(brm);
+
+		for (auto i : trap.watchpoints)
+			this->check(brm, this->_watchpoints[i], location(trap.program, trap.line));
+
+		if (trap.is_return && brm._depth < depth) { // The frame of the finished call is the first inactive one
+			const auto& frame = brm._frames[brm._depth];
+			const auto* caller = program_at(brm, brm._depth);
+			for (const auto& x : this->_watchpoints)
+				if (matches(caller, x.filename) && std::any_of(frame.call->results().begin(), frame.call->results().end(), [&](const std::string* r) { return *r == x.name; }))
+					this->check(brm, x, location(caller, frame.return_carriage - 1));
+		}
+	}
+
+	// Stops the launch at a watchpoint if the register has the watched value
+	void debugger::check(basic_register_machine& brm, const watchpoint& watchpoint, const std::string& location) {
+		auto it = brm._registers.find(watchpoint.name);
+		int value = it == brm._registers.end() ? 0 : it->second;
+		if (watchpoint.value && *watchpoint.value != value)
+			return;
+
+		brm._is_stopped = true;
+		if (!this->_event)
+			this->_event = stop_event{ stop_reason::watchpoint, "watchpoint " + std::to_string(watchpoint.id) + ": " + watchpoint.name + " = " + std::to_string(value) + " at " + location };
+	}
+
+	// Returns the program running at the given depth of calls of the stage
+	const basic_register_machine* debugger::program_at(const basic_register_machine& stage, size_t depth) noexcept {
+		return depth == 0 ? &stage : stage._frames[depth - 1].callee;
+	}
+
+	// Returns the location of the instruction: the file and the instruction number
+	std::string debugger::location(const basic_register_machine* program, size_t line) {
+		return program->_filename + ":" + std::to_string(line);
+	}
+
+	// Returns the locations of the breakpoint in the loaded programs, separated by commas
+	std::string debugger::locations(const breakpoint& breakpoint) const {
+		std::set<std::string> locations{}; // A file loaded as several stages is named once
+		for (const auto& [program, instructions] : this->_programs)
+			if (breakpoint.line < instructions.size() && matches(program, breakpoint.filename))
+				locations.insert(location(program, breakpoint.line));
+
+		std::string result{};
+		for (const auto& x : locations)
+			result += (result.empty() ? "" : ", ") + x;
+		return result;
+	}
+
+	// Returns true if the program belongs to the file, an empty file matches every program
+	bool debugger::matches(const basic_register_machine* program, const std::string& filename) {
+		return filename.empty() || program->_filename == filename || std::filesystem::path(program->_filename).filename() == filename;
+	}
+
+	// Starts the launch on the given values of the input registers, stopped before the first instruction
+	void debugger::start(const std::vector<int>& arguments) {
+		this->_stages.front()->start(arguments);
+		this->_stage = 0;
+		this->_is_started = true;
+	}
+
+	// Adds a breakpoint, returns its identifier
+	size_t debugger::add_breakpoint(size_t line, const std::string& filename) {
+		bool is_found{ false };
+		for (const auto& [program, instructions] : this->_programs)
+			is_found = is_found || (line < instructions.size() && matches(program, filename));
+		if (!is_found)
+			throw std::runtime_error("Filename: " + this->_filename + ". There is no instruction " + std::to_string(line) + (filename.empty() ? "" : " in " + filename));
+
+		this->_breakpoints.push_back({ this->_next_id, filename, line });
+		this->rearm();
+		return this->_next_id++;
+	}
+
+	// Adds a watchpoint, returns its identifier
+	size_t debugger::add_watchpoint(const std::string& name, std::optional<int> value, const std::string& filename) {
+		if (!grammar::is_register(name))
+			throw std::runtime_error("Filename: " + this->_filename + ". " + name + " is not a register");
+		if (std::none_of(this->_programs.begin(), this->_programs.end(), [&](const auto& x) { return matches(x.first, filename); }))
+			throw std::runtime_error("Filename: " + this->_filename + ". There is no program " + filename);
+
+		this->_watchpoints.push_back({ this->_next_id, filename, name, value });
+		this->rearm();
+		return this->_next_id++;
+	}
+
+	// Removes the breakpoint or watchpoint, returns false if there is none
+	bool debugger::remove(size_t id) {
+		auto size = this->_breakpoints.size() + this->_watchpoints.size();
+		std::erase_if(this->_breakpoints, [id](const breakpoint& x) { return x.id == id; });
+		std::erase_if(this->_watchpoints, [id](const watchpoint& x) { return x.id == id; });
+		if (size == this->_breakpoints.size() + this->_watchpoints.size())
+			return false;
+
+		this->rearm();
+		return true;
+	}
+
+	// Returns the breakpoints
+	const std::vector<debugger::breakpoint>& debugger::breakpoints() const noexcept {
+		return this->_breakpoints;
+	}
+
+	// Returns the watchpoints
+	const std::vector<debugger::watchpoint>& debugger::watchpoints() const noexcept {
+		return this->_watchpoints;
+	}
+
+	// Executes the given number of instructions, entering the calls, unless a breakpoint or a watchpoint stops the launch earlier
+	debugger::stop_event debugger::step(size_t count) {
+		return this->advance(count);
+	}
+
+	// Continues the launch until a breakpoint, a watchpoint or the end
+	debugger::stop_event debugger::resume() {
+		return this->advance(std::numeric_limits<size_t>::max());
+	}
+
+	// Continues the launch for at most max_steps instructions
+	// The launch stands before the instruction it was stopped at, so a breakpoint there is passed
+	debugger::stop_event debugger::advance(size_t max_steps) {
+		if (!this->_is_started)
+			throw std::runtime_error("Filename: " + this->_filename + ". The launch is not started");
+
+		this->_resumed_at = this->_stages[this->_stage]->_steps;
+		while (true) {
+			auto& stage = *this->_stages[this->_stage];
+			if (!stage._error.empty())
+				return { stop_reason::error, stage._error };
+			if (stage._is_stopped) { // The stage has halted, the next one takes its output registers
+				if (this->_stage + 1 == this->_stages.size())
+					return { stop_reason::halted, "halted" };
+				this->_stages[++this->_stage]->start(stage);
+				this->_resumed_at = std::numeric_limits<size_t>::max();
+				continue;
+			}
+			if (max_steps == 0)
+				return { stop_reason::step, "step" };
+
+			this->_event.reset();
+			auto steps = stage._steps;
+			auto state = stage.resume(max_steps);
+			max_steps -= std::min(max_steps, stage._steps - steps);
+			if (this->_event) { // A trap has stopped the launch
+				stage._is_stopped = false;
+				return *this->_event;
+			}
+			if (state == execution_state::error)
+				return { stop_reason::error, stage._error };
+		}
+	}
+
+	// Returns true if the last stage has halted
+	bool debugger::is_halted() const noexcept {
+		return this->_is_started && this->_stage + 1 == this->_stages.size() && this->_stages.back()->_is_stopped;
+	}
+
+	// Returns the values of the output registers of the last stage
+	std::vector<int> debugger::results() const {
+		return this->_stages.back()->results();
+	}
+
+	// Prints the registers of the running program, sorted by name
+	void debugger::print_registers(std::ostream& os) const {
+		const auto& registers = this->_stages[this->_stage]->_registers;
+		std::map<std::string, int> sorted(registers.begin(), registers.end());
+		for (const auto& [name, value] : sorted)
+			os << name << " = " << value << '\n';
+	}
+
+	// Prints the stage and the active calls with their instructions, the running one last
+	void debugger::print_position(std::ostream& os) const {
+		const auto& stage = *this->_stages[this->_stage];
+		if (this->_stages.size() > 1)
+			os << "stage " << this->_stage << ": " << stage._filename << '\n';
+		for (size_t depth{ 0 }; depth <= stage._depth; ++depth) {
+			const auto* program = program_at(stage, depth);
+			auto line = depth == stage._depth ? stage._carriage : stage._frames[depth].return_carriage - 1;
+			os << "#" << depth << " " << location(program, line) << ": " << this->_programs.at(program)[line]->description() << '\n';
+		}
+	}
+
+	// Prints the stop: its description and the instruction to be executed, or the output registers after the end
+	void debugger::print_stop(std::ostream& os, const stop_event& event) const {
+		os << event.message << '\n';
+		if (event.reason == stop_reason::error)
+			return;
+		if (event.reason == stop_reason::halted) {
+			const auto& stage = *this->_stages.back();
+			auto results = stage.results();
+			for (size_t i{ 0 }; i < results.size(); ++i)
+				os << stage._output_registers[i] << " = " << results[i] << '\n';
+			return;
+		}
+
+		const auto& stage = *this->_stages[this->_stage];
+		const auto* program = program_at(stage, stage._depth);
+		os << location(program, stage._carriage) << ": " << this->_programs.at(program)[stage._carriage]->description() << '\n';
+	}
+
+	// Executes the commands of the stream, one per line, and prints the stops into the output stream
+	// A failed command prints its error and the commands go on
+	void debugger::run(std::istream& is, std::ostream& os) {
+		// Splits [file:]name into the file and the name
+		auto split = [](const std::string& word) {
+			auto separator = word.rfind(':');
+			return separator == std::string::npos ? std::make_pair(std::string{}, word) : std::make_pair(word.substr(0, separator), word.substr(separator + 1));
+		};
+
+		std::string line{};
+		while (std::getline(is, line)) {
+			std::istringstream command(line);
+			std::string name{};
+			if (!(command >> name))
+				continue;
+
+			try {
+				if (name == "break" || name == "b") {
+					std::string word{};
+					command >> word;
+					auto [filename, label] = split(word);
+					auto id = this->add_breakpoint(std::stoul(label), filename);
+					os << "breakpoint " << id << " at " << this->locations(this->_breakpoints.back()) << '\n';
+				}
+				else if (name == "watch") {
+					std::string word{};
+					command >> word;
+					auto [filename, target] = split(word);
+					std::optional<int> value{};
+					if (int x{ 0 }; command >> x)
+						value = x;
+					auto id = this->add_watchpoint(target, value, filename);
+					os << "watchpoint " << id << ": " << word << (value ? " == " + std::to_string(*value) : "") << '\n';
+				}
+				else if (name == "delete" || name == "d") {
+					size_t id{ 0 };
+					command >> id;
+					os << (this->remove(id) ? "deleted " : "no breakpoint or watchpoint ") << id << '\n';
+				}
+				else if (name == "info") {
+					for (const auto& x : this->_breakpoints)
+						os << "breakpoint " << x.id << " at " << this->locations(x) << '\n';
+					for (const auto& x : this->_watchpoints)
+						os << "watchpoint " << x.id << ": " << (x.filename.empty() ? "" : x.filename + ":") << x.name << (x.value ? " == " + std::to_string(*x.value) : "") << '\n';
+				}
+				else if (name == "start") {
+					std::vector<int> arguments{};
+					for (int x{ 0 }; command >> x; )
+						arguments.push_back(x);
+					this->start(arguments);
+					this->print_position(os);
+				}
+				else if (name == "step" || name == "s") {
+					size_t count{ 1 };
+					command >> count;
+					this->print_stop(os, this->step(count));
+				}
+				else if (name == "continue" || name == "c")
+					this->print_stop(os, this->resume());
+				else if (name == "registers" || name == "r")
+					this->print_registers(os);
+				else if (name == "where" || name == "w")
+					this->print_position(os);
+				else if (name == "quit" || name == "q")
+					break;
+				else
+					os << "unknown command " << name << '\n';
+			}
+			catch (const std::exception& e) {
+				os << "error: " << e.what() << '\n';
+			}
+			os.flush();
+		}
+	}
+}
@@ -0,0 +1,182 @@
+﻿#ifndef __REGISTER_MACHINE_DEBUGGER_
+#define __REGISTER_MACHINE_DEBUGGER_
+
+#include "register_machine.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace IMD {
+
+	// Debugger of a launch: stops it at breakpoints on the instruction numbers and at watchpoints on the writes of registers
+	// The conditions are not checked on every step: the affected instructions are swapped in the instruction tables of the machines
+	// for traps holding the original instructions, the rest of the program runs the ordinary loop at full speed.
+	// A breakpoint trap stops the launch before its instruction, a write trap executes its instruction and stops after it
+	// if a watched register is written, a return trap stands for the stop instructions of the called programs and checks
+	// the result registers written by the return. The tables of the active calls and of the cached frames are patched too
+	class debugger {
+	public:
+		// Reason of the stop of the launch
+		enum class stop_reason {
+			step, // The number of steps is executed
+			breakpoint, // A breakpoint is reached
+			watchpoint, // A watched register is written
+			halted, // The last composition stage has executed its stop instruction
+			error // The launch failed
+		};
+
+		// Stop of the launch with its description
+		struct stop_event {
+			stop_reason reason;
+			std::string message;
+		};
+
+		// Breakpoint: the instruction number in the programs of the file, in all programs if the file is empty
+		struct breakpoint {
+			size_t id;
+			std::string filename;
+			size_t line;
+		};
+
+		// Watchpoint: the register of the programs of the file, in all programs if the file is empty;
+		// stops at every write of the register, or only at a write of the value if it is given
+		struct watchpoint {
+			size_t id;
+			std::string filename;
+			std::string name;
+			std::optional<int> value;
+		};
+
+	private:
+		// Instruction swapped for an affected instruction
+		class trap : public basic_register_machine::instruction {
+		private:
+			// Debugger handling the trap
+			debugger& _debugger;
+
+		public:
+			// Program and number of the instruction
+			const basic_register_machine* program;
+			size_t line;
+			// Original instruction
+			instruction* original;
+			// Flag of a breakpoint before the instruction
+			bool is_breakpoint;
+			// Watchpoints whose register the instruction writes
+			std::vector<size_t> watchpoints;
+			// Flag of a stop instruction of a called program returning the results
+			bool is_return;
+
+			// Constructor
+			explicit trap(debugger& debugger, const basic_register_machine* program, size_t line, instruction* original) noexcept;
+
+			// Destructor
+			~trap() override = default;
+
+			// Executing the trap
+			void execute(basic_register_machine& brm) override;
+			void execute_verified(basic_register_machine& brm) override;
+			// Returns the description of the original instruction
+			std::string description() const override;
+			// Returns the kind of the original instruction
+			basic_register_machine::instruction_kind kind() const noexcept override;
+		};
+
+		// File of the program
+		std::string _filename;
+		// Composition stages
+		std::vector<std::unique_ptr<extended_register_machine>> _stages;
+		// Number of the running stage
+		size_t _stage;
+		// Flag of a started launch
+		bool _is_started;
+		// Stages and called programs with their original instructions
+		std::map<const basic_register_machine*, std::vector<basic_register_machine::instruction*>> _programs;
+		// Breakpoints and watchpoints
+		std::vector<breakpoint> _breakpoints;
+		std::vector<watchpoint> _watchpoints;
+		// Identifier of the next breakpoint or watchpoint
+		size_t _next_id;
+		// Traps swapped in, by the program and the instruction number
+		std::map<std::pair<const basic_register_machine*, size_t>, std::unique_ptr<trap>> _traps;
+		// Number of steps of the running stage when the launch was continued: the breakpoint of the first instruction is passed
+		size_t _resumed_at;
+		// Stop reported by a trap
+		std::optional<stop_event> _event;
+
+		// Adds the program and the programs it calls
+		void add_program(const basic_register_machine& program);
+		// Swaps the traps for the current breakpoints and watchpoints
+		void rearm();
+		// Writes the instruction into every table of the program: its own, of the active calls and of the cached frames
+		void patch(const basic_register_machine* program, size_t line, basic_register_machine::instruction* instruction);
+		// Executes a trap
+		void on_trap(basic_register_machine& brm, trap& trap, bool is_verified);
+		// Stops the launch at a watchpoint if the register has the watched value
+		void check(basic_register_machine& brm, const watchpoint& watchpoint, const std::string& location);
+		// Returns the program running at the given depth of calls of the stage
+		static const basic_register_machine* program_at(const basic_register_machine& stage, size_t depth) noexcept;
+		// Returns the location of the instruction: the file and the instruction number
+		static std::string location(const basic_register_machine* program, size_t line);
+		// Returns the locations of the breakpoint in the loaded programs, separated by commas
+		std::string locations(const breakpoint& breakpoint) const;
+		// Returns true if the program belongs to the file, an empty file matches every program
+		static bool matches(const basic_register_machine* program, const std::string& filename);
+		// Continues the launch for at most max_steps instructions
+		stop_event advance(size_t max_steps);
+		// Prints the stop: its description and the instruction to be executed, or the output registers after the end
+		void print_stop(std::ostream& os, const stop_event& event) const;
+
+	public:
+		// Constructor: loads the program
+		explicit debugger(const std::string& filename);
+
+		// Copy constructor
+		debugger(const debugger&) = delete;
+		// Assignment operator
+		debugger& operator=(const debugger&) = delete;
+
+		// Destructor
+		~debugger() = default;
+
+		// Starts the launch on the given values of the input registers, stopped before the first instruction
+		void start(const std::vector<int>& arguments);
+
+		// Adds a breakpoint, returns its identifier
+		size_t add_breakpoint(size_t line, const std::string& filename = "");
+		// Adds a watchpoint, returns its identifier
+		size_t add_watchpoint(const std::string& name, std::optional<int> value = std::nullopt, const std::string& filename = "");
+		// Removes the breakpoint or watchpoint, returns false if there is none
+		bool remove(size_t id);
+		// Returns the breakpoints and the watchpoints
+		const std::vector<breakpoint>& breakpoints() const noexcept;
+		const std::vector<watchpoint>& watchpoints() const noexcept;
+
+		// Executes the given number of instructions, entering the calls, unless a breakpoint or a watchpoint stops the launch earlier
+		stop_event step(size_t count = 1);
+		// Continues the launch until a breakpoint, a watchpoint or the end
+		stop_event resume();
+
+		// Returns true if the last stage has halted
+		bool is_halted() const noexcept;
+		// Returns the values of the output registers of the last stage
+		std::vector<int> results() const;
+		// Prints the registers of the running program, sorted by name
+		void print_registers(std::ostream& os) const;
+		// Prints the stage and the active calls with their instructions, the running one last
+		void print_position(std::ostream& os) const;
+
+		// Executes the commands of the stream, one per line, and prints the stops into the output stream:
+		// break [file:]line, watch [file:]register [value], delete id, info, start values, step [count], continue, registers, where, quit
+		void run(std::istream& is, std::ostream& os);
+	};
+}
+
+#endif
@@ -0,0 +1,1066 @@
+﻿#include "differential.h"
+#include "constexpr_machine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace IMD {
+
+	// Implementation of the generated programs
+
+	// Returns the text of the instruction in the RM syntax
+	std::string generated_instruction::text() const {
+		switch (this->code) {
+		case opcode::assign:
+			return this->target + " " + COPY + " " + this->left;
+		case opcode::plus:
+			return this->target + " " + COPY + " " + this->left + " " + PLUS + " " + this->right;
+		case opcode::minus:
+			return this->target + " " + COPY + " " + this->left + " " + MINUS + " " + this->right;
+		case opcode::multiply:
+			return this->target + " " + COPY + " " + this->left + " " + MULTIPLY + " " + this->right;
+		case opcode::divide:
+			return this->target + " " + COPY + " " + this->left + " " + DIVIDE + " " + this->right;
+		case opcode::modulo:
+			return this->target + " " + COPY + " " + this->left + " " + MODULO + " " + this->right;
+		case opcode::move:
+			return this->target + " " + MOVE + " " + this->left;
+		case opcode::branch:
+			return IF + " " + this->target + " " + EQUAL + " 0 " + THEN + " " + GOTO + " " + std::to_string(this->goto_true) + " " + ELSE + " " + GOTO + " " + std::to_string(this->goto_false);
+		case opcode::compare:
+			return IF + " " + this->target + " " + this->relation + " " + this->right + " " + THEN + " " + GOTO + " " + std::to_string(this->goto_true) + " " + ELSE + " " + GOTO + " " + std::to_string(this->goto_false);
+		case opcode::jump:
+			return GOTO + " " + std::to_string(this->goto_true);
+		case opcode::call: {
+			auto text = COMPOSITION + " helper" + std::to_string(this->callee) + ".txt";
+			for (const auto& x : this->arguments)
+				text += " " + x;
+			text += " " + RESULT;
+			for (const auto& x : this->results)
+				text += " " + x;
+			return text;
+		}
+		default:
+			return STOP;
+		}
+	}
+
+	// Returns true for the copy assignments
+	bool generated_instruction::is_arithmetic() const noexcept {
+		switch (this->code) {
+		case opcode::assign:
+		case opcode::plus:
+		case opcode::minus:
+		case opcode::multiply:
+		case opcode::divide:
+		case opcode::modulo:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Returns the files of the program: pairs <file name, text>, the helpers come first and the file to launch is the last one
+	// The stages before the main one are called in its header in their order; the stages after it are called in its footer,
+	// where composition instructions are executed from the last one to the first, so they are written in reverse order
+	static std::vector<std::pair<std::string, std::string>> program_files(const generated_program& program, const std::filesystem::path& directory) {
+		auto stage_text = [](const generated_stage& stage) {
+			std::string text{};
+			for (const auto& x : stage.inputs)
+				text += x + " ";
+			text += "\n";
+			for (size_t i{ 0 }; i < stage.code.size(); ++i)
+				text += std::to_string(i) + SEPARATOR + " " + stage.code[i].text() + "\n";
+			for (const auto& x : stage.outputs)
+				text += x + " ";
+			return text + "\n";
+		};
+		auto path = [&directory](const std::string& name) {
+			return (directory / name).string();
+		};
+
+		std::vector<std::pair<std::string, std::string>> files{};
+		std::string main{};
+
+		for (size_t i{ 0 }; i < program.helpers.size(); ++i)
+			files.emplace_back(path("helper" + std::to_string(i) + ".txt"), stage_text(program.helpers[i]));
+
+		for (size_t i{ 0 }; i < program.stages.size(); ++i) {
+			if (i == program.main)
+				continue;
+
+			auto name = "stage" + std::to_string(i) + ".txt";
+			files.emplace_back(path(name), stage_text(program.stages[i]));
+			if (i < program.main)
+				main += COMPOSITION + " " + name + "\n";
+		}
+
+		main += stage_text(program.stages[program.main]);
+		for (size_t i{ program.stages.size() - 1 }; i > program.main; --i)
+			main += COMPOSITION + " stage" + std::to_string(i) + ".txt\n";
+		files.emplace_back(path("main.txt"), main);
+
+		if (program.is_wrapped)
+			files.emplace_back(path("program.txt"), COMPOSITION + " main.txt\n");
+
+		return files;
+	}
+
+	// Writes the stage files into the directory, returns the name of the file to launch
+	std::string generated_program::write(const std::filesystem::path& directory) const {
+		auto files = program_files(*this, directory);
+		for (const auto& [name, text] : files) {
+			std::ofstream ofs(name, std::ios::trunc);
+			ofs << text;
+			if (!ofs)
+				throw std::runtime_error("Filename: " + name + ". Error writing file");
+		}
+		return files.back().first;
+	}
+
+	// Prints the files of the program, the composition instructions refer to the files by their names
+	void generated_program::print(std::ostream& os) const {
+		for (const auto& [name, text] : program_files(*this, ""))
+			os << "== " << name << "\n" << text;
+	}
+
+	// Implementation of the reference interpreter
+
+	// Checks the rules of the verifier of the machines: jump targets are in range, no instruction falls through past the end,
+	// a stop instruction is reachable, and copy assignments and calls read only registers assigned on every path
+	bool is_verified(const generated_stage& stage) {
+		using opcode = generated_instruction::opcode;
+		auto size = stage.code.size();
+
+		// Registers are tracked by the bits of a word: generated stages use less than 64 registers
+		std::unordered_map<std::string, size_t> numbers{};
+		auto bit = [&numbers](const std::string& name) {
+			return uint64_t{ 1 } << numbers.try_emplace(name, numbers.size()).first->second;
+		};
+		auto is_literal = [](const std::string& operand) {
+			return !operand.empty() && std::all_of(operand.begin(), operand.end(), ::isdigit);
+		};
+		auto successors = [size](const generated_instruction& x, size_t i) -> std::vector<size_t> {
+			switch (x.code) {
+			case opcode::branch:
+			case opcode::compare:
+				return { x.goto_true, x.goto_false };
+			case opcode::jump:
+				return { x.goto_true };
+			case opcode::stop:
+				return {};
+			default:
+				return { i + 1 };
+			}
+		};
+
+		uint64_t initial{ 0 };
+		for (const auto& x : stage.inputs)
+			initial |= bit(x);
+		for (const auto& x : stage.outputs)
+			initial |= bit(x);
+
+		for (size_t i{ 0 }; i < size; ++i)
+			for (auto next : successors(stage.code[i], i))
+				if (next >= size)
+					return false;
+		if (size == 0)
+			return false;
+
+		// Definite assignment over the paths from the first instruction
+		std::vector<std::optional<uint64_t>> assigned(size);
+		assigned[0] = initial;
+		std::vector<size_t> worklist{ 0 };
+		while (!worklist.empty()) {
+			auto i = worklist.back();
+			worklist.pop_back();
+
+			const auto& x = stage.code[i];
+			auto after = *assigned[i];
+			if (x.code == opcode::move)
+				after |= bit(x.target) | bit(x.left);
+			else if (x.code == opcode::compare) // Both compared registers are created
+				after |= bit(x.target) | (is_literal(x.right) ? 0 : bit(x.right));
+			else if (x.code == opcode::call)
+				for (const auto& y : x.results)
+					after |= bit(y);
+			else if (x.code != opcode::jump && x.code != opcode::stop)
+				after |= bit(x.target);
+
+			for (auto next : successors(x, i)) {
+				auto joined = assigned[next] ? *assigned[next] & after : after;
+				if (!assigned[next] || joined != *assigned[next]) {
+					assigned[next] = joined;
+					worklist.push_back(next);
+				}
+			}
+		}
+
+		bool is_stop_reached{ false };
+		for (size_t i{ 0 }; i < size; ++i) {
+			const auto& x = stage.code[i];
+			if (!assigned[i])
+				continue;
+			if (x.code == opcode::stop)
+				is_stop_reached = true;
+			if (x.code == opcode::call)
+				for (const auto& y : x.arguments)
+					if (!is_literal(y) && !(*assigned[i] & bit(y)))
+						return false;
+			if (!x.is_arithmetic())
+				continue;
+			if (!is_literal(x.left) && !(*assigned[i] & bit(x.left)))
+				return false;
+			if (x.code != opcode::assign && !is_literal(x.right) && !(*assigned[i] & bit(x.right)))
+				return false;
+		}
+
+		return is_stop_reached;
+	}
+
+	// Executes a stage on the values of its input registers, which are replaced by the values of its output registers;
+	// a call executes its helper as a nested stage, the steps of both are counted
+	static execution_state execute(const generated_program& program, const generated_stage& stage, std::vector<int>& values, size_t& steps, size_t max_steps) {
+		if (values.size() < stage.inputs.size())
+			return execution_state::error;
+
+		// The output registers exist from the start, the input registers receive the outputs of the previous stage
+		std::unordered_map<std::string, long long> registers{};
+		for (const auto& x : stage.outputs)
+			registers.try_emplace(x, 0);
+		for (size_t i{ 0 }; i < stage.inputs.size(); ++i)
+			registers[stage.inputs[i]] = values[i];
+
+		// Value of a literal or an existing register; reading a register that does not exist cancels a copy assignment
+		auto value = [&registers](const std::string& operand) -> std::optional<long long> {
+			if (!operand.empty() && std::all_of(operand.begin(), operand.end(), ::isdigit))
+				return std::stoll(operand);
+			auto it = registers.find(operand);
+			if (it == registers.end())
+				return std::nullopt;
+			return it->second;
+		};
+
+		size_t carriage{ 0 };
+		bool is_stopped{ false };
+		while (!is_stopped) {
+			if (carriage >= stage.code.size())
+				return execution_state::error;
+			if (steps == max_steps)
+				return execution_state::running;
+
+			const auto& x = stage.code[carriage];
+			switch (x.code) {
+			case generated_instruction::opcode::assign:
+			case generated_instruction::opcode::plus:
+			case generated_instruction::opcode::minus:
+			case generated_instruction::opcode::multiply:
+			case generated_instruction::opcode::divide:
+			case generated_instruction::opcode::modulo: {
+				++carriage;
+				auto left = value(x.left);
+				auto right = x.code == generated_instruction::opcode::assign ? std::optional<long long>{ 0 } : value(x.right);
+				if (!left || !right)
+					break;
+
+				long long sum{ *left };
+				if (x.code == generated_instruction::opcode::plus)
+					sum = *left + *right;
+				else if (x.code == generated_instruction::opcode::minus)
+					sum = std::max(*left - *right, 0LL);
+				else if (x.code == generated_instruction::opcode::multiply)
+					sum = *left * *right;
+				else if (x.code == generated_instruction::opcode::divide) // Division by 0 gives 0
+					sum = *right == 0 ? 0 : *left / *right;
+				else if (x.code == generated_instruction::opcode::modulo) // The remainder of division by 0 is the dividend
+					sum = *right == 0 ? *left : *left % *right;
+				registers[x.target] = std::min(sum, static_cast<long long>(INT_MAX)); // A sum or a product saturates
+				break;
+			}
+			case generated_instruction::opcode::move: {
+				++carriage;
+				auto moved = registers[x.left];
+				registers[x.target] = moved;
+				registers[x.left] = 0;
+				break;
+			}
+			case generated_instruction::opcode::branch:
+				carriage = registers[x.target] == 0 ? x.goto_true : x.goto_false;
+				break;
+			case generated_instruction::opcode::compare: {
+				auto left = registers[x.target];
+				auto right = value(x.right);
+				if (!right) // The comparison creates the register compared with
+					right = registers[x.right];
+				bool holds = x.relation == EQUAL ? left == *right : x.relation == NOT_EQUAL ? left != *right : x.relation == LESS ? left < *right :
+					x.relation == LESS_EQUAL ? left <= *right : x.relation == GREATER ? left > *right : left >= *right;
+				carriage = holds ? x.goto_true : x.goto_false;
+				break;
+			}
+			case generated_instruction::opcode::jump:
+				carriage = x.goto_true;
+				break;
+			case generated_instruction::opcode::call: { // The machines link a call only to a helper with as many inputs and enough outputs
+				++carriage;
+				if (x.callee >= program.helpers.size())
+					return execution_state::error;
+				const auto& helper = program.helpers[x.callee];
+				if (x.arguments.size() != helper.inputs.size() || x.results.size() > helper.outputs.size())
+					return execution_state::error;
+
+				std::vector<int> arguments{};
+				for (const auto& y : x.arguments) {
+					auto argument = value(y);
+					if (!argument) // A call does not pass a register that does not exist
+						return execution_state::error;
+					arguments.push_back(static_cast<int>(*argument));
+				}
+
+				++steps; // The call is counted before the instructions of the helper
+				auto state = execute(program, helper, arguments, steps, max_steps);
+				if (state != execution_state::halted)
+					return state;
+				for (size_t i{ 0 }; i < x.results.size(); ++i)
+					registers[x.results[i]] = arguments[i];
+				continue;
+			}
+			case generated_instruction::opcode::stop:
+				is_stopped = true;
+				break;
+			}
+			++steps;
+		}
+
+		values.clear();
+		for (const auto& x : stage.outputs)
+			values.push_back(static_cast<int>(registers.at(x)));
+		return execution_state::halted;
+	}
+
+	// Executes a generated program directly by the semantics of the instructions
+	reference_result interpret(const generated_program& program, const std::vector<int>& arguments, size_t max_steps) {
+		reference_result result{ execution_state::halted, arguments, 0 };
+
+		for (const auto* stages : { &program.stages, &program.helpers }) // The machines load every stage and every called program before the launch
+			for (const auto& stage : *stages)
+				if (!is_verified(stage))
+					return { execution_state::error, {}, 0 };
+
+		for (const auto& stage : program.stages) {
+			result.state = execute(program, stage, result.outputs, result.steps, max_steps);
+			if (result.state != execution_state::halted)
+				return { result.state, {}, result.steps };
+		}
+
+		return result;
+	}
+
+	// Implementation of the program generator
+
+	// Names of the data registers
+	static const std::vector<std::string> DATA_REGISTERS{ "a", "b", "c", "x", "y", "z" };
+	// Maximum nesting of loops
+	static constexpr size_t MAX_DEPTH{ 2 };
+
+	// Constructor
+	program_generator::program_generator(uint64_t seed) noexcept : _random(seed), _stage(nullptr), _helpers(nullptr), _is_basic(false), _budget(0), _assigned() {}
+
+	// Returns the next program
+	generated_program program_generator::next() {
+		generated_program program{};
+		program.is_basic = this->chance(25);
+
+		this->_helpers = &program.helpers;
+		for (size_t i{ program.is_basic ? 0 : this->uniform(3) }; i > 0; --i)
+			program.helpers.push_back(this->stage(1 + this->uniform(3), false));
+
+		size_t count = program.is_basic ? 1 : 1 + this->uniform(4);
+		size_t inputs = 1 + this->uniform(3);
+		for (size_t i{ 0 }; i < count; ++i) {
+			program.stages.push_back(this->stage(inputs, program.is_basic));
+			inputs = 1 + this->uniform(program.stages.back().outputs.size()); // Extra outputs of a stage are dropped
+		}
+
+		program.main = this->uniform(count);
+		program.is_wrapped = !program.is_basic && this->chance(20);
+		this->_helpers = nullptr;
+		return program;
+	}
+
+	// Returns the given number of input tuples for the program
+	std::vector<std::vector<int>> program_generator::inputs(const generated_program& program, size_t count) {
+		std::vector<std::vector<int>> result(count);
+		for (auto& tuple : result)
+			for (size_t i{ 0 }; i < program.stages.front().inputs.size(); ++i)
+				tuple.push_back(static_cast<int>(this->chance(90) ? this->uniform(10) : this->uniform(1000)));
+		return result;
+	}
+
+	// Returns a uniformly distributed number from 0 to bound - 1
+	size_t program_generator::uniform(size_t bound) {
+		return std::uniform_int_distribution<size_t>(0, bound - 1)(this->_random);
+	}
+
+	// Returns true with the given probability in percent
+	bool program_generator::chance(size_t percent) {
+		return this->uniform(100) < percent;
+	}
+
+	// Returns the name of a data register; some of them are neither inputs nor outputs
+	std::string program_generator::data_register() {
+		return DATA_REGISTERS[this->uniform(DATA_REGISTERS.size())];
+	}
+
+	// Returns a register assigned on every path to the current position
+	std::string program_generator::assigned_register() {
+		auto it = this->_assigned.begin();
+		std::advance(it, this->uniform(this->_assigned.size()));
+		return *it;
+	}
+
+	// Returns an assigned register or a literal: mostly a small one, sometimes one large enough for a sum or a product to saturate
+	std::string program_generator::operand() {
+		static const std::string LARGE_LITERALS[] = { "46341", std::to_string(INT_MAX) };
+		if (!this->chance(40))
+			return this->assigned_register();
+		return this->chance(75) ? std::to_string(this->uniform(4)) : LARGE_LITERALS[this->uniform(2)];
+	}
+
+	// Returns a subset of the data registers without repetitions, of the given size
+	std::vector<std::string> program_generator::registers(size_t count) {
+		auto result = DATA_REGISTERS;
+		std::shuffle(result.begin(), result.end(), this->_random);
+		result.resize(count);
+		return result;
+	}
+
+	// Generates a stage with the given number of input registers
+	generated_stage program_generator::stage(size_t inputs, bool is_basic) {
+		generated_stage result{ this->registers(inputs), this->registers(1 + this->uniform(3)), {} };
+
+		this->_stage = &result;
+		this->_is_basic = is_basic;
+		this->_budget = 4 + this->uniform(28);
+		this->_assigned.clear();
+		this->_assigned.insert(result.inputs.begin(), result.inputs.end());
+		this->_assigned.insert(result.outputs.begin(), result.outputs.end());
+
+		this->block(0);
+		this->emit({ generated_instruction::opcode::stop, "", "", "", 0, 0 });
+
+		this->_stage = nullptr;
+		return result;
+	}
+
+	// Generates a sequence of statements at the given loop depth
+	void program_generator::block(size_t depth) {
+		for (size_t statements{ 1 + this->uniform(4) }; statements > 0 && this->_budget > 0; --statements) {
+			auto kind = this->uniform(10);
+			if (kind < 2 && !this->_is_basic && !this->_helpers->empty())
+				this->call();
+			else if (kind < 6 || (kind == 9 && depth == MAX_DEPTH))
+				this->assignment();
+			else if (kind < 9)
+				this->branch(depth);
+			else
+				this->loop(depth);
+
+			if (this->chance(2)) // The rest of the block is dead code
+				this->emit({ generated_instruction::opcode::stop, "", "", "", 0, 0 });
+		}
+	}
+
+	// Generates an assignment
+	void program_generator::assignment() {
+		auto target = this->data_register();
+
+		if (this->_is_basic) { // Increment or decrement of an assigned register, assignment of a literal
+			auto kind = this->uniform(3);
+			if (kind == 0) {
+				auto x = this->assigned_register();
+				this->emit({ generated_instruction::opcode::plus, x, x, "1", 0, 0 });
+			}
+			else if (kind == 1) {
+				auto x = this->assigned_register();
+				this->emit({ generated_instruction::opcode::minus, x, x, "1", 0, 0 });
+			}
+			else {
+				this->emit({ generated_instruction::opcode::assign, target, std::to_string(this->uniform(10)), "", 0, 0 });
+				this->_assigned.insert(target);
+			}
+			return;
+		}
+
+		auto kind = this->uniform(10);
+		if (kind < 2) { // Both registers of a move are created
+			auto source = this->data_register();
+			this->emit({ generated_instruction::opcode::move, target, source, "", 0, 0 });
+			this->_assigned.insert(source);
+		}
+		else if (kind < 4)
+			this->emit({ generated_instruction::opcode::assign, target, this->operand(), "", 0, 0 });
+		else if (kind < 6)
+			this->emit({ generated_instruction::opcode::plus, target, this->operand(), this->operand(), 0, 0 });
+		else if (kind < 8)
+			this->emit({ generated_instruction::opcode::minus, target, this->operand(), this->operand(), 0, 0 });
+		else {
+			static const generated_instruction::opcode products[] = { generated_instruction::opcode::multiply, generated_instruction::opcode::divide, generated_instruction::opcode::modulo };
+			this->emit({ products[this->uniform(3)], target, this->operand(), this->operand(), 0, 0 });
+		}
+		this->_assigned.insert(target);
+	}
+
+	// Generates a forward branch with two arms
+	void program_generator::branch(size_t depth) {
+		auto compared = this->data_register();
+		auto condition = this->emit({ generated_instruction::opcode::branch, compared, "", "", 0, 0 });
+		if (!this->_is_basic && this->chance(50)) { // A relation between the register and an operand
+			static const std::string relations[] = { EQUAL, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+			auto& x = this->_stage->code[condition];
+			x.code = generated_instruction::opcode::compare;
+			x.relation = relations[this->uniform(6)];
+			x.right = this->operand();
+		}
+		this->_assigned.insert(compared); // The condition creates the compared register
+		auto assigned = this->_assigned;
+
+		this->_stage->code[condition].goto_false = this->_stage->code.size();
+		this->block(depth);
+		auto skip = this->jump(compared);
+		std::swap(assigned, this->_assigned);
+
+		this->_stage->code[condition].goto_true = this->_stage->code.size();
+		this->block(depth);
+		this->land(skip, this->_stage->code.size());
+
+		// After the branch only the registers assigned in both arms are known
+		for (auto it = this->_assigned.begin(); it != this->_assigned.end(); )
+			it = assigned.count(*it) ? std::next(it) : this->_assigned.erase(it);
+	}
+
+	// Generates a loop counting down a dedicated register
+	void program_generator::loop(size_t depth) {
+		auto counter = "k" + std::to_string(depth);
+
+		if (this->_is_basic || this->chance(50))
+			this->emit({ generated_instruction::opcode::assign, counter, std::to_string(this->uniform(6)), "", 0, 0 });
+		else // The number of iterations depends on the data
+			this->emit({ generated_instruction::opcode::assign, counter, this->assigned_register(), "", 0, 0 });
+		this->_assigned.insert(counter);
+		auto assigned = this->_assigned; // The body may be skipped
+
+		auto head = this->emit({ generated_instruction::opcode::branch, counter, "", "", 0, 0 });
+		this->_stage->code[head].goto_false = this->_stage->code.size();
+		this->block(depth + 1);
+		this->emit({ generated_instruction::opcode::minus, counter, counter, "1", 0, 0 });
+		this->land(this->jump(counter), head);
+		this->_stage->code[head].goto_true = this->_stage->code.size();
+		this->_assigned = std::move(assigned);
+	}
+
+	// Generates a call of a helper generated before the stage: the arguments are operands, some of the outputs are received
+	void program_generator::call() {
+		generated_instruction x{ generated_instruction::opcode::call, "", "", "", 0, 0 };
+		x.callee = this->uniform(this->_helpers->size());
+		const auto& helper = (*this->_helpers)[x.callee];
+		for (size_t i{ 0 }; i < helper.inputs.size(); ++i)
+			x.arguments.push_back(this->operand());
+		x.results = this->registers(this->uniform(helper.outputs.size() + 1));
+		this->_assigned.insert(x.results.begin(), x.results.end());
+		this->emit(std::move(x));
+	}
+
+	// Generates an unconditional jump whose target is set later, a condition with equal targets in the basic syntax
+	size_t program_generator::jump(const std::string& any_register) {
+		if (this->_is_basic)
+			return this->emit({ generated_instruction::opcode::branch, any_register, "", "", 0, 0 });
+		return this->emit({ generated_instruction::opcode::jump, "", "", "", 0, 0 });
+	}
+
+	// Sets the target of a generated jump
+	void program_generator::land(size_t jump, size_t target) {
+		this->_stage->code[jump].goto_true = target;
+		this->_stage->code[jump].goto_false = target;
+	}
+
+	// Adds an instruction, returns its number
+	size_t program_generator::emit(generated_instruction instruction) {
+		if (this->_budget > 0)
+			--this->_budget;
+		this->_stage->code.push_back(std::move(instruction));
+		return this->_stage->code.size() - 1;
+	}
+
+	// Implementation of the differential checker
+
+	// The compiled callable dispatches the instructions differently from the interpreter of the compile-time machine,
+	// both are checked by the compiler on a fixed program
+	static constexpr char PRODUCT[] = "a b\n0: r <- 0\n1: if b == 0 then goto 5 else goto 2\n2: r <- r + a\n3: b <- b - 1\n4: goto 1\n5: stop\nr\n";
+	static_assert(compile_time::compile<PRODUCT>()(6, 7)[0] == 42 && compile_time::compile<PRODUCT>().run({ 6, 7 }).steps == 31);
+	static_assert(compile_time::compiled_program<PRODUCT>{}(6, 7)[0] == 42);
+
+	// Returns the text of the main file with the instruction cut right after a random operator or keyword that needs an operand,
+	// so that the instruction does not parse; std::nullopt if the instruction has no such place
+	static std::optional<std::string> malformed_text(const generated_program& program, size_t line, std::mt19937_64& random) {
+		static const std::set<std::string> incomplete{ COPY, MOVE, PLUS, MINUS, MULTIPLY, DIVIDE, MODULO, EQUAL, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, IF, THEN, ELSE, GOTO, COMPOSITION };
+
+		auto text = program.stages[program.main].code[line].text();
+		std::vector<size_t> cuts{};
+		for (size_t i{ 0 }, end{ 0 }; i < text.size(); i = end + 1) {
+			end = std::min(text.find(' ', i), text.size());
+			if (incomplete.contains(text.substr(i, end - i)))
+				cuts.push_back(end);
+		}
+		if (cuts.empty())
+			return std::nullopt;
+
+		auto files = program_files(program, "");
+		auto main = files[program.is_wrapped ? files.size() - 2 : files.size() - 1].second;
+		auto prefix = std::to_string(line) + SEPARATOR + " ";
+		auto position = main.find("\n" + prefix + text + "\n") + 1;
+		return main.replace(position + prefix.size(), text.size(), text.substr(0, cuts[random() % cuts.size()]));
+	}
+
+	// Constructor: the program files are written into the directory
+	differential_checker::differential_checker(const std::filesystem::path& directory, uint64_t seed) : _directory(std::filesystem::absolute(directory)), _scheduler(2, 3), _cache(), _cached(0), _instruction_sets(), _random(seed) {
+		std::filesystem::create_directories(this->_directory);
+
+		// The lockstep machine replaces an unsupported instruction set by the best supported one
+		generated_program probe{ false, 0, false, { { { "x" }, { "x" }, { { generated_instruction::opcode::stop, "", "", "", 0, 0 } } } } };
+		auto filename = probe.write(this->_directory);
+		for (auto instruction_set : { lockstep_machine::isa::scalar, lockstep_machine::isa::avx2, lockstep_machine::isa::avx512 })
+			if (lockstep_machine(filename, 8, instruction_set).instruction_set() == instruction_set)
+				this->_instruction_sets.push_back(instruction_set);
+	}
+
+	// Destructor: removes the directory
+	differential_checker::~differential_checker() {
+		std::error_code error{};
+		std::filesystem::remove_all(this->_directory, error);
+	}
+
+	// Checks the program on the input tuples, returns the discrepancies
+	std::vector<differential_checker::mismatch> differential_checker::check(const generated_program& program, const std::vector<std::vector<int>>& inputs) {
+		std::vector<mismatch> mismatches{};
+
+		std::vector<std::vector<int>> tuples{};
+		std::vector<reference_result> expected{};
+		for (const auto& input : inputs) {
+			auto result = interpret(program, input, MAX_STEPS);
+			if (result.state != execution_state::halted) // Too long or invalid launches are not compared
+				continue;
+			tuples.push_back(input);
+			expected.push_back(std::move(result));
+		}
+		if (tuples.empty())
+			return mismatches;
+
+		auto filename = program.write(this->_directory);
+		bool is_calling = std::any_of(program.stages.begin(), program.stages.end(), [](const generated_stage& stage) {
+			return std::any_of(stage.code.begin(), stage.code.end(), [](const generated_instruction& x) { return x.code == generated_instruction::opcode::call; });
+		});
+
+		// Compares the result of a configuration, the number of steps is compared when it is known
+		auto compare = [&](const std::string& engine, size_t i, const reference_result& actual, bool has_steps) {
+			if (actual.state != execution_state::halted || actual.outputs != expected[i].outputs || (has_steps && actual.steps != expected[i].steps))
+				mismatches.push_back({ engine, tuples[i], expected[i], actual, "" });
+		};
+		// Launches a configuration, an exception is a discrepancy on the first tuple
+		auto guarded = [&](const std::string& engine, auto launch) {
+			try {
+				launch();
+			}
+			catch (const std::exception& e) {
+				mismatches.push_back({ engine, tuples.front(), expected.front(), { execution_state::error, {}, 0 }, e.what() });
+			}
+		};
+
+		if (program.is_basic)
+			guarded("basic", [&]() {
+				basic_register_machine machine(filename);
+				machine.load_all_instructions();
+				for (size_t i{ 0 }; i < tuples.size(); ++i) {
+					auto outputs = machine.evaluate(tuples[i]);
+					compare("basic", i, { execution_state::halted, outputs, machine.steps() }, true);
+				}
+			});
+
+		guarded("evaluate", [&]() {
+			extended_register_machine erm(filename);
+			auto stages = erm.load_stages();
+			for (size_t i{ 0 }; i < tuples.size(); ++i) {
+				auto values = tuples[i];
+				size_t steps{ 0 };
+				for (const auto& stage : stages) {
+					values = stage->evaluate(values);
+					steps += stage->steps();
+				}
+				compare("evaluate", i, { execution_state::halted, values, steps }, true);
+			}
+		});
+
+		guarded("resume", [&]() {
+			execution launch(filename);
+			for (size_t i{ 0 }; i < tuples.size(); ++i) {
+				launch.start(tuples[i]);
+				while (launch.resume(1 + this->_random() % 7) == execution_state::running) {}
+				auto outputs = launch.state() == execution_state::halted ? launch.results() : std::vector<int>{};
+				compare("resume", i, { launch.state(), outputs, launch.steps() }, true);
+			}
+		});
+
+		guarded("scheduler", [&]() {
+			for (const auto& tuple : tuples)
+				this->_scheduler.submit(std::make_unique<execution>(filename), tuple);
+			auto results = this->_scheduler.wait();
+			for (size_t i{ 0 }; i < tuples.size(); ++i)
+				compare("scheduler", i, { results[i].state, results[i].outputs, results[i].steps }, true);
+		});
+
+		guarded("pipeline", [&]() {
+			auto outputs = pipeline(filename).run(tuples);
+			for (size_t i{ 0 }; i < tuples.size(); ++i)
+				compare("pipeline", i, { execution_state::halted, outputs[i], 0 }, false);
+		});
+
+		const char* isa_names[] = { "scalar", "avx2", "avx512" };
+		for (auto instruction_set : this->_instruction_sets) {
+			if (is_calling) // The lockstep machine does not support calls
+				break;
+			auto engine = "lockstep-"s + isa_names[static_cast<int>(instruction_set)];
+			guarded(engine, [&]() {
+				static const size_t lanes[] = { 4, 8, 16 };
+				lockstep_machine machine(filename, lanes[this->_random() % 3], instruction_set);
+				auto outputs = machine.run(tuples);
+				for (size_t i{ 0 }; i < tuples.size(); ++i)
+					compare(engine, i, { execution_state::halted, outputs[i], machine.steps()[i] }, true);
+			});
+		}
+
+		// The residual program of every tuple is launched on the rest of the tuple, its number of steps differs
+		if (program.stages.size() == 1 && !program.stages.front().inputs.empty() && !is_calling)
+			guarded("specialize", [&]() {
+				const auto& inputs = program.stages.front().inputs;
+				specializer specializer(filename);
+				auto residual_filename = (this->_directory / "residual.txt").string();
+				for (size_t i{ 0 }; i < tuples.size(); ++i) {
+					auto residual = specializer.specialize({ { inputs.front(), tuples[i].front() } });
+					residual.write(residual_filename);
+					std::vector<int> arguments{};
+					for (const auto& x : residual.inputs)
+						arguments.push_back(tuples[i][std::find(inputs.begin(), inputs.end(), x) - inputs.begin()]);
+
+					extended_register_machine erm(residual_filename);
+					auto stages = erm.load_stages();
+					auto outputs = stages.front()->evaluate(arguments);
+					compare("specialize", i, { execution_state::halted, outputs, 0 }, false);
+				}
+			});
+
+		// The coalesced program only renames the registers, so it executes the same number of steps;
+		// a wrongly coalesced program may not stop, so it is resumed for a bounded number of steps
+		if (program.stages.size() == 1)
+			guarded("coalesce", [&]() {
+				register_coalescer coalescer(filename);
+				auto coalesced_filename = (this->_directory / "coalesced.txt").string();
+				coalescer.coalesce().write(coalesced_filename);
+
+				extended_register_machine erm(coalesced_filename);
+				auto stages = erm.load_stages();
+				auto& machine = *stages.front();
+				for (size_t i{ 0 }; i < tuples.size(); ++i) {
+					machine.start(tuples[i]);
+					auto state = machine.resume(MAX_STEPS + 1);
+					auto outputs = state == execution_state::halted ? machine.results() : std::vector<int>{};
+					compare("coalesce", i, { state, outputs, machine.steps() }, true);
+				}
+			});
+
+		// The static estimate bounds the steps and the output registers from above, an unknown bound is not checked
+		guarded("estimate", [&]() {
+			step_estimator estimator(filename);
+			const auto& bounds = estimator.bounds();
+			for (size_t i{ 0 }; i < tuples.size(); ++i) {
+				std::unordered_map<std::string, int> values{};
+				for (size_t j{ 0 }; j < tuples[i].size() && j < estimator.inputs().size(); ++j)
+					values[estimator.inputs()[j]] = tuples[i][j];
+
+				auto steps = bounds.steps.evaluate(values);
+				bool is_exceeded = steps && *steps < static_cast<double>(expected[i].steps);
+				for (size_t j{ 0 }; j < bounds.outputs.size() && j < expected[i].outputs.size(); ++j) {
+					auto output = bounds.outputs[j].evaluate(values);
+					is_exceeded = is_exceeded || (output && *output < static_cast<double>(expected[i].outputs[j]));
+				}
+				if (is_exceeded)
+					mismatches.push_back({ "estimate", tuples[i], expected[i], { execution_state::halted, expected[i].outputs, steps ? static_cast<size_t>(*steps) : 0 },
+						"The static bound is exceeded: steps <= " + bounds.steps.text() });
+			}
+		});
+
+		// The compile-time machine decodes the text of the main file by its own productions and runs it at run time
+		if (program.stages.size() == 1 && !program.is_wrapped && !is_calling)
+			guarded("constexpr", [&]() {
+				std::ifstream ifs(filename, std::ios::binary);
+				std::string text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+				auto image = compile_time::parse(text, !program.is_basic);
+				compile_time::verify(image);
+				for (size_t i{ 0 }; i < tuples.size(); ++i) {
+					auto launch = compile_time::evaluate(image, tuples[i], MAX_STEPS);
+					compare("constexpr", i, { launch.is_stopped ? execution_state::halted : execution_state::running, launch.outputs, launch.steps }, true);
+				}
+			});
+
+		// A cut instruction must be reported as an error by every parser reading it, a request must not bring the server down
+		const auto& main = program.stages[program.main];
+		auto line = this->_random() % main.code.size();
+		auto text = malformed_text(program, line, this->_random);
+		if (text)
+			guarded("malformed", [&]() {
+				auto malformed_filename = (this->_directory / "malformed.txt").string();
+				std::ofstream(malformed_filename, std::ios::trunc) << *text;
+
+				auto is_rejected = [](auto load) {
+					try {
+						load();
+					}
+					catch (const std::runtime_error&) {
+						return true;
+					}
+					return false;
+				};
+				auto reject = [&](const std::string& engine, bool is_rejected) {
+					if (!is_rejected)
+						mismatches.push_back({ engine, tuples.front(), expected.front(), { execution_state::halted, {}, 0 }, "The cut instruction " + std::to_string(line) + " is accepted" });
+				};
+
+				if (program.is_basic)
+					reject("malformed-basic", is_rejected([&]() { basic_register_machine(malformed_filename).load_all_instructions(); }));
+				reject("malformed", is_rejected([&]() { extended_register_machine(malformed_filename).load_stages(); }));
+				reject("malformed-cache", is_rejected([&]() { this->_cache.acquire(malformed_filename); }));
+
+				// A call is parsed by the lazy load to be linked before the launches
+				if (main.code[line].code == generated_instruction::opcode::call) {
+					reject("malformed-lazy", is_rejected([&]() { extended_register_machine(malformed_filename, false, true).load_stages(); }));
+					return;
+				}
+
+				// The lazy launch parses the cut instruction only when it reaches it, the launch stands before the first instruction
+				debugger debugger(filename);
+				debugger.add_breakpoint(line, "main.txt");
+				extended_register_machine erm(malformed_filename, false, true);
+				auto stages = erm.load_stages();
+				for (size_t i{ 0 }; i < tuples.size(); ++i) {
+					debugger.start(tuples[i]);
+					bool is_reached = (program.main == 0 && line == 0) || debugger.resume().reason == debugger::stop_reason::breakpoint;
+
+					auto values = tuples[i];
+					auto state = execution_state::halted;
+					size_t steps{ 0 };
+					for (size_t j{ 0 }; j < stages.size() && state == execution_state::halted; ++j) {
+						stages[j]->start(values);
+						state = stages[j]->resume(MAX_STEPS + 1);
+						values = state == execution_state::halted ? stages[j]->results() : std::vector<int>{};
+						steps += stages[j]->steps();
+					}
+					if (is_reached && state != execution_state::error)
+						mismatches.push_back({ "malformed-lazy", tuples[i], expected[i], { state, values, steps }, "The cut instruction " + std::to_string(line) + " is executed" });
+					else if (!is_reached)
+						compare("malformed-lazy", i, { state, values, steps }, true);
+				}
+			});
+
+		// The server keeps serving a cached program in its loaded version when the file is saved with a cut instruction
+		guarded("cache", [&]() {
+			auto number = this->_cached++;
+			auto directory = this->_directory / ("cache" + std::to_string(number));
+			std::filesystem::create_directories(directory);
+			auto cached_filename = program.write(directory);
+			auto launch = [&](const std::string& engine) {
+				auto lease = this->_cache.acquire(cached_filename);
+				for (size_t i{ 0 }; i < tuples.size(); ++i) {
+					auto result = lease.evaluate(tuples[i]);
+					compare(engine, i, { execution_state::halted, result.outputs, result.steps }, true);
+				}
+			};
+			launch("cache");
+			if (!text || !this->_cache.is_watched() || number % RELOAD_PERIOD != 0)
+				return;
+
+			// The watcher reloads the program in the background, the launch waits until the reload has failed
+			auto& errors = metrics_registry::global().get_counter("rm_cache_reload_errors_total");
+			auto count = errors.value();
+			std::ofstream(directory / "main.txt", std::ios::trunc) << *text;
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+			while (errors.value() == count && std::chrono::steady_clock::now() < deadline)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			if (errors.value() == count)
+				throw std::runtime_error("The cut instruction " + std::to_string(line) + " is not reloaded");
+			launch("cache-reload");
+		});
+
+		return mismatches;
+	}
+
+	// Returns true if some configuration disagrees with the reference interpreter on a terminating launch
+	bool differential_checker::fails(const generated_program& program, const std::vector<int>& input) {
+		for (const auto* stages : { &program.stages, &program.helpers }) // Reduction must not produce jumps outside the stage
+			for (const auto& stage : *stages)
+				for (const auto& x : stage.code)
+					if ((x.code == generated_instruction::opcode::branch || x.code == generated_instruction::opcode::compare || x.code == generated_instruction::opcode::jump) &&
+						std::max(x.goto_true, x.goto_false) >= stage.code.size())
+						return false;
+
+		return !this->check(program, { input }).empty();
+	}
+
+	// Reduces the program and the input of a failing case while the discrepancy remains
+	std::pair<generated_program, std::vector<int>> differential_checker::minimize(generated_program program, std::vector<int> input) {
+		// Applies the change to a copy of the program, keeps the copy if the case still fails
+		auto attempt = [&](auto change) {
+			auto candidate = program;
+			if (!change(candidate) || !this->fails(candidate, input))
+				return false;
+			program = std::move(candidate);
+			return true;
+		};
+
+		for (bool is_reduced{ true }; is_reduced; ) {
+			is_reduced = false;
+
+			// The basic RM is no longer launched: the reduction may leave the basic syntax
+			is_reduced |= program.is_basic && attempt([](generated_program& x) { x.is_basic = false; return true; });
+			is_reduced |= program.is_wrapped && attempt([](generated_program& x) { x.is_wrapped = false; return true; });
+
+			for (size_t i{ 0 }; i < program.stages.size() && program.stages.size() > 1; ) { // Removal of stages
+				if (attempt([i](generated_program& x) {
+					x.stages.erase(x.stages.begin() + i);
+					x.main = std::min(x.main, x.stages.size() - 1);
+					return true; }))
+					is_reduced = true;
+				else
+					++i;
+			}
+
+			for (auto stages : { &generated_program::stages, &generated_program::helpers }) { // The helpers are reduced as the stages
+				for (size_t s{ 0 }; s < (program.*stages).size(); ++s) {
+					for (size_t i{ 0 }; i < (program.*stages)[s].code.size(); ) { // Removal of instructions, the jumps behind it are shifted
+						if (attempt([stages, s, i](generated_program& x) {
+							auto& code = (x.*stages)[s].code;
+							code.erase(code.begin() + i);
+							for (auto& y : code) {
+								if (y.goto_true > i) --y.goto_true;
+								if (y.goto_false > i) --y.goto_false;
+							}
+							return true; }))
+							is_reduced = true;
+						else
+							++i;
+					}
+
+					if (program.is_basic)
+						continue;
+
+					for (size_t i{ 0 }; i < (program.*stages)[s].code.size(); ++i) { // Simplification of instructions
+						using opcode = generated_instruction::opcode;
+						for (auto to_true : { true, false }) // A condition becomes a jump to one of its targets
+							is_reduced |= attempt([stages, s, i, to_true](generated_program& x) {
+								auto& y = (x.*stages)[s].code[i];
+								if (y.code != opcode::branch && y.code != opcode::compare)
+									return false;
+								y = { opcode::jump, "", "", "", to_true ? y.goto_true : y.goto_false, 0 };
+								return true; });
+						is_reduced |= attempt([stages, s, i](generated_program& x) { // Arithmetic becomes a copy
+							auto& y = (x.*stages)[s].code[i];
+							if (!y.is_arithmetic() || y.code == opcode::assign)
+								return false;
+							y.code = opcode::assign;
+							y.right.clear();
+							return true; });
+						for (auto operand : { &generated_instruction::left, &generated_instruction::right }) // Operands become 0
+							is_reduced |= attempt([stages, s, i, operand](generated_program& x) {
+								auto& y = (x.*stages)[s].code[i];
+								if (y.code == opcode::move || (y.*operand).empty() || y.*operand == "0")
+									return false;
+								y.*operand = "0";
+								return true; });
+					}
+				}
+			}
+
+			for (size_t i{ 0 }; i < input.size(); ++i) { // Reduction of the input values
+				for (auto value : { 0, input[i] / 2, input[i] - 1 }) {
+					if (value < 0 || value >= input[i])
+						continue;
+					auto candidate = input;
+					candidate[i] = value;
+					if (this->fails(program, candidate)) {
+						input = std::move(candidate);
+						is_reduced = true;
+						break;
+					}
+				}
+			}
+		}
+
+		return { program, input };
+	}
+
+	// Checks the given number of generated programs, reports minimized failing cases; returns the number of failing programs
+	size_t differential_checker::run(uint64_t seed, size_t programs, size_t inputs, std::ostream& os) {
+		auto print = [&os](const std::vector<int>& values) {
+			os << "(";
+			for (size_t i{ 0 }; i < values.size(); ++i)
+				os << (i == 0 ? "" : " ") << values[i];
+			os << ")";
+		};
+		auto report = [&](const mismatch& x) {
+			os << x.engine << ": input ";
+			print(x.input);
+			os << " expected ";
+			print(x.expected.outputs);
+			os << " steps " << x.expected.steps << ", got ";
+			if (x.error.empty()) {
+				print(x.actual.outputs);
+				os << " steps " << x.actual.steps << std::endl;
+			}
+			else
+				os << "error: " << x.error << std::endl;
+		};
+
+		program_generator generator(seed);
+		size_t failures{ 0 };
+		size_t cases{ 0 };
+		auto begin = std::chrono::steady_clock::now();
+
+		for (size_t i{ 0 }; i < programs; ++i) {
+			auto program = generator.next();
+			auto tuples = generator.inputs(program, inputs);
+			auto mismatches = this->check(program, tuples);
+			cases += tuples.size();
+
+			if (mismatches.empty())
+				continue;
+
+			++failures;
+			os << "program " << i << " of seed " << seed << " fails" << std::endl;
+			report(mismatches.front());
+
+			auto [reduced, input] = this->minimize(program, mismatches.front().input);
+			os << "minimized:" << std::endl;
+			for (const auto& x : this->check(reduced, { input }))
+				report(x);
+			reduced.print(os);
+		}
+
+		auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		os << "programs: " << programs << " cases: " << cases << " failures: " << failures << " time, s: " << seconds << " cases per second: " << (seconds > 0 ? cases / seconds : 0) << std::endl;
+		return failures;
+	}
+}
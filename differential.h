@@ -0,0 +1,246 @@
+﻿#ifndef __REGISTER_MACHINE_DIFFERENTIAL_
+#define __REGISTER_MACHINE_DIFFERENTIAL_
+
+#include "coalescer.h"
+#include "debugger.h"
+#include "estimator.h"
+#include "lockstep.h"
+#include "register_machine.h"
+#include "scheduler.h"
+#include "server.h"
+#include "specializer.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace IMD {
+
+	// Instruction of a generated program
+	struct generated_instruction {
+		// Operation codes
+		enum class opcode {
+			assign, // target <- left
+			plus, // target <- left + right
+			minus, // target <- left - right
+			multiply, // target <- left * right
+			divide, // target <- left / right
+			modulo, // target <- left % right
+			move, // target <<- left
+			branch, // if target == 0 then goto goto_true else goto goto_false
+			compare, // if target relation right then goto goto_true else goto goto_false
+			jump, // goto goto_true
+			call, // call helper<callee>.txt arguments -> results
+			stop // stop
+		};
+
+		opcode code;
+		std::string target;
+		std::string left;
+		std::string right;
+		size_t goto_true;
+		size_t goto_false;
+		// Relation of a comparison: ==, !=, <, <=, > or >=
+		std::string relation{};
+		// Index of the called helper, the registers or the literals passed to it and the registers receiving its outputs
+		size_t callee{};
+		std::vector<std::string> arguments{};
+		std::vector<std::string> results{};
+
+		// Returns the text of the instruction in the RM syntax
+		std::string text() const;
+		// Returns true for the copy assignments: a literal or a register, possibly combined with another one
+		bool is_arithmetic() const noexcept;
+	};
+
+	// Composition stage of a generated program
+	struct generated_stage {
+		// Names of the input registers
+		std::vector<std::string> inputs;
+		// Names of the output registers
+		std::vector<std::string> outputs;
+		// Instructions
+		std::vector<generated_instruction> code;
+	};
+
+	// Generated program: the composition stages in the order of their execution
+	struct generated_program {
+		// The program uses only the syntax of the basic RM: a single stage, increments, decrements and literal assignments
+		bool is_basic;
+		// Index of the stage whose instructions are placed in the main file, the other stages are called from it
+		size_t main;
+		// The main file is itself called from a file consisting of a single composition instruction
+		bool is_wrapped;
+		// Composition stages
+		std::vector<generated_stage> stages;
+		// Programs called from the instructions of the stages, a helper calls only the helpers before it
+		std::vector<generated_stage> helpers{};
+
+		// Writes the stage files into the directory, returns the name of the file to launch
+		std::string write(const std::filesystem::path& directory) const;
+		// Prints the files of the program, the composition instructions refer to the files by their names
+		void print(std::ostream& os) const;
+	};
+
+	// Result of a launch of a generated program
+	struct reference_result {
+		// Final state: halted, error, or running when the step budget is exceeded
+		execution_state state;
+		// Values of the output registers of the last stage
+		std::vector<int> outputs;
+		// Number of executed instructions of all stages
+		size_t steps;
+	};
+
+	// Checks the rules of the verifier of the machines on a stage of less than 64 registers: jump targets are in range,
+	// no instruction falls through past the end, a stop instruction is reachable, and copy assignments and calls read only
+	// registers assigned on every path
+	bool is_verified(const generated_stage& stage);
+
+	// Reference interpreter: executes a generated program directly by the semantics of the instructions, a call executes its helper
+	// A program the verifier of the machines would reject is reported as error without being executed;
+	// a sum or a product beyond the range of int saturates at its maximum, a launch exceeding max_steps is reported as running
+	reference_result interpret(const generated_program& program, const std::vector<int>& arguments, size_t max_steps);
+
+	// Seeded generator of valid terminating programs
+	// Loops count down registers that are written by nothing else, branches and jumps only lead forward
+	// and a stage calls only the helpers generated before it, so that every generated program halts; long launches are left to the step budget of the checker
+	// Copy assignments read only registers assigned on every path, so that the programs pass the verifier
+	class program_generator {
+	private:
+		// Random engine
+		std::mt19937_64 _random;
+		// Stage being generated
+		generated_stage* _stage;
+		// Helpers generated so far, the stage may call them
+		const std::vector<generated_stage>* _helpers;
+		// The stage uses only the syntax of the basic RM
+		bool _is_basic;
+		// Number of instructions left for the stage
+		size_t _budget;
+		// Registers assigned on every path to the current position
+		std::set<std::string> _assigned;
+
+	public:
+		// Constructor
+		explicit program_generator(uint64_t seed) noexcept;
+
+		// Returns the next program
+		generated_program next();
+		// Returns the given number of input tuples for the program
+		std::vector<std::vector<int>> inputs(const generated_program& program, size_t count);
+
+	private:
+		// Returns a uniformly distributed number from 0 to bound - 1
+		size_t uniform(size_t bound);
+		// Returns true with the given probability in percent
+		bool chance(size_t percent);
+
+		// Returns the name of a data register; some of them are neither inputs nor outputs
+		std::string data_register();
+		// Returns a register assigned on every path to the current position
+		std::string assigned_register();
+		// Returns an assigned register or a literal: mostly a small one, sometimes one large enough for a sum or a product to saturate
+		std::string operand();
+		// Returns a subset of the data registers without repetitions, of the given size
+		std::vector<std::string> registers(size_t count);
+
+		// Generates a stage with the given number of input registers
+		generated_stage stage(size_t inputs, bool is_basic);
+		// Generates a sequence of statements at the given loop depth
+		void block(size_t depth);
+		// Generates an assignment
+		void assignment();
+		// Generates a forward branch with two arms
+		void branch(size_t depth);
+		// Generates a loop counting down a dedicated register
+		void loop(size_t depth);
+		// Generates a call of a helper
+		void call();
+		// Generates an unconditional jump whose target is set later, a condition with equal targets in the basic syntax;
+		// any_register must exist at this point, returns the number of the jump
+		size_t jump(const std::string& any_register);
+		// Sets the target of a generated jump
+		void land(size_t jump, size_t target);
+		// Adds an instruction, returns its number
+		size_t emit(generated_instruction instruction);
+	};
+
+	// Differential checker: launches generated programs on every available execution configuration
+	// and compares the output registers and the numbers of executed instructions with the reference interpreter
+	// The configurations are the basic RM (for programs in the basic syntax), evaluation of the loaded stages,
+	// resumable execution in small slices, the work-stealing scheduler, the pipeline, the lockstep machine
+	// with every supported instruction set and, for a single stage, the program specialized for its first input,
+	// the program with coalesced registers and the compile-time machine run on the text of the program;
+	// the lockstep machine, the specializer and the compile-time machine do not support calls and skip the programs making them;
+	// the main file with an instruction cut in the middle must be rejected by the parsers and by the cache of the server,
+	// and a lazy launch of it must fail exactly when the debugger stops at a breakpoint on the cut instruction;
+	// a failing case is minimized before it is reported
+	class differential_checker {
+	public:
+		// Discrepancy of a configuration with the reference interpreter
+		struct mismatch {
+			// Name of the configuration
+			std::string engine;
+			// Input tuple
+			std::vector<int> input;
+			// Result of the reference interpreter
+			reference_result expected;
+			// Result of the configuration, the error message when it failed
+			reference_result actual;
+			std::string error;
+		};
+
+	private:
+		// Maximum number of instructions of a launch, longer programs are skipped
+		static constexpr size_t MAX_STEPS{ 20000 };
+		// Period of the reload check: it waits for the watcher thread, so only every that many cached programs are reloaded
+		static constexpr size_t RELOAD_PERIOD{ 16 };
+
+		// Directory of the program files
+		std::filesystem::path _directory;
+		// Scheduler shared by all checks
+		scheduler _scheduler;
+		// Cache of compiled programs of the server shared by all checks
+		program_cache _cache;
+		// Number of the programs loaded into the cache, each of them is written into its own directory
+		size_t _cached;
+		// Lockstep instruction sets supported by the processor
+		std::vector<lockstep_machine::isa> _instruction_sets;
+		// Random engine choosing slice lengths and numbers of lanes
+		std::mt19937_64 _random;
+
+	public:
+		// Constructor: the program files are written into the directory
+		explicit differential_checker(const std::filesystem::path& directory, uint64_t seed = 0);
+
+		// Copy constructor
+		differential_checker(const differential_checker&) = delete;
+		// Assignment operator
+		differential_checker& operator=(const differential_checker&) = delete;
+
+		// Destructor: removes the directory
+		~differential_checker();
+
+		// Checks the program on the input tuples, returns the discrepancies
+		// Tuples on which the reference launch exceeds the step budget are skipped
+		std::vector<mismatch> check(const generated_program& program, const std::vector<std::vector<int>>& inputs);
+
+		// Reduces the program and the input of a failing case while the discrepancy remains
+		std::pair<generated_program, std::vector<int>> minimize(generated_program program, std::vector<int> input);
+
+		// Checks the given number of generated programs, reports minimized failing cases; returns the number of failing programs
+		size_t run(uint64_t seed, size_t programs, size_t inputs, std::ostream& os);
+
+	private:
+		// Returns true if some configuration disagrees with the reference interpreter on a terminating launch
+		bool fails(const generated_program& program, const std::vector<int>& input);
+	};
+}
+
+#endif
@@ -0,0 +1,780 @@
+﻿#include "estimator.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_set>
+
+namespace IMD {
+
+	// Constructor of a constant
+	polynomial::polynomial(uint64_t value) : _terms(), _is_unknown(false) {
+		if (value != 0)
+			this->_terms[{}] = value;
+	}
+
+	// Returns the polynomial of a register
+	polynomial polynomial::variable(const std::string& name) {
+		polynomial result{};
+		result._terms[{ name }] = 1;
+		return result;
+	}
+
+	// Returns the unknown polynomial
+	polynomial polynomial::unknown() {
+		polynomial result{};
+		result._is_unknown = true;
+		return result;
+	}
+
+	// Returns true for the unknown polynomial
+	bool polynomial::is_unknown() const noexcept {
+		return this->_is_unknown;
+	}
+
+	// Returns the registers of the polynomial
+	std::set<std::string> polynomial::variables() const {
+		std::set<std::string> result{};
+		for (const auto& [monomial, coefficient] : this->_terms)
+			result.insert(monomial.begin(), monomial.end());
+		return result;
+	}
+
+	// Returns true if some monomial contains the register
+	bool polynomial::contains(const std::string& name) const {
+		for (const auto& [monomial, coefficient] : this->_terms)
+			if (std::binary_search(monomial.begin(), monomial.end(), name))
+				return true;
+		return false;
+	}
+
+	// Returns q if the polynomial is name + q and q does not contain the register, std::nullopt otherwise
+	std::optional<polynomial> polynomial::increment_of(const std::string& name) const {
+		auto it = this->_terms.find({ name });
+		if (this->_is_unknown || it == this->_terms.end() || it->second != 1)
+			return std::nullopt;
+
+		auto result = *this;
+		result._terms.erase({ name });
+		if (result.contains(name))
+			return std::nullopt;
+		return result;
+	}
+
+	// Sum
+	polynomial polynomial::operator+(const polynomial& other) const {
+		if (this->_is_unknown || other._is_unknown)
+			return unknown();
+
+		auto result = *this;
+		for (const auto& [monomial, coefficient] : other._terms) {
+			auto& sum = result._terms[monomial];
+			if (__builtin_add_overflow(sum, coefficient, &sum))
+				return unknown();
+		}
+		return result._terms.size() > MAX_TERMS ? unknown() : result;
+	}
+
+	// Product
+	polynomial polynomial::operator*(const polynomial& other) const {
+		if (this->_is_unknown || other._is_unknown)
+			return unknown();
+
+		polynomial result{};
+		for (const auto& [left, left_coefficient] : this->_terms)
+			for (const auto& [right, right_coefficient] : other._terms) {
+				std::vector<std::string> monomial{};
+				std::merge(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(monomial));
+				uint64_t product{ 0 };
+				auto& sum = result._terms[std::move(monomial)];
+				if (__builtin_mul_overflow(left_coefficient, right_coefficient, &product) || __builtin_add_overflow(sum, product, &sum))
+					return unknown();
+				if (result._terms.size() > MAX_TERMS)
+					return unknown();
+			}
+		return result;
+	}
+
+	// Returns the polynomial bounding both: the maximum of every coefficient
+	polynomial polynomial::join(const polynomial& other) const {
+		if (this->_is_unknown || other._is_unknown)
+			return unknown();
+
+		auto result = *this;
+		for (const auto& [monomial, coefficient] : other._terms) {
+			auto& maximum = result._terms[monomial];
+			maximum = std::max(maximum, coefficient);
+		}
+		return result._terms.size() > MAX_TERMS ? unknown() : result;
+	}
+
+	// Returns the polynomial with every register replaced by the polynomial of its value
+	polynomial polynomial::substitute(const std::function<polynomial(const std::string&)>& values) const {
+		if (this->_is_unknown)
+			return unknown();
+
+		polynomial result{};
+		for (const auto& [monomial, coefficient] : this->_terms) {
+			polynomial product{ coefficient };
+			for (const auto& x : monomial)
+				product = product * values(x);
+			result = result + product;
+		}
+		return result;
+	}
+
+	// Returns the value for the values of the registers, the registers without a value are 0; std::nullopt for the unknown polynomial
+	std::optional<double> polynomial::evaluate(const std::unordered_map<std::string, int>& values) const {
+		if (this->_is_unknown)
+			return std::nullopt;
+
+		double result{ 0.0 };
+		for (const auto& [monomial, coefficient] : this->_terms) {
+			double product = static_cast<double>(coefficient);
+			for (const auto& x : monomial) {
+				auto it = values.find(x);
+				product *= it != values.end() ? std::max(it->second, 0) : 0;
+			}
+			result += product;
+		}
+		return result;
+	}
+
+	// Returns the text of the polynomial: the monomials of higher degrees first, a power as x^2
+	std::string polynomial::text() const {
+		if (this->_is_unknown)
+			return "unknown";
+		if (this->_terms.empty())
+			return "0";
+
+		std::vector<std::pair<std::vector<std::string>, uint64_t>> terms(this->_terms.begin(), this->_terms.end());
+		std::stable_sort(terms.begin(), terms.end(), [](const auto& x, const auto& y) { return x.first.size() > y.first.size(); });
+
+		std::ostringstream oss{};
+		for (size_t i{ 0 }; i < terms.size(); ++i) {
+			const auto& [monomial, coefficient] = terms[i];
+			if (i != 0)
+				oss << " + ";
+			if (coefficient != 1 || monomial.empty())
+				oss << coefficient << (monomial.empty() ? "" : "*");
+			for (size_t j{ 0 }; j < monomial.size(); ) {
+				auto k = j;
+				while (k < monomial.size() && monomial[k] == monomial[j])
+					++k;
+				oss << (j != 0 ? "*" : "") << monomial[j];
+				if (k - j > 1)
+					oss << "^" << k - j;
+				j = k;
+			}
+		}
+		return oss.str();
+	}
+
+	// Returns the relation holding with the operands swapped
+	static grammar::relation swapped(grammar::relation relation) noexcept {
+		switch (relation) {
+		case grammar::relation::less:
+			return grammar::relation::greater;
+		case grammar::relation::less_equal:
+			return grammar::relation::greater_equal;
+		case grammar::relation::greater:
+			return grammar::relation::less;
+		case grammar::relation::greater_equal:
+			return grammar::relation::less_equal;
+		default:
+			return relation;
+		}
+	}
+
+	// Returns the polynomial of an operand: a literal or a register
+	static polynomial symbol(const std::string& operand) {
+		if (auto value = grammar::literal_value(operand))
+			return polynomial(static_cast<uint64_t>(*value));
+		return polynomial::variable(operand);
+	}
+
+	// Constructor: loads and estimates the program
+	// The composition stages are chained: the input registers of a stage take the bounds of the output registers of the previous one
+	step_estimator::step_estimator(const std::string& filename) : _filename(filename), _inputs(), _outputs(), _summary(), _summaries() {
+		extended_register_machine erm(filename);
+		auto stages = erm.load_stages();
+		if (stages.empty())
+			throw std::runtime_error("Filename: " + filename + ". The program has no stages");
+		this->_inputs = stages.front()->_input_registers;
+		this->_outputs = stages.back()->_output_registers;
+
+		std::vector<polynomial> values{};
+		for (const auto& x : this->_inputs)
+			values.push_back(polynomial::variable(x));
+		polynomial steps{ 0 };
+		for (const auto& stage : stages) {
+			const auto& bounds = this->estimate(*stage);
+			std::unordered_map<std::string, polynomial> arguments{};
+			for (size_t i{ 0 }; i < stage->_input_registers.size(); ++i)
+				arguments[stage->_input_registers[i]] = i < values.size() ? values[i] : polynomial::unknown();
+			auto value = [&arguments](const std::string& name) {
+				auto it = arguments.find(name);
+				return it != arguments.end() ? it->second : polynomial{ 0 };
+			};
+
+			steps = steps + bounds.steps.substitute(value);
+			values.clear();
+			for (const auto& x : bounds.outputs)
+				values.push_back(x.substitute(value));
+		}
+		this->_summary = { steps, values };
+	}
+
+	// Returns the input registers
+	const std::vector<std::string>& step_estimator::inputs() const noexcept {
+		return this->_inputs;
+	}
+
+	// Returns the output registers
+	const std::vector<std::string>& step_estimator::outputs() const noexcept {
+		return this->_outputs;
+	}
+
+	// Returns the bounds of the program
+	const step_estimator::summary& step_estimator::bounds() const noexcept {
+		return this->_summary;
+	}
+
+	// Returns the bound of the number of steps of a launch on the given values of the input registers, std::nullopt if unknown
+	std::optional<double> step_estimator::steps(const std::vector<int>& arguments) const {
+		if (arguments.size() != this->_inputs.size())
+			throw std::runtime_error("Filename: " + this->_filename + ". Expected " + std::to_string(this->_inputs.size()) + " input values");
+
+		std::unordered_map<std::string, int> values{};
+		for (size_t i{ 0 }; i < arguments.size(); ++i)
+			values[this->_inputs[i]] = arguments[i];
+		return this->_summary.steps.evaluate(values);
+	}
+
+	// Returns the bounds of a loaded program, the unknown ones for a recursive call
+	// A program failing the verifier may read registers that are not assigned, which cancels the assignment, so it is not estimated
+	const step_estimator::summary& step_estimator::estimate(const basic_register_machine& machine) {
+		if (auto it = this->_summaries.find(&machine); it != this->_summaries.end())
+			return it->second;
+
+		auto& result = this->_summaries[&machine];
+		result = { polynomial::unknown(), std::vector<polynomial>(machine._output_registers.size(), polynomial::unknown()) };
+		if (machine._is_verified) {
+			auto steps = this->collect(machine);
+			auto bounds = this->analyze(steps, machine._input_registers, machine._output_registers);
+			result = std::move(bounds);
+		}
+		return result;
+	}
+
+	// Returns the instructions of a loaded program as the estimate sees them
+	// The new value of an arithmetic assignment is bounded by its operands: a difference, a quotient and a remainder
+	// by the first one; a move writes 0 into its source
+	std::vector<step_estimator::step> step_estimator::collect(const basic_register_machine& machine) {
+		using basic = basic_register_machine;
+		auto size = machine._instructions.size();
+		std::vector<step> result(size);
+
+		for (size_t i{ 0 }; i < size; ++i) {
+			const auto* pointer = machine._instructions[i];
+			auto& x = result[i];
+			x.cost = polynomial{ 1 };
+			x.is_condition = false;
+			x.relation = grammar::relation::equal;
+			x.goto_true = x.goto_false = 0;
+			x.is_stop = false;
+
+			if (auto copy = dynamic_cast<const basic::copy_assignment_instruction*>(pointer)) {
+				const auto& target = copy->target_register();
+				const auto& left = copy->left_operand();
+				const auto& right = copy->right_operand();
+				auto value = symbol(left);
+				switch (copy->operation_type()) {
+				case basic::operation::plus:
+					value = value + symbol(right);
+					if ((left == target && grammar::literal_value(right).value_or(0) > 0) || (right == target && grammar::literal_value(left).value_or(0) > 0))
+						x.incremented = target;
+					break;
+				case basic::operation::minus:
+					if (left == target && grammar::literal_value(right).value_or(0) > 0)
+						x.decremented = target;
+					break;
+				case basic::operation::multiply:
+					value = value * symbol(right);
+					break;
+				default:
+					break;
+				}
+				x.writes.emplace_back(target, std::move(value));
+				x.successors.push_back(i + 1);
+			}
+			else if (auto move = dynamic_cast<const basic::move_assignment_instruction*>(pointer)) {
+				x.writes.emplace_back(move->to_register(), polynomial::variable(move->from_register()));
+				x.writes.emplace_back(move->from_register(), polynomial{ 0 });
+				x.successors.push_back(i + 1);
+			}
+			else if (auto condition = dynamic_cast<const basic::condition_instruction*>(pointer)) {
+				x.is_condition = true;
+				x.compared = condition->compared_register();
+				x.operand = "0";
+				if (auto extended_condition = dynamic_cast<const basic::extended_condition_instruction*>(pointer))
+					x.operand = std::to_string(extended_condition->compared_value());
+				else if (auto comparison = dynamic_cast<const basic::comparison_instruction*>(pointer)) {
+					x.relation = comparison->relation_type();
+					x.operand = comparison->compared_operand();
+				}
+				x.goto_true = condition->goto_true();
+				x.goto_false = condition->goto_false();
+				x.successors = { x.goto_true, x.goto_false };
+			}
+			else if (auto jump = dynamic_cast<const basic::goto_instruction*>(pointer))
+				x.successors.push_back(jump->target_mark());
+			else if (auto call = dynamic_cast<const basic::call_instruction*>(pointer)) {
+				if (call->callee() == nullptr)
+					throw std::runtime_error("Filename: " + machine._filename + ". The called program " + call->filename() + " is not linked");
+
+				const auto& callee = *call->callee();
+				const auto& bounds = this->estimate(callee);
+				std::unordered_map<std::string, polynomial> arguments{};
+				for (size_t j{ 0 }; j < call->arguments().size(); ++j)
+					arguments[callee._input_registers[j]] = symbol(*call->arguments()[j]);
+				auto value = [&arguments](const std::string& name) {
+					auto it = arguments.find(name);
+					return it != arguments.end() ? it->second : polynomial{ 0 };
+				};
+
+				for (size_t j{ 0 }; j < call->results().size(); ++j)
+					x.writes.emplace_back(*call->results()[j], bounds.outputs[j].substitute(value));
+				x.cost = x.cost + bounds.steps.substitute(value);
+				x.successors.push_back(i + 1);
+			}
+			else if (dynamic_cast<const basic::stop_instruction*>(pointer))
+				x.is_stop = true;
+			else
+				throw std::runtime_error("Filename: " + machine._filename + ". The instruction is not supported by the estimator: " + pointer->description());
+
+			for (auto y : x.successors)
+				if (y >= size)
+					throw std::runtime_error("Filename: " + machine._filename + ". The instruction " + std::to_string(i) + " passes control outside the program");
+		}
+		return result;
+	}
+
+	// Returns the bounds of the instructions starting at the first one with the input registers as the variables
+	// The components of the reachable instructions are visited in the topological order: an instruction outside the loops
+	// transforms the values of the registers, a loop replaces them by their bounds over all of its passes. The bound of
+	// the steps to the end of a component is the maximum over the components leading to it plus the steps of the component
+	step_estimator::summary step_estimator::analyze(const std::vector<step>& steps, const std::vector<std::string>& inputs, const std::vector<std::string>& outputs) const {
+		summary result{ polynomial::unknown(), std::vector<polynomial>(outputs.size(), polynomial::unknown()) };
+		if (steps.empty())
+			return result;
+
+		std::vector<bool> is_reached(steps.size(), false);
+		std::vector<size_t> nodes{ 0 };
+		is_reached[0] = true;
+		for (size_t i{ 0 }; i < nodes.size(); ++i)
+			for (auto x : steps[nodes[i]].successors)
+				if (!is_reached[x]) {
+					is_reached[x] = true;
+					nodes.push_back(x);
+				}
+
+		auto order = components(steps, nodes);
+		std::vector<size_t> component_of(steps.size(), 0);
+		for (size_t i{ 0 }; i < order.size(); ++i)
+			for (auto x : order[i])
+				component_of[x] = i;
+
+		auto join = [](valuation& target, const valuation& source) {
+			for (const auto& [name, value] : source) {
+				auto [it, is_inserted] = target.try_emplace(name, value);
+				if (!is_inserted)
+					it->second = it->second.join(value);
+			}
+		};
+
+		// Values on entry and the steps up to the entry of every component
+		std::vector<std::optional<valuation>> entries(order.size());
+		std::vector<std::optional<polynomial>> distances(order.size());
+		entries[component_of[0]].emplace();
+		for (const auto& x : inputs)
+			(*entries[component_of[0]])[x] = polynomial::variable(x);
+		distances[component_of[0]] = polynomial{ 0 };
+
+		bool is_stopped{ false };
+		polynomial total{ 0 };
+		std::vector<polynomial> bounds(outputs.size());
+		for (size_t i{ 0 }; i < order.size(); ++i) {
+			const auto& component = order[i];
+			auto values = entries[i].value_or(valuation{});
+			auto distance = distances[i].value_or(polynomial{ 0 });
+			auto value = [&values](const std::string& name) {
+				auto it = values.find(name);
+				return it != values.end() ? it->second : polynomial{ 0 };
+			};
+
+			if (!is_cyclic(steps, component)) {
+				const auto& x = steps[component.front()];
+				if (x.is_stop) {
+					auto steps = distance + x.cost.substitute(value);
+					total = is_stopped ? total.join(steps) : steps;
+					for (size_t j{ 0 }; j < outputs.size(); ++j)
+						bounds[j] = is_stopped ? bounds[j].join(value(outputs[j])) : value(outputs[j]);
+					is_stopped = true;
+				}
+
+				distance = distance + x.cost.substitute(value);
+				std::vector<polynomial> written{};
+				for (const auto& [name, expression] : x.writes)
+					written.push_back(expression.substitute(value));
+				for (size_t j{ 0 }; j < written.size(); ++j)
+					values[x.writes[j].first] = std::move(written[j]);
+			}
+			else if (auto loop = find_loop(steps, component))
+				distance = distance + bound_loop(steps, *loop, values);
+			else {
+				for (auto x : component)
+					for (const auto& [name, expression] : steps[x].writes)
+						values[name] = polynomial::unknown();
+				distance = polynomial::unknown();
+			}
+
+			for (auto x : component)
+				for (auto y : steps[x].successors) {
+					auto next = component_of[y];
+					if (next == i)
+						continue;
+					if (!entries[next])
+						entries[next] = values;
+					else
+						join(*entries[next], values);
+					distances[next] = distances[next] ? distances[next]->join(distance) : distance;
+				}
+		}
+
+		if (is_stopped)
+			result = { total, bounds };
+		return result;
+	}
+
+	// Returns the loop of a strongly connected set of instructions with its nested loops, std::nullopt if some of them has no counter
+	// Every register decremented or incremented by a literal is tried as the counter; the instructions left without
+	// the counting ones form the nested loops
+	std::optional<step_estimator::loop> step_estimator::find_loop(const std::vector<step>& steps, const std::vector<size_t>& nodes) {
+		std::set<std::string> candidates{};
+		for (auto x : nodes) {
+			if (!steps[x].decremented.empty())
+				candidates.insert(steps[x].decremented);
+			if (!steps[x].incremented.empty())
+				candidates.insert(steps[x].incremented);
+		}
+
+		for (const auto& counter : candidates) {
+			std::vector<size_t> counted{};
+			auto passes = find_counter(steps, nodes, counter, counted);
+			if (!passes)
+				continue;
+
+			loop result{ nodes, *passes, {} };
+			std::vector<size_t> rest{};
+			for (auto x : nodes)
+				if (std::find(counted.begin(), counted.end(), x) == counted.end())
+					rest.push_back(x);
+
+			bool is_bounded{ true };
+			for (const auto& component : components(steps, rest)) {
+				if (!is_cyclic(steps, component))
+					continue;
+				auto inner = find_loop(steps, component);
+				if (!inner) {
+					is_bounded = false;
+					break;
+				}
+				result.inner.push_back(std::move(*inner));
+			}
+			if (is_bounded)
+				return result;
+		}
+		return std::nullopt;
+	}
+
+	// Returns the bound of the passes of the loop for the counter, std::nullopt if the register is not its counter;
+	// the instructions decrementing or incrementing the counter are collected
+	// A decreasing counter is written only by decrements, moves out of it and assignments keeping or zeroing it; a test jumps
+	// out of the loop when it is 0. It is decremented with a positive value at most n times for the bound n on entry, and is
+	// decremented at 0 at most once, since a test follows every decrement before the next one: n + 1 decrements, n + 2 passes.
+	// An increasing counter is written only by increments, a test jumps out of the loop once it reaches the limit, a literal
+	// or a register not written in the loop: at most limit + 1 increments
+	std::optional<polynomial> step_estimator::find_counter(const std::vector<step>& steps, const std::vector<size_t>& nodes, const std::string& counter,
+		std::vector<size_t>& counted) {
+		std::unordered_set<size_t> inside(nodes.begin(), nodes.end());
+		std::set<std::string> written{};
+		bool is_decreasing{ true };
+		bool is_increasing{ true };
+		for (auto x : nodes)
+			for (const auto& [name, expression] : steps[x].writes) {
+				written.insert(name);
+				if (name != counter)
+					continue;
+				if (!(expression == polynomial::variable(counter) || expression == polynomial{ 0 }))
+					is_decreasing = false;
+				if (steps[x].incremented != counter)
+					is_increasing = false;
+			}
+
+		// Returns true if every path in the loop from a counting instruction to the next one passes through a test
+		auto is_tested = [&](const std::unordered_set<size_t>& tests) {
+			std::unordered_set<size_t> is_visited{};
+			std::vector<size_t> stack{};
+			for (auto x : counted)
+				stack.insert(stack.end(), steps[x].successors.begin(), steps[x].successors.end());
+			while (!stack.empty()) {
+				auto x = stack.back();
+				stack.pop_back();
+				if (!inside.contains(x) || tests.contains(x) || !is_visited.insert(x).second)
+					continue;
+				if (std::find(counted.begin(), counted.end(), x) != counted.end())
+					return false;
+				stack.insert(stack.end(), steps[x].successors.begin(), steps[x].successors.end());
+			}
+			return true;
+		};
+
+		// Tests of the counter with the relation and the other operand, the counter being the left one
+		std::vector<std::tuple<size_t, grammar::relation, std::string>> tests{};
+		for (auto x : nodes) {
+			const auto& y = steps[x];
+			if (!y.is_condition)
+				continue;
+			if (y.compared == counter)
+				tests.emplace_back(x, y.relation, y.operand);
+			else if (y.operand == counter)
+				tests.emplace_back(x, swapped(y.relation), y.compared);
+		}
+
+		if (is_decreasing) {
+			counted.clear();
+			for (auto x : nodes)
+				if (steps[x].decremented == counter)
+					counted.push_back(x);
+
+			std::unordered_set<size_t> exits{};
+			for (const auto& [x, relation, other] : tests) {
+				auto literal = grammar::literal_value(other);
+				std::optional<bool> holds{};
+				switch (relation) {
+				case grammar::relation::equal:
+					if (literal == 0)
+						holds = true;
+					break;
+				case grammar::relation::not_equal:
+					if (literal == 0)
+						holds = false;
+					break;
+				case grammar::relation::less_equal:
+					holds = true;
+					break;
+				case grammar::relation::less:
+					if (literal.value_or(0) > 0)
+						holds = true;
+					break;
+				case grammar::relation::greater:
+					holds = false;
+					break;
+				default:
+					if (literal)
+						holds = *literal == 0;
+					break;
+				}
+				if (holds && !inside.contains(*holds ? steps[x].goto_true : steps[x].goto_false))
+					exits.insert(x);
+			}
+			if (!counted.empty() && is_tested(exits))
+				return polynomial::variable(counter) + polynomial{ 2 };
+		}
+
+		if (is_increasing) {
+			counted.clear();
+			for (auto x : nodes)
+				if (steps[x].incremented == counter)
+					counted.push_back(x);
+
+			// Tests by the limit with the overshoot of the counter past it: 0 for the tests of counter >= limit, 1 for counter > limit
+			std::map<std::string, std::pair<std::unordered_set<size_t>, uint64_t>> limits{};
+			for (const auto& [x, relation, other] : tests) {
+				if (!grammar::literal_value(other) && written.contains(other))
+					continue;
+
+				std::optional<bool> exit{};
+				uint64_t overshoot{ 0 };
+				if (relation == grammar::relation::greater_equal || relation == grammar::relation::greater)
+					exit = true;
+				else if (relation == grammar::relation::less || relation == grammar::relation::less_equal)
+					exit = false;
+				if (relation == grammar::relation::greater || relation == grammar::relation::less_equal)
+					overshoot = 1;
+				if (exit && !inside.contains(*exit ? steps[x].goto_true : steps[x].goto_false)) {
+					auto& [exits, maximum] = limits[other];
+					exits.insert(x);
+					maximum = std::max(maximum, overshoot);
+				}
+			}
+			for (const auto& [limit, tested] : limits)
+				if (!counted.empty() && is_tested(tested.first))
+					return symbol(limit) + polynomial{ tested.second + 2 };
+		}
+
+		counted.clear();
+		return std::nullopt;
+	}
+
+	// Bounds the registers over all passes of the loop entered with the given values, returns the bound of its steps
+	// An instruction executes at most the product of the passes of the loops containing it. A register is bounded by its
+	// value on entry and the values assigned to it in the loop, plus the increments times the executions of the incrementing
+	// instructions. The bounds depend on each other: they are computed in the order of the dependencies, and the registers
+	// depending on themselves through other registers, or growing faster than linearly, are unknown
+	polynomial step_estimator::bound_loop(const std::vector<step>& steps, const loop& loop, valuation& values) {
+		std::unordered_map<size_t, polynomial> executions{};
+		std::function<void(const step_estimator::loop&, const polynomial&)> count = [&](const step_estimator::loop& x, const polynomial& outer) {
+			auto passes = outer * x.passes;
+			for (auto y : x.nodes)
+				executions[y] = passes;
+			for (const auto& y : x.inner)
+				count(y, passes);
+		};
+		count(loop, polynomial{ 1 });
+
+		// Assigned values and increments of the registers written in the loop
+		struct growth {
+			std::vector<polynomial> assigned;
+			std::vector<polynomial> increments;
+			bool is_unknown;
+			std::set<std::string> dependencies;
+		};
+		std::map<std::string, growth> writes{};
+		for (auto x : loop.nodes)
+			for (const auto& [name, expression] : steps[x].writes) {
+				auto& y = writes.try_emplace(name, growth{ {}, {}, false, {} }).first->second;
+				std::optional<polynomial> increment{};
+				if (expression == polynomial::variable(name))
+					continue;
+				if (!expression.contains(name))
+					y.assigned.push_back(expression);
+				else if ((increment = expression.increment_of(name)))
+					y.increments.push_back(*increment * executions.at(x));
+				else
+					y.is_unknown = true;
+			}
+		for (auto& [name, y] : writes) {
+			for (const auto& x : y.assigned)
+				y.dependencies.merge(x.variables());
+			for (const auto& x : y.increments)
+				y.dependencies.merge(x.variables());
+		}
+
+		auto entry = values;
+		auto value = [&values](const std::string& name) {
+			auto it = values.find(name);
+			return it != values.end() ? it->second : polynomial{ 0 };
+		};
+		for (bool is_changed{ true }; is_changed; ) {
+			is_changed = false;
+			for (auto it = writes.begin(); it != writes.end(); ) {
+				auto& [name, y] = *it;
+				if (std::any_of(y.dependencies.begin(), y.dependencies.end(), [&writes](const std::string& x) { return writes.contains(x); })) {
+					++it;
+					continue;
+				}
+
+				auto bound = y.is_unknown ? polynomial::unknown() : entry.contains(name) ? entry.at(name) : polynomial{ 0 };
+				for (const auto& x : y.assigned)
+					bound = bound.join(x.substitute(value));
+				for (const auto& x : y.increments)
+					bound = bound + x.substitute(value);
+				values[name] = std::move(bound);
+				it = writes.erase(it);
+				is_changed = true;
+			}
+		}
+		for (const auto& [name, y] : writes)
+			values[name] = polynomial::unknown();
+
+		polynomial result{ 0 };
+		for (auto x : loop.nodes)
+			result = result + executions.at(x).substitute(value) * steps[x].cost.substitute(value);
+		return result;
+	}
+
+	// Returns the strongly connected components of the instructions of the set in the topological order
+	// Tarjan's algorithm with an explicit stack, since the programs may be long; it finds the components in the reverse order
+	std::vector<std::vector<size_t>> step_estimator::components(const std::vector<step>& steps, const std::vector<size_t>& nodes) {
+		constexpr auto NONE = std::numeric_limits<size_t>::max();
+		std::unordered_map<size_t, size_t> positions{};
+		for (size_t i{ 0 }; i < nodes.size(); ++i)
+			positions[nodes[i]] = i;
+
+		std::vector<size_t> indices(nodes.size(), NONE);
+		std::vector<size_t> lows(nodes.size(), 0);
+		std::vector<bool> is_stacked(nodes.size(), false);
+		std::vector<size_t> stack{};
+		std::vector<std::pair<size_t, size_t>> calls{};
+		std::vector<std::vector<size_t>> result{};
+		size_t index{ 0 };
+
+		auto visit = [&](size_t x) {
+			indices[x] = lows[x] = index++;
+			stack.push_back(x);
+			is_stacked[x] = true;
+			calls.emplace_back(x, 0);
+		};
+		for (size_t root{ 0 }; root < nodes.size(); ++root) {
+			if (indices[root] != NONE)
+				continue;
+			visit(root);
+			while (!calls.empty()) {
+				auto x = calls.back().first;
+				const auto& successors = steps[nodes[x]].successors;
+				if (calls.back().second < successors.size()) {
+					auto it = positions.find(successors[calls.back().second++]);
+					if (it == positions.end())
+						continue;
+					auto y = it->second;
+					if (indices[y] == NONE)
+						visit(y);
+					else if (is_stacked[y])
+						lows[x] = std::min(lows[x], indices[y]);
+					continue;
+				}
+
+				if (lows[x] == indices[x]) {
+					std::vector<size_t> component{};
+					size_t y{ 0 };
+					do {
+						y = stack.back();
+						stack.pop_back();
+						is_stacked[y] = false;
+						component.push_back(nodes[y]);
+					} while (y != x);
+					std::sort(component.begin(), component.end());
+					result.push_back(std::move(component));
+				}
+				calls.pop_back();
+				if (!calls.empty())
+					lows[calls.back().first] = std::min(lows[calls.back().first], lows[x]);
+			}
+		}
+
+		std::reverse(result.begin(), result.end());
+		return result;
+	}
+
+	// Returns true if the component contains a cycle
+	bool step_estimator::is_cyclic(const std::vector<step>& steps, const std::vector<size_t>& component) {
+		if (component.size() > 1)
+			return true;
+		const auto& successors = steps[component.front()].successors;
+		return std::find(successors.begin(), successors.end(), component.front()) != successors.end();
+	}
+}
@@ -0,0 +1,173 @@
+﻿#ifndef __REGISTER_MACHINE_ESTIMATOR_
+#define __REGISTER_MACHINE_ESTIMATOR_
+
+#include "register_machine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace IMD {
+
+	// Polynomial with non-negative integer coefficients in the registers: since the registers hold non-negative values,
+	// it bounds a value or a number of steps from above, and the maximum of the coefficients of two polynomials bounds both
+	// The unknown polynomial bounds nothing; every operation with it, an overflow of a coefficient or too many monomials give it
+	class polynomial {
+	private:
+		// Maximum number of monomials
+		static constexpr size_t MAX_TERMS{ 256 };
+
+		// Coefficients by the monomials: the sorted names of the registers, a register repeated by its power; no zero coefficients
+		std::map<std::vector<std::string>, uint64_t> _terms;
+		// Flag of the unknown polynomial
+		bool _is_unknown;
+
+	public:
+		// Constructor of a constant
+		polynomial(uint64_t value = 0);
+
+		// Returns the polynomial of a register
+		static polynomial variable(const std::string& name);
+		// Returns the unknown polynomial
+		static polynomial unknown();
+
+		// Returns true for the unknown polynomial
+		bool is_unknown() const noexcept;
+		// Returns the registers of the polynomial
+		std::set<std::string> variables() const;
+		// Returns true if some monomial contains the register
+		bool contains(const std::string& name) const;
+		// Returns q if the polynomial is name + q and q does not contain the register, std::nullopt otherwise
+		std::optional<polynomial> increment_of(const std::string& name) const;
+
+		// Sum and product
+		polynomial operator+(const polynomial& other) const;
+		polynomial operator*(const polynomial& other) const;
+		// Returns the polynomial bounding both: the maximum of every coefficient
+		polynomial join(const polynomial& other) const;
+		// Returns the polynomial with every register replaced by the polynomial of its value
+		polynomial substitute(const std::function<polynomial(const std::string&)>& values) const;
+		// Returns the value for the values of the registers, the registers without a value are 0; std::nullopt for the unknown polynomial
+		std::optional<double> evaluate(const std::unordered_map<std::string, int>& values) const;
+
+		// Returns the text of the polynomial: the monomials of higher degrees first, a power as x^2
+		std::string text() const;
+
+		bool operator==(const polynomial& other) const = default;
+	};
+
+	// Static estimator of the number of steps: bounds the steps and the output registers of a program by polynomials
+	// in its input registers without running it, so that a launch of 10^12 steps can be told from a launch of 10 steps
+	// The instructions are split into strongly connected components. A component is a loop if it has a counter: a register
+	// that is decremented by a literal on the loop and never increased in it, and is tested against 0 with a jump out of
+	// the loop on every path from a decrement to the next one; or a register incremented by a literal and compared with
+	// a literal or a register not written in the loop, with a jump out of the loop once it reaches it. A loop with the bound n
+	// of its counter makes at most n + 2 passes, the components left after removing the decrements are the nested loops.
+	// The registers written in a loop are bounded over all of its passes, the increments by the number of their executions.
+	// The called programs and the composition stages are estimated in turn and their bounds are substituted.
+	// A loop without a counter, a register growing faster than linearly in a loop, recursion or an unverified program
+	// make the estimate unknown
+	class step_estimator {
+	public:
+		// Bounds of a program in its input registers
+		struct summary {
+			// Bound of the number of steps
+			polynomial steps;
+			// Bounds of the output registers
+			std::vector<polynomial> outputs;
+		};
+
+	private:
+		// Instruction as the estimate sees it
+		struct step {
+			// Registers written by the instruction with their new values in the registers before it, in the order of writing
+			std::vector<std::pair<std::string, polynomial>> writes;
+			// Number of steps of the instruction in the registers before it: 1, for a call 1 and the steps of the called program
+			polynomial cost;
+			// Numbers of the following instructions
+			std::vector<size_t> successors;
+			// Register decremented or incremented by a literal, empty for the other instructions
+			std::string decremented;
+			std::string incremented;
+			// Condition: compared register, relation, operand (a register or a literal) and the jump targets
+			bool is_condition;
+			std::string compared;
+			grammar::relation relation;
+			std::string operand;
+			size_t goto_true;
+			size_t goto_false;
+			// Stop instruction
+			bool is_stop;
+		};
+
+		// Loop: a strongly connected set of instructions with the bound of its passes and the loops nested in it
+		struct loop {
+			std::vector<size_t> nodes;
+			// Bound of the passes in the registers on entry: the bound of the counter plus 2
+			polynomial passes;
+			std::vector<loop> inner;
+		};
+
+		// Values of the registers: the bounds in the input registers, a missing register is 0
+		using valuation = std::map<std::string, polynomial>;
+
+		// File of the program
+		std::string _filename;
+		// Input and output registers of the first and the last composition stage
+		std::vector<std::string> _inputs;
+		std::vector<std::string> _outputs;
+		// Bounds of the program
+		summary _summary;
+		// Bounds of the called programs; a program being estimated has the unknown bounds, so that a recursive call gets them
+		std::unordered_map<const basic_register_machine*, summary> _summaries;
+
+	public:
+		// Constructor: loads and estimates the program
+		explicit step_estimator(const std::string& filename);
+
+		// Copy constructor
+		step_estimator(const step_estimator&) = delete;
+		// Assignment operator
+		step_estimator& operator=(const step_estimator&) = delete;
+
+		// Destructor
+		~step_estimator() = default;
+
+		// Returns the input and the output registers
+		const std::vector<std::string>& inputs() const noexcept;
+		const std::vector<std::string>& outputs() const noexcept;
+		// Returns the bounds of the program
+		const summary& bounds() const noexcept;
+		// Returns the bound of the number of steps of a launch on the given values of the input registers, std::nullopt if unknown
+		std::optional<double> steps(const std::vector<int>& arguments) const;
+
+	private:
+		// Returns the bounds of a loaded program, the unknown ones for a recursive call
+		const summary& estimate(const basic_register_machine& machine);
+		// Returns the instructions of a loaded program as the estimate sees them
+		std::vector<step> collect(const basic_register_machine& machine);
+		// Returns the bounds of the instructions starting at the first one with the input registers as the variables
+		summary analyze(const std::vector<step>& steps, const std::vector<std::string>& inputs, const std::vector<std::string>& outputs) const;
+
+		// Returns the loop of a strongly connected set of instructions with its nested loops, std::nullopt if some of them has no counter
+		static std::optional<loop> find_loop(const std::vector<step>& steps, const std::vector<size_t>& nodes);
+		// Returns the bound of the passes of the loop for the counter, std::nullopt if the register is not its counter;
+		// the instructions decrementing or incrementing the counter are collected
+		static std::optional<polynomial> find_counter(const std::vector<step>& steps, const std::vector<size_t>& nodes, const std::string& counter,
+			std::vector<size_t>& counted);
+		// Bounds the registers over all passes of the loop entered with the given values, returns the bound of its steps
+		static polynomial bound_loop(const std::vector<step>& steps, const loop& loop, valuation& values);
+		// Returns the strongly connected components of the instructions of the set in the topological order
+		static std::vector<std::vector<size_t>> components(const std::vector<step>& steps, const std::vector<size_t>& nodes);
+		// Returns true if the component contains a cycle
+		static bool is_cyclic(const std::vector<step>& steps, const std::vector<size_t>& component);
+	};
+}
+
+#endif
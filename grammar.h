@@ -0,0 +1,297 @@
+﻿#ifndef __REGISTER_MACHINE_GRAMMAR_
+#define __REGISTER_MACHINE_GRAMMAR_
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <string_view>
+
+// Grammar rules of the RM shared by the lexers and the parsers of the machines and by the compile-time machine
+// Everything here is constexpr, so that a program can be tokenized and evaluated by the same rules at compile time
+namespace IMD::grammar {
+
+	// Enumeration of token types
+	enum class token_type {
+		variable, // Register
+		literal, // Non-negative integer literal
+		keyword_if, // IF
+		keyword_then, // THEN
+		keyword_else, // ELSE
+		keyword_goto, // GOTO
+		operator_copy_assignment, // COPY
+		operator_move_assignment, // MOVE
+		operator_plus, // PLUS
+		operator_minus, // MINUS
+		operator_multiply, // MULTIPLY
+		operator_divide, // DIVIDE
+		operator_modulo, // MODULO
+		operator_equal, // EQUAL
+		operator_not_equal, // NOT_EQUAL
+		operator_less, // LESS
+		operator_less_equal, // LESS_EQUAL
+		operator_greater, // GREATER
+		operator_greater_equal, // GREATER_EQUAL
+		keyword_stop, // STOP
+		keyword_composition, // COMPOSITION
+		operator_result, // RESULT
+		file, // Filename with extension
+		unknown, // Unknown token
+	};
+
+	// Enum of arithmetic operations
+	enum class operation {
+		none,
+		plus,
+		minus,
+		multiply,
+		divide,
+		modulo
+	};
+
+	// Enum of comparison relations
+	enum class relation {
+		equal,
+		not_equal,
+		less,
+		less_equal,
+		greater,
+		greater_equal
+	};
+
+	// Keyword: its spelling and the type of its token
+	struct keyword {
+		std::string_view text;
+		token_type type;
+	};
+
+	// Keywords of the basic RM, in the order they are tried
+	inline constexpr keyword basic_keywords[] = {
+		{ "<-", token_type::operator_copy_assignment },
+		{ "==", token_type::operator_equal },
+		{ "+", token_type::operator_plus },
+		{ "-", token_type::operator_minus },
+		{ "stop", token_type::keyword_stop },
+		{ "if", token_type::keyword_if },
+		{ "then", token_type::keyword_then },
+		{ "else", token_type::keyword_else },
+		{ "goto", token_type::keyword_goto },
+	};
+
+	// Keywords of the extended RM, in the order they are tried
+	inline constexpr keyword extended_keywords[] = {
+		{ "call", token_type::keyword_composition },
+		{ "<-", token_type::operator_copy_assignment },
+		{ "<<-", token_type::operator_move_assignment },
+		{ "->", token_type::operator_result },
+		{ "==", token_type::operator_equal },
+		{ "!=", token_type::operator_not_equal },
+		{ "<", token_type::operator_less },
+		{ "<=", token_type::operator_less_equal },
+		{ ">", token_type::operator_greater },
+		{ ">=", token_type::operator_greater_equal },
+		{ "+", token_type::operator_plus },
+		{ "-", token_type::operator_minus },
+		{ "*", token_type::operator_multiply },
+		{ "/", token_type::operator_divide },
+		{ "%", token_type::operator_modulo },
+		{ "stop", token_type::keyword_stop },
+		{ "if", token_type::keyword_if },
+		{ "then", token_type::keyword_then },
+		{ "else", token_type::keyword_else },
+		{ "goto", token_type::keyword_goto },
+	};
+
+	// Separator of the instruction number and the comment marker
+	inline constexpr std::string_view separator{ ":" };
+	inline constexpr std::string_view comment{ "#" };
+
+	// Checks if the character is a whitespace character of the "C" locale
+	constexpr bool is_space(char c) noexcept {
+		return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+	}
+	// Checks if the character is a decimal digit
+	constexpr bool is_digit(char c) noexcept {
+		return c >= '0' && c <= '9';
+	}
+	// Checks if the character is a Latin letter
+	constexpr bool is_alpha(char c) noexcept {
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	}
+	// Checks if the character is a Latin letter or a decimal digit
+	constexpr bool is_alnum(char c) noexcept {
+		return is_alpha(c) || is_digit(c);
+	}
+
+	// Checks if the given string represents a keyword, the separator or the comment marker
+	constexpr bool is_keyword(std::string_view word) noexcept {
+		if (word == separator || word == comment)
+			return true;
+		for (const auto& x : extended_keywords)
+			if (word == x.text)
+				return true;
+		return false;
+	}
+
+	// Checks if the given string represents a valid register identifier: a letter followed by letters and digits
+	constexpr bool is_register(std::string_view word) noexcept {
+		if (word.empty() || is_keyword(word) || !is_alpha(word.front()))
+			return false;
+		for (size_t i{ 1 }; i < word.size(); ++i)
+			if (!is_alnum(word[i]))
+				return false;
+		return true;
+	}
+
+	// Checks if the given string represents a non-negative integer literal
+	constexpr bool is_non_negative_literal(std::string_view word) noexcept {
+		if (word.empty())
+			return false;
+		for (auto c : word)
+			if (!is_digit(c))
+				return false;
+		return true;
+	}
+
+	// Checks if the given string represents a negative integer literal
+	constexpr bool is_negative_literal(std::string_view word) noexcept {
+		return word.size() >= 2 && word.front() == '-' && is_non_negative_literal(word.substr(1));
+	}
+
+	// Returns the value of a literal, std::nullopt for a register or a literal out of the int range
+	constexpr std::optional<int> literal_value(std::string_view word) noexcept {
+		if (!is_non_negative_literal(word))
+			return std::nullopt;
+		int value{ 0 };
+		for (auto c : word) {
+			if (value > (std::numeric_limits<int>::max() - (c - '0')) / 10)
+				return std::nullopt;
+			value = value * 10 + (c - '0');
+		}
+		return value;
+	}
+
+	// Returns the line without the comment and the surrounding spaces, tabs and line breaks
+	constexpr std::string_view strip(std::string_view line) noexcept {
+		auto is_blank = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+		line = line.substr(0, line.find(comment));
+		while (!line.empty() && is_blank(line.front()))
+			line.remove_prefix(1);
+		while (!line.empty() && is_blank(line.back()))
+			line.remove_suffix(1);
+		return line;
+	}
+
+	// Moves the carriage past the whitespace
+	constexpr void skip_spaces(std::string_view line, size_t& carriage) noexcept {
+		while (carriage < line.size() && is_space(line[carriage]))
+			++carriage;
+	}
+
+	// Returns the first of the keywords standing at the carriage and followed by whitespace or the end of the line, std::nullopt if there is none;
+	// a copy is returned, as a pointer into the table is not compared with null in constant evaluation under -fsanitize=undefined
+	template <size_t N>
+	constexpr std::optional<keyword> match_keyword(std::string_view line, size_t carriage, const keyword(&keywords)[N]) noexcept {
+		for (const auto& x : keywords) {
+			auto end = carriage + x.text.size();
+			if (line.substr(carriage, x.text.size()) == x.text && (end >= line.size() || is_space(line[end])))
+				return x;
+		}
+		return std::nullopt;
+	}
+
+	// Returns the word standing at the carriage, the carriage is moved past it
+	constexpr std::string_view next_word(std::string_view line, size_t& carriage) noexcept {
+		auto start = carriage;
+		while (carriage < line.size() && !is_space(line[carriage]))
+			++carriage;
+		return line.substr(start, carriage - start);
+	}
+
+	// Returns the type of a word that is not a keyword: a literal, a register or unknown
+	constexpr token_type classify(std::string_view word) noexcept {
+		if (is_non_negative_literal(word))
+			return token_type::literal;
+		if (is_register(word))
+			return token_type::variable;
+		return token_type::unknown;
+	}
+
+	// Returns the relation of a comparison operator
+	constexpr std::optional<relation> relation_of(token_type type) noexcept {
+		switch (type) {
+		case token_type::operator_equal:
+			return relation::equal;
+		case token_type::operator_not_equal:
+			return relation::not_equal;
+		case token_type::operator_less:
+			return relation::less;
+		case token_type::operator_less_equal:
+			return relation::less_equal;
+		case token_type::operator_greater:
+			return relation::greater;
+		case token_type::operator_greater_equal:
+			return relation::greater_equal;
+		default:
+			return std::nullopt;
+		}
+	}
+
+	// Returns the operation of an arithmetic operator
+	constexpr std::optional<operation> operation_of(token_type type) noexcept {
+		switch (type) {
+		case token_type::operator_plus:
+			return operation::plus;
+		case token_type::operator_minus:
+			return operation::minus;
+		case token_type::operator_multiply:
+			return operation::multiply;
+		case token_type::operator_divide:
+			return operation::divide;
+		case token_type::operator_modulo:
+			return operation::modulo;
+		default:
+			return std::nullopt;
+		}
+	}
+
+	// Returns the value of the expression: subtraction stops at 0, division by 0 gives 0 and the remainder of it is the dividend
+	// The registers hold non-negative 32-bit values: a sum or a product beyond the range of int saturates at its maximum
+	constexpr int apply(operation operation, int left, int right) noexcept {
+		constexpr long long MAX_VALUE{ std::numeric_limits<int>::max() };
+		switch (operation) {
+		case operation::plus:
+			return static_cast<int>(std::min(static_cast<long long>(left) + right, MAX_VALUE));
+		case operation::minus:
+			return left > right ? left - right : 0;
+		case operation::multiply:
+			return static_cast<int>(std::min(static_cast<long long>(left) * right, MAX_VALUE));
+		case operation::divide:
+			return right == 0 ? 0 : static_cast<int>(static_cast<long long>(left) / right);
+		case operation::modulo:
+			return right == 0 ? left : static_cast<int>(static_cast<long long>(left) % right);
+		default:
+			return left;
+		}
+	}
+
+	// Returns true if the relation holds between the values
+	constexpr bool holds(relation relation, int left, int right) noexcept {
+		switch (relation) {
+		case relation::equal:
+			return left == right;
+		case relation::not_equal:
+			return left != right;
+		case relation::less:
+			return left < right;
+		case relation::less_equal:
+			return left <= right;
+		case relation::greater:
+			return left > right;
+		default:
+			return left >= right;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,694 @@
+﻿#include "lockstep.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LOCKSTEP_X86
+#include <immintrin.h>
+#endif
+
+namespace IMD {
+
+	// Kernels
+	//
+	// Every kernel processes all lanes of one instruction: values and defined are the lanes of a register slot,
+	// mask holds -1 for the lanes standing on the instruction and 0 for the others.
+	// A register that does not exist yet has defined == 0 and value 0: a copy assignment reading it does nothing,
+	// as in basic_register_machine, where such a read throws and the assignment is skipped
+
+	// Kind of a copy assignment
+	enum class arithmetic_kind {
+		assign,
+		plus,
+		minus,
+		multiply,
+		divide,
+		modulo
+	};
+
+	// Relation of a conditional jump: the other relations are reduced to these by swapping the operands or the targets
+	enum class relation_kind {
+		equal,
+		less,
+		less_equal
+	};
+
+	// Pointers to the lanes of the operands of a copy assignment
+	struct arithmetic_lanes {
+		int32_t* target;
+		int32_t* target_defined;
+		const int32_t* left;
+		const int32_t* left_defined;
+		const int32_t* right;
+		const int32_t* right_defined;
+		const int32_t* mask;
+	};
+
+	// Copy assignment in the lanes [begin, end)
+	template <arithmetic_kind kind>
+	static void arithmetic_scalar(const arithmetic_lanes& x, size_t begin, size_t end) noexcept {
+		for (size_t i{ begin }; i < end; ++i) {
+			if (!(x.mask[i] & x.left_defined[i] & x.right_defined[i]))
+				continue;
+
+			// A sum or a product beyond the range of the 32-bit registers saturates, as in the SIMD kernels
+			constexpr int64_t MAX_VALUE{ std::numeric_limits<int32_t>::max() };
+			auto left = static_cast<int64_t>(x.left[i]);
+			auto right = static_cast<int64_t>(x.right[i]);
+			int32_t value{ 0 };
+			if constexpr (kind == arithmetic_kind::assign)
+				value = x.left[i];
+			else if constexpr (kind == arithmetic_kind::plus)
+				value = static_cast<int32_t>(std::min(left + right, MAX_VALUE));
+			else if constexpr (kind == arithmetic_kind::minus)
+				value = static_cast<int32_t>(std::max(left - right, int64_t{ 0 }));
+			else if constexpr (kind == arithmetic_kind::multiply)
+				value = static_cast<int32_t>(std::min(left * right, MAX_VALUE));
+			else if constexpr (kind == arithmetic_kind::divide) // Division by 0 gives 0
+				value = right == 0 ? 0 : static_cast<int32_t>(static_cast<int64_t>(x.left[i]) / x.right[i]);
+			else // The remainder of division by 0 is the dividend
+				value = right == 0 ? x.left[i] : static_cast<int32_t>(static_cast<int64_t>(x.left[i]) % x.right[i]);
+
+			x.target[i] = value;
+			x.target_defined[i] = -1;
+		}
+	}
+
+	// Move assignment in the lanes [begin, end)
+	static void move_scalar(int32_t* to, int32_t* to_defined, int32_t* from, int32_t* from_defined, const int32_t* mask, size_t begin, size_t end) noexcept {
+		for (size_t i{ begin }; i < end; ++i) {
+			if (!mask[i])
+				continue;
+			to[i] = from[i];
+			from[i] = 0;
+			to_defined[i] = -1;
+			from_defined[i] = -1;
+		}
+	}
+
+	// Conditional jump in the lanes [begin, end): the compared registers are created if they do not exist
+	template <relation_kind kind>
+	static void branch_scalar(int32_t* carriage, int32_t* compared, int32_t* compared_defined, const int32_t* value, int32_t* value_defined, int32_t goto_true, int32_t goto_false, const int32_t* mask, size_t begin, size_t end) noexcept {
+		for (size_t i{ begin }; i < end; ++i) {
+			if (!mask[i])
+				continue;
+			compared_defined[i] = -1;
+			value_defined[i] = -1;
+			bool holds{ false };
+			if constexpr (kind == relation_kind::equal)
+				holds = compared[i] == value[i];
+			else if constexpr (kind == relation_kind::less)
+				holds = compared[i] < value[i];
+			else
+				holds = compared[i] <= value[i];
+			carriage[i] = holds ? goto_true : goto_false;
+		}
+	}
+
+	// Sets the carriage of the lanes [begin, end)
+	static void jump_scalar(int32_t* carriage, int32_t target, const int32_t* mask, size_t begin, size_t end) noexcept {
+		for (size_t i{ begin }; i < end; ++i)
+			if (mask[i])
+				carriage[i] = target;
+	}
+
+#ifdef LOCKSTEP_X86
+
+	// AVX2 kernels: process whole vectors of the lanes [begin, end), return the first unprocessed lane
+
+	// Truncating division of 32-bit lanes through double precision, which is exact for 32-bit operands; lanes divided by 0 are undefined
+	__attribute__((target("avx2"))) static __m256i quotient_avx2(__m256i left, __m256i right) noexcept {
+		__m256d low = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(left)), _mm256_cvtepi32_pd(_mm256_castsi256_si128(right)));
+		__m256d high = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(left, 1)), _mm256_cvtepi32_pd(_mm256_extracti128_si256(right, 1)));
+		return _mm256_set_m128i(_mm256_cvttpd_epi32(high), _mm256_cvttpd_epi32(low));
+	}
+
+	// Product of 32-bit lanes through double precision saturated at the maximum of int: a product within the range is exact
+	__attribute__((target("avx2"))) static __m256i product_avx2(__m256i left, __m256i right) noexcept {
+		__m256d limit = _mm256_set1_pd(std::numeric_limits<int32_t>::max());
+		__m256d low = _mm256_min_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(left)), _mm256_cvtepi32_pd(_mm256_castsi256_si128(right))), limit);
+		__m256d high = _mm256_min_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(left, 1)), _mm256_cvtepi32_pd(_mm256_extracti128_si256(right, 1))), limit);
+		return _mm256_set_m128i(_mm256_cvttpd_epi32(high), _mm256_cvttpd_epi32(low));
+	}
+
+	template <arithmetic_kind kind>
+	__attribute__((target("avx2"))) static size_t arithmetic_avx2(const arithmetic_lanes& x, size_t begin, size_t end) noexcept {
+		size_t i{ begin };
+		for (; i + 8 <= end; i += 8) {
+			__m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.mask + i));
+			mask = _mm256_and_si256(mask, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.left_defined + i)));
+			mask = _mm256_and_si256(mask, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.right_defined + i)));
+
+			__m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.left + i));
+			__m256i value{};
+			if constexpr (kind == arithmetic_kind::assign)
+				value = left;
+			else if constexpr (kind == arithmetic_kind::plus) // The sum of two non-negative lanes exceeds the maximum of int only as an unsigned value
+				value = _mm256_min_epu32(_mm256_add_epi32(left, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.right + i))), _mm256_set1_epi32(std::numeric_limits<int32_t>::max()));
+			else if constexpr (kind == arithmetic_kind::minus)
+				value = _mm256_max_epi32(_mm256_sub_epi32(left, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.right + i))), _mm256_setzero_si256());
+			else if constexpr (kind == arithmetic_kind::multiply)
+				value = product_avx2(left, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.right + i)));
+			else {
+				__m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.right + i));
+				__m256i is_zero = _mm256_cmpeq_epi32(right, _mm256_setzero_si256());
+				__m256i quotient = quotient_avx2(left, right);
+				if constexpr (kind == arithmetic_kind::divide)
+					value = _mm256_andnot_si256(is_zero, quotient);
+				else
+					value = _mm256_blendv_epi8(_mm256_sub_epi32(left, _mm256_mullo_epi32(quotient, right)), left, is_zero);
+			}
+
+			__m256i target = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.target + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(x.target + i), _mm256_blendv_epi8(target, value, mask));
+			__m256i target_defined = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.target_defined + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(x.target_defined + i), _mm256_or_si256(target_defined, mask));
+		}
+		return i;
+	}
+
+	__attribute__((target("avx2"))) static size_t move_avx2(int32_t* to, int32_t* to_defined, int32_t* from, int32_t* from_defined, const int32_t* mask, size_t begin, size_t end) noexcept {
+		size_t i{ begin };
+		for (; i + 8 <= end; i += 8) {
+			__m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + i));
+			__m256i source = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + i));
+			__m256i target = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(to + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(to + i), _mm256_blendv_epi8(target, source, m));
+			source = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + i)); // The source is reread: it may be the target
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(from + i), _mm256_andnot_si256(m, source));
+
+			__m256i defined = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(to_defined + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(to_defined + i), _mm256_or_si256(defined, m));
+			defined = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from_defined + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(from_defined + i), _mm256_or_si256(defined, m));
+		}
+		return i;
+	}
+
+	template <relation_kind kind>
+	__attribute__((target("avx2"))) static size_t branch_avx2(int32_t* carriage, int32_t* compared, int32_t* compared_defined, const int32_t* value, int32_t* value_defined, int32_t goto_true, int32_t goto_false, const int32_t* mask, size_t begin, size_t end) noexcept {
+		size_t i{ begin };
+		__m256i true_target = _mm256_set1_epi32(goto_true);
+		__m256i false_target = _mm256_set1_epi32(goto_false);
+		for (; i + 8 <= end; i += 8) {
+			__m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + i));
+			__m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(compared + i));
+			__m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(value + i));
+			__m256i target{};
+			if constexpr (kind == relation_kind::equal)
+				target = _mm256_blendv_epi8(false_target, true_target, _mm256_cmpeq_epi32(left, right));
+			else if constexpr (kind == relation_kind::less)
+				target = _mm256_blendv_epi8(false_target, true_target, _mm256_cmpgt_epi32(right, left));
+			else
+				target = _mm256_blendv_epi8(true_target, false_target, _mm256_cmpgt_epi32(left, right));
+			__m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(carriage + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(carriage + i), _mm256_blendv_epi8(current, target, m));
+
+			__m256i defined = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(compared_defined + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(compared_defined + i), _mm256_or_si256(defined, m));
+			defined = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(value_defined + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(value_defined + i), _mm256_or_si256(defined, m));
+		}
+		return i;
+	}
+
+	__attribute__((target("avx2"))) static size_t jump_avx2(int32_t* carriage, int32_t target, const int32_t* mask, size_t begin, size_t end) noexcept {
+		size_t i{ begin };
+		__m256i value = _mm256_set1_epi32(target);
+		for (; i + 8 <= end; i += 8) {
+			__m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + i));
+			__m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(carriage + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(carriage + i), _mm256_blendv_epi8(current, value, m));
+		}
+		return i;
+	}
+
+	// AVX-512 kernels: process whole vectors of the lanes [begin, end), return the first unprocessed lane
+	// The unmasked AVX-512 intrinsics of GCC start their results from an undefined vector, which GCC itself reports as uninitialized
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+	// Truncating division of 32-bit lanes through double precision, which is exact for 32-bit operands; lanes divided by 0 are undefined
+	__attribute__((target("avx512f"))) static __m512i quotient_avx512(__m512i left, __m512i right) noexcept {
+		__m512d low = _mm512_div_pd(_mm512_cvtepi32_pd(_mm512_castsi512_si256(left)), _mm512_cvtepi32_pd(_mm512_castsi512_si256(right)));
+		__m512d high = _mm512_div_pd(_mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(left, 1)), _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(right, 1)));
+		return _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvttpd_epi32(low)), _mm512_cvttpd_epi32(high), 1);
+	}
+
+	// Product of 32-bit lanes through double precision saturated at the maximum of int: a product within the range is exact
+	__attribute__((target("avx512f"))) static __m512i product_avx512(__m512i left, __m512i right) noexcept {
+		__m512d limit = _mm512_set1_pd(std::numeric_limits<int32_t>::max());
+		__m512d low = _mm512_min_pd(_mm512_mul_pd(_mm512_cvtepi32_pd(_mm512_castsi512_si256(left)), _mm512_cvtepi32_pd(_mm512_castsi512_si256(right))), limit);
+		__m512d high = _mm512_min_pd(_mm512_mul_pd(_mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(left, 1)), _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(right, 1))), limit);
+		return _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvttpd_epi32(low)), _mm512_cvttpd_epi32(high), 1);
+	}
+
+	template <arithmetic_kind kind>
+	__attribute__((target("avx512f"))) static size_t arithmetic_avx512(const arithmetic_lanes& x, size_t begin, size_t end) noexcept {
+		size_t i{ begin };
+		for (; i + 16 <= end; i += 16) {
+			__m512i mask = _mm512_loadu_si512(x.mask + i);
+			mask = _mm512_and_si512(mask, _mm512_loadu_si512(x.left_defined + i));
+			mask = _mm512_and_si512(mask, _mm512_loadu_si512(x.right_defined + i));
+			__mmask16 m = _mm512_test_epi32_mask(mask, mask);
+
+			__m512i left = _mm512_loadu_si512(x.left + i);
+			__m512i value{};
+			if constexpr (kind == arithmetic_kind::assign)
+				value = left;
+			else if constexpr (kind == arithmetic_kind::plus)
+				value = _mm512_min_epu32(_mm512_add_epi32(left, _mm512_loadu_si512(x.right + i)), _mm512_set1_epi32(std::numeric_limits<int32_t>::max()));
+			else if constexpr (kind == arithmetic_kind::minus)
+				value = _mm512_max_epi32(_mm512_sub_epi32(left, _mm512_loadu_si512(x.right + i)), _mm512_setzero_si512());
+			else if constexpr (kind == arithmetic_kind::multiply)
+				value = product_avx512(left, _mm512_loadu_si512(x.right + i));
+			else {
+				__m512i right = _mm512_loadu_si512(x.right + i);
+				__mmask16 is_zero = _mm512_cmpeq_epi32_mask(right, _mm512_setzero_si512());
+				__m512i quotient = quotient_avx512(left, right);
+				if constexpr (kind == arithmetic_kind::divide)
+					value = _mm512_mask_blend_epi32(is_zero, quotient, _mm512_setzero_si512());
+				else
+					value = _mm512_mask_blend_epi32(is_zero, _mm512_sub_epi32(left, _mm512_mullo_epi32(quotient, right)), left);
+			}
+
+			_mm512_mask_storeu_epi32(x.target + i, m, value);
+			_mm512_mask_storeu_epi32(x.target_defined + i, m, _mm512_set1_epi32(-1));
+		}
+		return i;
+	}
+
+	__attribute__((target("avx512f"))) static size_t move_avx512(int32_t* to, int32_t* to_defined, int32_t* from, int32_t* from_defined, const int32_t* mask, size_t begin, size_t end) noexcept {
+		size_t i{ begin };
+		for (; i + 16 <= end; i += 16) {
+			__m512i m = _mm512_loadu_si512(mask + i);
+			__mmask16 k = _mm512_test_epi32_mask(m, m);
+			_mm512_mask_storeu_epi32(to + i, k, _mm512_loadu_si512(from + i));
+			_mm512_mask_storeu_epi32(from + i, k, _mm512_setzero_si512());
+			_mm512_mask_storeu_epi32(to_defined + i, k, _mm512_set1_epi32(-1));
+			_mm512_mask_storeu_epi32(from_defined + i, k, _mm512_set1_epi32(-1));
+		}
+		return i;
+	}
+
+	template <relation_kind kind>
+	__attribute__((target("avx512f"))) static size_t branch_avx512(int32_t* carriage, int32_t* compared, int32_t* compared_defined, const int32_t* value, int32_t* value_defined, int32_t goto_true, int32_t goto_false, const int32_t* mask, size_t begin, size_t end) noexcept {
+		size_t i{ begin };
+		__m512i true_target = _mm512_set1_epi32(goto_true);
+		__m512i false_target = _mm512_set1_epi32(goto_false);
+		for (; i + 16 <= end; i += 16) {
+			__m512i m = _mm512_loadu_si512(mask + i);
+			__mmask16 k = _mm512_test_epi32_mask(m, m);
+			__m512i left = _mm512_loadu_si512(compared + i);
+			__m512i right = _mm512_loadu_si512(value + i);
+			__mmask16 holds{};
+			if constexpr (kind == relation_kind::equal)
+				holds = _mm512_cmpeq_epi32_mask(left, right);
+			else if constexpr (kind == relation_kind::less)
+				holds = _mm512_cmplt_epi32_mask(left, right);
+			else
+				holds = _mm512_cmple_epi32_mask(left, right);
+			_mm512_mask_storeu_epi32(carriage + i, k, _mm512_mask_blend_epi32(holds, false_target, true_target));
+			_mm512_mask_storeu_epi32(compared_defined + i, k, _mm512_set1_epi32(-1));
+			_mm512_mask_storeu_epi32(value_defined + i, k, _mm512_set1_epi32(-1));
+		}
+		return i;
+	}
+
+	__attribute__((target("avx512f"))) static size_t jump_avx512(int32_t* carriage, int32_t target, const int32_t* mask, size_t begin, size_t end) noexcept {
+		size_t i{ begin };
+		for (; i + 16 <= end; i += 16) {
+			__m512i m = _mm512_loadu_si512(mask + i);
+			_mm512_mask_storeu_epi32(carriage + i, _mm512_test_epi32_mask(m, m), _mm512_set1_epi32(target));
+		}
+		return i;
+	}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+	// Returns the best instruction set supported by the processor
+	static lockstep_machine::isa supported_isa() noexcept {
+#ifdef LOCKSTEP_X86
+		if (__builtin_cpu_supports("avx512f"))
+			return lockstep_machine::isa::avx512;
+		if (__builtin_cpu_supports("avx2"))
+			return lockstep_machine::isa::avx2;
+#endif
+		return lockstep_machine::isa::scalar;
+	}
+
+	// Copy assignment in all lanes with the given instruction set
+	template <arithmetic_kind kind>
+	static void arithmetic(lockstep_machine::isa isa, const arithmetic_lanes& x, size_t lanes) noexcept {
+		size_t i{ 0 };
+#ifdef LOCKSTEP_X86
+		if (isa == lockstep_machine::isa::avx512)
+			i = arithmetic_avx512<kind>(x, i, lanes);
+		if (isa != lockstep_machine::isa::scalar)
+			i = arithmetic_avx2<kind>(x, i, lanes);
+#endif
+		arithmetic_scalar<kind>(x, i, lanes);
+	}
+
+	// Move assignment in all lanes with the given instruction set
+	static void move(lockstep_machine::isa isa, int32_t* to, int32_t* to_defined, int32_t* from, int32_t* from_defined, const int32_t* mask, size_t lanes) noexcept {
+		size_t i{ 0 };
+#ifdef LOCKSTEP_X86
+		if (isa == lockstep_machine::isa::avx512)
+			i = move_avx512(to, to_defined, from, from_defined, mask, i, lanes);
+		if (isa != lockstep_machine::isa::scalar)
+			i = move_avx2(to, to_defined, from, from_defined, mask, i, lanes);
+#endif
+		move_scalar(to, to_defined, from, from_defined, mask, i, lanes);
+	}
+
+	// Conditional jump in all lanes with the given instruction set
+	template <relation_kind kind>
+	static void branch(lockstep_machine::isa isa, int32_t* carriage, int32_t* compared, int32_t* compared_defined, const int32_t* value, int32_t* value_defined, int32_t goto_true, int32_t goto_false, const int32_t* mask, size_t lanes) noexcept {
+		size_t i{ 0 };
+#ifdef LOCKSTEP_X86
+		if (isa == lockstep_machine::isa::avx512)
+			i = branch_avx512<kind>(carriage, compared, compared_defined, value, value_defined, goto_true, goto_false, mask, i, lanes);
+		if (isa != lockstep_machine::isa::scalar)
+			i = branch_avx2<kind>(carriage, compared, compared_defined, value, value_defined, goto_true, goto_false, mask, i, lanes);
+#endif
+		branch_scalar<kind>(carriage, compared, compared_defined, value, value_defined, goto_true, goto_false, mask, i, lanes);
+	}
+
+	// Sets the carriage of all lanes with the given instruction set
+	static void jump(lockstep_machine::isa isa, int32_t* carriage, int32_t target, const int32_t* mask, size_t lanes) noexcept {
+		size_t i{ 0 };
+#ifdef LOCKSTEP_X86
+		if (isa == lockstep_machine::isa::avx512)
+			i = jump_avx512(carriage, target, mask, i, lanes);
+		if (isa != lockstep_machine::isa::scalar)
+			i = jump_avx2(carriage, target, mask, i, lanes);
+#endif
+		jump_scalar(carriage, target, mask, i, lanes);
+	}
+
+	// Implementation of the lockstep machine
+
+	// Returns the average share of lanes doing useful work per issued instruction
+	double lockstep_machine::statistics::utilization() const noexcept {
+		if (this->issued == 0 || this->lanes == 0)
+			return 0.0;
+		return static_cast<double>(this->lane_steps) / static_cast<double>(this->issued * this->lanes);
+	}
+
+	// Constructor
+	lockstep_machine::lockstep_machine(const std::string& filename, size_t lanes, std::optional<isa> instruction_set) : _stages(), _lanes(lanes), _isa(supported_isa()), _statistics{ 0, 0, lanes }, _steps() {
+		if (lanes != 4 && lanes != 8 && lanes != 16)
+			throw std::invalid_argument("The number of lanes must be 4, 8 or 16");
+
+		if (instruction_set && *instruction_set < this->_isa) // An unsupported instruction set is replaced by the best supported one
+			this->_isa = *instruction_set;
+
+		extended_register_machine erm(filename);
+		for (const auto& machine : erm.load_stages())
+			this->_stages.push_back(compile(*machine));
+	}
+
+	// Launch on a batch of input tuples, returns the output tuples in the same order
+	std::vector<std::vector<int>> lockstep_machine::run(const std::vector<std::vector<int>>& inputs) {
+		auto tuples = inputs;
+		this->_steps.assign(inputs.size(), 0);
+
+		for (size_t first{ 0 }; first < tuples.size(); first += this->_lanes) {
+			size_t count = std::min(this->_lanes, tuples.size() - first);
+			for (const auto& stage : this->_stages) // The outputs of a stage are the inputs of the next one
+				this->execute(stage, tuples, first, count);
+		}
+
+		return tuples;
+	}
+
+	// Returns the lane utilization of all launches
+	const lockstep_machine::statistics& lockstep_machine::stats() const noexcept {
+		return this->_statistics;
+	}
+
+	// Returns the number of executed instructions per input of the last launch
+	const std::vector<size_t>& lockstep_machine::steps() const noexcept {
+		return this->_steps;
+	}
+
+	// Returns the instruction set used by the kernels
+	lockstep_machine::isa lockstep_machine::instruction_set() const noexcept {
+		return this->_isa;
+	}
+
+	// Compiles the instructions of a loaded stage
+	lockstep_machine::stage lockstep_machine::compile(const basic_register_machine& brm) {
+		stage result{ brm._filename, {}, 0, {}, {}, {}, {} };
+
+		std::unordered_map<std::string, size_t> registers{};
+		std::unordered_map<std::string, size_t> literals{};
+
+		auto register_slot = [&](const std::string& name) {
+			auto [it, is_inserted] = registers.try_emplace(name, result.registers);
+			if (is_inserted)
+				++result.registers;
+			return it->second;
+		};
+		auto literal_slot = [&](const std::string& text) {
+			auto [it, is_inserted] = literals.try_emplace(text, result.registers);
+			if (is_inserted) {
+				++result.registers;
+				try { // A literal out of the register range does not exist, as in get_value where it throws
+					result.constants.emplace_back(it->second, std::stoi(text));
+					result.initial.push_back(it->second);
+				}
+				catch (const std::out_of_range&) {}
+			}
+			return it->second;
+		};
+		auto operand_slot = [&](const std::string& operand) {
+			return is_non_negative_literal(operand) ? literal_slot(operand) : register_slot(operand);
+		};
+		auto mark = [&](size_t mark) {
+			return static_cast<int32_t>(std::min<size_t>(mark, std::numeric_limits<int32_t>::max()));
+		};
+
+		for (const auto& x : brm._input_registers)
+			result.inputs.push_back(register_slot(x));
+		for (const auto& x : brm._output_registers)
+			result.outputs.push_back(register_slot(x));
+		result.initial.insert(result.initial.end(), result.inputs.begin(), result.inputs.end());
+		result.initial.insert(result.initial.end(), result.outputs.begin(), result.outputs.end());
+
+		for (const auto* pointer : brm._instructions) {
+			switch (pointer->kind()) {
+			case basic_register_machine::instruction_kind::copy_assignment: {
+				auto copy = static_cast<const basic_register_machine::copy_assignment_instruction*>(pointer);
+				operation compiled{ opcode::assign, register_slot(copy->target_register()), operand_slot(copy->left_operand()), 0, 0, 0 };
+				switch (copy->operation_type()) {
+				case basic_register_machine::operation::plus:
+					compiled.code = opcode::plus;
+					break;
+				case basic_register_machine::operation::minus:
+					compiled.code = opcode::minus;
+					break;
+				case basic_register_machine::operation::multiply:
+					compiled.code = opcode::multiply;
+					break;
+				case basic_register_machine::operation::divide:
+					compiled.code = opcode::divide;
+					break;
+				case basic_register_machine::operation::modulo:
+					compiled.code = opcode::modulo;
+					break;
+				default:
+					break;
+				}
+				compiled.right = compiled.code == opcode::assign ? compiled.left : operand_slot(copy->right_operand());
+				result.code.push_back(compiled);
+				break;
+			}
+			case basic_register_machine::instruction_kind::move_assignment: {
+				auto move = static_cast<const basic_register_machine::move_assignment_instruction*>(pointer);
+				result.code.push_back({ opcode::move, register_slot(move->to_register()), register_slot(move->from_register()), 0, 0, 0 });
+				break;
+			}
+			case basic_register_machine::instruction_kind::extended_condition: {
+				auto extended_condition = static_cast<const basic_register_machine::extended_condition_instruction*>(pointer);
+				// The register is compared as size_t: the value must be representable by a 32-bit register
+				auto value = extended_condition->compared_value();
+				auto register_value = static_cast<int32_t>(value);
+				if (static_cast<size_t>(static_cast<int64_t>(register_value)) != value)
+					throw std::runtime_error("Filename: " + brm._filename + ". The compared value is out of the register range: " + pointer->description());
+
+				size_t slot = result.registers++;
+				result.constants.emplace_back(slot, register_value);
+				result.initial.push_back(slot);
+				result.code.push_back({ opcode::branch, register_slot(extended_condition->compared_register()), slot, 0, mark(extended_condition->goto_true()), mark(extended_condition->goto_false()) });
+				break;
+			}
+			case basic_register_machine::instruction_kind::comparison: {
+				auto comparison = static_cast<const basic_register_machine::comparison_instruction*>(pointer);
+				// x != y jumps as x == y with the targets swapped, x > y as y < x and x >= y as y <= x
+				auto compared = register_slot(comparison->compared_register());
+				auto operand = operand_slot(comparison->compared_operand());
+				auto goto_true = mark(comparison->goto_true());
+				auto goto_false = mark(comparison->goto_false());
+				switch (comparison->relation_type()) {
+				case basic_register_machine::relation::equal:
+					result.code.push_back({ opcode::branch, compared, operand, 0, goto_true, goto_false });
+					break;
+				case basic_register_machine::relation::not_equal:
+					result.code.push_back({ opcode::branch, compared, operand, 0, goto_false, goto_true });
+					break;
+				case basic_register_machine::relation::less:
+					result.code.push_back({ opcode::branch_less, compared, operand, 0, goto_true, goto_false });
+					break;
+				case basic_register_machine::relation::less_equal:
+					result.code.push_back({ opcode::branch_less_equal, compared, operand, 0, goto_true, goto_false });
+					break;
+				case basic_register_machine::relation::greater:
+					result.code.push_back({ opcode::branch_less, operand, compared, 0, goto_true, goto_false });
+					break;
+				case basic_register_machine::relation::greater_equal:
+					result.code.push_back({ opcode::branch_less_equal, operand, compared, 0, goto_true, goto_false });
+					break;
+				}
+				break;
+			}
+			case basic_register_machine::instruction_kind::condition: {
+				auto condition = static_cast<const basic_register_machine::condition_instruction*>(pointer);
+				result.code.push_back({ opcode::branch, register_slot(condition->compared_register()), literal_slot("0"), 0, mark(condition->goto_true()), mark(condition->goto_false()) });
+				break;
+			}
+			case basic_register_machine::instruction_kind::jump:
+				result.code.push_back({ opcode::jump, 0, 0, 0, mark(static_cast<const basic_register_machine::goto_instruction*>(pointer)->target_mark()), 0 });
+				break;
+			case basic_register_machine::instruction_kind::stop:
+				result.code.push_back({ opcode::stop, 0, 0, 0, 0, 0 });
+				break;
+			default:
+				throw std::runtime_error("Filename: " + brm._filename + ". The instruction is not supported by the lockstep machine: " + pointer->description());
+			}
+		}
+
+		return result;
+	}
+
+	// Executes a stage for a group of at most _lanes tuples, the outputs replace the inputs
+	void lockstep_machine::execute(const stage& stage, std::vector<std::vector<int>>& tuples, size_t first, size_t count) {
+		const size_t lanes{ this->_lanes };
+
+		std::vector<int32_t> values(stage.registers * lanes, 0);
+		std::vector<int32_t> defined(stage.registers * lanes, 0);
+		std::vector<int32_t> carriage(lanes, 0);
+		std::vector<int32_t> mask(lanes, 0);
+		std::vector<char> is_running(lanes, 0);
+
+		auto lane_values = [&](size_t slot) { return values.data() + slot * lanes; };
+		auto lane_defined = [&](size_t slot) { return defined.data() + slot * lanes; };
+
+		for (const auto& [slot, value] : stage.constants)
+			std::fill_n(lane_values(slot), lanes, value);
+		for (auto slot : stage.initial)
+			std::fill_n(lane_defined(slot), lanes, -1);
+
+		for (size_t lane{ 0 }; lane < count; ++lane) {
+			const auto& input = tuples[first + lane];
+			if (input.size() < stage.inputs.size()) // Check the correspondence between the number of arguments and input registers
+				throw std::runtime_error("Filename: " + stage.filename + ". Not enough input values for arguments");
+			for (size_t i{ 0 }; i < stage.inputs.size(); ++i)
+				lane_values(stage.inputs[i])[lane] = input[i];
+			is_running[lane] = 1;
+		}
+
+		while (true) {
+			// The smallest carriage among the running lanes is executed: lanes behind catch up with the others
+			size_t carriage_min{ std::numeric_limits<size_t>::max() };
+			for (size_t lane{ 0 }; lane < count; ++lane)
+				if (is_running[lane])
+					carriage_min = std::min(carriage_min, static_cast<size_t>(carriage[lane]));
+
+			if (carriage_min == std::numeric_limits<size_t>::max())
+				break;
+
+			if (carriage_min >= stage.code.size())
+				throw std::runtime_error("Filename: " + stage.filename + ". The register machine is stuck in a loop");
+
+			size_t active{ 0 };
+			for (size_t lane{ 0 }; lane < lanes; ++lane) {
+				bool is_active = is_running[lane] && static_cast<size_t>(carriage[lane]) == carriage_min;
+				mask[lane] = is_active ? -1 : 0;
+				if (is_active) {
+					++active;
+					++this->_steps[first + lane];
+				}
+			}
+			++this->_statistics.issued;
+			this->_statistics.lane_steps += active;
+
+			const auto& current = stage.code[carriage_min];
+			auto next = static_cast<int32_t>(carriage_min + 1);
+
+			switch (current.code) {
+			case opcode::assign:
+			case opcode::plus:
+			case opcode::minus:
+			case opcode::multiply:
+			case opcode::divide:
+			case opcode::modulo: {
+				arithmetic_lanes x{ lane_values(current.target), lane_defined(current.target), lane_values(current.left), lane_defined(current.left), lane_values(current.right), lane_defined(current.right), mask.data() };
+				if (current.code == opcode::assign)
+					arithmetic<arithmetic_kind::assign>(this->_isa, x, lanes);
+				else if (current.code == opcode::plus)
+					arithmetic<arithmetic_kind::plus>(this->_isa, x, lanes);
+				else if (current.code == opcode::minus)
+					arithmetic<arithmetic_kind::minus>(this->_isa, x, lanes);
+				else if (current.code == opcode::multiply)
+					arithmetic<arithmetic_kind::multiply>(this->_isa, x, lanes);
+				else if (current.code == opcode::divide)
+					arithmetic<arithmetic_kind::divide>(this->_isa, x, lanes);
+				else
+					arithmetic<arithmetic_kind::modulo>(this->_isa, x, lanes);
+				jump(this->_isa, carriage.data(), next, mask.data(), lanes);
+				break;
+			}
+			case opcode::move:
+				move(this->_isa, lane_values(current.target), lane_defined(current.target), lane_values(current.left), lane_defined(current.left), mask.data(), lanes);
+				jump(this->_isa, carriage.data(), next, mask.data(), lanes);
+				break;
+			case opcode::branch:
+				branch<relation_kind::equal>(this->_isa, carriage.data(), lane_values(current.target), lane_defined(current.target), lane_values(current.left), lane_defined(current.left), current.goto_true, current.goto_false, mask.data(), lanes);
+				break;
+			case opcode::branch_less:
+				branch<relation_kind::less>(this->_isa, carriage.data(), lane_values(current.target), lane_defined(current.target), lane_values(current.left), lane_defined(current.left), current.goto_true, current.goto_false, mask.data(), lanes);
+				break;
+			case opcode::branch_less_equal:
+				branch<relation_kind::less_equal>(this->_isa, carriage.data(), lane_values(current.target), lane_defined(current.target), lane_values(current.left), lane_defined(current.left), current.goto_true, current.goto_false, mask.data(), lanes);
+				break;
+			case opcode::jump:
+				jump(this->_isa, carriage.data(), current.goto_true, mask.data(), lanes);
+				break;
+			case opcode::stop:
+				for (size_t lane{ 0 }; lane < lanes; ++lane)
+					if (mask[lane])
+						is_running[lane] = 0;
+				break;
+			}
+		}
+
+		for (size_t lane{ 0 }; lane < count; ++lane) {
+			auto& output = tuples[first + lane];
+			output.clear();
+			for (auto slot : stage.outputs)
+				output.push_back(lane_values(slot)[lane]);
+		}
+	}
+}
\ No newline at end of file
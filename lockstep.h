@@ -0,0 +1,127 @@
+﻿#ifndef __REGISTER_MACHINE_LOCKSTEP_
+#define __REGISTER_MACHINE_LOCKSTEP_
+
+#include "register_machine.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace IMD {
+
+	// Lockstep (SPMD) interpreter: executes one program on a group of inputs at once
+	// Registers of all lanes are kept in structure-of-arrays layout, so that every instruction is executed
+	// for all lanes with AVX2/AVX-512 (or scalar code). Lanes diverging on a condition get their own carriages;
+	// at every step the instruction with the smallest carriage is executed for the lanes standing on it,
+	// so that diverged lanes re-converge when their paths meet
+	class lockstep_machine {
+	public:
+		// Instruction set used by the kernels
+		enum class isa {
+			scalar,
+			avx2,
+			avx512
+		};
+
+		// Lane utilization statistics
+		struct statistics {
+			// Number of instructions issued for a group of lanes
+			size_t issued;
+			// Number of instructions executed by individual lanes
+			size_t lane_steps;
+			// Number of lanes
+			size_t lanes;
+
+			// Returns the average share of lanes doing useful work per issued instruction
+			double utilization() const noexcept;
+		};
+
+	private:
+		// Operation codes of the compiled instructions
+		enum class opcode {
+			assign, // target <- left
+			plus, // target <- left + right
+			minus, // target <- left - right, not less than 0
+			multiply, // target <- left * right
+			divide, // target <- left / right, 0 when right is 0
+			modulo, // target <- left % right, left when right is 0
+			move, // target <<- left
+			branch, // if target == left then goto goto_true else goto goto_false
+			branch_less, // if target < left then goto goto_true else goto goto_false
+			branch_less_equal, // if target <= left then goto goto_true else goto goto_false
+			jump, // goto goto_true
+			stop // stop
+		};
+
+		// Compiled instruction: operands are register slots, literals are slots holding constants
+		struct operation {
+			opcode code;
+			size_t target;
+			size_t left;
+			size_t right;
+			int32_t goto_true;
+			int32_t goto_false;
+		};
+
+		// Compiled composition stage
+		struct stage {
+			// Name of the stage file
+			std::string filename;
+			// Compiled instructions
+			std::vector<operation> code;
+			// Number of register slots
+			size_t registers;
+			// Slots of literals and their values
+			std::vector<std::pair<size_t, int32_t>> constants;
+			// Slots existing right after loading: input and output registers and literals
+			std::vector<size_t> initial;
+			// Slots of the input registers
+			std::vector<size_t> inputs;
+			// Slots of the output registers
+			std::vector<size_t> outputs;
+		};
+
+	private:
+		// Compiled composition stages
+		std::vector<stage> _stages;
+		// Number of lanes
+		size_t _lanes;
+		// Instruction set used by the kernels
+		isa _isa;
+		// Lane utilization of the launches
+		statistics _statistics;
+		// Number of executed instructions per input of the last launch
+		std::vector<size_t> _steps;
+
+	public:
+		// Constructor: lanes is 4, 8 or 16; without an explicit instruction set the best supported one is used
+		explicit lockstep_machine(const std::string& filename, size_t lanes = 8, std::optional<isa> instruction_set = std::nullopt);
+
+		// Copy constructor
+		lockstep_machine(const lockstep_machine&) = delete;
+		// Assignment operator
+		lockstep_machine& operator=(const lockstep_machine&) = delete;
+
+		// Destructor
+		~lockstep_machine() = default;
+
+		// Launch on a batch of input tuples, returns the output tuples in the same order
+		std::vector<std::vector<int>> run(const std::vector<std::vector<int>>& inputs);
+
+		// Returns the lane utilization of all launches
+		const statistics& stats() const noexcept;
+		// Returns the number of executed instructions per input of the last launch
+		const std::vector<size_t>& steps() const noexcept;
+		// Returns the instruction set used by the kernels
+		isa instruction_set() const noexcept;
+
+	private:
+		// Compiles the instructions of a loaded stage
+		static stage compile(const basic_register_machine& brm);
+		// Executes a stage for a group of at most _lanes tuples, the outputs replace the inputs
+		void execute(const stage& stage, std::vector<std::vector<int>>& tuples, size_t first, size_t count);
+	};
+}
+
+#endif
\ No newline at end of file
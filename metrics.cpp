@@ -0,0 +1,297 @@
+﻿#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace IMD {
+
+	// Helper methods
+
+	// Returns the string quoted and escaped for JSON and for the label values of the Prometheus format
+	static std::string escaped(std::string_view text) {
+		std::string result{ "\"" };
+		for (char ch : text) {
+			if (ch == '"' || ch == '\\')
+				result.push_back('\\');
+			if (ch == '\n') {
+				result += "\\n";
+				continue;
+			}
+			result.push_back(ch);
+		}
+		result.push_back('"');
+		return result;
+	}
+
+	// Returns the value converted by the scale, rounded to an integer
+	static uint64_t scaled(uint64_t value, double scale) noexcept {
+		return scale == 1.0 ? value : static_cast<uint64_t>(std::llround(static_cast<double>(value) * scale));
+	}
+
+	// Quantiles of the exported histograms
+	static constexpr std::pair<const char*, double> QUANTILES[]{ { "0.5", 0.5 }, { "0.9", 0.9 }, { "0.99", 0.99 }, { "0.999", 0.999 } };
+
+	// Histograms of the program metrics: name in JSON, name and description in the Prometheus format; times are exported in nanoseconds
+	struct histogram_family {
+		histogram program_metrics::* member;
+		bool is_time;
+		const char* key;
+		const char* name;
+		const char* help;
+	};
+	static const histogram_family HISTOGRAMS[]{
+		{ &program_metrics::parse, true, "parse_ns", "rm_parse_nanoseconds", "Time of parsing the instructions of a program file" },
+		{ &program_metrics::include, true, "include_ns", "rm_include_nanoseconds", "Time of resolving the composition of a program file into stages" },
+		{ &program_metrics::execute, true, "execute_ns", "rm_execute_nanoseconds", "Time of executing a stage: a whole launch or a slice of a resumable one" },
+		{ &program_metrics::run, true, "run_ns", "rm_run_nanoseconds", "Time of a launch of a composition from start to halt or error" },
+		{ &program_metrics::run_steps, false, "run_steps", "rm_run_steps", "Number of instructions executed by a launch of a composition" },
+	};
+
+	// Returns the number of instructions a stage executes per second of its execution time
+	static double steps_per_second(const program_metrics& metrics, double nanoseconds_per_tick) noexcept {
+		auto time = static_cast<double>(metrics.execute.sum()) * nanoseconds_per_tick;
+		return time == 0 ? 0.0 : static_cast<double>(metrics.steps.value()) * 1e9 / time;
+	}
+
+	// Implementation of the counter
+
+	// Constructor
+	counter::counter() noexcept : _value(0) {}
+
+	// Adds the value to the counter
+	void counter::add(uint64_t value) noexcept {
+		this->_value.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	// Returns the value of the counter
+	uint64_t counter::value() const noexcept {
+		return this->_value.load(std::memory_order_relaxed);
+	}
+
+	// Implementation of the histogram
+
+	// Constructor
+	histogram::histogram() noexcept : _buckets(), _sum(0), _max(0) {
+		for (auto& x : this->_buckets)
+			x.store(0, std::memory_order_relaxed);
+	}
+
+	// Records a value
+	void histogram::record(uint64_t value) noexcept {
+		this->_buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+		this->_sum.fetch_add(value, std::memory_order_relaxed);
+		auto max = this->_max.load(std::memory_order_relaxed);
+		while (value > max && !this->_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+	}
+
+	// Returns the number of the recorded values
+	uint64_t histogram::count() const noexcept {
+		uint64_t count{ 0 };
+		for (const auto& x : this->_buckets)
+			count += x.load(std::memory_order_relaxed);
+		return count;
+	}
+
+	// Returns the sum of the recorded values
+	uint64_t histogram::sum() const noexcept {
+		return this->_sum.load(std::memory_order_relaxed);
+	}
+
+	// Returns the largest recorded value
+	uint64_t histogram::max() const noexcept {
+		return this->_max.load(std::memory_order_relaxed);
+	}
+
+	// Returns the value below or equal to which the given share of the recorded values lies
+	// The buckets are read one by one while other threads may record, so the result is approximate under load
+	uint64_t histogram::percentile(double share) const noexcept {
+		auto count = this->count();
+		if (count == 0)
+			return 0;
+
+		auto rank = static_cast<uint64_t>(std::ceil(std::clamp(share, 0.0, 1.0) * static_cast<double>(count)));
+		rank = std::clamp<uint64_t>(rank, 1, count);
+		uint64_t seen{ 0 };
+		for (size_t i{ 0 }; i < BUCKETS; ++i) {
+			seen += this->_buckets[i].load(std::memory_order_relaxed);
+			if (seen >= rank)
+				return std::min(upper_bound(i), this->max());
+		}
+		return this->max();
+	}
+
+	// Returns the bucket of the value: the position of its highest bit and the next SUB_BUCKET_BITS bits
+	size_t histogram::bucket(uint64_t value) noexcept {
+		if (value < SUB_BUCKETS)
+			return static_cast<size_t>(value);
+
+		size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(value));
+		size_t sub_bucket = static_cast<size_t>(value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+		return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+	}
+
+	// Returns the largest value of the bucket
+	uint64_t histogram::upper_bound(size_t bucket) noexcept {
+		if (bucket < SUB_BUCKETS)
+			return bucket;
+
+		size_t shift = bucket / SUB_BUCKETS - 1;
+		uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+		return lower + ((uint64_t{ 1 } << shift) - 1);
+	}
+
+	// Implementation of the metrics registry
+
+	// Constructor
+	metrics_registry::metrics_registry() noexcept : _is_enabled(true), _origin_time(std::chrono::steady_clock::now()), _origin_ticks(metrics_ticks()), _programs(), _counters(), _mutex() {}
+
+	// Returns the registry of the process
+	metrics_registry& metrics_registry::global() noexcept {
+		static metrics_registry registry{};
+		return registry;
+	}
+
+	// Checks if the metrics are recorded
+	bool metrics_registry::is_enabled() const noexcept {
+		return this->_is_enabled.load(std::memory_order_relaxed);
+	}
+
+	// Turns the recording of the metrics on or off
+	void metrics_registry::set_enabled(bool is_enabled) noexcept {
+		this->_is_enabled.store(is_enabled, std::memory_order_relaxed);
+	}
+
+	// Returns the number of nanoseconds per tick of metrics_ticks, measured since the creation of the registry
+	double metrics_registry::nanoseconds_per_tick() const noexcept {
+#ifdef METRICS_TSC
+		auto ticks = metrics_ticks() - this->_origin_ticks;
+		auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->_origin_time).count();
+		return ticks == 0 ? 1.0 : static_cast<double>(time) / static_cast<double>(ticks);
+#else
+		return 1.0;
+#endif
+	}
+
+	// Returns the metrics of the program file with the given name
+	program_metrics& metrics_registry::program(std::string_view filename) {
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		auto it = this->_programs.find(filename);
+		if (it == this->_programs.end())
+			it = this->_programs.emplace(std::string(filename), std::make_unique<program_metrics>()).first;
+		return *it->second;
+	}
+
+	// Returns the counter with the given name
+	counter& metrics_registry::get_counter(std::string_view name) {
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		auto it = this->_counters.find(name);
+		if (it == this->_counters.end())
+			it = this->_counters.emplace(std::string(name), std::make_unique<counter>()).first;
+		return *it->second;
+	}
+
+	// Writes the metrics in JSON
+	void metrics_registry::write_json(std::ostream& os) const {
+		auto rate = this->nanoseconds_per_tick();
+		std::lock_guard<std::mutex> lock(this->_mutex);
+
+		os << "{\n  \"counters\": {";
+		bool is_first{ true };
+		for (const auto& [name, value] : this->_counters) {
+			os << (is_first ? "\n" : ",\n") << "    " << escaped(name) << ": " << value->value();
+			is_first = false;
+		}
+		os << (is_first ? "},\n" : "\n  },\n");
+
+		os << "  \"programs\": {";
+		is_first = true;
+		for (const auto& [name, metrics] : this->_programs) {
+			os << (is_first ? "\n" : ",\n") << "    " << escaped(name) << ": {\n";
+			for (const auto& family : HISTOGRAMS) {
+				const auto& x = (*metrics).*family.member;
+				auto scale = family.is_time ? rate : 1.0;
+				os << "      " << escaped(family.key) << ": { \"count\": " << x.count() << ", \"sum\": " << scaled(x.sum(), scale) << ", \"max\": " << scaled(x.max(), scale);
+				for (const auto& [label, share] : QUANTILES)
+					os << ", " << escaped(std::string("p") + label) << ": " << scaled(x.percentile(share), scale);
+				os << " },\n";
+			}
+			os << "      \"steps\": " << metrics->steps.value() << ",\n";
+			os << "      \"steps_per_second\": " << std::fixed << std::setprecision(0) << steps_per_second(*metrics, rate) << std::defaultfloat << "\n    }";
+			is_first = false;
+		}
+		os << (is_first ? "}\n}\n" : "\n  }\n}\n");
+	}
+
+	// Writes the metrics in the Prometheus text format
+	void metrics_registry::write_prometheus(std::ostream& os) const {
+		auto rate = this->nanoseconds_per_tick();
+		std::lock_guard<std::mutex> lock(this->_mutex);
+
+		for (const auto& [name, value] : this->_counters)
+			os << "# TYPE " << name << " counter\n" << name << " " << value->value() << "\n";
+
+		for (const auto& family : HISTOGRAMS) {
+			os << "# HELP " << family.name << " " << family.help << "\n# TYPE " << family.name << " summary\n";
+			for (const auto& [name, metrics] : this->_programs) {
+				const auto& x = (*metrics).*family.member;
+				auto count = x.count();
+				if (count == 0)
+					continue;
+				auto scale = family.is_time ? rate : 1.0;
+				auto label = "program=" + escaped(name);
+				for (const auto& [quantile, share] : QUANTILES)
+					os << family.name << "{" << label << ",quantile=\"" << quantile << "\"} " << scaled(x.percentile(share), scale) << "\n";
+				os << family.name << "_sum{" << label << "} " << scaled(x.sum(), scale) << "\n";
+				os << family.name << "_count{" << label << "} " << count << "\n";
+			}
+		}
+
+		os << "# HELP rm_steps_total Number of instructions executed by a stage\n# TYPE rm_steps_total counter\n";
+		for (const auto& [name, metrics] : this->_programs)
+			if (metrics->execute.count() != 0)
+				os << "rm_steps_total{program=" << escaped(name) << "} " << metrics->steps.value() << "\n";
+		os << "# HELP rm_steps_per_second Number of instructions a stage executes per second of its execution time\n# TYPE rm_steps_per_second gauge\n";
+		for (const auto& [name, metrics] : this->_programs)
+			if (metrics->execute.count() != 0)
+				os << "rm_steps_per_second{program=" << escaped(name) << "} " << std::fixed << std::setprecision(0) << steps_per_second(*metrics, rate) << std::defaultfloat << "\n";
+	}
+
+	// Writes the metrics to the file
+	void metrics_registry::write(const std::string& filename) const {
+		if (filename == "-") {
+			this->write_prometheus(std::cout);
+			std::cout.flush();
+			return;
+		}
+
+		auto temporary = filename + ".tmp";
+		{
+			std::ofstream ofs(temporary, std::ios::trunc);
+			if (!ofs)
+				throw std::runtime_error("Filename: " + filename + ". Error writing metrics");
+			if (std::filesystem::path(filename).extension() == ".json")
+				this->write_json(ofs);
+			else
+				this->write_prometheus(ofs);
+		}
+		std::filesystem::rename(temporary, filename);
+	}
+
+	// Implementation of the scoped timer
+
+	// Constructor
+	scoped_timer::scoped_timer(histogram& histogram) noexcept :
+		_histogram(metrics_registry::global().is_enabled() ? &histogram : nullptr), _begin(_histogram ? metrics_ticks() : 0) {}
+
+	// Destructor: records the time
+	scoped_timer::~scoped_timer() {
+		if (this->_histogram)
+			this->_histogram->record(metrics_ticks() - this->_begin);
+	}
+}
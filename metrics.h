@@ -0,0 +1,199 @@
+﻿#ifndef __REGISTER_MACHINE_METRICS_
+#define __REGISTER_MACHINE_METRICS_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define METRICS_TSC
+#include <x86intrin.h>
+#endif
+
+namespace IMD {
+
+	// Clock of the metrics: the time stamp counter of the processor where it is available, the steady clock in nanoseconds otherwise
+	// Reading the counter costs a few nanoseconds instead of tens for the steady clock, the ticks are converted to nanoseconds on export
+	inline uint64_t metrics_ticks() noexcept {
+#ifdef METRICS_TSC
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+	}
+
+	// Monotonic counter, updated with relaxed atomic operations from any thread
+	class counter {
+	private:
+		// Value of the counter
+		std::atomic<uint64_t> _value;
+
+	public:
+		// Constructor
+		counter() noexcept;
+
+		// Copy constructor
+		counter(const counter&) = delete;
+		// Assignment operator
+		counter& operator=(const counter&) = delete;
+
+		// Destructor
+		~counter() = default;
+
+		// Adds the value to the counter
+		void add(uint64_t value = 1) noexcept;
+		// Returns the value of the counter
+		uint64_t value() const noexcept;
+	};
+
+	// Log-linear (HDR-style) histogram of non-negative values, updated with relaxed atomic operations from any thread
+	// Every power of two is split into SUB_BUCKETS linear buckets, so a percentile is reported with a relative error
+	// below 1 / SUB_BUCKETS over the whole range of uint64_t in a fixed array of counters
+	class histogram {
+	private:
+		// Number of the linear buckets of a power of two
+		static constexpr size_t SUB_BUCKET_BITS{ 4 };
+		static constexpr size_t SUB_BUCKETS{ size_t{ 1 } << SUB_BUCKET_BITS };
+		// Number of the buckets: the values below SUB_BUCKETS are exact, then SUB_BUCKETS buckets per power of two
+		static constexpr size_t BUCKETS{ (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS };
+
+		// Numbers of the values in the buckets, their total is the number of the values
+		std::array<std::atomic<uint64_t>, BUCKETS> _buckets;
+		// Sum and maximum of the values
+		std::atomic<uint64_t> _sum;
+		std::atomic<uint64_t> _max;
+
+	public:
+		// Constructor
+		histogram() noexcept;
+
+		// Copy constructor
+		histogram(const histogram&) = delete;
+		// Assignment operator
+		histogram& operator=(const histogram&) = delete;
+
+		// Destructor
+		~histogram() = default;
+
+		// Records a value
+		void record(uint64_t value) noexcept;
+
+		// Returns the number of the recorded values
+		uint64_t count() const noexcept;
+		// Returns the sum of the recorded values
+		uint64_t sum() const noexcept;
+		// Returns the largest recorded value
+		uint64_t max() const noexcept;
+		// Returns the value below or equal to which the given share of the recorded values lies, the upper bound of its bucket
+		uint64_t percentile(double share) const noexcept;
+
+	private:
+		// Returns the bucket of the value
+		static size_t bucket(uint64_t value) noexcept;
+		// Returns the largest value of the bucket
+		static uint64_t upper_bound(size_t bucket) noexcept;
+	};
+
+	// Metrics of a program file: parsing, resolution of the composition, and the launches of its stage
+	// The times are measured in the ticks of metrics_ticks
+	struct program_metrics {
+		// Time of parsing the instructions of the file
+		histogram parse;
+		// Time of resolving the composition of the file into stages
+		histogram include;
+		// Time of executing the stage of the file: a whole launch or a slice of a resumable one
+		histogram execute;
+		// Number of instructions executed by the stage
+		counter steps;
+		// Time of a launch of the composition starting at the file, from start to halt or error
+		histogram run;
+		// Number of instructions executed by a launch of the composition
+		histogram run_steps;
+	};
+
+	// Registry of the runtime metrics of the process
+	// The metrics are created on first use and live as long as the process: the machines keep references to them,
+	// so recording takes no locks and no lookups. Export formats: JSON and the Prometheus text format
+	class metrics_registry {
+	private:
+		// Flag of recording the metrics
+		std::atomic<bool> _is_enabled;
+		// Time and ticks of the creation of the registry, the ticks are converted to nanoseconds by the rate since then
+		std::chrono::steady_clock::time_point _origin_time;
+		uint64_t _origin_ticks;
+		// Metrics of the program files by file name
+		std::map<std::string, std::unique_ptr<program_metrics>, std::less<>> _programs;
+		// Counters of the process by name
+		std::map<std::string, std::unique_ptr<counter>, std::less<>> _counters;
+		// Mutex guarding the dictionaries
+		mutable std::mutex _mutex;
+
+	public:
+		// Constructor
+		metrics_registry() noexcept;
+
+		// Copy constructor
+		metrics_registry(const metrics_registry&) = delete;
+		// Assignment operator
+		metrics_registry& operator=(const metrics_registry&) = delete;
+
+		// Destructor
+		~metrics_registry() = default;
+
+		// Returns the registry of the process
+		static metrics_registry& global() noexcept;
+
+		// Checks if the metrics are recorded
+		bool is_enabled() const noexcept;
+		// Turns the recording of the metrics on or off
+		void set_enabled(bool is_enabled) noexcept;
+
+		// Returns the metrics of the program file with the given name
+		program_metrics& program(std::string_view filename);
+		// Returns the counter with the given name
+		counter& get_counter(std::string_view name);
+
+		// Returns the number of nanoseconds per tick of metrics_ticks
+		double nanoseconds_per_tick() const noexcept;
+
+		// Writes the metrics in JSON, the times in nanoseconds
+		void write_json(std::ostream& os) const;
+		// Writes the metrics in the Prometheus text format; histograms are exported as summaries with quantiles
+		void write_prometheus(std::ostream& os) const;
+		// Writes the metrics to the file, in JSON if its extension is .json, otherwise in the Prometheus format;
+		// the file name "-" is the standard output. The file is replaced at once, readers never see a partial export
+		void write(const std::string& filename) const;
+	};
+
+	// Timer recording the time from its construction to its destruction into a histogram, in ticks
+	// Nothing is measured when the recording of the metrics is off
+	class scoped_timer {
+	private:
+		// Histogram receiving the time, nullptr when nothing is measured
+		histogram* _histogram;
+		// Ticks at the construction
+		uint64_t _begin;
+
+	public:
+		// Constructor
+		explicit scoped_timer(histogram& histogram) noexcept;
+
+		// Copy constructor
+		scoped_timer(const scoped_timer&) = delete;
+		// Assignment operator
+		scoped_timer& operator=(const scoped_timer&) = delete;
+
+		// Destructor: records the time
+		~scoped_timer();
+	};
+}
+
+#endif
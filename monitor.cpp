@@ -0,0 +1,286 @@
+﻿#include "monitor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace IMD {
+
+	// Returns the time of the steady clock in nanoseconds
+	static uint64_t steady_nanoseconds() noexcept {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// Returns the name of a segment with the leading '/'
+	static std::string segment_name(const std::string& name) {
+		return name.empty() || name.front() != '/' ? "/" + name : name;
+	}
+
+	// Implementation of the published state
+
+	// Sets the file name, the end of a long name is kept
+	void monitor_snapshot::set_filename(std::string_view filename) noexcept {
+		if (filename.size() >= FILENAME_SIZE)
+			filename.remove_prefix(filename.size() - (FILENAME_SIZE - 1));
+		std::memcpy(this->filename, filename.data(), filename.size());
+		this->filename[filename.size()] = '\0';
+	}
+
+	// Adds a register, returns false if there is no room left
+	bool monitor_snapshot::add_register(std::string_view name, int value) noexcept {
+		if (this->count >= REGISTERS)
+			return false;
+
+		auto& x = this->values[this->count++];
+		auto size = std::min(name.size(), NAME_SIZE - 1);
+		std::memcpy(x.name, name.data(), size);
+		x.name[size] = '\0';
+		x.value = value;
+		return true;
+	}
+
+	// Implementation of the slot
+
+	// Writes the record, called only by the thread owning the slot
+	void monitor_slot::write(const monitor_snapshot& snapshot) noexcept {
+		uint64_t buffer[WORDS]{};
+		std::memcpy(buffer, &snapshot, sizeof(snapshot));
+
+		auto sequence = this->sequence.load(std::memory_order_relaxed);
+		this->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i{ 0 }; i < WORDS; ++i)
+			this->words[i].store(buffer[i], std::memory_order_relaxed);
+		this->sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// Returns a consistent copy of the record, std::nullopt if the slot keeps changing or its writer died in the middle of a write
+	std::optional<monitor_snapshot> monitor_slot::read() const noexcept {
+		constexpr size_t ATTEMPTS{ 1000 };
+
+		uint64_t buffer[WORDS]{};
+		for (size_t attempt{ 0 }; attempt < ATTEMPTS; ++attempt) {
+			auto before = this->sequence.load(std::memory_order_acquire);
+			if (before & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			for (size_t i{ 0 }; i < WORDS; ++i)
+				buffer[i] = this->words[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (this->sequence.load(std::memory_order_relaxed) == before) {
+				monitor_snapshot snapshot{};
+				std::memcpy(&snapshot, buffer, sizeof(snapshot));
+				return snapshot;
+			}
+		}
+		return std::nullopt;
+	}
+
+	// Implementation of the live state monitor
+
+	// Slot of the calling thread and the time of its next publication
+	struct monitor_thread_state {
+		// Segment the slot belongs to
+		const monitor_segment* segment{ nullptr };
+		// Slot of the thread, nullptr when all of them are taken
+		monitor_slot* slot{ nullptr };
+		uint64_t thread{ static_cast<uint64_t>(::syscall(SYS_gettid)) };
+		std::chrono::steady_clock::time_point deadline{};
+	};
+	static thread_local monitor_thread_state thread_state{};
+
+	// Constructor
+	state_monitor::state_monitor() noexcept : _name(), _segment(nullptr), _period(std::chrono::milliseconds(100)) {}
+
+	// Destructor: removes the name of the segment
+	state_monitor::~state_monitor() {
+		if (this->_segment.load(std::memory_order_relaxed))
+			::shm_unlink(this->_name.c_str());
+	}
+
+	// Returns the monitor of the process
+	state_monitor& state_monitor::global() noexcept {
+		static state_monitor monitor{};
+		return monitor;
+	}
+
+	// Creates the segment with the given name and starts publishing
+	void state_monitor::open(const std::string& name, std::chrono::milliseconds period) {
+		if (this->_segment.load(std::memory_order_relaxed))
+			throw std::runtime_error("The state monitor is already open: " + this->_name);
+
+		auto segment_name = IMD::segment_name(name);
+		int fd = ::shm_open(segment_name.c_str(), O_CREAT | O_RDWR, 0644);
+		if (fd < 0)
+			throw std::runtime_error("Error creating the shared-memory segment " + segment_name + ": " + std::strerror(errno));
+
+		// The segment of a previous process with the same name is cleared
+		if (::ftruncate(fd, 0) != 0 || ::ftruncate(fd, sizeof(monitor_segment)) != 0) {
+			auto error = errno;
+			::close(fd);
+			throw std::runtime_error("Error resizing the shared-memory segment " + segment_name + ": " + std::strerror(error));
+		}
+
+		void* address = ::mmap(nullptr, sizeof(monitor_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (address == MAP_FAILED)
+			throw std::runtime_error("Error mapping the shared-memory segment " + segment_name + ": " + std::strerror(errno));
+
+		auto* segment = static_cast<monitor_segment*>(address);
+		segment->pid = static_cast<uint64_t>(::getpid());
+		segment->period = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(period).count());
+		std::atomic_thread_fence(std::memory_order_release);
+		segment->magic = monitor_segment::MAGIC;
+
+		this->_name = segment_name;
+		this->_period = period;
+		this->_segment.store(segment, std::memory_order_release);
+	}
+
+	// Returns true if the launches are published
+	bool state_monitor::is_enabled() const noexcept {
+		return this->_segment.load(std::memory_order_relaxed) != nullptr;
+	}
+
+	// Returns true if the period of the calling thread has passed since its last publication
+	bool state_monitor::is_due() const noexcept {
+		return std::chrono::steady_clock::now() >= thread_state.deadline;
+	}
+
+	// Publishes the state into the slot of the calling thread, the first publication of a thread takes a slot
+	void state_monitor::publish(monitor_snapshot& snapshot) noexcept {
+		auto* segment = this->_segment.load(std::memory_order_acquire);
+		if (!segment)
+			return;
+
+		auto& local = thread_state;
+		if (local.segment != segment) {
+			auto index = segment->taken.fetch_add(1, std::memory_order_relaxed);
+			local.segment = segment;
+			local.slot = index < monitor_segment::SLOTS ? &segment->slots[index] : nullptr;
+		}
+		local.deadline = std::chrono::steady_clock::now() + this->_period;
+		if (!local.slot)
+			return;
+
+		snapshot.thread = local.thread;
+		snapshot.published_at = steady_nanoseconds();
+		local.slot->write(snapshot);
+	}
+
+	// Implementation of the viewer
+
+	// Constructor: attaches to the segment, throws if there is none
+	monitor_viewer::monitor_viewer(const std::string& name) : _name(segment_name(name)), _segment(nullptr), _previous() {
+		int fd = ::shm_open(this->_name.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+			throw std::runtime_error("Error opening the shared-memory segment " + this->_name + ": " + std::strerror(errno));
+
+		struct stat status {};
+		if (::fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(monitor_segment)) {
+			::close(fd);
+			throw std::runtime_error("The shared-memory segment " + this->_name + " is not a monitor segment");
+		}
+
+		void* address = ::mmap(nullptr, sizeof(monitor_segment), PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (address == MAP_FAILED)
+			throw std::runtime_error("Error mapping the shared-memory segment " + this->_name + ": " + std::strerror(errno));
+
+		this->_segment = static_cast<const monitor_segment*>(address);
+		if (this->_segment->magic != monitor_segment::MAGIC) {
+			::munmap(address, sizeof(monitor_segment));
+			throw std::runtime_error("The shared-memory segment " + this->_name + " is not a monitor segment");
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+
+	// Destructor
+	monitor_viewer::~monitor_viewer() {
+		::munmap(const_cast<monitor_segment*>(this->_segment), sizeof(monitor_segment));
+	}
+
+	// Returns true while the process writing the segment exists
+	bool monitor_viewer::is_alive() const noexcept {
+		return ::kill(static_cast<pid_t>(this->_segment->pid), 0) == 0 || errno == EPERM;
+	}
+
+	// Prints the state of the launches: a line per thread and its registers, the changed ones first and marked with '*'
+	void monitor_viewer::print(std::ostream& os) {
+		static const char* state_names[] = { "idle", "running", "halted", "error" };
+
+		auto taken = std::min<uint64_t>(this->_segment->taken.load(std::memory_order_acquire), monitor_segment::SLOTS);
+		this->_previous.resize(taken, monitor_snapshot{});
+		auto now = steady_nanoseconds();
+
+		os << "pid: " << this->_segment->pid << " threads: " << taken << " period, ms: " << this->_segment->period / 1000000 << std::endl;
+		os << std::left << std::setw(10) << "thread" << std::setw(9) << "state" << std::setw(16) << "steps" << std::setw(14) << "steps/s"
+			<< std::setw(8) << "line" << std::setw(7) << "depth" << std::setw(7) << "regs" << std::setw(10) << "age, ms" << "file" << std::endl;
+
+		for (size_t i{ 0 }; i < taken; ++i) {
+			auto snapshot = this->_segment->slots[i].read();
+			if (!snapshot || snapshot->state == monitored_state::idle)
+				continue;
+
+			// The speed is measured between the publications of the same launch
+			const auto& previous = this->_previous[i];
+			double speed{ 0 };
+			if (previous.state != monitored_state::idle && snapshot->published_at > previous.published_at && snapshot->steps >= previous.steps)
+				speed = static_cast<double>(snapshot->steps - previous.steps) * 1e9 / static_cast<double>(snapshot->published_at - previous.published_at);
+
+			os << std::setw(10) << snapshot->thread << std::setw(9) << state_names[static_cast<size_t>(snapshot->state)] << std::setw(16) << snapshot->steps
+				<< std::setw(14) << static_cast<uint64_t>(speed) << std::setw(8) << snapshot->carriage << std::setw(7) << snapshot->depth
+				<< std::setw(7) << snapshot->registers << std::setw(10) << (now > snapshot->published_at ? (now - snapshot->published_at) / 1000000 : 0)
+				<< snapshot->filename << std::endl;
+
+			// A register is hot if its value has changed since the previous refresh
+			auto is_changed = [&previous](const monitor_snapshot::published_register& x) {
+				for (uint32_t k{ 0 }; k < previous.count; ++k)
+					if (std::strncmp(previous.values[k].name, x.name, monitor_snapshot::NAME_SIZE) == 0)
+						return previous.values[k].value != x.value;
+				return previous.state != monitored_state::idle;
+			};
+			std::vector<const monitor_snapshot::published_register*> registers{};
+			for (uint32_t k{ 0 }; k < std::min<uint32_t>(snapshot->count, monitor_snapshot::REGISTERS); ++k)
+				registers.push_back(&snapshot->values[k]);
+			std::stable_partition(registers.begin(), registers.end(), [&is_changed](const auto* x) { return is_changed(*x); });
+
+			os << "  ";
+			for (const auto* x : registers)
+				os << (is_changed(*x) ? "*" : "") << x->name << "=" << x->value << " ";
+			os << std::endl;
+
+			this->_previous[i] = *snapshot;
+		}
+		os << std::right;
+	}
+
+	// Refreshes the screen with the given interval until the writing process exits or the number of refreshes is reached
+	void monitor_viewer::run(std::ostream& os, std::chrono::milliseconds interval, size_t refreshes) {
+		bool is_terminal = &os == &std::cout && ::isatty(STDOUT_FILENO);
+		for (size_t i{ 0 }; refreshes == 0 || i < refreshes; ++i) {
+			if (i != 0)
+				std::this_thread::sleep_for(interval);
+			if (is_terminal)
+				os << "\x1b[H\x1b[2J"; // The screen is cleared, the cursor is moved to the top
+			this->print(os);
+			if (!this->is_alive()) {
+				os << "The monitored process has exited" << std::endl;
+				return;
+			}
+		}
+	}
+}
@@ -0,0 +1,166 @@
+﻿#ifndef __REGISTER_MACHINE_MONITOR_
+#define __REGISTER_MACHINE_MONITOR_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace IMD {
+
+	// State of a monitored launch
+	enum class monitored_state : uint32_t {
+		idle, // Nothing has been published into the slot
+		running, // The launch is executing
+		halted, // The stop instruction is executed
+		error // The launch failed
+	};
+
+	// State of a launch as it is published: a trivially copyable record of fixed size
+	struct monitor_snapshot {
+		// Sizes of the fixed fields: the end of a longer file name and the first REGISTERS registers are published
+		static constexpr size_t FILENAME_SIZE{ 128 };
+		static constexpr size_t NAME_SIZE{ 20 };
+		static constexpr size_t REGISTERS{ 32 };
+
+		// Register with its value
+		struct published_register {
+			char name[NAME_SIZE];
+			int32_t value;
+		};
+
+		monitored_state state;
+		// Number of the published registers
+		uint32_t count;
+		// Identifier of the executing thread
+		uint64_t thread;
+		// Number of the current instruction, number of executed instructions and depth of nested calls
+		uint64_t carriage;
+		uint64_t steps;
+		uint64_t depth;
+		// Number of all registers of the running program
+		uint64_t registers;
+		// Time of publication in nanoseconds of the steady clock
+		uint64_t published_at;
+		// File of the running program, zero-terminated
+		char filename[FILENAME_SIZE];
+		published_register values[REGISTERS];
+
+		// Sets the file name, the end of a long name is kept
+		void set_filename(std::string_view filename) noexcept;
+		// Adds a register, returns false if there is no room left
+		bool add_register(std::string_view name, int value) noexcept;
+	};
+
+	// Slot of the segment written by a single thread under a seqlock: the sequence is odd while the slot is being written,
+	// a reader copies the slot and retries if the sequence was odd or has changed meanwhile
+	// The record is copied word by word with relaxed atomic operations, so that concurrent reading is not a data race
+	struct monitor_slot {
+		static constexpr size_t WORDS{ (sizeof(monitor_snapshot) + sizeof(uint64_t) - 1) / sizeof(uint64_t) };
+
+		std::atomic<uint64_t> sequence;
+		std::atomic<uint64_t> words[WORDS];
+
+		// Writes the record, called only by the thread owning the slot
+		void write(const monitor_snapshot& snapshot) noexcept;
+		// Returns a consistent copy of the record, std::nullopt if the slot keeps changing or its writer died in the middle of a write
+		std::optional<monitor_snapshot> read() const noexcept;
+	};
+
+	// Layout of the shared-memory segment: a header and a slot per executing thread
+	struct monitor_segment {
+		// Marker of an initialized segment: "RMMONIT1"
+		static constexpr uint64_t MAGIC{ 0x52'4D'4D'4F'4E'49'54'31 };
+		// Maximum number of threads publishing their launches, the threads beyond it are not published
+		static constexpr size_t SLOTS{ 64 };
+
+		uint64_t magic;
+		// Process writing the segment
+		uint64_t pid;
+		// Period of publication in nanoseconds
+		uint64_t period;
+		// Number of the slots taken by threads
+		std::atomic<uint64_t> taken;
+		monitor_slot slots[SLOTS];
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "The atomic counters of the segment must be address-free to be shared between processes");
+
+	// Live state monitor of the process: the launches periodically publish their state into a POSIX shared-memory segment,
+	// which another process reads without pausing or slowing them down
+	// Every thread publishes into its own slot, so the writers never wait; a launch checks whether it is due
+	// once per slice of instructions, and publishes at most once per period
+	class state_monitor {
+	private:
+		// Name of the segment
+		std::string _name;
+		// Mapped segment, nullptr while the monitor is disabled
+		std::atomic<monitor_segment*> _segment;
+		// Period of publication
+		std::chrono::nanoseconds _period;
+
+	public:
+		// Constructor
+		state_monitor() noexcept;
+
+		// Copy constructor
+		state_monitor(const state_monitor&) = delete;
+		// Assignment operator
+		state_monitor& operator=(const state_monitor&) = delete;
+
+		// Destructor: removes the name of the segment
+		~state_monitor();
+
+		// Returns the monitor of the process
+		static state_monitor& global() noexcept;
+
+		// Creates the segment with the given name and starts publishing; the name gets a leading '/' if it has none
+		// The segment stays mapped until the process exits, since the launches of other threads may be writing into it
+		void open(const std::string& name, std::chrono::milliseconds period = std::chrono::milliseconds(100));
+
+		// Returns true if the launches are published
+		bool is_enabled() const noexcept;
+		// Returns true if the period of the calling thread has passed since its last publication
+		bool is_due() const noexcept;
+		// Publishes the state into the slot of the calling thread
+		void publish(monitor_snapshot& snapshot) noexcept;
+	};
+
+	// Viewer of the segment of another process in the manner of top: prints the launches of the threads with their speed
+	// and the registers, the registers changed since the previous refresh first
+	class monitor_viewer {
+	private:
+		// Name of the segment
+		std::string _name;
+		// Mapped segment, read-only
+		const monitor_segment* _segment;
+		// Records of the previous refresh
+		std::vector<monitor_snapshot> _previous;
+
+	public:
+		// Constructor: attaches to the segment, throws if there is none
+		explicit monitor_viewer(const std::string& name);
+
+		// Copy constructor
+		monitor_viewer(const monitor_viewer&) = delete;
+		// Assignment operator
+		monitor_viewer& operator=(const monitor_viewer&) = delete;
+
+		// Destructor
+		~monitor_viewer();
+
+		// Returns true while the process writing the segment exists
+		bool is_alive() const noexcept;
+		// Prints the state of the launches
+		void print(std::ostream& os);
+		// Refreshes the screen with the given interval until the writing process exits or the number of refreshes is reached, 0 for no limit
+		void run(std::ostream& os, std::chrono::milliseconds interval, size_t refreshes = 0);
+	};
+}
+
+#endif
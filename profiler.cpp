@@ -0,0 +1,178 @@
+﻿#include "profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace IMD {
+
+	// Implementation of the slot
+
+	// Publishes the stack of the first depth frames followed by the given ones and the position, called only by the thread owning the slot
+	void profile_slot::enter(size_t depth, const uint64_t* frames, size_t count, uint64_t position) noexcept {
+		depth = std::min(depth, MAX_FRAMES);
+		count = std::min(count, MAX_FRAMES - depth);
+
+		auto sequence = this->sequence.load(std::memory_order_relaxed);
+		this->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i{ 0 }; i < count; ++i)
+			this->frames[depth + i].store(frames[i], std::memory_order_relaxed);
+		this->depth.store(depth + count, std::memory_order_relaxed);
+		this->position.store(position, std::memory_order_relaxed);
+		this->sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// Marks the thread as executing no launch
+	void profile_slot::leave() noexcept {
+		this->position.store(0, std::memory_order_relaxed);
+	}
+
+	// Copies the stack followed by the position, returns false if the thread executes no launch or the slot keeps changing
+	bool profile_slot::sample(std::vector<uint64_t>& stack) const {
+		constexpr size_t ATTEMPTS{ 16 };
+
+		for (size_t attempt{ 0 }; attempt < ATTEMPTS; ++attempt) {
+			auto before = this->sequence.load(std::memory_order_acquire);
+			if (before & 1)
+				continue;
+
+			stack.clear();
+			auto depth = std::min<uint64_t>(this->depth.load(std::memory_order_relaxed), MAX_FRAMES);
+			for (size_t i{ 0 }; i < depth; ++i)
+				stack.push_back(this->frames[i].load(std::memory_order_relaxed));
+			auto position = this->position.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (this->sequence.load(std::memory_order_relaxed) == before) {
+				if (position == 0)
+					return false;
+				stack.push_back(position);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Implementation of the profiler
+
+	// Slot of the calling thread, nullptr before its first launch
+	static thread_local profile_slot* thread_slot{ nullptr };
+
+	// Constructor
+	sampling_profiler::sampling_profiler() noexcept : _is_enabled(false), _interval(10000), _slots(), _files(), _numbers(), _samples() {}
+
+	// Destructor: stops the sampling thread
+	sampling_profiler::~sampling_profiler() {
+		this->stop();
+	}
+
+	// Returns the profiler of the process
+	sampling_profiler& sampling_profiler::global() noexcept {
+		static sampling_profiler profiler{};
+		return profiler;
+	}
+
+	// Starts the sampling thread with the given interval between the samples
+	void sampling_profiler::start(std::chrono::microseconds interval) {
+		if (interval.count() <= 0)
+			throw std::runtime_error("The sampling interval must be positive");
+
+		std::lock_guard lock(this->_mutex);
+		if (this->_is_enabled.load(std::memory_order_relaxed))
+			throw std::runtime_error("The sampling profiler is already started");
+
+		this->_interval = interval;
+		this->_is_enabled.store(true, std::memory_order_relaxed);
+		this->_sampler = std::thread([this]() {
+			std::unique_lock lock(this->_mutex);
+			auto next = std::chrono::steady_clock::now() + this->_interval;
+			while (!this->_stopping.wait_until(lock, next, [this]() { return !this->_is_enabled.load(std::memory_order_relaxed); })) {
+				this->sample_all();
+				// A late sampler skips the missed intervals instead of catching up with a burst of samples
+				next = std::max(next + this->_interval, std::chrono::steady_clock::now());
+			}
+		});
+	}
+
+	// Stops the sampling thread, the counted samples are kept
+	void sampling_profiler::stop() {
+		{
+			std::lock_guard lock(this->_mutex);
+			this->_is_enabled.store(false, std::memory_order_relaxed);
+		}
+		this->_stopping.notify_all();
+		if (this->_sampler.joinable())
+			this->_sampler.join();
+	}
+
+	// Returns true if the launches are sampled
+	bool sampling_profiler::is_enabled() const noexcept {
+		return this->_is_enabled.load(std::memory_order_relaxed);
+	}
+
+	// Returns the number of the file, the same name always gets the same number
+	uint32_t sampling_profiler::intern(std::string_view filename) {
+		std::lock_guard lock(this->_mutex);
+		auto [it, is_inserted] = this->_numbers.try_emplace(std::string(filename), static_cast<uint32_t>(this->_files.size() + 1));
+		if (is_inserted)
+			this->_files.push_back(it->first);
+		return it->second;
+	}
+
+	// Returns the slot of the calling thread
+	profile_slot& sampling_profiler::slot() {
+		if (thread_slot == nullptr) {
+			std::lock_guard lock(this->_mutex);
+			thread_slot = this->_slots.emplace_back(std::make_unique<profile_slot>()).get();
+		}
+		return *thread_slot;
+	}
+
+	// Takes a sample of every slot, called by the sampling thread under the lock
+	void sampling_profiler::sample_all() {
+		std::vector<uint64_t> stack{};
+		for (const auto& x : this->_slots) {
+			if (x->position.load(std::memory_order_relaxed) == 0)
+				continue;
+			if (x->sample(stack))
+				++this->_samples[stack];
+		}
+	}
+
+	// Writes the samples in the folded format of the flame graph tools: the frames separated by ';' and the number of the samples
+	// A frame is a file or a line of it: the composition, the file of the stage, the call lines with the files they call, the running line
+	void sampling_profiler::write(std::ostream& os) const {
+		std::lock_guard lock(this->_mutex);
+		auto name = [this](uint64_t position) {
+			auto file = profile_position::file(position);
+			std::string name = file != 0 && file <= this->_files.size() ? this->_files[file - 1] : "?";
+			if (auto line = profile_position::line(position); line != profile_position::WHOLE_FILE)
+				name += ":" + std::to_string(line);
+			return name;
+		};
+
+		for (const auto& [stack, count] : this->_samples) {
+			for (size_t i{ 0 }; i < stack.size(); ++i)
+				os << (i != 0 ? ";" : "") << name(stack[i]);
+			os << ' ' << count << '\n';
+		}
+		os.flush();
+	}
+
+	// Writes the samples into a file, "-" is the standard output
+	void sampling_profiler::write(const std::string& path) const {
+		if (path == "-") {
+			this->write(std::cout);
+			return;
+		}
+
+		std::ofstream ofs(path);
+		if (!ofs)
+			throw std::runtime_error("Error opening the profile file " + path);
+		this->write(ofs);
+		if (!ofs)
+			throw std::runtime_error("Error writing the profile file " + path);
+	}
+}
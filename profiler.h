@@ -0,0 +1,128 @@
+﻿#ifndef __REGISTER_MACHINE_PROFILER_
+#define __REGISTER_MACHINE_PROFILER_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace IMD {
+
+	// Position in a program packed into a word: the number of the file in the upper bits, the number of the instruction in the lower ones
+	// The file numbers start from 1, so the zero word is no position
+	struct profile_position {
+		static constexpr unsigned LINE_BITS{ 40 };
+		static constexpr uint64_t LINE_MASK{ (uint64_t{ 1 } << LINE_BITS) - 1 };
+		// Line of a frame standing for the file as a whole
+		static constexpr uint64_t WHOLE_FILE{ LINE_MASK };
+
+		// Returns the packed position
+		static constexpr uint64_t pack(uint32_t file, uint64_t line) noexcept {
+			return (uint64_t{ file } << LINE_BITS) | (line & LINE_MASK);
+		}
+		// Returns the number of the file of the packed position
+		static constexpr uint32_t file(uint64_t position) noexcept {
+			return static_cast<uint32_t>(position >> LINE_BITS);
+		}
+		// Returns the number of the instruction of the packed position
+		static constexpr uint64_t line(uint64_t position) noexcept {
+			return position & LINE_MASK;
+		}
+	};
+
+	// Execution context of a thread read by the sampling thread: the stack of frames under a seqlock and the current position
+	// The stack changes only when a slice starts and on calls and returns, so it is published under the sequence;
+	// the position changes with every instruction and is a single word stored on its own
+	struct profile_slot {
+		// Maximum number of published frames, the deeper frames are not published
+		static constexpr size_t MAX_FRAMES{ 64 };
+
+		std::atomic<uint64_t> sequence{ 0 };
+		std::atomic<uint64_t> depth{ 0 };
+		std::atomic<uint64_t> frames[MAX_FRAMES]{};
+		// Packed position of the running instruction, 0 while the thread executes no launch
+		std::atomic<uint64_t> position{ 0 };
+
+		// Publishes the stack of the first depth frames followed by the given ones and the position, called only by the thread owning the slot
+		void enter(size_t depth, const uint64_t* frames, size_t count, uint64_t position) noexcept;
+		// Publishes the position of the next instruction, called only by the thread owning the slot
+		void move(uint64_t position) noexcept {
+			this->position.store(position, std::memory_order_relaxed);
+		}
+		// Marks the thread as executing no launch
+		void leave() noexcept;
+		// Copies the stack followed by the position, returns false if the thread executes no launch or the slot keeps changing
+		bool sample(std::vector<uint64_t>& stack) const;
+	};
+
+	// Sampling profiler of the launches: the executing threads publish their position with an atomic store per instruction,
+	// a sampling thread periodically reads the positions of all threads and counts the stacks of the samples
+	// The stack of a sample consists of the composition, the file of the stage and the lines of the active calls with their files,
+	// so the samples written in the folded format give a flame graph of the compositions
+	class sampling_profiler {
+	private:
+		// Sampling thread is running
+		std::atomic<bool> _is_enabled;
+		// Interval between the samples
+		std::chrono::microseconds _interval;
+		// Slots of the threads that executed launches, never released: pooled threads keep their slots
+		std::vector<std::unique_ptr<profile_slot>> _slots;
+		// Names of the files by their number minus 1 and the numbers by the names
+		std::vector<std::string> _files;
+		std::unordered_map<std::string, uint32_t> _numbers;
+		// Number of the samples by their stacks
+		std::map<std::vector<uint64_t>, uint64_t> _samples;
+		// Guards the slots, the files and the samples
+		mutable std::mutex _mutex;
+		// Wakes the sampling thread up to stop
+		std::condition_variable _stopping;
+		std::thread _sampler;
+
+		// Takes a sample of every slot
+		void sample_all();
+
+	public:
+		// Constructor
+		sampling_profiler() noexcept;
+
+		// Copy constructor
+		sampling_profiler(const sampling_profiler&) = delete;
+		// Assignment operator
+		sampling_profiler& operator=(const sampling_profiler&) = delete;
+
+		// Destructor: stops the sampling thread
+		~sampling_profiler();
+
+		// Returns the profiler of the process
+		static sampling_profiler& global() noexcept;
+
+		// Starts the sampling thread with the given interval between the samples
+		void start(std::chrono::microseconds interval = std::chrono::microseconds(10000));
+		// Stops the sampling thread, the counted samples are kept
+		void stop();
+
+		// Returns true if the launches are sampled
+		bool is_enabled() const noexcept;
+		// Returns the number of the file, the same name always gets the same number
+		uint32_t intern(std::string_view filename);
+		// Returns the slot of the calling thread
+		profile_slot& slot();
+
+		// Writes the samples in the folded format of the flame graph tools: the frames separated by ';' and the number of the samples
+		void write(std::ostream& os) const;
+		// Writes the samples into a file, "-" is the standard output
+		void write(const std::string& path) const;
+	};
+}
+
+#endif
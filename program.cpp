@@ -1,13 +1,329 @@
-﻿#include "register_machine.h"
+﻿#include "coalescer.h"
+#include "debugger.h"
+#include "differential.h"
+#include "estimator.h"
+#include "lockstep.h"
+#include "metrics.h"
+#include "monitor.h"
+#include "profiler.h"
+#include "register_machine.h"
+#include "scheduler.h"
+#include "server.h"
+#include "specializer.h"
+#include "superoptimizer.h"
+#include <algorithm>
+#include <csignal>
 #include <iostream>
+#include <pthread.h>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
-int main() {
+using namespace std::string_literals;
+
+int main(int argc, char* argv[]) {
 	setlocale(LC_ALL, "Russian");
 
 	std::string filename{ "examples/RM2.txt" };
+
+	// Export of the metrics: program --metrics path [mode and its arguments]
+	// The metrics are written when the mode finishes and on every SIGUSR1, JSON for a .json file, the Prometheus text format otherwise, "-" is the standard output
+	struct metrics_export {
+		std::string path;
+		~metrics_export() {
+			if (!this->path.empty())
+				IMD::metrics_registry::global().write(this->path);
+		}
+	} metrics{};
+	if (argc > 2 && argv[1] == "--metrics"s) {
+		metrics.path = argv[2];
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+
+		// The signal is blocked before any thread is started, so that only the exporting thread receives it
+		sigset_t signals{};
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGUSR1);
+		pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+		std::thread([signals, path = metrics.path]() {
+			int signal{ 0 };
+			while (sigwait(&signals, &signal) == 0) {
+				try {
+					IMD::metrics_registry::global().write(path);
+				}
+				catch (const std::exception& e) {
+					std::cerr << e.what() << std::endl;
+				}
+			}
+		}).detach();
+	}
+
+	// Live state monitor: program --monitor name [mode and its arguments]
+	// The launches of the mode publish their state into the POSIX shared-memory segment with the given name, program --top name shows it
+	if (argc > 2 && argv[1] == "--monitor"s) {
+		IMD::state_monitor::global().open(argv[2]);
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+	}
+
+	// Sampling profiler: program --profile path [interval, us] [mode and its arguments]
+	// The samples are written in the folded format of the flame graph tools when the mode finishes and on every SIGUSR2, "-" is the standard output
+	struct profile_export {
+		std::string path;
+		~profile_export() {
+			if (this->path.empty())
+				return;
+			IMD::sampling_profiler::global().stop();
+			IMD::sampling_profiler::global().write(this->path);
+		}
+	} profile{};
+	if (argc > 2 && argv[1] == "--profile"s) {
+		profile.path = argv[2];
+		auto interval = std::chrono::microseconds(10000);
+		if (argc > 3 && !std::string(argv[3]).empty() && std::all_of(argv[3], argv[3] + std::char_traits<char>::length(argv[3]), [](char c) { return c >= '0' && c <= '9'; })) {
+			interval = std::chrono::microseconds(std::stoll(argv[3]));
+			argv[3] = argv[0];
+			argv += 3;
+			argc -= 3;
+		}
+		else {
+			argv[2] = argv[0];
+			argv += 2;
+			argc -= 2;
+		}
+
+		sigset_t signals{};
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGUSR2);
+		pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+		std::thread([signals, path = profile.path]() {
+			int signal{ 0 };
+			while (sigwait(&signals, &signal) == 0) {
+				try {
+					IMD::sampling_profiler::global().write(path);
+				}
+				catch (const std::exception& e) {
+					std::cerr << e.what() << std::endl;
+				}
+			}
+		}).detach();
+		IMD::sampling_profiler::global().start(interval);
+	}
+
+	if (argc > 2 && argv[1] == "--top"s) { // Viewer of the live state of a monitored process: program --top name [interval, ms] [refreshes]
+		IMD::monitor_viewer viewer(argv[2]);
+		viewer.run(std::cout, std::chrono::milliseconds(argc > 3 ? std::stoll(argv[3]) : 1000), argc > 4 ? std::stoul(argv[4]) : 0);
+		return 0;
+	}
+
+	// Resource limits given by the arguments starting at first: [max_steps] [max_time, ms] [max_registers]
+	auto parse_limits = [argc, argv](int first) {
+		IMD::execution_limits limits{};
+		if (argc > first)
+			limits.max_steps = std::stoull(argv[first]);
+		if (argc > first + 1)
+			limits.max_time = std::chrono::milliseconds(std::stoll(argv[first + 1]));
+		if (argc > first + 2)
+			limits.max_registers = std::stoull(argv[first + 2]);
+		return limits;
+	};
+
+	if (argc > 2 && argv[1] == "--pipeline"s) { // Pipelined launch over a stream of input tuples: one tuple per line of standard input
+		IMD::pipeline pipeline(argv[2]);
+		pipeline.run(std::cin, std::cout);
+		return 0;
+	}
+
+	if (argc > 2 && argv[1] == "--serve"s) { // Server mode: program --serve socket [workers] [max_steps] [max_time, ms] [max_registers]
+		IMD::server server(argv[2], argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency(), parse_limits(4));
+		server.run();
+		return 0;
+	}
+
+	if (argc > 3 && argv[1] == "--client"s) { // Client of the server: program --client socket filename, input tuples from standard input
+		std::vector<std::vector<int>> inputs{};
+		while (auto input = IMD::read_tuple(std::cin))
+			inputs.push_back(*input);
+
+		IMD::client client(argv[2]);
+		for (const auto& result : client.run(argv[3], inputs)) {
+			for (auto x : result.outputs)
+				std::cout << x << " ";
+			std::cout << "steps: " << result.steps << std::endl;
+		}
+		return 0;
+	}
+
+	if (argc > 3 && argv[1] == "--loadgen"s) { // Load generator: program --loadgen socket filename [requests] [connections], input tuples from standard input
+		std::vector<std::vector<int>> inputs{};
+		while (auto input = IMD::read_tuple(std::cin))
+			inputs.push_back(*input);
+
+		IMD::generate_load(argv[2], argv[3], inputs, argc > 4 ? std::stoul(argv[4]) : 10000, argc > 5 ? std::stoul(argv[5]) : 4, std::cout);
+		return 0;
+	}
+
+	if (argc > 2 && argv[1] == "--schedule"s) { // Work-stealing launch of a job per input tuple: program --schedule filename [workers] [quantum]
+		IMD::scheduler scheduler(argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency(), argc > 4 ? std::stoul(argv[4]) : 10000);
+		IMD::extended_register_machine erm(argv[2]);
+		auto prototype = erm.load_stages(); // The program is loaded once, every job launches clones of its stages
+		while (auto input = IMD::read_tuple(std::cin)) {
+			std::vector<std::unique_ptr<IMD::extended_register_machine>> stages{};
+			for (const auto& x : prototype)
+				stages.push_back(x->clone());
+			scheduler.submit(std::make_unique<IMD::execution>(std::move(stages)), *input);
+		}
+
+		auto results = scheduler.wait();
+		std::vector<long long> latencies{};
+		for (const auto& result : results) {
+			std::cout << result.id << ": ";
+			if (result.state == IMD::execution_state::halted)
+				for (auto x : result.outputs)
+					std::cout << x << " ";
+			else
+				std::cout << "error: " << result.error << " ";
+			std::cout << "steps: " << result.steps << " latency, us: " << result.latency.count() << std::endl;
+			latencies.push_back(result.latency.count());
+		}
+
+		if (!latencies.empty()) {
+			std::sort(latencies.begin(), latencies.end());
+			std::cout << "jobs: " << latencies.size() << " steals: " << scheduler.steals() << " latency, us: p50 " << latencies[latencies.size() / 2] << " p99 " << latencies[latencies.size() * 99 / 100] << " max " << latencies.back() << std::endl;
+		}
+		return 0;
+	}
+
+	if (argc > 2 && argv[1] == "--meter"s) { // Launch under resource limits per input tuple: program --meter filename [max_steps] [max_time, ms] [max_registers]
+		auto limits = parse_limits(3);
+		IMD::execution launch(argv[2]);
+		while (auto input = IMD::read_tuple(std::cin)) {
+			auto result = launch.run(*input, limits);
+			if (result.state == IMD::execution_state::error)
+				std::cout << "error: " << result.error << " ";
+			else
+				for (auto x : result.outputs)
+					std::cout << x << " ";
+			std::cout << "limit: " << IMD::limit_name(result.limit) << " steps: " << result.steps << " registers: " << result.registers
+				<< " stage: " << result.stage << " line: " << result.carriage << " time, us: " << result.elapsed.count() << std::endl;
+		}
+		return 0;
+	}
+
+	if (argc > 2 && argv[1] == "--lockstep"s) { // Lockstep launch on a batch of input tuples: program --lockstep filename [lanes]
+		std::vector<std::vector<int>> inputs{};
+		while (auto input = IMD::read_tuple(std::cin))
+			inputs.push_back(*input);
+
+		IMD::lockstep_machine machine(argv[2], argc > 3 ? std::stoul(argv[3]) : 8);
+		auto outputs = machine.run(inputs);
+		for (size_t i{ 0 }; i < outputs.size(); ++i) {
+			for (auto x : outputs[i])
+				std::cout << x << " ";
+			std::cout << "steps: " << machine.steps()[i] << std::endl;
+		}
+
+		const auto& stats = machine.stats();
+		const char* isa_names[] = { "scalar", "avx2", "avx512" };
+		std::cout << "lanes: " << stats.lanes << " isa: " << isa_names[static_cast<int>(machine.instruction_set())] << " issued: " << stats.issued << " lane steps: " << stats.lane_steps << " utilization: " << stats.utilization() * 100 << "%" << std::endl;
+		return 0;
+	}
+
+	if (argc > 1 && argv[1] == "--differential"s) { // Differential check of the execution configurations on generated programs: program --differential [seed] [programs] [inputs]
+		uint64_t seed = argc > 2 ? std::stoull(argv[2]) : 1;
+		IMD::differential_checker checker(std::filesystem::temp_directory_path() / ("rm-differential-" + std::to_string(seed)), seed);
+		return checker.run(seed, argc > 3 ? std::stoul(argv[3]) : 1000, argc > 4 ? std::stoul(argv[4]) : 16, std::cout) == 0 ? 0 : 1;
+	}
+
+	if (argc > 3 && argv[1] == "--specialize"s) { // Partial evaluation for fixed input registers: program --specialize filename output register=value...
+		std::unordered_map<std::string, int> bindings{};
+		for (int i{ 4 }; i < argc; ++i) {
+			std::string binding = argv[i];
+			auto separator = binding.find('=');
+			if (separator == std::string::npos)
+				throw std::invalid_argument("Expected register=value: " + binding);
+			bindings[binding.substr(0, separator)] = std::stoi(binding.substr(separator + 1));
+		}
+
+		IMD::specializer specializer(argv[2]);
+		auto residual = specializer.specialize(bindings);
+		residual.write(argv[3]);
+		std::cout << "instructions: " << specializer.size() << " -> " << residual.code.size() << std::endl;
+		return 0;
+	}
+
+	if (argc > 3 && argv[1] == "--coalesce"s) { // Register coalescing: program --coalesce filename output
+		IMD::register_coalescer coalescer(argv[2]);
+		coalescer.coalesce().write(argv[3]);
+		std::cout << "registers: " << coalescer.registers() << " -> " << coalescer.coalesced_registers() << std::endl;
+		return 0;
+	}
+
+	if (argc > 2 && argv[1] == "--estimate"s) { // Static estimate of the number of steps: program --estimate filename [max_steps], input tuples from standard input with max_steps
+		IMD::step_estimator estimator(argv[2]);
+		const auto& bounds = estimator.bounds();
+		std::cout << "steps <= " << bounds.steps.text() << std::endl;
+		for (size_t i{ 0 }; i < bounds.outputs.size(); ++i)
+			std::cout << estimator.outputs()[i] << " <= " << bounds.outputs[i].text() << std::endl;
+		if (argc < 4)
+			return 0;
+
+		// Admission of the launches: a launch is admitted if its bound does not exceed max_steps
+		auto max_steps = std::stod(argv[3]);
+		while (auto input = IMD::read_tuple(std::cin)) {
+			auto steps = estimator.steps(*input);
+			for (auto x : *input)
+				std::cout << x << " ";
+			if (steps)
+				std::cout << "steps <= " << *steps << (*steps <= max_steps ? " admit" : " reject") << std::endl;
+			else
+				std::cout << "steps: unknown" << std::endl;
+		}
+		return 0;
+	}
+
+	if (argc > 2 && argv[1] == "--debug"s) { // Debugger: program --debug filename [values...], commands from standard input
+		IMD::debugger debugger(argv[2]);
+		std::vector<int> arguments{};
+		for (int i{ 3 }; i < argc; ++i)
+			arguments.push_back(std::stoi(argv[i]));
+		debugger.start(arguments);
+		debugger.print_position(std::cout);
+		debugger.run(std::cin, std::cout);
+		return 0;
+	}
+
+	if (argc > 3 && argv[1] == "--superoptimize"s) { // Superoptimization: program --superoptimize filename output [iterations] [threads]
+		IMD::superoptimizer::options settings{};
+		if (argc > 4)
+			settings.iterations = std::stoul(argv[4]);
+		if (argc > 5)
+			settings.threads = std::stoul(argv[5]);
+		settings.cache = std::filesystem::temp_directory_path() / "rm-superoptimizer";
+
+		IMD::superoptimizer superoptimizer(argv[2]);
+		auto result = superoptimizer.optimize(settings);
+		result.program.write(argv[3]);
+		std::cout << "instructions: " << result.size << " -> " << result.optimized_size << std::endl;
+		std::cout << "steps: " << result.steps << " -> " << result.optimized_steps << std::endl;
+		std::cout << "exhaustive bound: " << result.bound << (result.is_cached ? ", cached" : "") << std::endl;
+		return 0;
+	}
+
+	if (argc > 2 && argv[1] == "--lazy"s) { // Launch parsing every instruction the first time it is executed: program --lazy filename
+		IMD::extended_register_machine erm(argv[2], false, true);
+		erm.run();
+		return 0;
+	}
+
+	if (argc > 1)
+		filename = argv[1];
+
 	IMD::extended_register_machine erm(filename);
 	erm.run();
 
 	return 0;
-}
+}
\ No newline at end of file
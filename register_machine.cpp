@@ -1,14 +1,22 @@
 ﻿#include "register_machine.h"
+#include "monitor.h"
 
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <filesystem>
 #include <fstream>
 #include <ios>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <optional>
 #include <sstream>
-#include <stack>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 #include <stdexcept>
@@ -27,59 +35,122 @@ namespace IMD {
 
 	// Checks if the given string represents a keyword
 	bool is_keyword(std::string_view line){
-		if (line == SEPARATOR || line == COPY || line == MOVE || line == PLUS || line == MINUS ||
-			line == STOP || line == IF || line == THEN || line == ELSE || line == GOTO ||
-			line == EQUAL || line == COMPOSITION || line == COMMENT)
-			return true; 
-		return false;
+		return grammar::is_keyword(line);
 	}
 
 	// Checks if the given string represents a valid register identifier
 	bool is_register(std::string_view line) noexcept {
-		if (line.empty())
-			return false;
+		return grammar::is_register(line);
+	}
 
-		if (is_keyword(line))
-			return false;
-			
+	// Checks if the given string represents a non-negative integer literal
+	bool is_non_negative_literal(std::string_view line) noexcept {
+		return grammar::is_non_negative_literal(line);
+	}
 
-		if (!std::isalpha(*line.begin()))
-			return false; // The first character of the register must be a letter
+	// Returns the value of a literal operand, std::nullopt for a register or a literal out of the int range
+	static std::optional<int> literal_value(std::string_view operand) noexcept {
+		return grammar::literal_value(operand);
+	}
 
-		for (size_t i{ 1 }; i < line.size(); ++i) // The remaining case characters can be letters or numbers
-			if (!std::isalnum(line[i]))
-				return false;
+	// Returns the path of a file called from the given file: a relative path is taken relative to the directory of the calling file
+	static std::string called_path(const std::string& caller, const std::string& callee) {
+		std::filesystem::path path(callee);
+		if (path.is_absolute())
+			return callee;
+		return (std::filesystem::path(caller).parent_path() / path).lexically_normal().string();
+	}
 
-		return true;
+	// Returns the name identifying the file regardless of the spelling of its path
+	static std::string canonical_name(const std::string& filename) {
+		std::error_code error{};
+		auto path = std::filesystem::weakly_canonical(filename, error);
+		return error ? filename : path.string();
 	}
 
-	// Checks if the given string represents a non-negative integer literal
-	bool is_non_negative_literal(std::string_view line) noexcept {
-		if (line.empty())
-			return false;
+	// Calls f(i) for every i from 0 to count - 1 on up to hardware_concurrency threads, the calling thread takes part
+	// The exception of the smallest failed i is rethrown after all calls are finished
+	template <typename F>
+	static void parallel_for(size_t count, F f) {
+		auto threads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+		if (threads <= 1) {
+			for (size_t i{ 0 }; i < count; ++i)
+				f(i);
+			return;
+		}
 
-		for (size_t i{ 0 }; i < line.size(); ++i) // All characters must be numbers from 0 to 9
-			if (!std::isdigit(line[i]))
-				return false;
+		std::atomic<size_t> next{ 0 };
+		std::vector<std::exception_ptr> errors(count);
+		auto work = [&next, &errors, &f, count]() {
+			for (size_t i; (i = next++) < count; )
+				try {
+					f(i);
+				}
+				catch (...) {
+					errors[i] = std::current_exception();
+				}
+		};
+		std::vector<std::thread> workers{};
+		for (size_t i{ 1 }; i < threads; ++i)
+			workers.emplace_back(work);
+		work();
+		for (auto& worker : workers)
+			worker.join();
+
+		for (const auto& error : errors)
+			if (error)
+				std::rethrow_exception(error);
+	}
 
-		return true;
+	// Returns for every composition stage the number of its first occurrence: the same file and position range
+	static std::vector<size_t> first_occurrences(const std::vector<extended_register_machine::stage>& stages) {
+		std::vector<size_t> first(stages.size());
+		for (size_t i{ 0 }; i < stages.size(); ++i) {
+			first[i] = i;
+			for (size_t j{ 0 }; j < i; ++j)
+				if (first[j] == j && stages[j].filename == stages[i].filename && stages[j].begin == stages[i].begin && stages[j].end == stages[i].end) {
+					first[i] = j;
+					break;
+				}
+		}
+		return first;
 	}
-	// Checks if the given string represents a negative integer literal
-	bool is_negative_literal(std::string_view line) noexcept {
-		if (line.size() < 2) // минимум '-' и одна цифра
-			return false;
-		if (line[0] != '-')
-			return false;
 
-		for (size_t i = 1; i < line.size(); ++i)
-			if (!std::isdigit(static_cast<unsigned char>(line[i])))
-				return false;
+	// Block of the text comparisons: whole blocks are compared by memcmp, the differing one byte by byte
+	static constexpr size_t COMPARED_BLOCK{ 4096 };
+
+	// Returns the length of the common beginning of the texts
+	static size_t common_prefix(std::string_view a, std::string_view b) noexcept {
+		auto limit = std::min(a.size(), b.size());
+		size_t length{ 0 };
+		while (length + COMPARED_BLOCK <= limit && std::memcmp(a.data() + length, b.data() + length, COMPARED_BLOCK) == 0)
+			length += COMPARED_BLOCK;
+		while (length < limit && a[length] == b[length])
+			++length;
+		return length;
+	}
 
-		return true;
+	// Returns the length of the common ending of the texts, at most the given limit
+	static size_t common_suffix(std::string_view a, std::string_view b, size_t limit) noexcept {
+		limit = std::min({ limit, a.size(), b.size() });
+		size_t length{ 0 };
+		while (length + COMPARED_BLOCK <= limit && std::memcmp(a.data() + a.size() - length - COMPARED_BLOCK, b.data() + b.size() - length - COMPARED_BLOCK, COMPARED_BLOCK) == 0)
+			length += COMPARED_BLOCK;
+		while (length < limit && a[a.size() - length - 1] == b[b.size() - length - 1])
+			++length;
+		return length;
+	}
+
+	// Checks if the given string represents a negative integer literal
+	bool is_negative_literal(std::string_view line) noexcept {
+		return grammar::is_negative_literal(line);
 	}
 
 	// Checks if the given string is a valid filename with an extension
 	bool is_filename_with_extension(std::string_view line) noexcept {
+		if (line.find('.') == std::string_view::npos) // Registers and literals are rejected without building a path
+			return false;
+
 		std::filesystem::path p(line);
 		std::string filename = p.filename().string();
 
@@ -109,6 +180,44 @@ namespace IMD {
 		trim(line);
 	}
 
+	// Returns the line without the comment and the surrounding whitespace
+	std::string_view strip(std::string_view line) noexcept {
+		return grammar::strip(line);
+	}
+
+	// Reads the next tuple of integers from the stream, one tuple per line; returns std::nullopt at the end of the stream
+	std::optional<std::vector<int>> read_tuple(std::istream& is) {
+		std::string line;
+		while (std::getline(is, line)) {
+			remove_comment(line);
+			if (line.empty()) continue;
+
+			std::vector<int> tuple{};
+			std::istringstream iss(line);
+			int value{ 0 };
+			while (iss >> value)
+				tuple.push_back(value);
+			if (!iss.eof())
+				throw std::runtime_error("The input tuple contains a non-integer value: " + line);
+			return tuple;
+		}
+		return std::nullopt;
+	}
+
+	// Returns the name of the limit
+	std::string_view limit_name(execution_limit limit) noexcept {
+		switch (limit) {
+		case execution_limit::steps:
+			return "steps";
+		case execution_limit::time:
+			return "time";
+		case execution_limit::registers:
+			return "registers";
+		default:
+			return "none";
+		}
+	}
+
 	// Returns an integer value parsed from a string, which may contain a literal or a register
 	int get_value(const basic_register_machine& brm, const std::string& line) {
 		if (std::all_of(line.begin(), line.end(), ::isdigit))
@@ -142,6 +251,7 @@ namespace IMD {
 	// Returns a vector of tokens
 	std::vector<basic_register_machine::token> basic_register_machine::basic_lexer::tokenize() {
 		std::vector<token> tokens{};
+		tokens.reserve(12); // The longest instruction (a condition) has 10 tokens
 		while (true) {
 			this->skip_spaces();
 			if (this->eof()) break;
@@ -157,43 +267,17 @@ namespace IMD {
 		if (this->eof())
 			return std::nullopt;
 
-		static const std::vector<std::pair<std::string, token_type>> keyword_type_pairs = {
-			{COPY, token_type::operator_copy_assignment},
-			{EQUAL, token_type::operator_equal},
-			{PLUS, token_type::operator_plus},
-			{MINUS, token_type::operator_minus},
-			{STOP, token_type::keyword_stop},
-			{IF, token_type::keyword_if},
-			{THEN, token_type::keyword_then},
-			{ELSE, token_type::keyword_else},
-			{GOTO, token_type::keyword_goto},
-		};
-
-		for (const auto& [keyword, type] : keyword_type_pairs) {
-			if (this->_line.size() - this->_carriage >= keyword.size() &&
-				this->_line.compare(this->_carriage, keyword.size(), keyword) == 0) {
-
-				size_t next_symbol_position = this->_carriage + keyword.size();
-				if (next_symbol_position >= this->_line.size() ||
-					std::isspace(static_cast<unsigned char>(this->_line[next_symbol_position]))) {
-					this->_carriage += keyword.size();
-					return token{ type, keyword };
-				}
-			}
+		if (auto keyword = grammar::match_keyword(this->_line, this->_carriage, grammar::basic_keywords)) {
+			this->_carriage += keyword->text.size();
+			return token{ keyword->type, keyword->text };
 		}
 
-		size_t start = { this->_carriage };
-		while (!this->eof() && !std::isspace(this->_line[this->_carriage]))
-			++this->_carriage;
-		std::string_view text(this->_line.data() + start, this->_carriage - start);
+		auto text = grammar::next_word(this->_line, this->_carriage);
 
 		if (text.empty()) return std::nullopt;
 
-		if (is_non_negative_literal(text))
-			return token{ token_type::literal, text };
-
-		if (is_register(text))
-			return token{ token_type::variable, text };
+		if (auto type = grammar::classify(text); type != token_type::unknown)
+			return token{ type, text };
 
 		if (is_negative_literal(text))
 			throw std::runtime_error("Expected a non-negative integer literal at position: " + std::to_string(this->_carriage));
@@ -203,8 +287,7 @@ namespace IMD {
 
 	// Skip spaces
 	void basic_register_machine::basic_lexer::skip_spaces() noexcept {
-		while (!this->eof() && std::isspace(this->_line[this->_carriage]))
-			++this->_carriage;
+		grammar::skip_spaces(this->_line, this->_carriage);
 	}
 
 	// Checking for end of line
@@ -221,48 +304,20 @@ namespace IMD {
 		if (this->eof())
 			return std::nullopt;
 
-		static const std::vector<std::pair<std::string, token_type>> keyword_type_pairs = {
-			{COMPOSITION, token_type::keyword_composition},
-			{COPY, token_type::operator_copy_assignment},
-			{MOVE, token_type::operator_move_assignment},
-			{EQUAL, token_type::operator_equal},
-			{PLUS, token_type::operator_plus},
-			{MINUS, token_type::operator_minus},
-			{STOP, token_type::keyword_stop},
-			{IF, token_type::keyword_if},
-			{THEN, token_type::keyword_then},
-			{ELSE, token_type::keyword_else},
-			{GOTO, token_type::keyword_goto},
-		};
-
-		for (const auto& [keyword, type] : keyword_type_pairs) {
-			if (this->_line.size() - this->_carriage >= keyword.size() &&
-				this->_line.compare(this->_carriage, keyword.size(), keyword) == 0) {
-
-				size_t next_symbol_position = this->_carriage + keyword.size();
-				if (next_symbol_position >= this->_line.size() ||
-					std::isspace(static_cast<unsigned char>(this->_line[next_symbol_position]))) {
-					this->_carriage += keyword.size();
-					return token{ type, keyword };
-				}
-			}
+		if (auto keyword = grammar::match_keyword(this->_line, this->_carriage, grammar::extended_keywords)) {
+			this->_carriage += keyword->text.size();
+			return token{ keyword->type, keyword->text };
 		}
 
-		size_t start = { this->_carriage };
-		while (!this->eof() && !std::isspace(this->_line[this->_carriage]))
-			++this->_carriage;
-		std::string_view text(this->_line.data() + start, this->_carriage - start);
+		auto text = grammar::next_word(this->_line, this->_carriage);
 
 		if (text.empty()) return std::nullopt;
 
 		if (is_filename_with_extension(text))
 			return token{ token_type::file, text };
 
-		if (is_non_negative_literal(text))
-			return token{ token_type::literal, text };
-
-		if (is_register(text))
-			return token{ token_type::variable, text };
+		if (auto type = grammar::classify(text); type != token_type::unknown)
+			return token{ type, text };
 
 		if (is_negative_literal(text))
 			throw std::runtime_error("Expected a non-negative integer literal at position: " + std::to_string(this->_carriage));
@@ -273,10 +328,10 @@ namespace IMD {
 	// Implementation of the extended register machine parser
 
 	// Constructor
-	extended_register_machine::extended_parser::extended_parser(const std::vector<token>& tokens) noexcept : basic_parser(tokens) {};
+	extended_register_machine::extended_parser::extended_parser(const std::vector<token>& tokens, instruction_arena& arena, name_pool& names) noexcept : basic_parser(tokens, arena, names) {};
 
-	// Returns a unique pointer to the instruction
-	std::unique_ptr<basic_register_machine::instruction> extended_register_machine::extended_parser::make_instruction() {
+	// Returns a pointer to the instruction created in the arena
+	basic_register_machine::instruction* extended_register_machine::extended_parser::make_instruction() {
 		if (this->eof())
 			throw std::runtime_error("Empty instruction");
 
@@ -299,7 +354,9 @@ namespace IMD {
 
 
 		if (current_type == token_type::variable) {
-			auto next_token = this->_tokens.at(this->_carriage + 1);
+			if (this->_carriage + 1 >= this->_tokens.size())
+				throw std::runtime_error("Unexpected end of instruction");
+			auto next_token = this->_tokens[this->_carriage + 1];
 			if (next_token.type() == token_type::operator_copy_assignment)
 				return this->make_copy_assignment_instruction();
 			else if (next_token.type() == token_type::operator_move_assignment) {
@@ -312,7 +369,11 @@ namespace IMD {
 		return NULL;
 	}
 
-	std::unique_ptr<basic_register_machine::instruction> extended_register_machine::extended_parser::make_composition_command() {
+	basic_register_machine::instruction* extended_register_machine::extended_parser::make_composition_command() {
+		// A composition instruction with results is a call of a subroutine from the instructions of the program
+		if (std::any_of(this->_tokens.begin(), this->_tokens.end(), [](const token& x) { return x.type() == token_type::operator_result; }))
+			return this->make_call_instruction();
+
 		if (this->_tokens.size() > 2)
 			throw std::runtime_error("An unexpected part of the COMPOSITION command");
 
@@ -322,28 +383,104 @@ namespace IMD {
 		if (include_filename_token.type() == token_type::file) {
 			auto include_filename = include_filename_token.text();
 			++this->_carriage;
-			return std::make_unique<composition_instruction>(include_filename_token.text());
+			return this->_arena.create<composition_instruction>(this->_names.intern(include_filename_token.text()));
 		}
 		throw std::runtime_error("");
 	}
 
-	std::unique_ptr<basic_register_machine::instruction> extended_register_machine::extended_parser::make_goto_assignment_instruction() {
+	// Returns a pointer to the call instruction created in the arena: CALL file arguments RESULT results
+	basic_register_machine::instruction* extended_register_machine::extended_parser::make_call_instruction() {
+		++this->_carriage;
+
+		if (!this->is_type_match(token_type::file))
+			throw std::runtime_error("Expected a file name after '" + COMPOSITION + "'");
+		const auto& filename = this->_names.intern(this->preview().text());
+		++this->_carriage;
+
+		std::vector<const std::string*> arguments{};
+		while (!this->is_type_match(token_type::operator_result)) {
+			if (!this->is_type_match(token_type::variable) && !this->is_type_match(token_type::literal))
+				throw std::runtime_error("Expected a register or a literal as an argument of '" + COMPOSITION + "'");
+			arguments.push_back(&this->_names.intern(this->preview().text()));
+			++this->_carriage;
+		}
 		++this->_carriage;
 
-		auto number_token = this->preview();
+		std::vector<const std::string*> results{};
+		while (!this->eof()) {
+			if (!this->is_type_match(token_type::variable))
+				throw std::runtime_error("Expected a register as a result after '" + RESULT + "'");
+			results.push_back(&this->_names.intern(this->preview().text()));
+			++this->_carriage;
+		}
+
+		return this->_arena.create<call_instruction>(filename, std::move(arguments), std::move(results));
+	}
+
+	basic_register_machine::instruction* extended_register_machine::extended_parser::make_goto_assignment_instruction() {
+		++this->_carriage;
 
-		if (number_token.type() == token_type::literal) {
-			size_t mark = std::stoul(std::string(number_token.text()));
+		if (this->is_type_match(token_type::literal)) {
+			size_t mark = std::stoul(std::string(this->preview().text()));
 
 			++this->_carriage;
 
-			return std::make_unique<goto_instruction>(mark);
+			return this->_arena.create<goto_instruction>(mark);
 		}
 		throw std::runtime_error("Expected number after '" + GOTO + "'");
 
 	}
 
-	std::unique_ptr<basic_register_machine::instruction> extended_register_machine::extended_parser::make_move_assignment_instruction() {
+	// Returns a pointer to the condition or comparison instruction created in the arena
+	// Comparison with 0 keeps the conditional instruction of the basic RM and comparison with a literal for equality the extended one,
+	// the other relations and comparisons of two registers become comparison instructions
+	basic_register_machine::instruction* extended_register_machine::extended_parser::make_condition_instruction() {
+		++this->_carriage;
+
+		// Processing the compared register
+		if (!this->is_type_match(token_type::variable))
+			throw std::runtime_error("Expected register after if");
+		auto register_token = this->preview();
+
+		++this->_carriage;
+
+		// Handling the comparison operator
+		auto relation = this->eof() ? std::nullopt : grammar::relation_of(this->preview().type());
+		if (!relation.has_value())
+			throw std::runtime_error("Expected comparison operator after register");
+
+		++this->_carriage;
+
+		// Processing the register or the literal compared with
+		if (!this->is_type_match(token_type::variable) && !this->is_type_match(token_type::literal))
+			throw std::runtime_error("Expected register or literal after comparison operator");
+		auto operand_token = this->preview();
+
+		++this->_carriage;
+
+		auto [goto_true, goto_false] = this->make_jump_targets();
+
+		if (operand_token.type() == token_type::literal) {
+			auto value = literal_value(operand_token.text());
+			if (!value)
+				throw std::runtime_error("The literal " + std::string(operand_token.text()) + " is out of the register range");
+
+			if (*relation == basic_register_machine::relation::equal && *value == 0)
+				return this->_arena.create<condition_instruction>(this->_names.intern(register_token.text()), goto_true, goto_false);
+
+			if (*relation == basic_register_machine::relation::equal)
+				return this->_arena.create<extended_condition_instruction>(this->_names.intern(register_token.text()), static_cast<size_t>(*value), goto_true, goto_false);
+		}
+
+		return this->_arena.create<comparison_instruction>(
+			this->_names.intern(register_token.text()),
+			*relation,
+			this->_names.intern(operand_token.text()),
+			goto_true,
+			goto_false);
+	}
+
+	basic_register_machine::instruction* extended_register_machine::extended_parser::make_move_assignment_instruction() {
 		auto to_register_token = this->preview();
 
 		++this->_carriage;
@@ -364,12 +501,12 @@ namespace IMD {
 		if (from_register_token.type() != token_type::variable)
 			throw std::runtime_error("Expected register after '"s + MOVE + "'"s);
 
-		return std::make_unique<move_assignment_instruction>(
-			to_register_token.text(),
-			from_register_token.text());
+		return this->_arena.create<move_assignment_instruction>(
+			this->_names.intern(to_register_token.text()),
+			this->_names.intern(from_register_token.text()));
 	}
 
-	std::unique_ptr<basic_register_machine::instruction> extended_register_machine::extended_parser::make_copy_assignment_instruction() {
+	basic_register_machine::instruction* extended_register_machine::extended_parser::make_copy_assignment_instruction() {
 		auto target_token = this->preview();
 
 		++this->_carriage;
@@ -403,11 +540,11 @@ namespace IMD {
 			if (right_operand_token.type() == token_type::literal && std::stoi(std::string(right_operand_token.text())) < 0)
 				throw std::runtime_error("Only positive integers allowed for subtraction"s);
 
-			return std::make_unique<copy_assignment_instruction>(
-				target_token.text(),
+			return this->_arena.create<copy_assignment_instruction>(
+				this->_names.intern(target_token.text()),
 				basic_register_machine::operation::plus,
-				left_operand_token.text(),
-				right_operand_token.text());
+				this->_names.intern(left_operand_token.text()),
+				this->_names.intern(right_operand_token.text()));
 		}
 
 		if (this->is_type_match(token_type::operator_minus)) { // Found a minus
@@ -423,29 +560,50 @@ namespace IMD {
 			if (right_operand_token.type() == token_type::literal && std::stoi(std::string(right_operand_token.text())) < 0)
 				throw std::runtime_error("Only positive integers allowed for subtraction"s);
 
-			return std::make_unique<copy_assignment_instruction>(
-				target_token.text(),
+			return this->_arena.create<copy_assignment_instruction>(
+				this->_names.intern(target_token.text()),
 				basic_register_machine::operation::minus,
-				left_operand_token.text(),
-				right_operand_token.text());
+				this->_names.intern(left_operand_token.text()),
+				this->_names.intern(right_operand_token.text()));
+		}
+
+		// Multiplication, division and modulo take a single step instead of a loop of increments
+		if (auto type = this->eof() ? token_type::unknown : this->preview().type();
+			type == token_type::operator_multiply || type == token_type::operator_divide || type == token_type::operator_modulo) {
+			auto symbol = this->preview().text();
+
+			++this->_carriage;
+
+			if (this->eof() || (this->preview().type() != token_type::literal && this->preview().type() != token_type::variable))
+				throw std::runtime_error("Expected number or literal after '" + std::string(symbol) + "'"s);
+
+			auto right_operand_token = this->preview();
+
+			++this->_carriage;
+
+			return this->_arena.create<copy_assignment_instruction>(
+				this->_names.intern(target_token.text()),
+				*grammar::operation_of(type),
+				this->_names.intern(left_operand_token.text()),
+				this->_names.intern(right_operand_token.text()));
 		}
 
 		if (left_operand_token.type() == token_type::literal) {
 			if (std::stoi(std::string(left_operand_token.text())) < 0)
 				throw std::runtime_error("Only positive integers allowed for copy assignment"s);
 
-			return std::make_unique<copy_assignment_instruction>(
-				target_token.text(),
+			return this->_arena.create<copy_assignment_instruction>(
+				this->_names.intern(target_token.text()),
 				basic_register_machine::operation::none,
-				left_operand_token.text(),
-				"");
+				this->_names.intern(left_operand_token.text()),
+				this->_names.intern(""));
 		}
 		else if (left_operand_token.type() == token_type::variable) {
-			return std::make_unique<copy_assignment_instruction>(
-				target_token.text(),
+			return this->_arena.create<copy_assignment_instruction>(
+				this->_names.intern(target_token.text()),
 				basic_register_machine::operation::none,
-				left_operand_token.text(),
-				"");
+				this->_names.intern(left_operand_token.text()),
+				this->_names.intern(""));
 		}
 		else throw std::runtime_error("Expected number or literal in '" + COPY + "'"s);
 	}
@@ -453,20 +611,22 @@ namespace IMD {
 	// Implementation of the basic register machine parser
 
 	// Constructor
-	basic_register_machine::basic_parser::basic_parser(const std::vector<token>& tokens) noexcept : _tokens(tokens), _carriage(0) {}
+	basic_register_machine::basic_parser::basic_parser(const std::vector<token>& tokens, instruction_arena& arena, name_pool& names) noexcept : _tokens(tokens), _carriage(0), _arena(arena), _names(names) {}
 
 	// Checks for the end of a vector
 	bool basic_register_machine::basic_parser::eof() const noexcept {
 		return this->_carriage >= this->_tokens.size();
 	}
 
-	// Returns the current token
+	// Returns the current token, throws at the end of the instruction
 	const basic_register_machine::token& basic_register_machine::basic_parser::preview() const {
+		if (this->eof())
+			throw std::runtime_error("Unexpected end of instruction");
 		return this->_tokens[this->_carriage];
 	}
 
-	// Returns a unique pointer to the instruction
-	std::unique_ptr<basic_register_machine::instruction> basic_register_machine::basic_parser::make_instruction() {
+	// Returns a pointer to the instruction created in the arena
+	basic_register_machine::instruction* basic_register_machine::basic_parser::make_instruction() {
 		if (this->eof())
 			throw std::runtime_error("Empty instruction");
 
@@ -482,24 +642,24 @@ namespace IMD {
 		throw std::runtime_error("Unknown instruction start");
 	}
 
-	// Returns a unique pointer to the stop instruction
-	std::unique_ptr<basic_register_machine::instruction> basic_register_machine::basic_parser::make_stop_instruction() {
+	// Returns a pointer to the stop instruction created in the arena
+	basic_register_machine::instruction* basic_register_machine::basic_parser::make_stop_instruction() {
 		if (this->is_type_match(token_type::keyword_stop)) {
 			++this->_carriage;
-			return std::make_unique<stop_instruction>();
+			return this->_arena.create<stop_instruction>();
 		}
 
 		throw std::runtime_error("Invalid stop instruction");
 	}
 
-	// Returns a unique pointer to the condition instruction
-	std::unique_ptr<basic_register_machine::instruction> basic_register_machine::basic_parser::make_condition_instruction() {
+	// Returns a pointer to the condition instruction created in the arena
+	basic_register_machine::instruction* basic_register_machine::basic_parser::make_condition_instruction() {
 		++this->_carriage;
 
 		// Processing the compared register
-		auto register_token = this->preview();
-		if (register_token.type() != token_type::variable)
+		if (!this->is_type_match(token_type::variable))
 			throw std::runtime_error("Expected register after if");
+		auto register_token = this->preview();
 
 		++this->_carriage;
 
@@ -515,6 +675,13 @@ namespace IMD {
 
 		++this->_carriage;
 
+		auto [goto_true, goto_false] = this->make_jump_targets();
+
+		return this->_arena.create<condition_instruction>(this->_names.intern(register_token.text()), goto_true, goto_false);
+	}
+
+	// Processes the jump targets of a condition
+	std::pair<size_t, size_t> basic_register_machine::basic_parser::make_jump_targets() {
 		// Processing the THEN keyword
 		if (!this->is_type_match(token_type::keyword_then))
 			throw std::runtime_error("Expected '" + THEN + "'");
@@ -528,9 +695,9 @@ namespace IMD {
 		++this->_carriage;
 
 		// Processing the TRUE_MARKER keyword
-		auto goto_true_token = this->preview();
 		if (!this->is_type_match(token_type::literal))
 			throw std::runtime_error("Expected number after '" + GOTO + "'");
+		auto goto_true_token = this->preview();
 
 		++this->_carriage;
 
@@ -547,18 +714,15 @@ namespace IMD {
 		++this->_carriage;
 
 		// Processing the FALSE_MARKER keyword
-		auto goto_false_token = this->preview();
 		if (!this->is_type_match(token_type::literal))
 			throw std::runtime_error("Expected number after '" + GOTO + "'");
+		auto goto_false_token = this->preview();
 
-		return std::make_unique<condition_instruction>(
-			register_token.text(),
-			std::stoul(std::string(goto_true_token.text())),
-			std::stoul(std::string(goto_false_token.text())));
+		return { std::stoul(std::string(goto_true_token.text())), std::stoul(std::string(goto_false_token.text())) };
 	}
 
-	// Returns a unique pointer to the copy assignment instruction
-	std::unique_ptr<basic_register_machine::instruction> basic_register_machine::basic_parser::make_copy_assignment_instruction() {
+	// Returns a pointer to the copy assignment instruction created in the arena
+	basic_register_machine::instruction* basic_register_machine::basic_parser::make_copy_assignment_instruction() {
 		auto target_token = this->preview();
 
 		++this->_carriage;
@@ -594,11 +758,11 @@ namespace IMD {
 			if (right_operand_token.text() != "1")
 				throw std::runtime_error("Only increment by 1 is allowed");
 
-			return std::make_unique<copy_assignment_instruction>(
-				target_token.text(),
+			return this->_arena.create<copy_assignment_instruction>(
+				this->_names.intern(target_token.text()),
 				basic_register_machine::operation::plus,
-				left_operand_token.text(),
-				right_operand_token.text());
+				this->_names.intern(left_operand_token.text()),
+				this->_names.intern(right_operand_token.text()));
 		}
 		else if (this->is_type_match(token_type::operator_minus)) {
 			++this->_carriage;
@@ -610,11 +774,11 @@ namespace IMD {
 			if (right_operand_token.text() != "1")
 				throw std::runtime_error("Only decrement by 1 is allowed");
 
-			return std::make_unique<copy_assignment_instruction>(
-				target_token.text(),
+			return this->_arena.create<copy_assignment_instruction>(
+				this->_names.intern(target_token.text()),
 				basic_register_machine::operation::minus,
-				left_operand_token.text(),
-				right_operand_token.text());
+				this->_names.intern(left_operand_token.text()),
+				this->_names.intern(right_operand_token.text()));
 		}
 		else {
 			// Simple assignment: x <- a, where a is a non-negative integer
@@ -625,11 +789,11 @@ namespace IMD {
 			if (std::stoi(std::string(left_operand_token.text())) < 0)
 				throw std::runtime_error("Only positive integers allowed for assignment");
 
-			return std::make_unique<copy_assignment_instruction>(
-				target_token.text(),
+			return this->_arena.create<copy_assignment_instruction>(
+				this->_names.intern(target_token.text()),
 				basic_register_machine::operation::none,
-				left_operand_token.text(),
-				"");
+				this->_names.intern(left_operand_token.text()),
+				this->_names.intern(""));
 		}
 	}
 
@@ -645,15 +809,24 @@ namespace IMD {
 	// Constructor
 	basic_register_machine::instruction::instruction() noexcept {}
 
-	// Returns a normalized description of the instruction
-	const std::string& basic_register_machine::instruction::description() const noexcept {
-		return this->_description;
+	// Execution of the instruction of a verified program: the registers it reads are known to exist
+	void basic_register_machine::instruction::execute_verified(basic_register_machine& brm) {
+		this->execute(brm);
 	}
 
 	// Constructor
-	basic_register_machine::copy_assignment_instruction::copy_assignment_instruction(std::string_view target_register, const operation& operation, std::string_view left_operand, std::string_view right_operand) noexcept :
-		instruction(), _target_register(target_register), _operation(operation), _left_operand(left_operand), _right_operand(right_operand) {
-		this->_description = this->_target_register + " " + COPY + " " + this->_left_operand + " " + (this->_operation == operation::plus ? PLUS : this->_operation == operation::minus ? MINUS : " ") + " " + this->_right_operand;
+	basic_register_machine::copy_assignment_instruction::copy_assignment_instruction(const std::string& target_register, const operation& operation, const std::string& left_operand, const std::string& right_operand) noexcept :
+		instruction(), _target_register(target_register), _operation(operation), _left_operand(left_operand), _right_operand(right_operand), _left_value(literal_value(left_operand)), _right_value(literal_value(right_operand)) {}
+
+	// Returns a normalized description of the instruction
+	std::string basic_register_machine::copy_assignment_instruction::description() const {
+		static const std::string symbols[] = { " "s, PLUS, MINUS, MULTIPLY, DIVIDE, MODULO };
+		return this->_target_register + " " + COPY + " " + this->_left_operand + " " + symbols[static_cast<size_t>(this->_operation)] + " " + this->_right_operand;
+	}
+
+	// Returns the kind of the instruction
+	basic_register_machine::instruction_kind basic_register_machine::copy_assignment_instruction::kind() const noexcept {
+		return instruction_kind::copy_assignment;
 	}
 
 	// Executing a copy assignment instruction
@@ -663,28 +836,64 @@ namespace IMD {
 
 		try {
 			int value{ 0 };
-			switch (this->_operation) {
-			case operation::none:
+			if (this->_operation == operation::none)
 				value = get_value(brm, _left_operand);
-				break;
-			case operation::plus:
-				value = get_value(brm, _left_operand) + get_value(brm, _right_operand);
-				break;
-			case operation::minus:
-				value = get_value(brm, _left_operand) - get_value(brm, _right_operand);
-				if (value < 0)
-					value = 0;
-				break;
-			}
+			else
+				value = apply(this->_operation, get_value(brm, _left_operand), get_value(brm, _right_operand));
 			brm._registers[_target_register] = value;
 		}
 		catch (...) {}
 	}
 
+	// Executing a copy assignment instruction of a verified program without catching missing registers
+	void basic_register_machine::copy_assignment_instruction::execute_verified(basic_register_machine& brm) {
+		++brm._carriage;
+
+		int left = this->_left_value ? *this->_left_value : brm._registers.find(this->_left_operand)->second;
+		if (this->_operation == operation::none) {
+			brm._registers[this->_target_register] = left;
+			return;
+		}
+
+		int right = this->_right_value ? *this->_right_value : brm._registers.find(this->_right_operand)->second;
+		brm._registers[this->_target_register] = apply(this->_operation, left, right);
+	}
+
+	// Returns the value of the expression
+	// The registers hold non-negative 32-bit values: a sum or a product beyond INT_MAX saturates at it
+	int basic_register_machine::copy_assignment_instruction::apply(operation operation, int left, int right) noexcept {
+		return grammar::apply(operation, left, right);
+	}
+
+	// Returns the name of the target register
+	const std::string& basic_register_machine::copy_assignment_instruction::target_register() const noexcept {
+		return this->_target_register;
+	}
+	// Returns the operation in expression
+	const basic_register_machine::operation& basic_register_machine::copy_assignment_instruction::operation_type() const noexcept {
+		return this->_operation;
+	}
+	// Returns the left operand of expression
+	const std::string& basic_register_machine::copy_assignment_instruction::left_operand() const noexcept {
+		return this->_left_operand;
+	}
+	// Returns the right operand of expression
+	const std::string& basic_register_machine::copy_assignment_instruction::right_operand() const noexcept {
+		return this->_right_operand;
+	}
+
 	// Constructor
-	basic_register_machine::condition_instruction::condition_instruction(std::string_view compared_register, size_t goto_true, size_t goto_false) noexcept :
-		instruction(), _compared_register(compared_register), _goto_true(goto_true), _goto_false(goto_false) {
-		this->_description = IF + " " + this->_compared_register + " " + EQUAL + " 0 " + THEN + " " + GOTO + " " + std::to_string(this->_goto_true) + " " + ELSE + " " + GOTO + " " + std::to_string(this->_goto_false);
+	basic_register_machine::condition_instruction::condition_instruction(const std::string& compared_register, size_t goto_true, size_t goto_false) noexcept :
+		instruction(), _compared_register(compared_register), _goto_true(goto_true), _goto_false(goto_false) {}
+
+	// Returns a normalized description of the instruction
+	std::string basic_register_machine::condition_instruction::description() const {
+		return IF + " " + this->_compared_register + " " + EQUAL + " 0 " + THEN + " " + GOTO + " " + std::to_string(this->_goto_true) + " " + ELSE + " " + GOTO + " " + std::to_string(this->_goto_false);
+	}
+
+	// Returns the kind of the instruction
+	basic_register_machine::instruction_kind basic_register_machine::condition_instruction::kind() const noexcept {
+		return instruction_kind::condition;
 	}
 	// Executing a conditional instruction
 	void basic_register_machine::condition_instruction::execute(basic_register_machine& brm) noexcept {
@@ -692,18 +901,50 @@ namespace IMD {
 		else brm._carriage = this->_goto_false;
 	}
 
+	// Returns the name of the compared register
+	const std::string& basic_register_machine::condition_instruction::compared_register() const noexcept {
+		return this->_compared_register;
+	}
+	// Returns the instruction number when the condition is true
+	size_t basic_register_machine::condition_instruction::goto_true() const noexcept {
+		return this->_goto_true;
+	}
+	// Returns the instruction number when the condition is false
+	size_t basic_register_machine::condition_instruction::goto_false() const noexcept {
+		return this->_goto_false;
+	}
+
 	// Constructor
-	basic_register_machine::stop_instruction::stop_instruction() noexcept : instruction() {
-		this->_description = STOP;
+	basic_register_machine::stop_instruction::stop_instruction() noexcept : instruction() {}
+
+	// Returns a normalized description of the instruction
+	std::string basic_register_machine::stop_instruction::description() const {
+		return STOP;
+	}
+
+	// Returns the kind of the instruction
+	basic_register_machine::instruction_kind basic_register_machine::stop_instruction::kind() const noexcept {
+		return instruction_kind::stop;
 	}
 	// Executing a stop instruction
-	void basic_register_machine::stop_instruction::execute(basic_register_machine& brm) noexcept {
+	void basic_register_machine::stop_instruction::execute(basic_register_machine& brm) {
+		if (brm._depth != 0) {
+			brm.return_from_call();
+			return;
+		}
 		brm._is_stopped = true;
 	}
 
 	// Constructor
-	basic_register_machine::extended_condition_instruction::extended_condition_instruction(std::string_view compared_register, size_t compared_value, size_t goto_true, size_t goto_false) noexcept : _compared_value(compared_value), condition_instruction(compared_register, goto_true, goto_false) {
-		this->_description = IF + " " + this->_compared_register + " " + EQUAL + " " + std::to_string(this->_compared_value) + " " + THEN + " " + GOTO + " " + std::to_string(this->_goto_true) + " " + ELSE + " " + GOTO + " " + std::to_string(this->_goto_false);
+	basic_register_machine::extended_condition_instruction::extended_condition_instruction(const std::string& compared_register, size_t compared_value, size_t goto_true, size_t goto_false) noexcept : condition_instruction(compared_register, goto_true, goto_false), _compared_value(compared_value) {}
+
+	// Returns a normalized description of the instruction
+	std::string basic_register_machine::extended_condition_instruction::description() const {
+		return IF + " " + this->_compared_register + " " + EQUAL + " " + std::to_string(this->_compared_value) + " " + THEN + " " + GOTO + " " + std::to_string(this->_goto_true) + " " + ELSE + " " + GOTO + " " + std::to_string(this->_goto_false);
+	}
+	// Returns the kind of the instruction
+	basic_register_machine::instruction_kind basic_register_machine::extended_condition_instruction::kind() const noexcept {
+		return instruction_kind::extended_condition;
 	}
 	// Executing a extended conditional instruction
 	void basic_register_machine::extended_condition_instruction::execute(basic_register_machine& brm) noexcept {
@@ -711,32 +952,225 @@ namespace IMD {
 		else brm._carriage = this->_goto_false;
 	}
 
+	// Returns the value to be compared
+	size_t basic_register_machine::extended_condition_instruction::compared_value() const noexcept {
+		return this->_compared_value;
+	}
+
+	// Constructor
+	basic_register_machine::comparison_instruction::comparison_instruction(const std::string& compared_register, relation relation, const std::string& compared_operand, size_t goto_true, size_t goto_false) noexcept :
+		condition_instruction(compared_register, goto_true, goto_false), _relation(relation), _compared_operand(compared_operand), _compared_literal(literal_value(compared_operand)) {}
+
+	// Returns a normalized description of the instruction
+	std::string basic_register_machine::comparison_instruction::description() const {
+		static const std::string symbols[] = { EQUAL, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+		return IF + " " + this->_compared_register + " " + symbols[static_cast<size_t>(this->_relation)] + " " + this->_compared_operand + " " + THEN + " " + GOTO + " " + std::to_string(this->_goto_true) + " " + ELSE + " " + GOTO + " " + std::to_string(this->_goto_false);
+	}
+
+	// Returns the kind of the instruction
+	basic_register_machine::instruction_kind basic_register_machine::comparison_instruction::kind() const noexcept {
+		return instruction_kind::comparison;
+	}
+	// Executing a comparison instruction
+	void basic_register_machine::comparison_instruction::execute(basic_register_machine& brm) noexcept {
+		int left = brm._registers[this->_compared_register];
+		int right = this->_compared_literal ? *this->_compared_literal : brm._registers[this->_compared_operand];
+		brm._carriage = holds(this->_relation, left, right) ? this->_goto_true : this->_goto_false;
+	}
+
+	// Returns true if the relation holds between the values
+	bool basic_register_machine::comparison_instruction::holds(relation relation, int left, int right) noexcept {
+		return grammar::holds(relation, left, right);
+	}
+
+	// Returns the relation between the compared register and the operand
+	basic_register_machine::relation basic_register_machine::comparison_instruction::relation_type() const noexcept {
+		return this->_relation;
+	}
+	// Returns the name of the register or the literal compared with
+	const std::string& basic_register_machine::comparison_instruction::compared_operand() const noexcept {
+		return this->_compared_operand;
+	}
+
 	// Constructor
-	basic_register_machine::goto_instruction::goto_instruction(size_t mark) noexcept : instruction(), _target_mark(mark) {
-		this->_description = GOTO + " " + std::to_string(this->_target_mark);
+	basic_register_machine::goto_instruction::goto_instruction(size_t mark) noexcept : instruction(), _target_mark(mark) {}
+
+	// Returns a normalized description of the instruction
+	std::string basic_register_machine::goto_instruction::description() const {
+		return GOTO + " " + std::to_string(this->_target_mark);
+	}
+
+	// Returns the kind of the instruction
+	basic_register_machine::instruction_kind basic_register_machine::goto_instruction::kind() const noexcept {
+		return instruction_kind::jump;
 	}
 	// Executing a goto instruction
 	void basic_register_machine::goto_instruction::execute(basic_register_machine& brm) noexcept {
 		brm._carriage = this->_target_mark;
 	}
 
+	// Returns the number of the target instruction
+	size_t basic_register_machine::goto_instruction::target_mark() const noexcept {
+		return this->_target_mark;
+	}
+
 	// Constructor
-	extended_register_machine::composition_instruction::composition_instruction(std::string_view include_filename) noexcept : instruction(), _include_filename(include_filename) {
-		this->_description = COMPOSITION + " " + this->_include_filename;
+	extended_register_machine::composition_instruction::composition_instruction(const std::string& include_filename) noexcept : instruction(), _include_filename(include_filename) {}
+
+	// Returns a normalized description of the instruction
+	std::string extended_register_machine::composition_instruction::description() const {
+		return COMPOSITION + " " + this->_include_filename;
+	}
+
+	// Returns the kind of the instruction
+	basic_register_machine::instruction_kind extended_register_machine::composition_instruction::kind() const noexcept {
+		return instruction_kind::composition;
 	}
 
 	// Executing a composition instruction
 	void extended_register_machine::composition_instruction::execute(basic_register_machine& brm) {
-		auto erm = dynamic_cast<extended_register_machine*>(&brm);
-		if (erm == NULL)
-			throw std::runtime_error("erasd");
+		throw std::runtime_error("Filename: " + brm.filename() + ". The composition instruction " + this->description() + " is resolved before the launch and cannot be executed");
+	}
+
+	// Returns the name of the included file
+	const std::string& extended_register_machine::composition_instruction::include_filename() const noexcept {
+		return this->_include_filename;
+	}
+
+	// Constructor
+	basic_register_machine::call_instruction::call_instruction(const std::string& filename, std::vector<const std::string*> arguments, std::vector<const std::string*> results) :
+		instruction(), _filename(filename), _arguments(std::move(arguments)), _argument_values(), _results(std::move(results)), _callee(nullptr), _slot_registers(), _input_slots(), _output_slots() {
+		for (const auto* x : this->_arguments)
+			this->_argument_values.push_back(literal_value(*x));
+	}
+
+	// Returns a normalized description of the instruction
+	std::string basic_register_machine::call_instruction::description() const {
+		auto description = COMPOSITION + " " + this->_filename;
+		for (const auto* x : this->_arguments)
+			description += " " + *x;
+		description += " " + RESULT;
+		for (const auto* x : this->_results)
+			description += " " + *x;
+		return description;
+	}
+
+	// Returns the kind of the instruction
+	basic_register_machine::instruction_kind basic_register_machine::call_instruction::kind() const noexcept {
+		return instruction_kind::call;
+	}
+
+	// Executing a call instruction
+	// The window of the called program holds only its input and output registers; the dictionaries and the instruction vectors
+	// are swapped with the frame, so the instructions of both programs run on the machine unchanged
+	// The window is bound to the frame when the frame gets another program; later calls remove only the registers created
+	// by the previous one and pass the arguments through the slots
+	void basic_register_machine::call_instruction::execute(basic_register_machine& brm) {
+		if (this->_callee == nullptr)
+			throw std::runtime_error("Filename: " + brm._filename + ". The called program " + this->_filename + " is not linked");
+		if (brm._depth == MAX_CALL_DEPTH)
+			throw std::runtime_error("Filename: " + brm._filename + ". The depth of the calls exceeds " + std::to_string(MAX_CALL_DEPTH));
+
+		if (brm._depth == brm._frames.size())
+			brm._frames.emplace_back();
+		auto& frame = brm._frames[brm._depth];
+		if (frame.callee != this->_callee) {
+			frame.instructions = this->_callee->_instructions;
+			frame.callee = this->_callee;
+			frame.registers.clear();
+			frame.slots.clear();
+			for (const auto* x : this->_slot_registers)
+				frame.slots.push_back(&frame.registers.try_emplace(*x, 0).first->second);
+			frame.initial.assign(frame.slots.begin(), frame.slots.end());
+			std::sort(frame.initial.begin(), frame.initial.end());
+		}
+		else if (frame.registers.size() != frame.initial.size()) {
+			for (auto it = frame.registers.begin(); it != frame.registers.end(); ) {
+				if (std::binary_search(frame.initial.begin(), frame.initial.end(), &it->second))
+					++it;
+				else
+					it = frame.registers.erase(it);
+			}
+		}
+
+		for (auto x : this->_output_slots)
+			*frame.slots[x] = 0;
+		for (size_t i{ 0 }; i < this->_arguments.size(); ++i) {
+			int value{ 0 };
+			if (this->_argument_values[i])
+				value = *this->_argument_values[i];
+			else if (auto it = brm._registers.find(*this->_arguments[i]); it != brm._registers.end())
+				value = it->second;
+			else
+				throw std::runtime_error("Filename: " + brm._filename + ". The argument " + *this->_arguments[i] + " of the call of " + this->_filename + " is not assigned");
+			*frame.slots[this->_input_slots[i]] = value;
+		}
+
+		std::swap(brm._registers, frame.registers);
+		std::swap(brm._instructions, frame.instructions);
+		frame.call = this;
+		frame.return_carriage = brm._carriage + 1;
+		++brm._depth;
+		brm._carriage = 0;
+		if (brm._profile != nullptr)
+			brm.profile_call();
+	}
+
+	// Binds the instruction to the called program and resolves the slots of its registers
+	void basic_register_machine::call_instruction::bind(const basic_register_machine& callee) {
+		if (this->_arguments.size() != callee._input_registers.size())
+			throw std::runtime_error("The call of " + this->_filename + " passes " + std::to_string(this->_arguments.size()) + " arguments to " + std::to_string(callee._input_registers.size()) + " input registers");
+		if (this->_results.size() > callee._output_registers.size())
+			throw std::runtime_error("The call of " + this->_filename + " expects " + std::to_string(this->_results.size()) + " results from " + std::to_string(callee._output_registers.size()) + " output registers");
+		this->_callee = &callee;
+
+		this->_slot_registers.clear();
+		auto slot = [this](const std::string& x) {
+			auto it = std::find_if(this->_slot_registers.begin(), this->_slot_registers.end(), [&x](const std::string* y) { return *y == x; });
+			if (it == this->_slot_registers.end())
+				it = this->_slot_registers.insert(it, &x);
+			return static_cast<size_t>(it - this->_slot_registers.begin());
+		};
+		this->_output_slots.clear();
+		for (const auto& x : callee._output_registers)
+			this->_output_slots.push_back(slot(x));
+		this->_input_slots.clear();
+		for (const auto& x : callee._input_registers)
+			this->_input_slots.push_back(slot(x));
+	}
 
-		erm->_file_stack.push({ this->_include_filename, {std::nullopt, std::nullopt} });
+	// Returns the name of the called file
+	const std::string& basic_register_machine::call_instruction::filename() const noexcept {
+		return this->_filename;
+	}
+	// Returns the names of the registers or the literals passed as arguments
+	const std::vector<const std::string*>& basic_register_machine::call_instruction::arguments() const noexcept {
+		return this->_arguments;
+	}
+	// Returns the names of the registers receiving the results
+	const std::vector<const std::string*>& basic_register_machine::call_instruction::results() const noexcept {
+		return this->_results;
+	}
+	// Returns the called program, nullptr before linking
+	const basic_register_machine* basic_register_machine::call_instruction::callee() const noexcept {
+		return this->_callee;
+	}
+	// Returns the slots of the output registers of the called program
+	const std::vector<size_t>& basic_register_machine::call_instruction::output_slots() const noexcept {
+		return this->_output_slots;
 	}
 
 	// Constructor
-	basic_register_machine::move_assignment_instruction::move_assignment_instruction(std::string_view to_register, std::string_view from_register) noexcept : instruction(), _to_register(to_register), _from_register(from_register) {
-		this->_description = this->_to_register + " " + MOVE + " " + this->_from_register;
+	basic_register_machine::move_assignment_instruction::move_assignment_instruction(const std::string& to_register, const std::string& from_register) noexcept : instruction(), _to_register(to_register), _from_register(from_register) {}
+
+	// Returns a normalized description of the instruction
+	std::string basic_register_machine::move_assignment_instruction::description() const {
+		return this->_to_register + " " + MOVE + " " + this->_from_register;
+	}
+
+	// Returns the kind of the instruction
+	basic_register_machine::instruction_kind basic_register_machine::move_assignment_instruction::kind() const noexcept {
+		return instruction_kind::move_assignment;
 	}
 	// Executing move assignment instruction
 	void basic_register_machine::move_assignment_instruction::execute(basic_register_machine& brm) {
@@ -746,10 +1180,72 @@ namespace IMD {
 		return;
 	}
 
+	// Returns the name of the target register
+	const std::string& basic_register_machine::move_assignment_instruction::to_register() const noexcept {
+		return this->_to_register;
+	}
+	// Returns the name of the source register
+	const std::string& basic_register_machine::move_assignment_instruction::from_register() const noexcept {
+		return this->_from_register;
+	}
+
+	// Implementation of the instruction arena
+
+	// Constructor
+	basic_register_machine::instruction_arena::instruction_arena() noexcept : _blocks(), _used(0), _instructions() {}
+
+	// Destructor: destroys all instructions
+	basic_register_machine::instruction_arena::~instruction_arena() {
+		this->clear();
+	}
+
+	// Destroys all instructions, the first block is kept for reuse
+	void basic_register_machine::instruction_arena::clear() noexcept {
+		for (auto* x : this->_instructions)
+			x->~instruction();
+		this->_instructions.clear();
+
+		if (this->_blocks.size() > 1)
+			this->_blocks.resize(1);
+		this->_used = 0;
+	}
+
+	// Returns suitably aligned memory of the given size
+	void* basic_register_machine::instruction_arena::allocate(size_t size) {
+		constexpr size_t ALIGNMENT{ alignof(std::max_align_t) };
+		size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+		if (this->_blocks.empty() || this->_used + size > BLOCK_SIZE) {
+			this->_blocks.push_back(std::make_unique<std::byte[]>(BLOCK_SIZE));
+			this->_used = 0;
+		}
+
+		auto* result = this->_blocks.back().get() + this->_used;
+		this->_used += size;
+		return result;
+	}
+
+	// Implementation of the name pool
+
+	// Returns the pooled copy of the name
+	const std::string& basic_register_machine::name_pool::intern(std::string_view name) {
+		std::string key(name);
+		auto it = this->_names.find(key);
+		if (it != this->_names.end())
+			return *it;
+
+		return *this->_names.insert(std::move(key)).first;
+	}
+
+	// Removes all names
+	void basic_register_machine::name_pool::clear() noexcept {
+		this->_names.clear();
+	}
+
 	// Implementation of the basic register machine
 
 	// Constructor
-	basic_register_machine::basic_register_machine(std::string_view filename, bool is_verbose) noexcept : _filename(filename), _is_verbose(is_verbose), _carriage(0), _registers(), _instructions(), _output_registers(), _is_stopped(false) {}
+	basic_register_machine::basic_register_machine(std::string_view filename, bool is_verbose) noexcept : _is_stopped(false), _is_verbose(is_verbose), _error(), _filename(filename), _carriage(0), _steps(0), _is_verified(false), _registers(), _code(std::make_shared<code_storage>()), _retained(), _instructions(), _text(), _verification(), _output_registers(), _input_registers(), _input_values(), _output_values(), _initial_values(), _is_bound(false), _frames(), _depth(0), _metrics(nullptr), _profile(nullptr), _profile_file(0), _profile_number(0), _composition_number(0) {}
 
 	// Launch of RM
 	void basic_register_machine::run() {
@@ -773,23 +1269,264 @@ namespace IMD {
 	// Reboot RM
 	void basic_register_machine::reboot() {
 		this->_carriage = 0;
+		this->_steps = 0;
+		this->_is_verified = false;
 		this->_registers.clear();
+		this->_is_bound = false;
+		this->_frames.clear();
+		this->_depth = 0;
 		this->_instructions.clear();
+		this->release_code();
 		this->_output_registers.clear();
 		this->_input_registers.clear();
 		this->_is_stopped = false;
 	}
 
-	// Drop settings of RM
-	void basic_register_machine::drop() {
-		this->_carriage = 0;
-		this->_registers.clear();
-		this->_instructions.clear();
-		this->_output_registers.clear();
-		this->_input_registers.clear();
-		this->_filename = ""s;
-		this->_is_stopped = false;
-		this->_is_verbose = false;
+	// Launch of the loaded RM on the given values of the input registers, returns the values of the output registers
+	std::vector<int> basic_register_machine::evaluate(const std::vector<int>& arguments) {
+		this->start(arguments);
+		this->execute_all_instructions();
+		return this->results();
+	}
+
+	// Prepares the loaded RM for a resumable launch on the given values of the input registers
+	void basic_register_machine::start(const std::vector<int>& arguments) {
+		if (arguments.size() < this->_input_registers.size()) // Check the correspondence between the number of arguments and input registers
+			throw std::runtime_error("Filename: " + this->_filename + ". Not enough input values for arguments");
+
+		this->reset_registers();
+		for (size_t i{ 0 }; i < this->_input_values.size(); ++i)
+			*this->_input_values[i] = arguments[i];
+	}
+
+	// Prepares the loaded RM for a resumable launch on the values of the output registers of the previous composition stage
+	void basic_register_machine::start(const basic_register_machine& previous) {
+		if (!previous._is_bound) {
+			this->start(previous.results());
+			return;
+		}
+
+		if (previous._output_values.size() < this->_input_registers.size()) // Check the correspondence between the number of inputs and outputs of the connected register machines
+			throw std::runtime_error("Filename: " + this->_filename + ". Not enough input values for arguments");
+
+		this->reset_registers();
+		for (size_t i{ 0 }; i < this->_input_values.size(); ++i)
+			*this->_input_values[i] = *previous._output_values[i];
+	}
+
+	// Returns the registers to their state after loading, the instructions are kept:
+	// registers created by the previous launch must not exist, a copy assignment reading them does nothing
+	void basic_register_machine::reset_registers() {
+		this->unwind_calls(); // A launch stopped inside a call leaves the registers of the top-level program in a frame
+
+		if (!this->_is_bound) { // The first launch after loading binds the values of the input and output registers
+			this->_registers.clear();
+			this->_input_values.clear();
+			this->_output_values.clear();
+			for (const auto& x : this->_output_registers)
+				this->_output_values.push_back(&this->_registers.try_emplace(x, 0).first->second);
+			for (const auto& x : this->_input_registers)
+				this->_input_values.push_back(&this->_registers.try_emplace(x, 0).first->second);
+			this->_initial_values.assign(this->_output_values.begin(), this->_output_values.end());
+			this->_initial_values.insert(this->_initial_values.end(), this->_input_values.begin(), this->_input_values.end());
+			std::sort(this->_initial_values.begin(), this->_initial_values.end());
+			this->_initial_values.erase(std::unique(this->_initial_values.begin(), this->_initial_values.end()), this->_initial_values.end());
+			this->_is_bound = true;
+		}
+		else if (this->_registers.size() != this->_initial_values.size()) { // Only the registers created by the launch are removed, the bound nodes stay
+			for (auto it = this->_registers.begin(); it != this->_registers.end(); ) {
+				if (std::binary_search(this->_initial_values.begin(), this->_initial_values.end(), &it->second))
+					++it;
+				else
+					it = this->_registers.erase(it);
+			}
+		}
+
+		for (auto* x : this->_output_values)
+			*x = 0;
+		this->_carriage = 0;
+		this->_steps = 0;
+		this->_is_stopped = false;
+		this->_error.clear();
+	}
+
+	// Returns from the active call: the output registers of the called program are written to the result registers
+	void basic_register_machine::return_from_call() {
+		auto& frame = this->_frames[this->_depth - 1];
+		const auto& results = frame.call->results();
+		const auto& slots = frame.call->output_slots();
+		for (size_t i{ 0 }; i < results.size(); ++i)
+			frame.registers[*results[i]] = *frame.slots[slots[i]];
+
+		std::swap(this->_registers, frame.registers);
+		std::swap(this->_instructions, frame.instructions);
+		this->_carriage = frame.return_carriage;
+		--this->_depth;
+		if (this->_profile != nullptr)
+			this->profile_return();
+	}
+
+	// Leaves all active calls without returning the results
+	void basic_register_machine::unwind_calls() noexcept {
+		for (; this->_depth != 0; --this->_depth) {
+			auto& frame = this->_frames[this->_depth - 1];
+			std::swap(this->_registers, frame.registers);
+			std::swap(this->_instructions, frame.instructions);
+		}
+	}
+
+	// Continues the launch for at most max_steps instructions and max_time, returns the state of the launch
+	execution_state basic_register_machine::resume(size_t max_steps, std::chrono::microseconds max_time) {
+		// The clock is read once per CLOCK_PERIOD instructions, so the time budget may be exceeded by that many instructions
+		constexpr size_t CLOCK_PERIOD{ 1024 };
+
+		if (!this->_error.empty())
+			return execution_state::error;
+		if (this->_is_stopped)
+			return execution_state::halted;
+
+		bool is_timed = max_time != std::chrono::microseconds::max();
+		auto deadline = is_timed ? std::chrono::steady_clock::now() + max_time : std::chrono::steady_clock::time_point::max();
+
+		// The slice is measured as a whole, the instructions executed before an error are counted too
+		scoped_timer timer(this->metrics().execute);
+		struct step_recorder {
+			basic_register_machine& brm;
+			size_t steps;
+			~step_recorder() { brm._metrics->steps.add(brm._steps - steps); }
+		} recorder{ *this, this->_steps };
+
+		// A published launch is sliced too, the monitor is checked between the slices
+		bool is_published = state_monitor::global().is_enabled();
+		try {
+			while (max_steps != 0) {
+				// The budget is counted down by slices, the clock is read only between them
+				auto slice = is_timed ? std::min(max_steps, CLOCK_PERIOD) : max_steps;
+				if (is_published)
+					slice = std::min(slice, PUBLISH_PERIOD);
+				max_steps -= slice;
+
+				if (this->_is_verified && !this->_is_verbose)
+					this->execute_verified_instructions(slice);
+				else {
+					profile_scope profile(*this);
+					for (; slice != 0 && !this->_is_stopped; --slice) {
+						if (this->_carriage >= this->_instructions.size())
+							throw std::runtime_error("Filename: " + this->_filename + ". The register machine is stuck in a loop");
+						if (this->_profile != nullptr)
+							this->_profile->move(this->_profile_file | this->_carriage);
+
+						auto* current_instruction = this->_instructions[this->_carriage];
+						if (current_instruction == nullptr) // The instruction of a lazily loaded program is reached for the first time
+							current_instruction = this->parse_instruction(this->_carriage);
+
+						if (this->_is_verbose) { // Print the current state of the register machine
+							this->println_all_registers();
+							std::cout << this->_carriage << ": " << current_instruction->description() << std::endl;
+						}
+
+						current_instruction->execute(*this);
+						++this->_steps;
+					}
+				}
+
+				if (is_published)
+					this->publish_state(this->_is_stopped);
+
+				if (this->_is_stopped)
+					return execution_state::halted;
+
+				if (is_timed && std::chrono::steady_clock::now() >= deadline)
+					break;
+			}
+		}
+		catch (const std::exception& e) {
+			this->_error = e.what();
+			if (is_published)
+				this->publish_state(true);
+			return execution_state::error;
+		}
+
+		return execution_state::running;
+	}
+
+	// Returns the values of the output registers
+	std::vector<int> basic_register_machine::results() const {
+		std::vector<int> results{};
+		if (this->_is_bound) {
+			for (const auto* x : this->_output_values)
+				results.push_back(*x);
+			return results;
+		}
+
+		for (const auto& x : this->_output_registers)
+			results.push_back(this->_registers.at(x));
+
+		return results;
+	}
+
+	// Returns the error message of the failed launch
+	const std::string& basic_register_machine::error() const noexcept {
+		return this->_error;
+	}
+
+	// Returns the number of instructions executed since the last launch
+	size_t basic_register_machine::steps() const noexcept {
+		return this->_steps;
+	}
+
+	// Returns the number of distinct registers
+	size_t basic_register_machine::registers() const noexcept {
+		return this->_registers.size();
+	}
+
+	// Returns the number of the next instruction
+	size_t basic_register_machine::carriage() const noexcept {
+		return this->_carriage;
+	}
+
+	// Returns the name of the program file
+	const std::string& basic_register_machine::filename() const noexcept {
+		return this->_filename;
+	}
+
+	// Returns the metrics of the program file
+	program_metrics& basic_register_machine::metrics() {
+		if (this->_metrics == nullptr)
+			this->_metrics = &metrics_registry::global().program(this->_filename);
+		return *this->_metrics;
+	}
+
+	// Drop settings of RM
+	void basic_register_machine::drop() {
+		this->_carriage = 0;
+		this->_steps = 0;
+		this->_is_verified = false;
+		this->_registers.clear();
+		this->_is_bound = false;
+		this->_frames.clear();
+		this->_depth = 0;
+		this->_instructions.clear();
+		this->release_code();
+		this->_output_registers.clear();
+		this->_input_registers.clear();
+		this->_filename = ""s;
+		this->_metrics = nullptr;
+		this->_is_stopped = false;
+		this->_is_verbose = false;
+	}
+
+	// Releases the loaded instructions: the storage is cleared in place unless other machines share it
+	void basic_register_machine::release_code() {
+		if (this->_code.use_count() == 1) { // The first block of the arena is kept for reuse
+			this->_code->arena.clear();
+			this->_code->names.clear();
+		}
+		else
+			this->_code = std::make_shared<code_storage>();
+		this->_retained.clear();
+		this->_text.reset();
+		this->_verification.reset();
 	}
 
 	// Print input registers separated by a separator without a new line
@@ -835,6 +1572,7 @@ namespace IMD {
 
 	// Load all instuctions
 	void basic_register_machine::load_all_instructions(std::pair<std::streampos, std::streampos> barier, std::ios_base::seekdir border) {
+		scoped_timer timer(this->metrics().parse);
 		std::ifstream ifs(this->_filename);
 		ifs.seekg(barier.first, border);
 		std::string line;
@@ -877,9 +1615,8 @@ namespace IMD {
 			try {
 				basic_lexer lexer(instruction);
 				auto tokens = lexer.tokenize();
-				basic_parser parser(tokens);
-				auto instruction_pointer = parser.make_instruction();
-				this->_instructions.push_back(std::move(instruction_pointer));
+				basic_parser parser(tokens, this->_code->arena, this->_code->names);
+				this->_instructions.push_back(parser.make_instruction());
 			}
 			catch (const std::exception& e) {
 				throw std::runtime_error("Filename: " + this->_filename + ". Invalid instruction at line " + std::to_string(expected_number) + ": " + e.what());
@@ -896,24 +1633,554 @@ namespace IMD {
 			if (!line.empty())
 				throw std::invalid_argument("Filename: " + this->_filename + ". There should be no extra entries after the output registers");
 		}
+
+		this->verify();
 	}
 
 	// Follow all instructions
 	void basic_register_machine::execute_all_instructions() {
+		scoped_timer timer(this->metrics().execute);
+		auto steps = this->_steps;
+		if (this->_is_verified && !this->_is_verbose) {
+			this->execute_verified_program();
+			this->_metrics->steps.add(this->_steps - steps);
+			return;
+		}
+
+		bool is_published = state_monitor::global().is_enabled();
+		profile_scope profile(*this);
 		while (!this->_is_stopped) {
+			if (is_published && this->_steps % PUBLISH_PERIOD == 0)
+				this->publish_state();
 
 			if (this->_carriage >= this->_instructions.size())
 				throw std::runtime_error("Filename: " + this->_filename + ". The register machine is stuck in a loop");
+			if (this->_profile != nullptr)
+				this->_profile->move(this->_profile_file | this->_carriage);
 
-			const auto& current_instruction = this->_instructions[this->_carriage];
+			auto* current_instruction = this->_instructions[this->_carriage];
+			if (current_instruction == nullptr) // The instruction of a lazily loaded program is reached for the first time
+				current_instruction = this->parse_instruction(this->_carriage);
 
 			if (this->_is_verbose) { // Print the current state of the register machine
 				this->println_all_registers();
-				std::cout << this->_carriage << ": " << this->_instructions[this->_carriage]->description() << std::endl;
+				std::cout << this->_carriage << ": " << current_instruction->description() << std::endl;
 			}
 
 			current_instruction->execute(*this);
+			++this->_steps;
+		}
+		if (is_published)
+			this->publish_state(true);
+		this->_metrics->steps.add(this->_steps - steps);
+	}
+
+	// Returns the instruction with the given number that is not parsed yet, throws if the program is not loaded lazily
+	basic_register_machine::instruction* basic_register_machine::parse_instruction(size_t number) {
+		throw std::runtime_error("Filename: " + this->_filename + ". The instruction " + std::to_string(number) + " is not loaded");
+	}
+
+	// Follow at most max_steps instructions of a verified program: no bounds checks of the carriage and no exception handling
+	// A sampled launch takes the loop publishing its position, the profiler is checked once per call
+	void basic_register_machine::execute_verified_instructions(size_t max_steps) {
+		if (sampling_profiler::global().is_enabled()) {
+			this->execute_profiled_instructions(max_steps);
+			return;
+		}
+
+		for (; max_steps != 0 && !this->_is_stopped; --max_steps) {
+			this->_instructions[this->_carriage]->execute_verified(*this);
+			++this->_steps;
+		}
+	}
+
+	// Follow at most max_steps instructions of a verified program publishing the position of every one into the sampling profiler
+	// The position is a single relaxed store per instruction, which costs as much as an ordinary one
+	void basic_register_machine::execute_profiled_instructions(size_t max_steps) {
+		profile_scope profile(*this);
+		for (; max_steps != 0 && !this->_is_stopped; --max_steps) {
+			this->_profile->move(this->_profile_file | this->_carriage);
+			this->_instructions[this->_carriage]->execute_verified(*this);
+			++this->_steps;
+		}
+	}
+
+	// Follow the instructions of a verified program to the stop instruction
+	// A published launch runs in slices of PUBLISH_PERIOD instructions: the monitor is checked between them only
+	void basic_register_machine::execute_verified_program() {
+		if (!state_monitor::global().is_enabled()) {
+			this->execute_verified_instructions();
+			return;
+		}
+
+		while (!this->_is_stopped) {
+			this->execute_verified_instructions(PUBLISH_PERIOD);
+			this->publish_state(this->_is_stopped);
+		}
+	}
+
+	// Publishes the state of the launch into the live state monitor: at most once per its period unless is_final
+	void basic_register_machine::publish_state(bool is_final) {
+		auto& monitor = state_monitor::global();
+		if (!is_final && !monitor.is_due())
+			return;
+
+		monitor_snapshot snapshot{};
+		snapshot.state = !this->_error.empty() ? monitored_state::error : this->_is_stopped ? monitored_state::halted : monitored_state::running;
+		snapshot.carriage = this->_carriage;
+		snapshot.steps = this->_steps;
+		snapshot.depth = this->_depth;
+		snapshot.registers = this->_registers.size();
+		snapshot.set_filename(this->_filename);
+		for (const auto& [name, value] : this->_registers)
+			if (!snapshot.add_register(name, value))
+				break;
+		monitor.publish(snapshot);
+	}
+
+	// Constructor: publishes the stack of the launch
+	basic_register_machine::profile_scope::profile_scope(basic_register_machine& brm) : _brm(brm) {
+		auto& profiler = sampling_profiler::global();
+		if (!profiler.is_enabled())
+			return;
+
+		this->_brm._profile = &profiler.slot();
+		this->_brm.publish_profile();
+	}
+
+	// Destructor: marks the thread as executing no launch
+	basic_register_machine::profile_scope::~profile_scope() {
+		if (this->_brm._profile == nullptr)
+			return;
+
+		this->_brm._profile->leave();
+		this->_brm._profile = nullptr;
+	}
+
+	// Returns the number of the program file in the sampling profiler
+	uint32_t basic_register_machine::profile_number() const {
+		auto number = this->_profile_number.load(std::memory_order_relaxed);
+		if (number == 0) {
+			number = sampling_profiler::global().intern(this->_filename);
+			this->_profile_number.store(number, std::memory_order_relaxed);
+		}
+		return number;
+	}
+
+	// Returns the number of frames published for the launch itself: the composition and the file, or the file only
+	size_t basic_register_machine::profile_base() const noexcept {
+		return this->_composition_number != 0 && this->_composition_number != this->_profile_number.load(std::memory_order_relaxed) ? 2 : 1;
+	}
+
+	// Publishes the stack of the launch into the sampling profiler: the composition, the file and the lines of the active calls
+	// A call contributes the line of the call instruction and the called file; the calls beyond the slot are left out,
+	// while the file of the running instruction is always the called one
+	void basic_register_machine::publish_profile() {
+		uint64_t frames[profile_slot::MAX_FRAMES];
+		size_t depth{ 0 };
+		auto file = this->profile_number();
+		if (this->profile_base() == 2)
+			frames[depth++] = profile_position::pack(this->_composition_number, profile_position::WHOLE_FILE);
+		frames[depth++] = profile_position::pack(file, profile_position::WHOLE_FILE);
+		for (size_t i{ 0 }; i < this->_depth && depth + 2 <= profile_slot::MAX_FRAMES; ++i) {
+			frames[depth++] = profile_position::pack(file, this->_frames[i].return_carriage - 1);
+			file = this->_frames[i].callee->profile_number();
+			frames[depth++] = profile_position::pack(file, profile_position::WHOLE_FILE);
+		}
+		if (this->_depth != 0)
+			file = this->_frames[this->_depth - 1].callee->profile_number();
+
+		this->_profile_file = profile_position::pack(file, 0);
+		this->_profile->enter(0, frames, depth, this->_profile_file | this->_carriage);
+	}
+
+	// Publishes the frames of the call just made: the line of the call and the called file
+	// Only the frames above the stack are written, a call beyond the slot publishes the position only
+	void basic_register_machine::profile_call() {
+		const auto& frame = this->_frames[this->_depth - 1];
+		auto caller = profile_position::file(this->_profile_file);
+		auto callee = frame.callee->profile_number();
+		this->_profile_file = profile_position::pack(callee, 0);
+
+		auto depth = this->profile_base() + 2 * (this->_depth - 1);
+		if (depth + 2 > profile_slot::MAX_FRAMES) {
+			this->_profile->move(this->_profile_file | this->_carriage);
+			return;
 		}
+		uint64_t frames[]{ profile_position::pack(caller, frame.return_carriage - 1), profile_position::pack(callee, profile_position::WHOLE_FILE) };
+		this->_profile->enter(depth, frames, 2, this->_profile_file | this->_carriage);
+	}
+
+	// Removes the frames of the call just returned from
+	void basic_register_machine::profile_return() {
+		auto file = this->_depth == 0 ? this->profile_number() : this->_frames[this->_depth - 1].callee->profile_number();
+		this->_profile_file = profile_position::pack(file, 0);
+
+		auto depth = this->profile_base() + 2 * this->_depth;
+		if (depth + 2 > profile_slot::MAX_FRAMES) {
+			this->_profile->move(this->_profile_file | this->_carriage);
+			return;
+		}
+		this->_profile->enter(depth, nullptr, 0, this->_profile_file | this->_carriage);
+	}
+
+	// Verifies the loaded program, throws with the number of the offending instruction
+	void basic_register_machine::verify() {
+		this->verify(nullptr, 0, 0);
+	}
+
+	// Verifies the program reusing the verification of its previous version, throws with the number of the offending instruction
+	void basic_register_machine::verify(const verification* previous, size_t first, size_t last) {
+		constexpr uint32_t NONE{ std::numeric_limits<uint32_t>::max() };
+		constexpr size_t BLOCK{ verification::BLOCK };
+		using flow = verification::flow;
+		using effect = verification::effect;
+
+		auto fail = [this](size_t number, const std::string& message) {
+			throw std::runtime_error("Filename: " + this->_filename + ". Verification failed at line " + std::to_string(number) + " (" + this->_instructions[number]->description() + "): " + message);
+		};
+		auto size = this->_instructions.size();
+		if (size >= NONE)
+			throw std::runtime_error("Filename: " + this->_filename + ". Verification failed: the program is too large");
+
+		// Registers are numbered by their names, the input and output registers exist from the start
+		// Instructions shared with a previous version refer to its name pool, so a pooled name missing from the cache is looked up by content
+		std::unordered_map<std::string_view, uint32_t> numbers{};
+		std::unordered_map<const std::string*, uint32_t> pooled{};
+		std::vector<std::string_view> names{};
+		auto number_of = [&numbers, &names](std::string_view name) {
+			auto [it, is_inserted] = numbers.try_emplace(name, static_cast<uint32_t>(numbers.size()));
+			if (is_inserted)
+				names.push_back(name);
+			return it->second;
+		};
+		// Programs use few distinct names, so the lookups mostly hit a small direct-mapped cache in front of the dictionaries
+		struct cached_number {
+			const std::string* name;
+			uint32_t number;
+		};
+		std::vector<cached_number> cache(256, { nullptr, 0 });
+		auto number = [&pooled, &number_of, &cache](const std::string& name) {
+			auto address = reinterpret_cast<uintptr_t>(&name);
+			auto& slot = cache[((address >> 4) ^ (address >> 12)) % cache.size()];
+			if (slot.name == &name)
+				return slot.number;
+
+			auto it = pooled.find(&name);
+			if (it == pooled.end())
+				it = pooled.emplace(&name, number_of(name)).first;
+			slot = { &name, it->second };
+			return it->second;
+		};
+		for (const auto& x : this->_input_registers)
+			number_of(x);
+		for (const auto& x : this->_output_registers)
+			number_of(x);
+		auto initial = numbers.size();
+
+		// The previous verification is reused if the registers existing from the start are the same: its numbering is extended,
+		// and the effects of the instructions outside the changed range are taken as they are
+		if (previous) {
+			bool is_reusable = previous->initial == initial && first <= last && last <= size && first <= previous->size && (last == size || previous->size == size);
+			for (size_t r{ 0 }; r < initial && is_reusable; ++r)
+				is_reusable = previous->names[r] == names[r];
+			if (!is_reusable)
+				previous = nullptr;
+		}
+		if (!previous) {
+			first = 0;
+			last = size;
+		}
+
+		// Effects of the instructions: the instructions are decoded once, the passes below work on the effects only
+		// A block of effects is copied from the previous version only if some of its instructions have changed
+		auto result = std::make_shared<verification>();
+		auto& blocks = result->effects;
+		auto& calls = result->calls;
+		result->size = size;
+		result->stops = 0;
+		blocks.resize((size + BLOCK - 1) / BLOCK);
+		std::vector<const effect*> view(blocks.size(), nullptr);
+		std::vector<effect*> own(blocks.size(), nullptr);
+		if (previous) {
+			for (size_t r{ initial }; r < previous->names.size(); ++r)
+				number_of(previous->names[r]);
+			for (size_t b{ 0 }; b < blocks.size() && b < previous->effects.size(); ++b)
+				if ((b + 1) * BLOCK <= first || (b * BLOCK >= last && last < size)) {
+					blocks[b] = previous->effects[b];
+					view[b] = blocks[b]->data();
+				}
+			calls = previous->calls;
+
+			// The stop instructions replaced by the changed ones are not counted
+			result->stops = previous->stops;
+			for (size_t i{ first }; i < (last < size ? last : previous->size); ++i)
+				result->stops -= (*previous->effects[i / BLOCK])[i % BLOCK].kind == flow::stop;
+		}
+		auto effect_of = [&view](size_t i) -> const effect& {
+			return view[i / BLOCK][i % BLOCK];
+		};
+		auto writable_effect_of = [&](size_t i) -> effect& {
+			auto b = i / BLOCK;
+			if (!own[b]) { // The last block holds only the remaining instructions
+				auto block = std::make_shared<std::vector<effect>>(std::min(BLOCK, size - b * BLOCK));
+				if (previous && b < previous->effects.size())
+					std::copy_n(previous->effects[b]->begin(), std::min(block->size(), previous->effects[b]->size()), block->begin());
+				own[b] = block->data();
+				view[b] = own[b];
+				blocks[b] = std::move(block);
+			}
+			return own[b][i % BLOCK];
+		};
+
+		// The instructions taken from the previous version have passed its checks, only a shorter program may leave their targets out of range
+		for (size_t i{ 0 }; previous && size < previous->size && i < first; ++i) {
+			const auto& e = (*previous->effects[i / BLOCK])[i % BLOCK];
+			for (auto target : e.next)
+				if (target != NONE && target >= size) {
+					if (e.kind == flow::next)
+						fail(i, "the last instruction must be stop or a jump");
+					fail(i, "the jump target " + std::to_string(target) + " is out of range");
+				}
+		}
+
+		// Jump targets and literals
+		for (size_t i{ first }; i < last; ++i) {
+			const auto* x = this->_instructions[i];
+			auto& e = writable_effect_of(i);
+			e = { { NONE, NONE }, { NONE, NONE }, { NONE, NONE }, flow::next, NONE };
+			size_t targets[2]{ i + 1, 0 };
+			size_t target_count{ 1 };
+
+			switch (x->kind()) {
+			case instruction_kind::stop:
+				++result->stops;
+				e.kind = flow::stop;
+				continue;
+			case instruction_kind::copy_assignment: {
+				auto copy = static_cast<const copy_assignment_instruction*>(x);
+				size_t k{ 0 };
+				for (const auto* operand : { &copy->left_operand(), &copy->right_operand() }) {
+					if (operand == &copy->right_operand() && copy->operation_type() == operation::none)
+						continue;
+					if (!is_non_negative_literal(*operand))
+						e.reads[k++] = number(*operand);
+					else if (!literal_value(*operand))
+						fail(i, "the literal " + *operand + " is out of the register range");
+				}
+				e.writes[0] = number(copy->target_register());
+				break;
+			}
+			case instruction_kind::move_assignment: { // Both registers are created by the move
+				auto move = static_cast<const move_assignment_instruction*>(x);
+				e.writes[0] = number(move->to_register());
+				e.writes[1] = number(move->from_register());
+				break;
+			}
+			case instruction_kind::condition:
+			case instruction_kind::extended_condition:
+			case instruction_kind::comparison: { // The compared registers are created by the condition
+				auto condition = static_cast<const condition_instruction*>(x);
+				e.kind = flow::jump;
+				targets[0] = condition->goto_true();
+				targets[1] = condition->goto_false();
+				target_count = 2;
+				e.writes[0] = number(condition->compared_register());
+				if (x->kind() == instruction_kind::comparison && !is_non_negative_literal(static_cast<const comparison_instruction*>(x)->compared_operand()))
+					e.writes[1] = number(static_cast<const comparison_instruction*>(x)->compared_operand());
+				break;
+			}
+			case instruction_kind::jump:
+				e.kind = flow::jump;
+				targets[0] = static_cast<const goto_instruction*>(x)->target_mark();
+				break;
+			case instruction_kind::call: { // The called program is verified on its own, the call reads its arguments and writes its results
+				auto call = static_cast<const call_instruction*>(x);
+				auto& registers = calls.emplace_back();
+				for (const auto* argument : call->arguments())
+					if (!is_non_negative_literal(*argument))
+						registers.reads.push_back(number(*argument));
+					else if (!literal_value(*argument))
+						fail(i, "the literal " + *argument + " is out of the register range");
+				for (const auto* result : call->results())
+					registers.writes.push_back(number(*result));
+				e.call = static_cast<uint32_t>(calls.size() - 1);
+				break;
+			}
+			default:
+				fail(i, "the instruction is not supported by the verifier");
+			}
+
+			for (size_t k{ 0 }; k < target_count; ++k) {
+				if (targets[k] >= size) {
+					if (e.kind == flow::next)
+						fail(i, "the last instruction must be stop or a jump");
+					fail(i, "the jump target " + std::to_string(targets[k]) + " is out of range");
+				}
+				e.next[k] = static_cast<uint32_t>(targets[k]);
+			}
+		}
+
+		for (size_t b{ 0 }; b < blocks.size(); ++b) // A block that has lost its changed instructions is copied as well
+			if (!view[b])
+				writable_effect_of(b * BLOCK);
+
+		if (result->stops == 0)
+			throw std::runtime_error("Filename: " + this->_filename + ". Verification failed: the program has no stop instruction");
+
+		// Checks the registers read by an instruction against the registers existing before it
+		std::vector<uint64_t> state{};
+		auto is_assigned = [&state](uint32_t r) {
+			return r / 64 < state.size() && (state[r / 64] >> (r % 64) & 1);
+		};
+		auto check_reads = [&](size_t i) {
+			const auto& e = effect_of(i);
+			for (auto r : e.reads)
+				if (r != NONE && !is_assigned(r))
+					fail(i, "the register " + std::string(names[r]) + " may be read before it is assigned");
+			if (e.call != NONE)
+				for (auto r : calls[e.call].reads)
+					if (!is_assigned(r))
+						fail(i, "the register " + std::string(names[r]) + " may be read before it is assigned");
+		};
+		// Adds the registers written by an instruction to the registers existing
+		auto apply_writes = [&](size_t i) {
+			const auto& e = effect_of(i);
+			for (auto r : e.writes)
+				if (r != NONE)
+					state[r / 64] |= uint64_t{ 1 } << (r % 64);
+			if (e.call != NONE)
+				for (auto r : calls[e.call].writes)
+					state[r / 64] |= uint64_t{ 1 } << (r % 64);
+		};
+
+		// The definite assignment of the previous version holds if the changed instructions keep the control flow and the writes
+		bool is_same_flow = previous && previous->assigned && size == previous->size;
+		for (size_t i{ first }; i < last && is_same_flow; ++i) {
+			const auto& a = effect_of(i);
+			const auto& b = (*previous->effects[i / BLOCK])[i % BLOCK];
+			is_same_flow = a.kind == b.kind && std::equal(std::begin(a.next), std::end(a.next), std::begin(b.next)) && std::equal(std::begin(a.writes), std::end(a.writes), std::begin(b.writes)) &&
+				(a.call == NONE) == (b.call == NONE) && (a.call == NONE || calls[a.call].writes == previous->calls[b.call].writes);
+		}
+		if (is_same_flow) { // Only the reads of the changed instructions are checked: their blocks are replayed from the kept sets
+			result->assigned = previous->assigned;
+			const auto& a = *result->assigned;
+
+			// The straight-line code leading to the first changed instruction is replayed from the beginning of its block
+			auto start = first;
+			while (start > 0 && a.leaders[start] == NONE && effect_of(start - 1).kind == flow::next)
+				--start;
+			bool is_live{ false };
+			for (size_t i{ start }; i < last; ++i) {
+				if (a.leaders[i] != NONE) {
+					is_live = a.is_reached[a.leaders[i]];
+					if (is_live)
+						state.assign(a.assigned.begin() + a.leaders[i] * a.words, a.assigned.begin() + (a.leaders[i] + 1) * a.words);
+				}
+				else if (i != start && effect_of(i - 1).kind != flow::next) // Code after a jump or a stop without a jump to it is unreachable
+					is_live = false;
+
+				if (!is_live)
+					continue;
+				if (i >= first)
+					check_reads(i);
+				apply_writes(i);
+			}
+		}
+		else {
+			// Definite assignment: the registers existing before an instruction are the intersection over the paths leading to it
+			// The sets are kept only for the first instruction and the jump targets, straight-line code between them is replayed
+			auto assignment = std::make_shared<verification::assignment>();
+			auto& leaders = assignment->leaders;
+			auto& assigned = assignment->assigned;
+			auto& is_reached = assignment->is_reached;
+			leaders.assign(size, NONE);
+			std::vector<uint32_t> first_of{ 0 };
+			leaders[0] = 0;
+			for (size_t i{ 0 }; i < size; ++i)
+				if (effect_of(i).kind == flow::jump)
+					for (auto target : effect_of(i).next)
+						if (target != NONE && leaders[target] == NONE) {
+							leaders[target] = static_cast<uint32_t>(first_of.size());
+							first_of.push_back(target);
+						}
+			auto count = first_of.size();
+
+			auto words = assignment->words = (numbers.size() + 63) / 64;
+			assigned.assign(count * words, 0);
+			is_reached.assign(count, false);
+			std::vector<size_t> worklist{ 0 };
+			for (size_t r{ 0 }; r < initial; ++r)
+				assigned[r / 64] |= uint64_t{ 1 } << (r % 64);
+			is_reached[0] = true;
+
+			// Joins the registers existing after a jump into the set of its target
+			state.resize(words);
+			auto join = [&](size_t target) {
+				auto leader = leaders[target];
+				auto* before = assigned.data() + leader * words;
+				bool is_changed{ !is_reached[leader] };
+				for (size_t w{ 0 }; w < words; ++w) {
+					auto joined = is_reached[leader] ? before[w] & state[w] : state[w];
+					is_changed |= joined != before[w];
+					before[w] = joined;
+				}
+				is_reached[leader] = true;
+				if (is_changed)
+					worklist.push_back(leader);
+			};
+			// Replays the straight-line code from a leader to the next jump, stop or leader; is_checking reports the registers read too early
+			bool is_stop_reached{ false };
+			auto replay = [&](size_t start, bool is_checking) {
+				std::copy(assigned.begin() + leaders[start] * words, assigned.begin() + (leaders[start] + 1) * words, state.begin());
+
+				for (size_t i{ start }; ; ++i) {
+					if (i != start && leaders[i] != NONE) {
+						join(i);
+						return;
+					}
+
+					const auto& e = effect_of(i);
+					if (e.kind == flow::stop) {
+						is_stop_reached = true;
+						return;
+					}
+
+					if (is_checking)
+						check_reads(i);
+					apply_writes(i);
+
+					if (e.kind == flow::jump) {
+						for (auto target : e.next)
+							if (target != NONE)
+								join(target);
+						return;
+					}
+				}
+			};
+
+			while (!worklist.empty()) {
+				auto leader = worklist.back();
+				worklist.pop_back();
+				replay(first_of[leader], false);
+			}
+
+			worklist.clear();
+			for (size_t leader{ 0 }; leader < count; ++leader) // The sets are final: the reads are checked on the reachable code
+				if (is_reached[leader]) {
+					replay(first_of[leader], true);
+					worklist.clear();
+				}
+
+			if (!is_stop_reached)
+				throw std::runtime_error("Filename: " + this->_filename + ". Verification failed: no stop instruction is reachable from line 0");
+			result->assigned = std::move(assignment);
+		}
+
+		result->names.assign(names.begin(), names.end());
+		result->initial = initial;
+		this->_verification = std::move(result);
+		this->_is_verified = true;
 	}
 
 	// Parsing input registers
@@ -952,7 +2219,7 @@ namespace IMD {
 	// Implementation of an extended register machine
 
 	// Constructor
-	extended_register_machine::extended_register_machine(const std::string& filename, bool is_verbose) noexcept : basic_register_machine(filename, is_verbose), _file_stack() {}
+	extended_register_machine::extended_register_machine(const std::string& filename, bool is_verbose, bool is_lazy) noexcept : basic_register_machine(filename, is_verbose), _is_lazy(is_lazy), _source(), _offsets(), _subroutines() {}
 
 	// Launch of RM
 	void extended_register_machine::run() {
@@ -960,95 +2227,330 @@ namespace IMD {
 			throw std::runtime_error("You need to reboot the register machine");
 			return;
 		}
-		
-		
-		this->_include_files(_filename); // Processing all instructions of the composition from the source file
 
-		while (!this->_file_stack.empty()) { // Traverse all included files
-			auto [file, barier] = this->_file_stack.top(); // Retrieve the top-level file and the current reading position
-			this->_file_stack.pop();
+		// Every stage is loaded into its own machine once, the input registers of a stage take the output registers of the previous one
+		auto stages = this->load_stages();
+		for (size_t i{ 0 }; i < stages.size(); ++i) { // Traverse all composition stages
+			auto& stage = *stages[i];
+
+			if (i == 0) { // Prompt the user to enter values for the input registers of the first stage
+				std::vector<int> arguments{};
+				for (const auto& x : stage._input_registers) {
+					std::cout << "Введите значения для " << x << ": ";
+					arguments.push_back(0);
+					std::cin >> arguments.back();
+				}
+				stage.start(arguments);
+			}
+			else
+				stage.start(*stages[i - 1]);
 
-			if (barier.first == std::nullopt && barier.second == std::nullopt) // Processing all instructions of the composition from the top-level file
-				this->_include_files(file);
-			else {
-				std::vector<int> results{}; // Vector of intermediate results
+			if (stage._is_verbose)
+				std::cout << stage._filename << std::endl;
 
-				for (const auto& x : this->_output_registers)
-					results.push_back(this->_registers[x]);
-				auto is_verbose = this->_is_verbose;
+			stage.execute_all_instructions(); // Executing the instructions of the stage
+		}
+		if (!stages.empty()) // After executing all files, display the values of the output registers
+			stages.back()->println_output_registers(" ");
+		this->_is_stopped = true;
+	}
+	// Returns the composition stages in the order of their execution
+	std::vector<extended_register_machine::stage> extended_register_machine::resolve_stages() {
+		scoped_timer timer(this->metrics().include);
+
+		// The graph is discovered level by level: the files of a level are scanned in parallel,
+		// the files they call and that are not known yet form the next level. The nodes are keyed by canonical names
+		std::unordered_map<std::string, composition_node> nodes{};
+		std::vector<std::pair<std::string, std::string>> level{ { canonical_name(this->_filename), this->_filename } };
+		nodes.emplace(level.front().first, composition_node{});
+		while (!level.empty()) {
+			std::vector<composition_node> scanned(level.size());
+			parallel_for(level.size(), [&level, &scanned](size_t i) { scanned[i] = scan_composition(level[i].second); });
+
+			std::vector<std::pair<std::string, std::string>> next{};
+			for (size_t i{ 0 }; i < level.size(); ++i) {
+				auto& node = nodes[level[i].first] = std::move(scanned[i]);
+				for (auto* calls : { &node.header, &node.footer })
+					for (auto& file : *calls) { // The called file is replaced by the key of its node
+						auto path = called_path(node.filename, file);
+						file = canonical_name(path);
+						if (nodes.try_emplace(file).second)
+							next.emplace_back(file, path);
+					}
+			}
+			level = std::move(next);
+		}
 
-				// Updating the register machine state before a new run
-				this->drop();
-				this->_filename = file;
-				this->_is_verbose = is_verbose;
-				this->load_all_instructions({barier.first.value(), barier.second.value()});
+		// The stages are the files with instructions in the order of execution: the header calls, the instructions, the footer calls from the last one
+		std::vector<stage> stages{};
+		std::vector<std::string> path{};
+		auto expand = [this, &nodes, &stages, &path](auto& self, const std::string& key) -> void {
+			if (auto it = std::find(path.begin(), path.end(), key); it != path.end()) {
+				std::string cycle{};
+				for (; it != path.end(); ++it)
+					cycle += nodes.at(*it).filename + " -> ";
+				throw std::runtime_error("Filename: " + this->_filename + ". The composition is cyclic: " + cycle + nodes.at(key).filename);
+			}
 
-				if (!results.empty()) { // If there are intermediate results, pass them into the input registers
+			path.push_back(key);
+			const auto& node = nodes.at(key);
+			for (const auto& x : node.header)
+				self(self, x);
+			if (node.has_body)
+				stages.push_back({ node.filename, node.begin, node.end });
+			for (auto it = node.footer.rbegin(); it != node.footer.rend(); ++it)
+				self(self, *it);
+			path.pop_back();
+		};
+		expand(expand, level.empty() ? canonical_name(this->_filename) : level.front().first);
 
-					if (results.size() < this->_input_registers.size()) // Check the correspondence between the number of inputs and outputs of the connected register machines
-						throw std::runtime_error("Filename: " + this->_filename + ". Not enough input values for arguments");
+		return stages;
+	}
 
-					size_t index{ 0 };
-					for (const auto& x : this->_input_registers) {
-						this->_registers[x] = results[index];
-						++index;
-					}
-				}
-				else { // If there are no intermediate results (first run), prompt the user to enter values for the input registers
-					for (const auto& x : this->_input_registers) {
-						std::cout << "Введите значения для " << x << ": ";
-						std::cin >> this->_registers[x];
-					}
-				}
+	// Loads every composition stage into its own register machine
+	std::vector<std::unique_ptr<extended_register_machine>> extended_register_machine::load_stages() {
+		auto stages = this->resolve_stages();
+		auto first = first_occurrences(stages);
+		std::vector<std::unique_ptr<extended_register_machine>> machines(stages.size());
+
+		parallel_for(stages.size(), [this, &stages, &first, &machines](size_t i) {
+			if (first[i] != i)
+				return;
+			auto machine = std::make_unique<extended_register_machine>(stages[i].filename, this->_is_verbose, this->_is_lazy);
+			machine->load_all_instructions({ stages[i].begin, stages[i].end });
+			machines[i] = std::move(machine);
+		});
+		for (size_t i{ 0 }; i < stages.size(); ++i)
+			if (first[i] != i)
+				machines[i] = machines[first[i]]->clone();
+		this->mark_composition(machines);
+
+		return machines;
+	}
 
-				if (this->_is_verbose)
-					std::cout << this->_filename << std::endl;
+	// Returns a machine executing the same loaded program: the instructions are shared, the registers are not
+	std::unique_ptr<extended_register_machine> extended_register_machine::clone() const {
+		auto machine = std::make_unique<extended_register_machine>(this->_filename, this->_is_verbose, this->_is_lazy);
+		machine->_code = this->_code;
+		machine->_retained = this->_retained;
+		if (this->_is_lazy) { // The clone parses the instructions reached later into its own storage
+			machine->_code = std::make_shared<code_storage>();
+			machine->_retained.push_back(this->_code);
+		}
+		machine->_source = this->_source;
+		machine->_offsets = this->_offsets;
+		machine->_subroutines = this->_subroutines;
+		machine->_instructions = this->_instructions;
+		machine->_text = this->_text;
+		machine->_verification = this->_verification;
+		machine->_input_registers = this->_input_registers;
+		machine->_output_registers = this->_output_registers;
+		for (const auto& x : this->_input_registers)
+			machine->_registers.try_emplace(x, 0);
+		for (const auto& x : this->_output_registers)
+			machine->_registers.try_emplace(x, 0);
+		machine->_is_verified = this->_is_verified;
+		return machine;
+	}
 
-				this->execute_all_instructions(); // Executing the instructions of the top-level file
+	// Loads a new version of the loaded stage from the given position range of its file
+	std::unique_ptr<extended_register_machine> extended_register_machine::reload(std::pair<std::streampos, std::streampos> barier) const {
+		auto machine = std::make_unique<extended_register_machine>(this->_filename, this->_is_verbose, this->_is_lazy);
+		machine->load_instructions(barier, std::ios::beg, this->_retained.size() < MAX_RETAINED ? this : nullptr);
+		machine->link_subroutines();
+		return machine;
+	}
+
+	// Loads the composition stages again: a stage loaded before from the same file is reloaded from its previous machine
+	std::vector<std::unique_ptr<extended_register_machine>> extended_register_machine::reload_stages(const std::vector<std::unique_ptr<extended_register_machine>>& previous) {
+		auto stages = this->resolve_stages();
+		auto first = first_occurrences(stages);
+		std::vector<std::unique_ptr<extended_register_machine>> machines(stages.size());
+
+		parallel_for(stages.size(), [this, &stages, &first, &machines, &previous](size_t i) {
+			if (first[i] != i)
+				return;
+			const auto& [file, begin, end] = stages[i];
+			auto it = std::find_if(previous.begin(), previous.end(), [&file = file](const auto& machine) { return machine->_filename == file; });
+			if (it != previous.end())
+				machines[i] = (*it)->reload({ begin, end });
+			else {
+				auto machine = std::make_unique<extended_register_machine>(file, this->_is_verbose, this->_is_lazy);
+				machine->load_all_instructions({ begin, end });
+				machines[i] = std::move(machine);
 			}
-		}
-		this->println_output_registers(" "); // After executing all files, display the values of the output registers
+		});
+		for (size_t i{ 0 }; i < stages.size(); ++i)
+			if (first[i] != i)
+				machines[i] = machines[first[i]]->clone();
+		this->mark_composition(machines);
+
+		return machines;
 	}
-	// Reboot RM
-	void extended_register_machine::reboot() {
-		basic_register_machine::reboot();
-		while (!this->_file_stack.empty())
-			this->_file_stack.pop();
-		
+
+	// Numbers the stages with the composition file in the sampling profiler, so that their samples are stacked under it
+	void extended_register_machine::mark_composition(std::vector<std::unique_ptr<extended_register_machine>>& stages) const {
+		auto& profiler = sampling_profiler::global();
+		if (!profiler.is_enabled())
+			return;
+
+		auto number = profiler.intern(this->_filename);
+		for (auto& x : stages)
+			x->_composition_number = number;
 	}
 
 	// Load all instructions
 	void extended_register_machine::load_all_instructions(std::pair<std::streampos, std::streampos> barier, std::ios_base::seekdir border) {
-		std::ifstream ifs(this->_filename);
+		this->load_instructions(barier, border, nullptr);
+		this->link_subroutines();
+	}
+
+	// Loads the instructions, the lines equal to those of the previous version take its instructions
+	void extended_register_machine::load_instructions(std::pair<std::streampos, std::streampos> barier, std::ios_base::seekdir border, const extended_register_machine* previous) {
+		scoped_timer timer(this->metrics().parse);
+		std::ifstream ifs(this->_filename, std::ios::binary);
 
 		if (!ifs)
 			throw std::runtime_error("Filename: " + this->_filename + ". Error processing file");
 
+		// The stage is read at once: up to the first composition line of the footer, or to the end of the file without a footer
+		ifs.seekg(0, std::ios::end);
+		std::streamoff file_size = ifs.tellg();
 		ifs.seekg(barier.first, border);
-		std::string line;
+		std::streamoff begin = ifs.tellg();
+		std::streamoff end = barier.second > barier.first ? std::min<std::streamoff>(barier.second, file_size) : file_size;
+		auto source = std::make_shared<std::string>(static_cast<size_t>(std::max<std::streamoff>(end - begin, 0)), '\0');
+		auto& buffer = *source;
+		ifs.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		buffer.resize(static_cast<size_t>(ifs.gcount()));
+		if (this->_is_lazy && buffer.size() > std::numeric_limits<uint32_t>::max())
+			throw std::runtime_error("Filename: " + this->_filename + ". The stage is too large to be loaded lazily");
+
+		// Returns the next line without the comment and the surrounding whitespace, std::nullopt at the end of the stage
+		size_t position{ 0 };
+		auto next_line = [&buffer, &position]() -> std::optional<std::string_view> {
+			if (position >= buffer.size())
+				return std::nullopt;
+			auto line_end = buffer.find('\n', position);
+			if (line_end == std::string::npos)
+				line_end = buffer.size();
+			std::string_view line(buffer.data() + position, line_end - position);
+			position = line_end + 1;
+			return strip(line);
+		};
 
-		while (std::getline(ifs, line)) { // Skipping blank lines between composition instructions and input registers
-			remove_comment(line);
-			if (!line.empty()) break;
-		}
+		std::optional<std::string_view> line{};
+		while ((line = next_line())) // Skipping blank lines between composition instructions and input registers
+			if (!line->empty()) break;
 
-		this->parse_input_registers(line); // Processing input registers
+		this->parse_input_registers(std::string(line.value_or(std::string_view{}))); // Processing input registers
 
 		// Processing all instuctions
+		const std::string separator{ SEPARATOR };
+		auto text = std::make_shared<loaded_text>();
+		std::vector<uint32_t> offsets{};
+		if (this->_is_lazy || (previous && !previous->_text))
+			previous = nullptr;
+		if (previous) {
+			text->lines.reserve(previous->_text->lines.size());
+			this->_instructions.reserve(previous->_instructions.size());
+		}
+
+		// Returns the line with the given position in the text without the comment and the surrounding whitespace
+		auto line_at = [](const std::string& text, size_t begin) {
+			auto end = text.find('\n', begin);
+			if (end == std::string::npos)
+				end = text.size();
+			return strip(std::string_view(text.data() + begin, end - begin));
+		};
+		// Parses the instruction with the given number
+		auto parse = [this](size_t number, std::string_view instruction) {
+			try {
+				extended_lexer lexer(instruction);
+				auto tokens = lexer.tokenize();
+				extended_parser parser(tokens, this->_code->arena, this->_code->names);
+				auto instr_ptr = parser.make_instruction();
+				if (dynamic_cast<basic_register_machine::composition_instruction*>(instr_ptr) != NULL)
+					throw std::runtime_error("CALL CALL CALL CALL");
+				return instr_ptr;
+			}
+			catch (const std::exception& e) {
+				throw std::runtime_error("Filename: " + this->_filename + ". Invalid instruction at line " + std::to_string(number) + ": " + e.what());
+			}
+		};
+
+		// The instruction lines lying entirely in the text common with the previous version at its beginning and at its end
+		// are taken at once; the lines between them are compared with the lines of the same numbers one by one
+		size_t shared_front{ 0 };
+		size_t shared_back{ 0 };
+		if (previous) {
+			const auto& old = *previous->_text;
+			auto prefix = common_prefix(buffer, old.text);
+			auto suffix = common_suffix(buffer, old.text, std::min(buffer.size(), old.text.size()) - prefix);
+			// A line is common if the next one starts in the common beginning, or if the newline before it lies in the common end
+			shared_front = std::partition_point(old.lines.begin(), old.lines.end(), [prefix](size_t x) { return x <= prefix; }) - old.lines.begin();
+			shared_front -= shared_front > 0;
+			shared_back = std::partition_point(old.lines.begin(), old.lines.end(), [&old, suffix](size_t x) { return x <= old.text.size() - suffix; }) - old.lines.begin();
+		}
+
+		bool is_shared{ false };
 		size_t expected_number{ 0 }; // Instructions must be numbered sequentially
-		while (std::getline(ifs, line)) {
-			remove_comment(line);
-			if (line.empty()) continue;
+		size_t changed_end{ std::numeric_limits<size_t>::max() }; // Number of the first instruction of the common end
+		// Takes the instructions [from, to) of the previous version, the first of them starts at the given position of the text
+		auto take = [&](size_t from, size_t to, size_t at) {
+			const auto& old = *previous->_text;
+			this->_instructions.insert(this->_instructions.end(), previous->_instructions.begin() + from, previous->_instructions.begin() + to);
+			auto shift = at - old.lines[from];
+			std::transform(old.lines.begin() + from, old.lines.begin() + to, std::back_inserter(text->lines), [shift](size_t x) { return x + shift; });
+
+			// A call instruction is parsed anew, since it is bound to the called program of its own version
+			for (auto it = std::lower_bound(old.calls.begin(), old.calls.end(), from); it != old.calls.end() && *it < to; ++it) {
+				auto call = line_at(buffer, text->lines[*it]);
+				this->_instructions[*it] = parse(*it, strip(call.substr(call.find(separator) + separator.length())));
+				text->calls.push_back(*it);
+			}
 
-			auto separator_position = line.find(SEPARATOR);
-			if (separator_position == std::string::npos)
+			is_shared = true;
+			expected_number = to;
+			if (to < old.lines.size())
+				position = old.lines[to] + shift;
+			else { // The loading continues after the last instruction line
+				position = buffer.find('\n', text->lines.back());
+				position = position == std::string::npos ? buffer.size() : position + 1;
+			}
+		};
+
+		while (true) {
+			if (previous && expected_number == 0 && shared_front > 0)
+				take(0, shared_front, previous->_text->lines[0]);
+			else if (previous && expected_number == shared_back && shared_back < previous->_text->lines.size() &&
+				position == previous->_text->lines[shared_back] + buffer.size() - previous->_text->text.size()) {
+				changed_end = shared_back;
+				take(shared_back, previous->_text->lines.size(), position);
+			}
+
+			auto line_begin = position;
+			if (!(line = next_line()))
 				break;
+			if (line->empty()) continue;
+
+			// A line equal to the line with the same number in the previous version yields the same instruction
+			if (previous && expected_number < previous->_text->lines.size() && line_at(previous->_text->text, previous->_text->lines[expected_number]) == *line &&
+				!std::binary_search(previous->_text->calls.begin(), previous->_text->calls.end(), expected_number)) {
+				this->_instructions.push_back(previous->_instructions[expected_number]);
+				text->lines.push_back(line_begin);
+				is_shared = true;
+				++expected_number;
+				continue;
+			}
 
-			std::string number = line.substr(0, separator_position);
-			std::string instruction = line.substr(separator_position + SEPARATOR.length());
+			auto separator_position = line->find(separator);
+			if (separator_position == std::string_view::npos)
+				break;
+			text->lines.push_back(line_begin);
 
-			trim(instruction);
-			trim(number);
+			auto number = strip(line->substr(0, separator_position));
+			auto instruction = strip(line->substr(separator_position + separator.length()));
 
 			if (number.empty())
 				throw std::invalid_argument("Filename: " + this->_filename + ". Expected an instruction with the number " + std::to_string(expected_number));
@@ -1056,64 +2558,202 @@ namespace IMD {
 			if (!is_non_negative_literal(number))
 				throw std::invalid_argument("Filename: " + this->_filename + ". The instruction must be numbered with a non-negative integer");
 
-			if (std::stoi(number) != expected_number)
+			size_t value{ 0 };
+			if (auto [end, error] = std::from_chars(number.data(), number.data() + number.size(), value); error != std::errc{} || value != expected_number)
 				throw std::invalid_argument("Filename: " + this->_filename + ". Instructions must be numbered sequentially");
 
-			try {
-				extended_lexer lexer(instruction);
-				auto tokens = lexer.tokenize();
-				extended_parser parser(tokens);
-				auto instr_ptr = parser.make_instruction();
-				if (dynamic_cast<basic_register_machine::composition_instruction*>(instr_ptr.get()) != NULL)
-					throw std::runtime_error("CALL CALL CALL CALL");
-
-				this->_instructions.push_back(std::move(instr_ptr));
-			}
-			catch (const std::exception& e) {
-				throw std::runtime_error("Filename: " + this->_filename + ". Invalid instruction at line " + std::to_string(expected_number) + ": " + e.what());
+			// The instruction is parsed when the carriage reaches it for the first time; calls are parsed now to be linked before the launches
+			if (this->_is_lazy) {
+				offsets.push_back(static_cast<uint32_t>(instruction.data() - buffer.data()));
+				if (instruction.substr(0, COMPOSITION.size()) != COMPOSITION) {
+					this->_instructions.push_back(nullptr);
+					++expected_number;
+					continue;
+				}
 			}
 
+			auto instr_ptr = parse(expected_number, instruction);
+			if (instr_ptr->kind() == instruction_kind::call)
+				text->calls.push_back(expected_number);
+			this->_instructions.push_back(instr_ptr);
+
 			++expected_number;
 		}
 
 		// Processing output registers
-		this->parse_output_registers(line);
+		this->parse_output_registers(std::string(line.value_or(std::string_view{})));
 
 		// There should be no extra entries after the output registers
-		while (ifs.tellg() < barier.second && std::getline(ifs, line)) {
-			remove_comment(line);
-			if (!line.empty())
+		while ((line = next_line()))
+			if (!line->empty() && barier.second > barier.first)
 				throw std::invalid_argument("Filename: " + this->_filename + ". There should be no extra entries after the output registers");
+
+		if (is_shared) { // The instructions taken from the previous version keep its storages alive
+			this->_retained = previous->_retained;
+			this->_retained.push_back(previous->_code);
+		}
+		if (this->_is_lazy) { // The text of the stage is kept for the instructions that are not parsed yet
+			this->_source = std::move(source);
+			this->_offsets = std::make_shared<const std::vector<uint32_t>>(std::move(offsets));
+			return;
+		}
+		text->text = std::move(buffer);
+		this->_text = std::move(text);
+
+		// Only the instructions between the common beginning and the common end are verified anew
+		if (previous)
+			this->verify(previous->_verification.get(), shared_front, std::min(changed_end, this->_instructions.size()));
+		else
+			this->verify();
+	}
+
+	// Parses the instruction with the given number from the kept text of the stage
+	basic_register_machine::instruction* extended_register_machine::parse_instruction(size_t number) {
+		if (!this->_source || !this->_offsets || number >= this->_offsets->size())
+			return basic_register_machine::parse_instruction(number);
+
+		const auto& source = *this->_source;
+		size_t begin = (*this->_offsets)[number];
+		auto line_end = source.find('\n', begin);
+		if (line_end == std::string::npos)
+			line_end = source.size();
+		auto instruction = strip(std::string_view(source.data() + begin, line_end - begin));
+
+		try {
+			extended_lexer lexer(instruction);
+			auto tokens = lexer.tokenize();
+			extended_parser parser(tokens, this->_code->arena, this->_code->names);
+			auto instr_ptr = parser.make_instruction();
+			if (dynamic_cast<basic_register_machine::composition_instruction*>(instr_ptr) != NULL)
+				throw std::runtime_error("CALL CALL CALL CALL");
+
+			this->_instructions[number] = instr_ptr;
+			return instr_ptr;
+		}
+		catch (const std::exception& e) {
+			throw std::runtime_error("Filename: " + this->_filename + ". Invalid instruction at line " + std::to_string(number) + ": " + e.what());
+		}
+	}
+
+	// Loads the called programs and binds the call instructions to them
+	void extended_register_machine::link_subroutines() {
+		auto table = std::make_shared<subroutine_table>();
+		this->link(*table);
+		if (table->empty())
+			return;
+
+		for (const auto& [file, callee] : *table)
+			if (!callee->_is_verified)
+				this->_is_verified = false;
+		this->_subroutines = std::move(table);
+	}
+
+	// Binds the call instructions to the programs of the table, the missing ones are loaded into it first
+	void extended_register_machine::link(subroutine_table& table) {
+		auto link_call = [this, &table](size_t i) {
+			// The called file is taken relative to the directory of the calling file
+			auto* call = static_cast<call_instruction*>(this->_instructions[i]);
+			auto path = called_path(this->_filename, call->filename());
+			auto key = canonical_name(path);
+			auto it = table.find(key);
+			if (it == table.end()) { // The called program is loaded eagerly and must consist of a single stage
+				auto callee = std::make_unique<extended_register_machine>(path, this->_is_verbose);
+				auto stages = callee->resolve_stages();
+				if (stages.size() > 1)
+					throw std::runtime_error("Filename: " + this->_filename + ". The called program " + path + " must not be a composition");
+
+				it = table.emplace(key, std::move(callee)).first;
+				auto& machine = *it->second;
+				if (stages.empty()) // A missing file is reported by the loading
+					machine.load_instructions({ 0, 0 }, std::ios::beg, nullptr);
+				else
+					machine.load_instructions({ stages[0].begin, stages[0].end }, std::ios::beg, nullptr);
+				machine.link(table);
+			}
+
+			try {
+				call->bind(*it->second);
+			}
+			catch (const std::exception& e) {
+				throw std::runtime_error("Filename: " + this->_filename + ". Invalid instruction at line " + std::to_string(i) + ": " + e.what());
+			}
+		};
+
+		// The numbers of the call instructions are kept with the text of the stage, the instructions of a lazily loaded one are scanned
+		if (this->_text) {
+			for (auto i : this->_text->calls)
+				link_call(i);
+			return;
 		}
+		for (size_t i{ 0 }; i < this->_instructions.size(); ++i)
+			if (this->_instructions[i] != nullptr && this->_instructions[i]->kind() == instruction_kind::call)
+				link_call(i);
 	}
 
 	// Follow all instuctions
 	void extended_register_machine::execute_all_instructions() {
+		scoped_timer timer(this->metrics().execute);
+		auto steps = this->_steps;
+		if (this->_is_verified && !this->_is_verbose) {
+			this->execute_verified_program();
+			this->_metrics->steps.add(this->_steps - steps);
+			return;
+		}
 
+		bool is_published = state_monitor::global().is_enabled();
+		profile_scope profile(*this);
 		while (!this->_is_stopped) {
-			const auto& current_instruction = this->_instructions[this->_carriage];
+			if (is_published && this->_steps % PUBLISH_PERIOD == 0)
+				this->publish_state();
 
 			if (this->_carriage >= this->_instructions.size())
 				throw std::runtime_error("Filename: " + this->_filename + ". The register machine is stuck in a loop");
+			if (this->_profile != nullptr)
+				this->_profile->move(this->_profile_file | this->_carriage);
+
+			auto* current_instruction = this->_instructions[this->_carriage];
+			if (current_instruction == nullptr) // The instruction of a lazily loaded program is reached for the first time
+				current_instruction = this->parse_instruction(this->_carriage);
 
 			if (this->_is_verbose) { // Print the current state of the register machine
 				this->println_all_registers(" ");
-				std::cout << this->_carriage << ": " << this->_instructions[this->_carriage]->description() << std::endl;
+				std::cout << this->_carriage << ": " << current_instruction->description() << std::endl;
 			}
 
-			this->_instructions[this->_carriage]->execute(*this);
+			current_instruction->execute(*this);
+			++this->_steps;
 		}
+		if (is_published)
+			this->publish_state(true);
+		this->_metrics->steps.add(this->_steps - steps);
 	}
 
-	// Process all composition insturctions in the given file and add the included files to the stack
-	void extended_register_machine::_include_files(const std::string& filename) {
+	// Reads the composition lines of the file: the lines before its instructions and the lines after them
+	extended_register_machine::composition_node extended_register_machine::scan_composition(const std::string& filename) {
 		std::ifstream input_file(filename, std::ios::binary);
 		if (!input_file)
-			return;
+			throw std::runtime_error("Filename: " + filename + ". Error processing file");
 
-		std::vector<std::unique_ptr<basic_register_machine::instruction>> composition_instructions{};
+		// The composition lines are parsed only to take the called files, they do not belong to the loaded program
+		instruction_arena arena{};
+		name_pool names{};
+		// Returns the file called by a composition line, std::nullopt for any other line
+		auto called_file = [&arena, &names](const std::string& line) -> std::optional<std::string> {
+			try {
+				extended_lexer lexer(line);
+				auto tokens = lexer.tokenize();
+				extended_parser parser(tokens, arena, names);
+				auto instr_ptr = parser.make_instruction();
+				if (instr_ptr == NULL || instr_ptr->kind() != instruction_kind::composition)
+					return std::nullopt;
+				return static_cast<composition_instruction*>(instr_ptr)->include_filename();
+			}
+			catch (...) {
+				return std::nullopt;
+			}
+		};
 
-		bool composition_block_ended {false};
+		composition_node node{ filename, {}, {}, false, 0, 0 };
 
 		// Determining the file size
 		input_file.seekg(0, std::ios::end);
@@ -1122,12 +2762,11 @@ namespace IMD {
 		// Buffer for accumulating characters of the line that we read from the end of the file
 		std::string reversed_line_buffer;
 		std::streamoff read_position{ file_size }; // Current reading position pointer
-		std::streampos end;
 		// Reading a file from the end
-		// We go through the file in blocks by READ_BUFFER_SIZE, moving backwards
-		while (read_position > 0 && !composition_block_ended) {
-			// We determine the size of the current block (if there is a piece smaller than READ_BUFFER_SIZE left, we read it entirely)
-			size_t current_chunk_size = (read_position >= BUFFER_SIZE) ? BUFFER_SIZE : static_cast<size_t>(read_position);
+		// We go through the file in blocks by BUFFER_SIZE, moving backwards, until a line that is not a composition line
+		while (read_position > 0 && !node.has_body) {
+			// We determine the size of the current block (if there is a piece smaller than BUFFER_SIZE left, we read it entirely)
+			size_t current_chunk_size = (read_position >= static_cast<std::streamoff>(BUFFER_SIZE)) ? BUFFER_SIZE : static_cast<size_t>(read_position);
 			read_position -= current_chunk_size;
 			input_file.seekg(read_position);
 
@@ -1136,93 +2775,340 @@ namespace IMD {
 			input_file.read(read_buffer.data(), current_chunk_size);
 
 			// We go through the block from the end to the beginning (since we read the file from the end)
-			for (int i = static_cast<long>(current_chunk_size) - 1; i >= 0; --i) {
+			for (auto i = static_cast<std::streamoff>(current_chunk_size) - 1; i >= 0 && !node.has_body; --i) {
 				char ch = read_buffer[i];
-				if (ch == '\n') {
-					// End of line encountered - reverse the accumulated buffer, since the characters were added in reverse order
-					std::streampos line_start_pos = read_position + i + 1;
-					std::reverse(reversed_line_buffer.begin(), reversed_line_buffer.end());
-					remove_comment(reversed_line_buffer);
-					if (reversed_line_buffer.empty()) continue;
-					try {
-						extended_lexer lexer(reversed_line_buffer);
-						auto tokens = lexer.tokenize();
-						extended_parser parser(tokens);
-						auto instr_ptr = parser.make_instruction();
-						if (instr_ptr == NULL)
-							break;
-
-						composition_instructions.push_back(std::move(instr_ptr));
+				if (ch != '\n') {
+					reversed_line_buffer.push_back(ch);
+					continue;
+				}
 
-						if (!composition_block_ended && end == 0)
-							end = line_start_pos;
+				// End of line encountered - reverse the accumulated buffer, since the characters were added in reverse order
+				std::reverse(reversed_line_buffer.begin(), reversed_line_buffer.end());
+				remove_comment(reversed_line_buffer);
+				if (!reversed_line_buffer.empty()) {
+					if (auto file = called_file(reversed_line_buffer)) {
+						node.footer.push_back(*file);
+						node.end = read_position + i + 1; // The instructions end before the first composition line of the footer
 					}
-					catch (...) {
-						composition_block_ended = true;
-						break;
-					}
-					reversed_line_buffer.clear();
+					else
+						node.has_body = true;
 				}
-				else reversed_line_buffer.push_back(ch);
+				reversed_line_buffer.clear();
 			}
 		}
 
-		// Process the last row if it has not been processed
-		if (!reversed_line_buffer.empty() && !composition_block_ended) {
+		// Process the first line of the file if it has not been processed
+		if (!node.has_body && !reversed_line_buffer.empty()) {
 			std::reverse(reversed_line_buffer.begin(), reversed_line_buffer.end());
 			remove_comment(reversed_line_buffer);
 			if (!reversed_line_buffer.empty()) {
-				try {
-					extended_lexer lexer(reversed_line_buffer);
-					auto tokens = lexer.tokenize();
-					extended_parser parser(tokens);
-					auto instr_ptr = parser.make_instruction();
-					if (instr_ptr)
-						composition_instructions.push_back(std::move(instr_ptr));
-				}
-				catch (...) {
-					composition_block_ended = true;
-				}
+				if (auto file = called_file(reversed_line_buffer))
+					node.footer.push_back(*file);
+				else
+					node.has_body = true;
 			}
 		}
+		std::reverse(node.footer.begin(), node.footer.end());
+
+		if (!node.has_body) // A file of composition lines only: all of them are executed from the last one
+			return node;
+
+		// The header: the composition lines before the input registers
+		input_file.clear(); // Resetting the flow flags
+		input_file.seekg(0, std::ios::beg);
+
+		std::string line;
+		node.begin = input_file.tellg();
+		while (std::getline(input_file, line)) {
+			remove_comment(line);
+			if (line.empty())
+				continue;
 
+			auto file = called_file(line);
+			if (!file)
+				break;
 
-		for (auto it = composition_instructions.rbegin(); it != composition_instructions.rend(); ++it)
-			(*it)->execute(*this);
+			node.header.push_back(*file);
+			node.begin = input_file.tellg();
+		}
 
-		composition_instructions.clear();
+		return node;
+	}
 
-		if (composition_block_ended) {
-			input_file.clear(); // Resetting the flow flags
-			input_file.seekg(0, std::ios::beg);
+	// Implementation of the resumable execution
 
-			std::string line;
-			std::streampos start = input_file.tellg();
+	// Constructor
+	execution::execution(std::vector<std::unique_ptr<extended_register_machine>> stages) noexcept : _stages(std::move(stages)), _stage(0), _steps(0), _state(execution_state::halted), _error(), _started(0), _metrics(nullptr) {}
 
-			while (std::getline(input_file, line)) {
-				remove_comment(line);
-				if (line.empty())
-					continue;
+	// Constructor
+	execution::execution(const std::string& filename) : _stages(), _stage(0), _steps(0), _state(execution_state::halted), _error(), _started(0), _metrics(nullptr) {
+		extended_register_machine erm(filename);
+		this->_stages = erm.load_stages();
+	}
 
-				try {
-					extended_lexer lexer(line);
-					auto tokens = lexer.tokenize();
-					extended_parser parser(tokens);
-					auto instr_ptr = parser.make_instruction();
-					if (instr_ptr == NULL)
-						break;
-
-					composition_instructions.push_back(std::move(instr_ptr));
-					start = input_file.tellg();
-				}
-				catch (...) {
-					break;
+	// Prepares a launch on the given values of the input registers
+	void execution::start(const std::vector<int>& arguments) {
+		this->_stage = 0;
+		this->_steps = 0;
+		this->_state = execution_state::halted;
+		this->_error.clear();
+
+		if (this->_stages.empty())
+			return;
+
+		this->_metrics = metrics_registry::global().is_enabled() ? &this->_stages.front()->metrics() : nullptr;
+		if (this->_metrics)
+			this->_started = metrics_ticks();
+		this->_stages.front()->start(arguments);
+		this->_state = execution_state::running;
+	}
+
+	// Continues the launch for at most max_steps instructions and max_time, returns the state of the launch
+	execution_state execution::resume(size_t max_steps, std::chrono::microseconds max_time) {
+		if (this->_state != execution_state::running)
+			return this->_state;
+
+		bool is_timed = max_time != std::chrono::microseconds::max();
+		auto deadline = std::chrono::steady_clock::now() + (is_timed ? max_time : std::chrono::microseconds::zero());
+
+		while (true) {
+			auto& stage = *this->_stages[this->_stage];
+			auto stage_steps = stage.steps();
+
+			auto remaining_time = is_timed ? std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()) : max_time;
+			if (is_timed && remaining_time <= std::chrono::microseconds::zero())
+				return this->_state;
+
+			this->_state = stage.resume(max_steps, remaining_time);
+			max_steps -= stage.steps() - stage_steps;
+
+			if (this->_state == execution_state::error)
+				this->_error = stage.error();
+
+			if (this->_state != execution_state::halted || this->_stage + 1 == this->_stages.size()) {
+				if (this->_state != execution_state::running)
+					this->record();
+				return this->_state;
+			}
+
+			// The stage is finished: its output registers are the input registers of the next stage
+			try {
+				this->_stages[this->_stage + 1]->start(stage);
+			}
+			catch (const std::exception& e) {
+				this->_error = e.what();
+				this->_state = execution_state::error;
+				this->record();
+				return this->_state;
+			}
+			this->_steps += stage.steps();
+			++this->_stage;
+			this->_state = execution_state::running;
+
+			if (max_steps == 0)
+				return this->_state;
+		}
+	}
+
+	// Launch on the given values of the input registers under resource limits
+	metered_result execution::run(const std::vector<int>& arguments, const execution_limits& limits) {
+		auto begin = std::chrono::steady_clock::now();
+		bool is_timed = limits.max_time != std::chrono::microseconds::max();
+		auto deadline = is_timed ? begin + limits.max_time : std::chrono::steady_clock::time_point::max();
+
+		metered_result result{ execution_state::error, execution_limit::none, {}, {}, 0, 0, 0, 0, std::chrono::microseconds::zero() };
+		try {
+			this->start(arguments);
+		}
+		catch (const std::exception& e) {
+			this->_error = e.what();
+			this->_state = execution_state::error;
+		}
+
+		while (this->_state == execution_state::running) {
+			if (this->steps() >= limits.max_steps) {
+				result.limit = execution_limit::steps;
+				break;
+			}
+			if (is_timed && std::chrono::steady_clock::now() >= deadline) {
+				result.limit = execution_limit::time;
+				break;
+			}
+
+			auto& stage = *this->_stages[this->_stage];
+			this->resume(std::min(limits.max_steps - this->steps(), METER_PERIOD));
+
+			result.registers = std::max(result.registers, stage.registers());
+			if (result.registers > limits.max_registers) {
+				result.limit = execution_limit::registers;
+				break;
+			}
+		}
+
+		result.state = this->_state;
+		result.error = this->_error;
+		result.steps = this->steps();
+		result.stage = this->_stage;
+		if (!this->_stages.empty()) {
+			result.carriage = this->_stages[this->_stage]->carriage();
+			result.outputs = this->results();
+		}
+		result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+		return result;
+	}
+
+	// Returns the register machines of the stages, the launch is left without stages
+	std::vector<std::unique_ptr<extended_register_machine>> execution::release() noexcept {
+		this->_stage = 0;
+		this->_steps = 0;
+		this->_state = execution_state::halted;
+
+		auto stages = std::move(this->_stages);
+		this->_stages.clear();
+		return stages;
+	}
+
+	// Returns the state of the launch
+	execution_state execution::state() const noexcept {
+		return this->_state;
+	}
+
+	// Returns the values of the output registers of the last stage
+	std::vector<int> execution::results() const {
+		if (this->_stages.empty())
+			return {};
+		return this->_stages[this->_stage]->results();
+	}
+
+	// Returns the error message of the failed launch
+	const std::string& execution::error() const noexcept {
+		return this->_error;
+	}
+
+	// Returns the number of instructions executed since the start of the launch
+	size_t execution::steps() const noexcept {
+		if (this->_stages.empty())
+			return 0;
+		return this->_steps + this->_stages[this->_stage]->steps();
+	}
+
+	// Returns the number of the current stage
+	size_t execution::stage() const noexcept {
+		return this->_stage;
+	}
+
+	// Records the time and the number of instructions of the finished launch
+	void execution::record() noexcept {
+		if (this->_metrics == nullptr)
+			return;
+		this->_metrics->run.record(metrics_ticks() - this->_started);
+		this->_metrics->run_steps.record(this->steps());
+		this->_metrics = nullptr;
+	}
+
+	// Implementation of the pipeline
+
+	// Constructor
+	pipeline::pipeline(const std::string& filename, size_t capacity) : _stages(), _capacity(capacity) {
+		extended_register_machine erm(filename);
+		this->_stages = erm.load_stages();
+	}
+
+	// Launch of the pipeline on a vector of input tuples, returns the output tuples in the same order
+	std::vector<std::vector<int>> pipeline::run(const std::vector<std::vector<int>>& inputs) {
+		std::vector<std::vector<int>> outputs{};
+		outputs.reserve(inputs.size());
+
+		size_t index{ 0 };
+		this->execute(
+			[&]() -> tuple {
+				if (index >= inputs.size())
+					return std::nullopt;
+				return inputs[index++];
+			},
+			[&](std::vector<int>& output) { outputs.push_back(std::move(output)); });
+
+		return outputs;
+	}
+
+	// Launch of the pipeline on a stream of input tuples, one tuple per line
+	void pipeline::run(std::istream& is, std::ostream& os) {
+		this->execute(
+			[&]() -> tuple { return read_tuple(is); },
+			[&](std::vector<int>& output) {
+				for (size_t i{ 0 }; i < output.size(); ++i)
+					os << (i == 0 ? "" : " ") << output[i];
+				os << '\n';
+			});
+		os.flush();
+	}
+
+	// Launch of the pipeline: source returns input tuples until std::nullopt, sink receives output tuples
+	template <typename Source, typename Sink>
+	void pipeline::execute(Source source, Sink sink) {
+		// queues[i] connects stage i - 1 (or the source) with stage i (or the sink)
+		std::vector<std::unique_ptr<spsc_queue<tuple>>> queues{};
+		for (size_t i{ 0 }; i <= this->_stages.size(); ++i)
+			queues.push_back(std::make_unique<spsc_queue<tuple>>(this->_capacity));
+
+		// errors[0] belongs to the source, errors[i + 1] to stage i
+		std::vector<std::exception_ptr> errors(this->_stages.size() + 1);
+
+		std::vector<std::thread> threads{};
+
+		threads.emplace_back([&]() {
+			try {
+				for (auto input = source(); input; input = source())
+					queues.front()->push(std::move(input));
+			}
+			catch (...) {
+				errors.front() = std::current_exception();
+			}
+			queues.front()->push(std::nullopt);
+		});
+
+		for (size_t i{ 0 }; i < this->_stages.size(); ++i) {
+			threads.emplace_back([&, i]() {
+				auto& stage = *this->_stages[i];
+				auto& input_queue = *queues[i];
+				auto& output_queue = *queues[i + 1];
+
+				for (auto input = input_queue.pop(); input; input = input_queue.pop()) {
+					if (errors[i + 1])
+						continue; // After an error the stage only drains its input so that the previous stage does not block
+					try {
+						output_queue.push(stage.evaluate(*input));
+					}
+					catch (...) {
+						errors[i + 1] = std::current_exception();
+					}
 				}
+				output_queue.push(std::nullopt);
+			});
+		}
+
+		auto& output_queue = *queues.back();
+		bool is_sink_failed{ false };
+		std::exception_ptr sink_error{};
+		for (auto output = output_queue.pop(); output; output = output_queue.pop()) {
+			if (is_sink_failed)
+				continue;
+			try {
+				sink(*output);
+			}
+			catch (...) {
+				is_sink_failed = true;
+				sink_error = std::current_exception();
 			}
-			this->_file_stack.push({ filename, {start, end} });
 		}
 
-		for (auto it = composition_instructions.rbegin(); it != composition_instructions.rend(); ++it)
-			(*it)->execute(*this);
+		for (auto& thread : threads)
+			thread.join();
+
+		for (const auto& error : errors)
+			if (error)
+				std::rethrow_exception(error);
+		if (sink_error)
+			std::rethrow_exception(sink_error);
 	}
 }
\ No newline at end of file
@@ -1,16 +1,31 @@
 ﻿#ifndef __REGISTER_MACHINE_
 #define __REGISTER_MACHINE_
 
+#include "grammar.h"
+#include "metrics.h"
+#include "profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <ios>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <new>
 #include <optional>
 #include <sstream>
 #include <stack>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 using namespace std::string_literals;
@@ -22,19 +37,78 @@ using namespace std::string_literals;
 #define MOVE "<<-"s
 #define PLUS "+"s
 #define MINUS "-"s
+#define MULTIPLY "*"s
+#define DIVIDE "/"s
+#define MODULO "%"s
 #define STOP "stop"s
 #define IF "if"s
 #define THEN "then"s
 #define ELSE "else"s
 #define GOTO "goto"s
 #define EQUAL "=="s
+#define NOT_EQUAL "!="s
+#define LESS "<"s
+#define LESS_EQUAL "<="s
+#define GREATER ">"s
+#define GREATER_EQUAL ">="s
 #define COMPOSITION "call"s
+#define RESULT "->"s
 #define COMMENT "#"s
 
 namespace IMD {
 
 	class basic_register_machine;
 
+	// State of a resumable RM launch
+	enum class execution_state {
+		running, // The budget is exhausted before the stop instruction, the launch can be resumed
+		halted, // The stop instruction is executed
+		error // The launch failed
+	};
+
+	// Resource limits of a launch
+	struct execution_limits {
+		// Maximum number of executed instructions
+		size_t max_steps{ std::numeric_limits<size_t>::max() };
+		// Maximum wall-clock time of the launch
+		std::chrono::microseconds max_time{ std::chrono::microseconds::max() };
+		// Maximum number of distinct registers of a composition stage
+		size_t max_registers{ std::numeric_limits<size_t>::max() };
+	};
+
+	// Resource limit that terminated a launch
+	enum class execution_limit {
+		none, // The launch finished within the limits
+		steps, // The step budget is exhausted
+		time, // The time budget is exhausted
+		registers // Too many distinct registers are created
+	};
+
+	// Result of a launch under resource limits
+	struct metered_result {
+		// Final state: halted, error, or running when a limit terminated the launch
+		execution_state state;
+		// Limit that terminated the launch
+		execution_limit limit;
+		// Values of the output registers of the stage executed at termination
+		std::vector<int> outputs;
+		// Error message of the failed launch
+		std::string error;
+		// Number of executed instructions
+		size_t steps;
+		// Largest number of distinct registers of a stage
+		size_t registers;
+		// Number of the stage executed at termination
+		size_t stage;
+		// Number of the next instruction of that stage
+		size_t carriage;
+		// Wall-clock time of the launch
+		std::chrono::microseconds elapsed;
+	};
+
+	// Returns the name of the limit
+	std::string_view limit_name(execution_limit limit) noexcept;
+
 	// Helper methods
 
 	// Removes leading and trailing whitespace characters from the given string in-place
@@ -56,42 +130,37 @@ namespace IMD {
 
 	// Removes comment from the given string by erasing everything after the comment marker
 	void remove_comment(std::string& line) noexcept;
+	// Returns the line without the comment and the surrounding whitespace
+	std::string_view strip(std::string_view line) noexcept;
+
+	// Reads the next tuple of integers from the stream, one tuple per line; returns std::nullopt at the end of the stream
+	std::optional<std::vector<int>> read_tuple(std::istream& is);
 
 	// Класс базовой РМ
 	class basic_register_machine {
 	protected:
 
-		// Enumeration of token types
-		enum class token_type {
-			variable, // Register
-			literal, // Non-negative integer literal
-			keyword_if, // IF
-			keyword_then, // THEN
-			keyword_else, // ELSE
-			keyword_goto, // GOTO
-			operator_copy_assignment, // COPY
-			operator_move_assignment, // MOVE
-			operator_plus, // PLUS
-			operator_minus, // MINUS
-			operator_equal, // EQUAL
-			keyword_stop, // STOP
-			keyword_composition, // COMPOSITION
-			file, // Filename with extension
-			unknown, // Unknown token
-		};
-
-		// Enum of arithmetic operations
-		enum class operation {
-			none,
-			plus,
-			minus
+		// Token types, arithmetic operations and comparison relations are defined by the grammar
+		using token_type = grammar::token_type;
+		using operation = grammar::operation;
+		using relation = grammar::relation;
+
+		// Enum of instruction kinds
+		enum class instruction_kind {
+			copy_assignment,
+			move_assignment,
+			condition,
+			extended_condition,
+			comparison,
+			jump,
+			composition,
+			call,
+			stop
 		};
 
 		// Instruction class
+		// Instructions are placed in the instruction arena of the RM, register names refer to its name pool
 		class instruction {
-		protected:
-			// Normalized instruction description
-			std::string _description;
 		public:
 			// Constructor
 			explicit instruction() noexcept;
@@ -101,8 +170,12 @@ namespace IMD {
 
 			// Execution of instructions
 			virtual void execute(basic_register_machine& brm) = 0;
-			// Returns a normalized description of the instruction
-			virtual const std::string& description() const noexcept;
+			// Execution of the instruction of a verified program: the registers it reads are known to exist
+			virtual void execute_verified(basic_register_machine& brm);
+			// Returns a normalized description of the instruction, built on demand
+			virtual std::string description() const = 0;
+			// Returns the kind of the instruction
+			virtual instruction_kind kind() const noexcept = 0;
 		};
 
 		// Copy assignment instruction class
@@ -112,31 +185,52 @@ namespace IMD {
 
 		protected:
 			// Name of the target register
-			std::string _target_register;
+			const std::string& _target_register;
 			// Operation in expression
 			operation _operation;
 			// Name of the left operand of expression
-			std::string _left_operand;
+			const std::string& _left_operand;
 			// Name of the right operand of expression
 			// Empty string when there is no arithmetic operation in the expression
-			std::string _right_operand;
+			const std::string& _right_operand;
+			// Values of the literal operands, parsed once
+			std::optional<int> _left_value;
+			std::optional<int> _right_value;
 
 		public:
-			// Constructor
-			explicit copy_assignment_instruction(std::string_view target_register, const operation& operation, std::string_view left_operand, std::string_view right_operand) noexcept;
+			// Constructor: the names must outlive the instruction
+			explicit copy_assignment_instruction(const std::string& target_register, const operation& operation, const std::string& left_operand, const std::string& right_operand) noexcept;
 
 			// Destructor
 			~copy_assignment_instruction() override = default;
 
 			// Executing a copy assignment instruction
 			void execute(basic_register_machine& brm) override;
+			// Executing a copy assignment instruction of a verified program without catching missing registers
+			void execute_verified(basic_register_machine& brm) override;
+			// Returns a normalized description of the instruction
+			std::string description() const override;
+			// Returns the kind of the instruction
+			instruction_kind kind() const noexcept override;
+
+			// Returns the value of the expression: subtraction stops at 0, division by 0 gives 0 and the remainder of it is the dividend
+			static int apply(operation operation, int left, int right) noexcept;
+
+			// Returns the name of the target register
+			const std::string& target_register() const noexcept;
+			// Returns the operation in expression
+			const operation& operation_type() const noexcept;
+			// Returns the left operand of expression
+			const std::string& left_operand() const noexcept;
+			// Returns the right operand of expression
+			const std::string& right_operand() const noexcept;
 		};
 
 		// Conditional instruction class
 		class condition_instruction : public instruction {
 		protected:
 			// Name of the compared register
-			std::string _compared_register;
+			const std::string& _compared_register;
 			// Instruction number when the condition is true
 			size_t _goto_true;
 			// Instruction number when the condition is false
@@ -144,27 +238,96 @@ namespace IMD {
 
 		public:
 			// Constructor
-			explicit condition_instruction(std::string_view compared_register, size_t goto_true, size_t goto_false) noexcept;
+			explicit condition_instruction(const std::string& compared_register, size_t goto_true, size_t goto_false) noexcept;
 
 			// Destructor
 			~condition_instruction() override = default;
 
 			// Executing a conditional instruction
 			void execute(basic_register_machine& brm) noexcept override;
+			// Returns a normalized description of the instruction
+			std::string description() const override;
+			// Returns the kind of the instruction
+			instruction_kind kind() const noexcept override;
+
+			// Returns the name of the compared register
+			const std::string& compared_register() const noexcept;
+			// Returns the instruction number when the condition is true
+			size_t goto_true() const noexcept;
+			// Returns the instruction number when the condition is false
+			size_t goto_false() const noexcept;
 		};
 
 		// Composition instruction class
 		class composition_instruction : public instruction {
-			std::string _include_filename;
+			// Name of the included file
+			const std::string& _include_filename;
 		public:
 			// Constructor
-			explicit composition_instruction(std::string_view include_filename) noexcept;
+			explicit composition_instruction(const std::string& include_filename) noexcept;
 
 			// Destructor
 			~composition_instruction() override = default;
 
-			// Executing a composition instruction
+			// Executing a composition instruction: the compositions are resolved before the launch, so it throws
+			void execute(basic_register_machine& brm) override;
+			// Returns a normalized description of the instruction
+			std::string description() const override;
+			// Returns the kind of the instruction
+			instruction_kind kind() const noexcept override;
+
+			// Returns the name of the included file
+			const std::string& include_filename() const noexcept;
+		};
+
+		// Call instruction class: runs another program as a subroutine in a frame of its own
+		// The arguments are passed to the input registers of the called program, its output registers are returned to the result registers
+		class call_instruction : public instruction {
+		protected:
+			// Name of the called file
+			const std::string& _filename;
+			// Names of the registers or the literals passed as arguments
+			std::vector<const std::string*> _arguments;
+			// Values of the literal arguments, parsed once
+			std::vector<std::optional<int>> _argument_values;
+			// Names of the registers receiving the results
+			std::vector<const std::string*> _results;
+			// Called program, set when the program is linked
+			const basic_register_machine* _callee;
+			// Layout of the window of the called program, resolved when the program is linked:
+			// the distinct names of its output and then input registers take the slots in order
+			std::vector<const std::string*> _slot_registers;
+			// Slots of the input and output registers of the called program
+			std::vector<size_t> _input_slots;
+			std::vector<size_t> _output_slots;
+
+		public:
+			// Constructor: the names must outlive the instruction
+			explicit call_instruction(const std::string& filename, std::vector<const std::string*> arguments, std::vector<const std::string*> results);
+
+			// Destructor
+			~call_instruction() override = default;
+
+			// Executing a call instruction: the registers and the instructions of the calling program are kept in a frame
 			void execute(basic_register_machine& brm) override;
+			// Returns a normalized description of the instruction
+			std::string description() const override;
+			// Returns the kind of the instruction
+			instruction_kind kind() const noexcept override;
+
+			// Binds the instruction to the called program, throws if the numbers of arguments and results do not fit its registers
+			void bind(const basic_register_machine& callee);
+
+			// Returns the name of the called file
+			const std::string& filename() const noexcept;
+			// Returns the names of the registers or the literals passed as arguments
+			const std::vector<const std::string*>& arguments() const noexcept;
+			// Returns the names of the registers receiving the results
+			const std::vector<const std::string*>& results() const noexcept;
+			// Returns the called program, nullptr before linking
+			const basic_register_machine* callee() const noexcept;
+			// Returns the slots of the output registers of the called program
+			const std::vector<size_t>& output_slots() const noexcept;
 		};
 
 		// Extended conditional instruction class
@@ -174,13 +337,54 @@ namespace IMD {
 			size_t _compared_value;
 		public:
 			// Constructor
-			explicit extended_condition_instruction(std::string_view compared_register, size_t compared_value, size_t goto_true, size_t goto_false) noexcept;
+			explicit extended_condition_instruction(const std::string& compared_register, size_t compared_value, size_t goto_true, size_t goto_false) noexcept;
 
 			// Destructor
 			~extended_condition_instruction() override = default;
 
 			// Executing a extended conditional instruction
 			void execute(basic_register_machine& brm) noexcept override;
+			// Returns a normalized description of the instruction
+			std::string description() const override;
+			// Returns the kind of the instruction
+			instruction_kind kind() const noexcept override;
+
+			// Returns the value to be compared
+			size_t compared_value() const noexcept;
+		};
+
+		// Comparison instruction class: compares a register with a register or a literal
+		// Both compared registers are created by the comparison, like the register of a conditional instruction
+		class comparison_instruction : public condition_instruction {
+		protected:
+			// Relation between the compared register and the operand
+			relation _relation;
+			// Name of the register or the literal compared with
+			const std::string& _compared_operand;
+			// Value of the literal operand, parsed once
+			std::optional<int> _compared_literal;
+
+		public:
+			// Constructor: the names must outlive the instruction
+			explicit comparison_instruction(const std::string& compared_register, relation relation, const std::string& compared_operand, size_t goto_true, size_t goto_false) noexcept;
+
+			// Destructor
+			~comparison_instruction() override = default;
+
+			// Executing a comparison instruction
+			void execute(basic_register_machine& brm) noexcept override;
+			// Returns a normalized description of the instruction
+			std::string description() const override;
+			// Returns the kind of the instruction
+			instruction_kind kind() const noexcept override;
+
+			// Returns true if the relation holds between the values
+			static bool holds(relation relation, int left, int right) noexcept;
+
+			// Returns the relation between the compared register and the operand
+			relation relation_type() const noexcept;
+			// Returns the name of the register or the literal compared with
+			const std::string& compared_operand() const noexcept;
 		};
 
 		// Movement instruction class
@@ -197,24 +401,40 @@ namespace IMD {
 
 			// Executing a goto instruction
 			void execute(basic_register_machine& brm) noexcept override;
+			// Returns a normalized description of the instruction
+			std::string description() const override;
+			// Returns the kind of the instruction
+			instruction_kind kind() const noexcept override;
+
+			// Returns the number of the target instruction
+			size_t target_mark() const noexcept;
 		};
 
 		// Move assignment instruction class
 		class move_assignment_instruction : public instruction {
 		protected:
 			// Name of the target register
-			std::string _to_register;
+			const std::string& _to_register;
 			// Name of the source register
-			std::string _from_register;
+			const std::string& _from_register;
 		public:
 			// Constructor
-			explicit move_assignment_instruction(std::string_view _to_register, std::string_view _from_register) noexcept;
+			explicit move_assignment_instruction(const std::string& to_register, const std::string& from_register) noexcept;
 
 			// Destructor
 			~move_assignment_instruction() override = default;
 
 			// Executing move assignment instruction
 			void execute(basic_register_machine& brm) override;
+			// Returns a normalized description of the instruction
+			std::string description() const override;
+			// Returns the kind of the instruction
+			instruction_kind kind() const noexcept override;
+
+			// Returns the name of the target register
+			const std::string& to_register() const noexcept;
+			// Returns the name of the source register
+			const std::string& from_register() const noexcept;
 		};
 
 		// Stop instruction class
@@ -226,12 +446,84 @@ namespace IMD {
 			// Destructor
 			~stop_instruction() override = default;
 
-			// Executing a stop instruction
-			void execute(basic_register_machine& brm) noexcept override;
+			// Executing a stop instruction: the called program returns to the calling one
+			void execute(basic_register_machine& brm) override;
+			// Returns a normalized description of the instruction
+			std::string description() const override;
+			// Returns the kind of the instruction
+			instruction_kind kind() const noexcept override;
 		};
 
 	protected:
 
+		// Arena of instructions: the instructions of a program are placed one after another in large blocks
+		// instead of a separate heap allocation each, and are destroyed all at once
+		class instruction_arena {
+		private:
+			// Size of an arena block
+			static constexpr size_t BLOCK_SIZE{ 64 * 1024 };
+
+			// Memory blocks
+			std::vector<std::unique_ptr<std::byte[]>> _blocks;
+			// Number of bytes used in the last block
+			size_t _used;
+			// Instructions placed in the arena, in the order of creation
+			std::vector<instruction*> _instructions;
+
+		public:
+			// Constructor
+			instruction_arena() noexcept;
+
+			// Copy constructor
+			instruction_arena(const instruction_arena&) = delete;
+			// Assignment operator
+			instruction_arena& operator=(const instruction_arena&) = delete;
+
+			// Destructor: destroys all instructions
+			~instruction_arena();
+
+			// Creates an instruction in the arena, the arena owns it
+			template <typename T, typename... Args>
+			T* create(Args&&... args) {
+				static_assert(std::is_base_of_v<instruction, T> && alignof(T) <= alignof(std::max_align_t));
+
+				auto* memory = this->allocate(sizeof(T));
+				auto* result = new (memory) T(std::forward<Args>(args)...);
+				this->_instructions.push_back(result);
+				return result;
+			}
+
+			// Destroys all instructions, the first block is kept for reuse
+			void clear() noexcept;
+
+		private:
+			// Returns suitably aligned memory of the given size
+			void* allocate(size_t size);
+		};
+
+		// Pool of interned names: each distinct register name or literal of a program is stored once,
+		// instructions refer to the pooled strings
+		class name_pool {
+		private:
+			// Interned names; references to elements stay valid on insertion
+			std::unordered_set<std::string> _names;
+
+		public:
+			// Returns the pooled copy of the name
+			const std::string& intern(std::string_view name);
+
+			// Removes all names
+			void clear() noexcept;
+		};
+
+		// Storage of the instructions parsed by a machine: the arena and the pool of the names they refer to
+		// Loaded instructions are never modified, so the storage is shared by the clones and the reloaded versions of the machine;
+		// the call instructions are only bound to the called programs when the program is linked
+		struct code_storage {
+			instruction_arena arena;
+			name_pool names;
+		};
+
 		// Token class
 		class token {
 		private:
@@ -287,34 +579,41 @@ namespace IMD {
 			std::vector<token> _tokens;
 			// Position indicator (carriage) for reading the token vector
 			size_t _carriage;
+			// Arena receiving the created instructions
+			instruction_arena& _arena;
+			// Pool of the register names of the instructions
+			name_pool& _names;
 
 		public:
 			// Constructor
-			explicit basic_parser(const std::vector<token>& tokens) noexcept;
+			explicit basic_parser(const std::vector<token>& tokens, instruction_arena& arena, name_pool& names) noexcept;
 
 			// Destructor
 			~basic_parser() noexcept = default;
 
 			// Checks for the end of a vector
 			bool eof() const noexcept;
-			// Returns the current token
+			// Returns the current token, throws at the end of the instruction
 			const token& preview() const;
 
-			// Returns a unique pointer to the instruction
-			virtual std::unique_ptr<instruction> make_instruction();
+			// Returns a pointer to the instruction created in the arena
+			virtual instruction* make_instruction();
 
-			// Returns a unique pointer to the stop instruction
-			virtual std::unique_ptr<instruction> make_stop_instruction();
+			// Returns a pointer to the stop instruction created in the arena
+			virtual instruction* make_stop_instruction();
 
-			// Returns a unique pointer to the condition instruction
-			virtual std::unique_ptr<instruction> make_condition_instruction();
+			// Returns a pointer to the condition instruction created in the arena
+			virtual instruction* make_condition_instruction();
 
-			// Returns a unique pointer to the copy assignment instruction
-			virtual std::unique_ptr<instruction> make_copy_assignment_instruction();
+			// Returns a pointer to the copy assignment instruction created in the arena
+			virtual instruction* make_copy_assignment_instruction();
 
 			// Checks if the current token type matches the given type
 			bool is_type_match(const token_type& type) const noexcept;
 
+			// Processes the jump targets of a condition: THEN GOTO L1 ELSE GOTO L2, returns the pair <L1, L2>
+			std::pair<size_t, size_t> make_jump_targets();
+
 		};
 	protected:
 		// Flag indicating whether the RM is stopped
@@ -323,17 +622,99 @@ namespace IMD {
 		// Flag indicating the mode of detailed output of the RM work
 		bool _is_verbose;
 
+		// Error message of the failed launch, empty if there was no error
+		std::string _error;
+
 		// Name of the file being processed
 		std::string _filename;
 
 		// Каретка, описывающая номер текущей инструкции
 		size_t _carriage;
 
+		// Number of instructions executed since the last launch
+		size_t _steps;
+
+		// Flag indicating that the loaded program has passed the verifier
+		bool _is_verified;
+
 		// Dictionary of registers
 		std::unordered_map<std::string, int> _registers;
 
-		// Vector of unique instruction pointers
-		std::vector<std::unique_ptr<instruction>> _instructions;
+		// Storage of the instructions parsed by this machine
+		std::shared_ptr<code_storage> _code;
+
+		// Storages of the instructions taken over from the previous versions of the program on reload
+		std::vector<std::shared_ptr<code_storage>> _retained;
+
+		// Vector of instruction pointers in the order of their numbers
+		std::vector<instruction*> _instructions;
+
+		// Text of a loaded stage, compared with the text of its next version to find the changed lines
+		struct loaded_text {
+			// Text of the stage
+			std::string text;
+			// Positions of the instruction lines in the text
+			std::vector<size_t> lines;
+			// Numbers of the call instructions, which every version parses anew
+			std::vector<size_t> calls;
+		};
+		// Text of the loaded stage, nullptr for a lazily loaded one
+		std::shared_ptr<const loaded_text> _text;
+
+		// Result of the verification kept for the next version of the program: its unchanged instructions are not decoded again,
+		// and the definite assignment is not computed again if the changed ones keep the control flow and the writes
+		struct verification {
+			// Control flow after an instruction
+			enum class flow : uint8_t {
+				next, // Continues with the next instruction
+				jump, // Continues with the targets
+				stop // Stops the machine
+			};
+			// Effect of an instruction: its successors, the registers it creates and the registers it reads
+			struct effect {
+				uint32_t next[2];
+				uint32_t writes[2];
+				uint32_t reads[2];
+				flow kind;
+				uint32_t call; // Index of the registers of a call instruction, which may read and write more than two
+			};
+			// Registers of a call instruction
+			struct call_effect {
+				std::vector<uint32_t> writes;
+				std::vector<uint32_t> reads;
+			};
+			// Registers existing before the first instruction of every block, the blocks start at line 0 and at the jump targets
+			struct assignment {
+				// Number of the block starting at an instruction, none for the other instructions
+				std::vector<uint32_t> leaders;
+				// Bit sets of the registers by block
+				std::vector<uint64_t> assigned;
+				// Flags of the blocks reachable from line 0
+				std::vector<bool> is_reached;
+				// Number of words in a bit set
+				size_t words;
+			};
+
+			// Number of instructions in a block of effects
+			static constexpr size_t BLOCK{ 4096 };
+
+			// Register names by number, the input and output registers come first
+			std::vector<std::string> names;
+			// Number of the input and output registers
+			size_t initial;
+			// Number of instructions
+			size_t size;
+			// Number of stop instructions
+			size_t stops;
+			// Effects of the instructions by blocks, a block without changed instructions is shared with the previous version
+			std::vector<std::shared_ptr<const std::vector<effect>>> effects;
+			// Registers of the call instructions
+			std::vector<call_effect> calls;
+			// Definite assignment, shared by the versions with the same control flow and writes
+			std::shared_ptr<const assignment> assigned;
+		};
+		// Verification of the loaded program, nullptr if it is not verified
+		std::shared_ptr<const verification> _verification;
 
 		// Vector of output register names
 		std::vector<std::string> _output_registers;
@@ -341,6 +722,56 @@ namespace IMD {
 		// Vector of input register names
 		std::vector<std::string> _input_registers;
 
+		// Values of the input and output registers, bound to the nodes of the dictionary by the first launch after loading:
+		// the nodes stay in place between launches, so arguments and results are passed without lookups
+		std::vector<int*> _input_values;
+		std::vector<int*> _output_values;
+		// Values of the registers existing right after loading, sorted by address
+		std::vector<const int*> _initial_values;
+		// Flag indicating that the values above are bound
+		bool _is_bound;
+
+		// Frame of a call: while the called program runs, the registers and the instructions of the calling one are swapped into it
+		// The frames are kept between calls, so a program called again at the same depth reuses the copy of its instructions
+		// and the nodes of its input and output registers
+		struct call_frame {
+			// Instructions of the program not running at the moment: the calling one during the call, the called one after it
+			std::vector<instruction*> instructions;
+			// Registers of the program not running at the moment
+			std::unordered_map<std::string, int> registers;
+			// Values of the window registers of the called program by slots, bound to the nodes of its dictionary
+			std::vector<int*> slots;
+			// The same values sorted by address
+			std::vector<const int*> initial;
+			// Called program whose instructions are kept in the frame
+			const basic_register_machine* callee;
+			// Call instruction of the frame
+			const call_instruction* call;
+			// Number of the instruction following the call
+			size_t return_carriage;
+		};
+
+		// Maximum depth of nested calls
+		static constexpr size_t MAX_CALL_DEPTH{ 10000 };
+
+		// Frames of the calls, the first _depth of them are active; the stack grows only when a call goes deeper than ever before,
+		// and its elements stay in place, so the bound slots remain valid
+		std::deque<call_frame> _frames;
+		// Number of active calls
+		size_t _depth;
+
+		// Metrics of the program file, taken from the registry on first use
+		program_metrics* _metrics;
+
+		// Slot of the sampling profiler the running slice publishes into, nullptr while the launch is not sampled
+		profile_slot* _profile;
+		// Packed file of the running program, the number of the running instruction is added to it
+		uint64_t _profile_file;
+		// Number of the program file in the sampling profiler, taken on first use
+		mutable std::atomic<uint32_t> _profile_number;
+		// Number of the composition file in the sampling profiler for a composition stage, 0 otherwise
+		uint32_t _composition_number;
+
 	public:
 		// Constructor
 		basic_register_machine(std::string_view name, bool is_verbose = false) noexcept;
@@ -358,6 +789,31 @@ namespace IMD {
 		// Reboot RM
 		virtual void reboot();
 
+		// Launch of the loaded RM on the given values of the input registers, returns the values of the output registers
+		std::vector<int> evaluate(const std::vector<int>& arguments);
+
+		// Prepares the loaded RM for a resumable launch on the given values of the input registers
+		void start(const std::vector<int>& arguments);
+		// Prepares the loaded RM for a resumable launch on the values of the output registers of the previous composition stage
+		void start(const basic_register_machine& previous);
+		// Continues the launch for at most max_steps instructions and max_time, returns the state of the launch
+		execution_state resume(size_t max_steps, std::chrono::microseconds max_time = std::chrono::microseconds::max());
+		// Returns the values of the output registers
+		std::vector<int> results() const;
+		// Returns the error message of the failed launch
+		const std::string& error() const noexcept;
+
+		// Returns the number of instructions executed since the last launch
+		size_t steps() const noexcept;
+		// Returns the number of distinct registers
+		size_t registers() const noexcept;
+		// Returns the number of the next instruction
+		size_t carriage() const noexcept;
+		// Returns the name of the program file
+		const std::string& filename() const noexcept;
+		// Returns the metrics of the program file
+		program_metrics& metrics();
+
 		// Print input registers separated by a separator without a new line
 		void print_input_registers(const std::string& separator = " ") const noexcept;
 		// Print input registers separated by a separator and go to a new line
@@ -381,14 +837,86 @@ namespace IMD {
 		// Returns an integer value parsed from a string, which may contain a literal or a register
 		friend int get_value(const basic_register_machine& brm, const std::string& line);
 
+		// Lockstep interpreter compiles the instructions of loaded machines
+		friend class lockstep_machine;
+		// Differential checker loads programs into the basic RM
+		friend class differential_checker;
+		// Specializer executes the instructions of a loaded machine symbolically
+		friend class specializer;
+		// Register coalescer analyzes the liveness of the registers over the loaded instructions
+		friend class register_coalescer;
+		// Superoptimizer searches over the loaded instructions
+		friend class superoptimizer;
+		// Step estimator bounds the loops of the loaded instructions
+		friend class step_estimator;
+		// Debugger swaps traps for the loaded instructions
+		friend class debugger;
+
 	protected:
 		// Drop settings of RM
 		virtual void drop();
+		// Releases the loaded instructions: the storage is cleared in place unless other machines share it
+		void release_code();
+		// Returns the registers to their state after loading: the output registers are 0, the registers created by a launch are removed
+		void reset_registers();
+		// Returns from the active call: the output registers of the called program are written to the result registers
+		void return_from_call();
+		// Leaves all active calls without returning the results
+		void unwind_calls() noexcept;
 
 		// Load all instructions
 		virtual void load_all_instructions(std::pair<std::streampos, std::streampos> barier = {0, 0}, std::ios_base::seekdir border = std::ios::beg);
 		// Follow all instructions
 		virtual void execute_all_instructions();
+		// Returns the instruction with the given number that is not parsed yet, throws if the program is not loaded lazily
+		virtual instruction* parse_instruction(size_t number);
+		// Follow at most max_steps instructions of a verified program: no bounds checks of the carriage and no exception handling
+		void execute_verified_instructions(size_t max_steps = std::numeric_limits<size_t>::max());
+		// Follow the instructions of a verified program to the stop instruction, publishing the state when the live state monitor is open
+		void execute_verified_program();
+
+		// Number of instructions between the checks whether the state is due to be published into the live state monitor
+		static constexpr size_t PUBLISH_PERIOD{ size_t{ 1 } << 16 };
+		// Publishes the state of the launch into the live state monitor: at most once per its period unless is_final
+		void publish_state(bool is_final = false);
+
+		// Publishes the launch into the slot of the sampling profiler of the calling thread while the scope exists,
+		// if the profiler is started
+		class profile_scope {
+		private:
+			basic_register_machine& _brm;
+
+		public:
+			// Constructor: publishes the stack of the launch
+			explicit profile_scope(basic_register_machine& brm);
+			// Copy constructor
+			profile_scope(const profile_scope&) = delete;
+			// Assignment operator
+			profile_scope& operator=(const profile_scope&) = delete;
+			// Destructor: marks the thread as executing no launch
+			~profile_scope();
+		};
+
+		// Follow at most max_steps instructions of a verified program publishing the position of every one into the sampling profiler
+		void execute_profiled_instructions(size_t max_steps);
+		// Returns the number of the program file in the sampling profiler
+		uint32_t profile_number() const;
+		// Returns the number of frames published for the launch itself: the composition and the file, or the file only
+		size_t profile_base() const noexcept;
+		// Publishes the stack of the launch into the sampling profiler: the composition, the file and the lines of the active calls
+		void publish_profile();
+		// Publishes the frames of the call just made: the line of the call and the called file
+		void profile_call();
+		// Removes the frames of the call just returned from
+		void profile_return();
+
+		// Verifies the loaded program, throws with the number of the offending instruction:
+		// every jump target is in range, no instruction falls through past the end, a stop instruction is reachable,
+		// and every register read by a copy assignment is assigned on every path leading to it
+		void verify();
+		// Verifies the program reusing the verification of its previous version, nullptr if there is none:
+		// only the instructions with the numbers in [first, last) differ from those of the previous version
+		void verify(const verification* previous, size_t first, size_t last);
 
 		// Parsing input registers
 		void parse_input_registers(const std::string& line);
@@ -399,9 +927,6 @@ namespace IMD {
 
 	// Extended register machine class
 	class extended_register_machine : public basic_register_machine {
-	protected:
-		friend class composition_instruction;
-
 	protected:
 
 		// Extended register machine lexer class
@@ -421,36 +946,77 @@ namespace IMD {
 		class extended_parser : public basic_parser {
 		public:
 			// Constructor
-			explicit extended_parser(const std::vector<token>& tokens) noexcept;
+			explicit extended_parser(const std::vector<token>& tokens, instruction_arena& arena, name_pool& names) noexcept;
 
 			// Destructor
 			~extended_parser() = default;
 
-			// Returns a unique pointer to the instruction
-			std::unique_ptr<instruction> make_instruction() override;
+			// Returns a pointer to the instruction created in the arena
+			instruction* make_instruction() override;
+
+			// Returns a pointer to the copy assignment instruction created in the arena
+			instruction* make_copy_assignment_instruction() override;
 
-			// Returns a unique pointer to the copy assignment instruction
-			std::unique_ptr<instruction> make_copy_assignment_instruction() override;
+			// Returns a pointer to the condition or comparison instruction created in the arena
+			instruction* make_condition_instruction() override;
 
-			// Returns a unique pointer to the move assignment instruction
-			virtual std::unique_ptr<instruction> make_move_assignment_instruction();
+			// Returns a pointer to the move assignment instruction created in the arena
+			virtual instruction* make_move_assignment_instruction();
 
-			// Returns a unique pointer to the goto instruction
-			virtual std::unique_ptr<instruction> make_goto_assignment_instruction();
+			// Returns a pointer to the goto instruction created in the arena
+			virtual instruction* make_goto_assignment_instruction();
 
-			// Returns a unique pointer to the composition instruction
-			virtual std::unique_ptr<instruction> make_composition_command();
+			// Returns a pointer to the composition instruction created in the arena
+			virtual instruction* make_composition_command();
+
+			// Returns a pointer to the call instruction created in the arena: CALL file arguments RESULT results
+			virtual instruction* make_call_instruction();
+		};
+
+		// File of the composition graph: the files it calls before and after its instructions and the position range of the instructions
+		struct composition_node {
+			// Name of the file
+			std::string filename;
+			// Files called before the instructions, in the order of the lines
+			std::vector<std::string> header;
+			// Files called after the instructions, in the order of the lines; they are executed from the last one
+			std::vector<std::string> footer;
+			// The file has instructions, otherwise it consists of composition lines only
+			bool has_body;
+			// Position range of the instructions, the end is 0 without a footer
+			std::streampos begin;
+			std::streampos end;
 		};
 
 	protected:
-		// Stack for controlling the order of processing RM files: pair <file name, position to continue reading from>
-		std::stack<std::pair<std::string, std::pair<std::optional<std::streampos>, std::optional<std::streampos>>>> _file_stack;
 		// 4 KB - standard read block
-		const size_t BUFFER_SIZE{4096};
+		static constexpr size_t BUFFER_SIZE{ 4096 };
+
+		// Flag of the lazy mode: instructions are parsed when the carriage first reaches them
+		bool _is_lazy;
+		// Text of the stage of a lazily loaded program
+		std::shared_ptr<const std::string> _source;
+		// Offsets of the instructions in the text of the stage, by instruction number
+		std::shared_ptr<const std::vector<uint32_t>> _offsets;
+
+		// Programs called by the call instructions by file name, each loaded once for the program and all programs it calls
+		using subroutine_table = std::unordered_map<std::string, std::unique_ptr<extended_register_machine>>;
+		// Called programs, shared by the clones of the machine
+		std::shared_ptr<subroutine_table> _subroutines;
+
+	public:
+		// Composition stage: file name and the position range of its instructions
+		struct stage {
+			std::string filename;
+			std::streampos begin;
+			std::streampos end;
+		};
 
 	public:
 		// Constructor
-		extended_register_machine(const std::string& filename, bool is_verbose = false) noexcept;
+		// In the lazy mode loading only indexes the instruction lines and checks their numbering, every instruction is parsed
+		// the first time it is executed; such a program is not verified, and an invalid line is reported when it is reached
+		extended_register_machine(const std::string& filename, bool is_verbose = false, bool is_lazy = false) noexcept;
 
 		// Copy constructor
 		extended_register_machine(const extended_register_machine&) = delete;
@@ -462,18 +1028,221 @@ namespace IMD {
 
 		// Launch of RM
 		void run() override;
-		// Reboot RM
-		void reboot() override;
+
+		// Returns the composition stages in the order of their execution
+		// The composition graph is built first: the distinct files are scanned in parallel level by level, the called files are
+		// taken relative to the directory of the calling file; a cyclic composition is reported with the cycle
+		std::vector<stage> resolve_stages();
+		// Loads every composition stage into its own register machine
+		// The distinct stages are loaded in parallel, a stage repeated in the composition is a clone of its first occurrence
+		std::vector<std::unique_ptr<extended_register_machine>> load_stages();
+		// Loads the composition stages again: a stage loaded before from the same file is reloaded from its previous machine
+		std::vector<std::unique_ptr<extended_register_machine>> reload_stages(const std::vector<std::unique_ptr<extended_register_machine>>& previous);
+
+		// Returns a machine executing the same loaded program: the instructions are shared, the registers are not
+		std::unique_ptr<extended_register_machine> clone() const;
+		// Loads a new version of the loaded stage from the given position range of its file
+		// Only the instruction lines differing from this version are lexed and parsed, the other instructions are shared,
+		// and this version stays valid for the launches still using it
+		std::unique_ptr<extended_register_machine> reload(std::pair<std::streampos, std::streampos> barier) const;
 
 	protected:
+		// Number of reloads sharing instructions after which the stage is parsed anew, so that old storages are released
+		static constexpr size_t MAX_RETAINED{ 16 };
+
 		// Load all instruction
 		void load_all_instructions(std::pair<std::streampos, std::streampos> barier = {0, 0}, std::ios_base::seekdir border = std::ios::beg) override;
+		// Loads the instructions, the lines equal to those of the previous version take its instructions
+		void load_instructions(std::pair<std::streampos, std::streampos> barier, std::ios_base::seekdir border, const extended_register_machine* previous);
+		// Parses the instruction with the given number of a lazily loaded program
+		instruction* parse_instruction(size_t number) override;
+		// Numbers the stages with the composition file in the sampling profiler, so that their samples are stacked under it
+		void mark_composition(std::vector<std::unique_ptr<extended_register_machine>>& stages) const;
+		// Loads the called programs and binds the call instructions to them; a program calling an unverified one is not verified
+		void link_subroutines();
+		// Binds the call instructions to the programs of the table, the missing ones are loaded into it first
+		// A called program is added before its own calls are linked, so recursive calls refer to the same machine
+		void link(subroutine_table& table);
 
 		// Follow all instructions
 		void execute_all_instructions() override;
 
-		// Process all composition instructions in the current file and add included files to the stack
-		void _include_files(const std::string& filename);
+		// Reads the composition lines of the file: the lines before its instructions and the lines after them
+		static composition_node scan_composition(const std::string& filename);
+	};
+
+	// Resumable launch of a composition: the stages are executed one after another within step and time budgets,
+	// so that one thread can interleave many launches and every call has a bounded latency
+	class execution {
+	private:
+		// Number of instructions executed between the checks of the resource limits
+		static constexpr size_t METER_PERIOD{ 4096 };
+
+		// Register machines of the composition stages
+		std::vector<std::unique_ptr<extended_register_machine>> _stages;
+		// Number of the current stage
+		size_t _stage;
+		// Number of instructions executed by the finished stages
+		size_t _steps;
+		// State of the launch
+		execution_state _state;
+		// Error message of the failed launch, empty if there was no error
+		std::string _error;
+		// Ticks of the metrics clock at the start of the launch, for the metrics of the first stage
+		uint64_t _started;
+		// Metrics of the program file of the first stage, nullptr while they are not recorded
+		program_metrics* _metrics;
+
+	public:
+		// Constructor
+		explicit execution(std::vector<std::unique_ptr<extended_register_machine>> stages) noexcept;
+		// Constructor
+		explicit execution(const std::string& filename);
+
+		// Copy constructor
+		execution(const execution&) = delete;
+		// Assignment operator
+		execution& operator=(const execution&) = delete;
+
+		// Destructor
+		~execution() = default;
+
+		// Prepares a launch on the given values of the input registers
+		void start(const std::vector<int>& arguments);
+		// Continues the launch for at most max_steps instructions and max_time, returns the state of the launch
+		execution_state resume(size_t max_steps, std::chrono::microseconds max_time = std::chrono::microseconds::max());
+		// Launch on the given values of the input registers under resource limits
+		// The budgets are counted down by slices of METER_PERIOD instructions, the clock and the number of registers
+		// are read only between slices: a launch may outrun the time limit or create extra registers within one slice
+		metered_result run(const std::vector<int>& arguments, const execution_limits& limits);
+		// Returns the register machines of the stages, the launch is left without stages
+		std::vector<std::unique_ptr<extended_register_machine>> release() noexcept;
+
+		// Returns the state of the launch
+		execution_state state() const noexcept;
+		// Returns the values of the output registers of the current stage, of the last one after the launch is halted
+		std::vector<int> results() const;
+		// Returns the error message of the failed launch
+		const std::string& error() const noexcept;
+		// Returns the number of instructions executed since the start of the launch
+		size_t steps() const noexcept;
+		// Returns the number of the current stage
+		size_t stage() const noexcept;
+
+	private:
+		// Records the time and the number of instructions of the finished launch
+		void record() noexcept;
+	};
+
+	// Bounded lock-free single-producer/single-consumer queue
+	// A thread waiting for the other side spins for a while and then parks on the position it waits to change
+	template <typename T>
+	class spsc_queue {
+	private:
+		// Number of attempts before a waiting thread parks
+		static constexpr size_t SPIN_LIMIT{ 64 };
+
+		// Ring buffer, one slot is always kept free to distinguish a full queue from an empty one
+		std::vector<T> _buffer;
+		// Position of the next element to read, written only by the consumer
+		alignas(64) std::atomic<size_t> _head;
+		// Position of the next element to write, written only by the producer
+		alignas(64) std::atomic<size_t> _tail;
+
+	public:
+		// Constructor
+		explicit spsc_queue(size_t capacity) : _buffer(capacity + 1), _head(0), _tail(0) {}
+
+		// Copy constructor
+		spsc_queue(const spsc_queue&) = delete;
+		// Assignment operator
+		spsc_queue& operator=(const spsc_queue&) = delete;
+
+		// Destructor
+		~spsc_queue() = default;
+
+		// Adds an element to the queue, returns false if the queue is full
+		bool try_push(T& value) {
+			size_t tail = this->_tail.load(std::memory_order_relaxed);
+			size_t next = (tail + 1) % this->_buffer.size();
+			if (next == this->_head.load(std::memory_order_acquire))
+				return false;
+			this->_buffer[tail] = std::move(value);
+			this->_tail.store(next, std::memory_order_release);
+			this->_tail.notify_one();
+			return true;
+		}
+		// Extracts an element from the queue, returns false if the queue is empty
+		bool try_pop(T& value) {
+			size_t head = this->_head.load(std::memory_order_relaxed);
+			if (head == this->_tail.load(std::memory_order_acquire))
+				return false;
+			value = std::move(this->_buffer[head]);
+			this->_head.store((head + 1) % this->_buffer.size(), std::memory_order_release);
+			this->_head.notify_one();
+			return true;
+		}
+
+		// Adds an element to the queue, waiting for a free slot
+		void push(T value) {
+			for (size_t attempts{ 0 }; !this->try_push(value); ++attempts) {
+				if (attempts < SPIN_LIMIT) {
+					std::this_thread::yield();
+					continue;
+				}
+				// The queue is full while the head stays where it is, the wait returns at once if it has moved
+				auto head = (this->_tail.load(std::memory_order_relaxed) + 1) % this->_buffer.size();
+				this->_head.wait(head, std::memory_order_acquire);
+			}
+		}
+		// Extracts an element from the queue, waiting for it to appear
+		T pop() {
+			T value{};
+			for (size_t attempts{ 0 }; !this->try_pop(value); ++attempts) {
+				if (attempts < SPIN_LIMIT) {
+					std::this_thread::yield();
+					continue;
+				}
+				// The queue is empty while the tail stays at the head, the wait returns at once if it has moved
+				this->_tail.wait(this->_head.load(std::memory_order_relaxed), std::memory_order_acquire);
+			}
+			return value;
+		}
+	};
+
+	// Pipelined execution of the composition: every stage runs on its own thread
+	// and passes its output registers to the next stage through a bounded queue
+	class pipeline {
+	private:
+		// Tuple of register values, std::nullopt marks the end of the stream
+		using tuple = std::optional<std::vector<int>>;
+
+		// Register machines of the composition stages
+		std::vector<std::unique_ptr<extended_register_machine>> _stages;
+		// Capacity of the queues between stages
+		size_t _capacity;
+
+	public:
+		// Constructor
+		explicit pipeline(const std::string& filename, size_t capacity = 1024);
+
+		// Copy constructor
+		pipeline(const pipeline&) = delete;
+		// Assignment operator
+		pipeline& operator=(const pipeline&) = delete;
+
+		// Destructor
+		~pipeline() = default;
+
+		// Launch of the pipeline on a vector of input tuples, returns the output tuples in the same order
+		std::vector<std::vector<int>> run(const std::vector<std::vector<int>>& inputs);
+		// Launch of the pipeline on a stream of input tuples, one tuple per line
+		void run(std::istream& is, std::ostream& os);
+
+	private:
+		// Launch of the pipeline: source returns input tuples until std::nullopt, sink receives output tuples
+		template <typename Source, typename Sink>
+		void execute(Source source, Sink sink);
 	};
 }
 
@@ -0,0 +1,158 @@
+﻿#include "scheduler.h"
+
+#include <algorithm>
+
+namespace IMD {
+
+	// Implementation of the scheduler
+
+	// Constructor
+	scheduler::scheduler(size_t workers, size_t quantum) : _quantum(std::max<size_t>(quantum, 1)), _queues(), _workers(), _next_id(0), _pending(0), _idle(0), _epoch(0), _steals(0), _is_stopped(false), _results(), _mutex(), _work_available(), _all_finished() {
+		workers = std::max<size_t>(workers, 1);
+		for (size_t i{ 0 }; i < workers; ++i)
+			this->_queues.push_back(std::make_unique<worker_queue>());
+		for (size_t i{ 0 }; i < workers; ++i)
+			this->_workers.emplace_back(&scheduler::work, this, i);
+	}
+
+	// Destructor: stops the workers, unfinished jobs are dropped
+	scheduler::~scheduler() {
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_is_stopped = true;
+		}
+		this->_work_available.notify_all();
+		for (auto& worker : this->_workers)
+			worker.join();
+	}
+
+	// Starts the launch on the given values of the input registers and schedules it, returns the job identifier
+	size_t scheduler::submit(std::unique_ptr<execution> launch, const std::vector<int>& arguments) {
+		auto id = this->_next_id++;
+		auto new_job = std::make_unique<job>(job{ id, std::move(launch), 0, std::chrono::steady_clock::now() });
+
+		++this->_pending;
+
+		try {
+			new_job->launch->start(arguments);
+		}
+		catch (const std::exception& e) { // The job fails without being scheduled
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_results.push_back({ id, execution_state::error, {}, e.what(), 0, 0, std::chrono::microseconds::zero() });
+			--this->_pending;
+			return id;
+		}
+
+		this->put(id % this->_queues.size(), std::move(new_job)); // New jobs are spread over the workers in turn
+		this->signal();
+		return id;
+	}
+
+	// Waits for all submitted jobs, returns their results ordered by identifier
+	std::vector<job_result> scheduler::wait() {
+		std::unique_lock<std::mutex> lock(this->_mutex);
+		this->_all_finished.wait(lock, [this]() { return this->_pending == 0; });
+
+		auto results = std::move(this->_results);
+		this->_results.clear();
+		std::sort(results.begin(), results.end(), [](const job_result& x, const job_result& y) { return x.id < y.id; });
+		return results;
+	}
+
+	// Returns the number of jobs taken from the deques of other workers
+	size_t scheduler::steals() const noexcept {
+		return this->_steals;
+	}
+
+	// Worker loop
+	void scheduler::work(size_t index) {
+		while (!this->_is_stopped) {
+			auto epoch = this->_epoch.load();
+			auto current = this->take(index);
+
+			if (!current) { // Nothing to run or to steal: sleep until new jobs appear, a job put after the search wakes the worker at once
+				std::unique_lock<std::mutex> lock(this->_mutex);
+				++this->_idle;
+				this->_work_available.wait(lock, [this, epoch]() { return this->_is_stopped || this->_epoch != epoch; });
+				--this->_idle;
+				continue;
+			}
+
+			++current->slices;
+			if (current->launch->resume(this->_quantum) == execution_state::running)
+				this->put(index, std::move(current)); // The quantum is exhausted: the job goes back and may be stolen
+			else
+				this->finish(*current);
+		}
+	}
+
+	// Takes a job from the own deque or steals one from another worker
+	std::unique_ptr<scheduler::job> scheduler::take(size_t index) {
+		{ // The owner takes jobs from the front, so that the jobs of its deque are sliced in turn
+			auto& own = *this->_queues[index];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.jobs.empty()) {
+				auto result = std::move(own.jobs.front());
+				own.jobs.pop_front();
+				return result;
+			}
+		}
+
+		for (size_t i{ 1 }; i < this->_queues.size(); ++i) { // Thieves take jobs from the back
+			auto& victim = *this->_queues[(index + i) % this->_queues.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.jobs.empty()) {
+				auto result = std::move(victim.jobs.back());
+				victim.jobs.pop_back();
+				++this->_steals;
+				return result;
+			}
+		}
+
+		return nullptr;
+	}
+
+	// Adds a job to the deque of the worker
+	void scheduler::put(size_t index, std::unique_ptr<job> job) {
+		size_t size{ 0 };
+		{
+			auto& own = *this->_queues[index];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			own.jobs.push_back(std::move(job));
+			size = own.jobs.size();
+		}
+
+		if (this->_idle > 0 && size > 1) // More than one runnable job: an idle worker can steal
+			this->signal();
+	}
+
+	// Wakes an idle worker
+	void scheduler::signal() {
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			++this->_epoch;
+		}
+		this->_work_available.notify_one();
+	}
+
+	// Records the result of a finished job
+	void scheduler::finish(job& job) {
+		auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - job.submitted);
+
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_results.push_back({
+				job.id,
+				job.launch->state(),
+				job.launch->state() == execution_state::halted ? job.launch->results() : std::vector<int>{},
+				std::string(job.launch->error()),
+				job.launch->steps(),
+				job.slices,
+				latency });
+			--this->_pending;
+		}
+
+		if (this->_pending == 0)
+			this->_all_finished.notify_all();
+	}
+}
\ No newline at end of file
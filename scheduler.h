@@ -0,0 +1,120 @@
+﻿#ifndef __REGISTER_MACHINE_SCHEDULER_
+#define __REGISTER_MACHINE_SCHEDULER_
+
+#include "register_machine.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace IMD {
+
+	// Result of a scheduled job
+	struct job_result {
+		// Job identifier returned by submit
+		size_t id;
+		// Final state of the launch: halted or error
+		execution_state state;
+		// Values of the output registers
+		std::vector<int> outputs;
+		// Error message of the failed launch
+		std::string error;
+		// Number of executed instructions
+		size_t steps;
+		// Number of time slices the job received
+		size_t slices;
+		// Time from submission to completion
+		std::chrono::microseconds latency;
+	};
+
+	// Work-stealing scheduler of resumable launches
+	// Every worker owns a deque of runnable jobs and executes each job for a bounded quantum of instructions,
+	// then returns it to the deque; a worker with an empty deque steals jobs from the other workers
+	// When a composition stage halts, the launch starts the machine of the next stage, and the job stays stealable between slices
+	class scheduler {
+	private:
+		// Runnable job: a resumable launch of a composition
+		struct job {
+			size_t id;
+			std::unique_ptr<execution> launch;
+			size_t slices;
+			std::chrono::steady_clock::time_point submitted;
+		};
+
+		// Deque of runnable jobs of a worker
+		struct worker_queue {
+			std::deque<std::unique_ptr<job>> jobs;
+			std::mutex mutex;
+		};
+
+	private:
+		// Number of instructions executed in one time slice
+		size_t _quantum;
+		// Deques of the workers
+		std::vector<std::unique_ptr<worker_queue>> _queues;
+		// Worker threads
+		std::vector<std::thread> _workers;
+		// Identifier of the next submitted job
+		std::atomic<size_t> _next_id;
+		// Number of submitted jobs that are not finished yet
+		std::atomic<size_t> _pending;
+		// Number of workers waiting for jobs
+		std::atomic<size_t> _idle;
+		// Number of wake-ups of idle workers, changed under the mutex; a worker sleeps only while it is unchanged since its last search for jobs
+		std::atomic<size_t> _epoch;
+		// Number of jobs taken from the deques of other workers
+		std::atomic<size_t> _steals;
+		// Flag of the scheduler shutdown
+		std::atomic<bool> _is_stopped;
+		// Results of the finished jobs
+		std::vector<job_result> _results;
+		// Mutex guarding the results and the sleep of idle workers
+		std::mutex _mutex;
+		// Notification of new jobs for idle workers
+		std::condition_variable _work_available;
+		// Notification of all jobs being finished
+		std::condition_variable _all_finished;
+
+	public:
+		// Constructor
+		explicit scheduler(size_t workers = std::thread::hardware_concurrency(), size_t quantum = 10000);
+
+		// Copy constructor
+		scheduler(const scheduler&) = delete;
+		// Assignment operator
+		scheduler& operator=(const scheduler&) = delete;
+
+		// Destructor: stops the workers, unfinished jobs are dropped
+		~scheduler();
+
+		// Starts the launch on the given values of the input registers and schedules it, returns the job identifier
+		// A launch that cannot be started is recorded as a failed job
+		size_t submit(std::unique_ptr<execution> launch, const std::vector<int>& arguments);
+
+		// Waits for all submitted jobs, returns their results ordered by identifier
+		std::vector<job_result> wait();
+
+		// Returns the number of jobs taken from the deques of other workers
+		size_t steals() const noexcept;
+
+	private:
+		// Worker loop
+		void work(size_t index);
+		// Takes a job from the own deque or steals one from another worker
+		std::unique_ptr<job> take(size_t index);
+		// Adds a job to the deque of the worker
+		void put(size_t index, std::unique_ptr<job> job);
+		// Wakes an idle worker
+		void signal();
+		// Records the result of a finished job
+		void finish(job& job);
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,729 @@
+﻿#include "server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace IMD {
+
+	// Helper methods
+
+	// Returns the FNV-1a hash of the given string
+	static uint64_t fnv1a(std::string_view line) noexcept {
+		uint64_t hash{ 14695981039346656037ull };
+		for (unsigned char ch : line) {
+			hash ^= ch;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Fills the address of a Unix domain socket
+	static sockaddr_un make_address(std::string_view socket_path) {
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (socket_path.size() >= sizeof(address.sun_path))
+			throw std::runtime_error("Socket path is too long: " + std::string(socket_path));
+		std::memcpy(address.sun_path, socket_path.data(), socket_path.size());
+		return address;
+	}
+
+	// Implementation of the protocol
+
+	// Appends an unsigned integer to the message
+	void protocol::write_u8(std::string& message, uint8_t value) {
+		message.push_back(static_cast<char>(value));
+	}
+	void protocol::write_u32(std::string& message, uint32_t value) {
+		for (size_t i{ 0 }; i < 4; ++i)
+			message.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+	void protocol::write_u64(std::string& message, uint64_t value) {
+		for (size_t i{ 0 }; i < 8; ++i)
+			message.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+	// Appends a signed integer to the message
+	void protocol::write_i32(std::string& message, int32_t value) {
+		protocol::write_u32(message, static_cast<uint32_t>(value));
+	}
+	// Appends a length-prefixed string to the message
+	void protocol::write_string(std::string& message, std::string_view value) {
+		protocol::write_u32(message, static_cast<uint32_t>(value.size()));
+		message.append(value);
+	}
+
+	// Constructor
+	protocol::reader::reader(std::string_view message) noexcept : _message(message), _carriage(0) {}
+
+	// Read values of the given size
+	uint8_t protocol::reader::read_u8() {
+		return static_cast<uint8_t>(this->read_bytes(1));
+	}
+	uint32_t protocol::reader::read_u32() {
+		return static_cast<uint32_t>(this->read_bytes(4));
+	}
+	uint64_t protocol::reader::read_u64() {
+		return this->read_bytes(8);
+	}
+	int32_t protocol::reader::read_i32() {
+		return static_cast<int32_t>(this->read_u32());
+	}
+	std::string protocol::reader::read_string() {
+		size_t size = this->read_u32();
+		if (this->_message.size() - this->_carriage < size)
+			throw std::runtime_error("Unexpected end of message");
+		std::string value(this->_message.substr(this->_carriage, size));
+		this->_carriage += size;
+		return value;
+	}
+
+	// Checks for the end of a message
+	bool protocol::reader::eof() const noexcept {
+		return this->_carriage >= this->_message.size();
+	}
+
+	// Number of bytes left unread
+	size_t protocol::reader::remaining() const noexcept {
+		return this->_message.size() - std::min(this->_carriage, this->_message.size());
+	}
+
+	// Reads an unsigned little-endian integer of the given size
+	uint64_t protocol::reader::read_bytes(size_t size) {
+		if (this->_message.size() - this->_carriage < size)
+			throw std::runtime_error("Unexpected end of message");
+		uint64_t value{ 0 };
+		for (size_t i{ 0 }; i < size; ++i)
+			value |= static_cast<uint64_t>(static_cast<unsigned char>(this->_message[this->_carriage + i])) << (8 * i);
+		this->_carriage += size;
+		return value;
+	}
+
+	// Sends a frame to the socket
+	void protocol::send_frame(int fd, const std::string& payload) {
+		std::string frame{};
+		frame.reserve(payload.size() + 4);
+		protocol::write_u32(frame, static_cast<uint32_t>(payload.size()));
+		frame.append(payload);
+
+		size_t sent{ 0 };
+		while (sent < frame.size()) {
+			auto count = ::send(fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+			if (count < 0) {
+				if (errno == EINTR) continue;
+				throw std::runtime_error("Error sending a frame: "s + std::strerror(errno));
+			}
+			sent += static_cast<size_t>(count);
+		}
+	}
+
+	// Receives exactly size bytes from the socket, returns false if the peer closed the connection before the first byte
+	static bool receive_bytes(int fd, char* data, size_t size) {
+		size_t received{ 0 };
+		while (received < size) {
+			auto count = ::recv(fd, data + received, size - received, 0);
+			if (count < 0) {
+				if (errno == EINTR) continue;
+				throw std::runtime_error("Error receiving a frame: "s + std::strerror(errno));
+			}
+			if (count == 0) {
+				if (received == 0) return false;
+				throw std::runtime_error("Connection closed in the middle of a frame");
+			}
+			received += static_cast<size_t>(count);
+		}
+		return true;
+	}
+
+	// Receives a frame from the socket, returns false if the peer closed the connection
+	bool protocol::receive_frame(int fd, std::string& payload) {
+		char header[4];
+		if (!receive_bytes(fd, header, sizeof(header)))
+			return false;
+
+		uint32_t size = protocol::reader(std::string_view(header, sizeof(header))).read_u32();
+		if (size > protocol::MAX_FRAME_SIZE)
+			throw std::runtime_error("Frame is too large: " + std::to_string(size));
+
+		payload.resize(size);
+		if (size != 0 && !receive_bytes(fd, payload.data(), size))
+			throw std::runtime_error("Connection closed in the middle of a frame");
+		return true;
+	}
+
+	// Implementation of the program cache
+
+	// Constructor
+	program_cache::program_cache(std::ostream* log) : _entries(), _filenames(), _mutex(), _reload_mutex(), _log(log), _watcher(*this) {}
+
+	// Constructor
+	program_cache::lease::lease(std::shared_ptr<entry> entry, std::unique_ptr<compiled_program> program) noexcept : _entry(std::move(entry)), _program(std::move(program)) {}
+
+	// Destructor
+	program_cache::lease::~lease() {
+		if (!this->_entry || !this->_program)
+			return;
+		std::lock_guard<std::mutex> lock(this->_entry->mutex);
+		this->_entry->instances.push_back(std::move(this->_program));
+	}
+
+	// Returns the program hash
+	uint64_t program_cache::lease::hash() const noexcept {
+		return this->_entry->hash;
+	}
+
+	// Launch of the program on the given values of the input registers under resource limits
+	protocol::result program_cache::lease::evaluate(const std::vector<int>& arguments, const execution_limits& limits) {
+		// The stages are lent to the launch and taken back, the launch itself does not throw
+		execution launch(std::move(*this->_program));
+		auto result = launch.run(arguments, limits);
+		*this->_program = launch.release();
+
+		if (result.limit != execution_limit::none)
+			throw std::runtime_error("The launch exceeded the limit of " + std::string(limit_name(result.limit)) + " at line " + std::to_string(result.carriage) + " of stage " + std::to_string(result.stage) + " after " + std::to_string(result.steps) + " steps");
+		if (result.state == execution_state::error)
+			throw std::runtime_error(result.error);
+
+		return { std::move(result.outputs), result.steps };
+	}
+
+	// Borrows a compiled instance of the program with the given file name
+	program_cache::lease program_cache::acquire(const std::string& filename) {
+		return this->acquire_canonical(std::filesystem::weakly_canonical(filename).string());
+	}
+
+	// Borrows a compiled instance of the program with the given hash
+	program_cache::lease program_cache::acquire(uint64_t hash) {
+		std::string filename{};
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			auto it = this->_filenames.find(hash);
+			if (it == this->_filenames.end())
+				throw std::runtime_error("Unknown program hash: " + std::to_string(hash));
+			filename = it->second;
+		}
+		return this->acquire_canonical(filename);
+	}
+
+	// Checks if the files are watched, otherwise the modification times are checked on every request
+	bool program_cache::is_watched() const noexcept {
+		return this->_watcher.is_active();
+	}
+
+	// Borrows a compiled instance of the program with the given canonical file name
+	program_cache::lease program_cache::acquire_canonical(const std::string& canonical) {
+		std::shared_ptr<entry> current{};
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			auto it = this->_entries.find(canonical);
+			if (it != this->_entries.end())
+				current = it->second;
+		}
+
+		static auto& hits = metrics_registry::global().get_counter("rm_cache_hits_total");
+		static auto& misses = metrics_registry::global().get_counter("rm_cache_misses_total");
+		static auto& clones = metrics_registry::global().get_counter("rm_cache_clones_total");
+
+		// The watcher keeps the current versions up to date, without it the modification times are checked on every request
+		if (!current || (!this->_watcher.is_active() && is_outdated(*current))) {
+			misses.add();
+			current = this->reload(canonical, current);
+		}
+		else
+			hits.add();
+
+		std::unique_ptr<compiled_program> program{};
+		{
+			std::lock_guard<std::mutex> lock(current->mutex);
+			if (!current->instances.empty()) {
+				program = std::move(current->instances.back());
+				current->instances.pop_back();
+			}
+		}
+
+		if (!program) { // All instances are busy: make one more, the instructions are shared with the prototype
+			clones.add();
+			program = clone(*current->prototype);
+		}
+
+		return lease(std::move(current), std::move(program));
+	}
+
+	// Replaces the given version of the program by a new one, returns the current version
+	std::shared_ptr<program_cache::entry> program_cache::reload(const std::string& canonical, const std::shared_ptr<entry>& outdated) {
+		std::lock_guard<std::mutex> reload_lock(this->_reload_mutex);
+
+		std::shared_ptr<entry> current{};
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			auto it = this->_entries.find(canonical);
+			if (it != this->_entries.end())
+				current = it->second;
+		}
+		if (current != outdated) // Another thread has replaced the version while this one waited
+			return current;
+
+		// The program is loaded outside the lock, the other programs keep being served
+		static auto& reloads = metrics_registry::global().get_counter("rm_cache_reloads_total");
+		reloads.add();
+		auto next = this->load(canonical, current.get());
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_entries[canonical] = next;
+			this->_filenames[next->hash] = canonical;
+		}
+
+		std::vector<std::string> files{};
+		for (const auto& [file, time] : next->files)
+			files.push_back(file);
+		this->_watcher.watch(canonical, files);
+		return next;
+	}
+
+	// Loads a new version of the program, the lines unchanged since the previous version are not parsed again
+	std::shared_ptr<program_cache::entry> program_cache::load(const std::string& filename, const entry* previous) {
+		auto result = std::make_shared<entry>();
+		result->filename = filename;
+		result->hash = fnv1a(filename);
+
+		// Modification times are taken before compiling, so an edit during the load causes one more reload
+		extended_register_machine erm(filename);
+		std::vector<std::string> files{ filename };
+		for (const auto& stage : erm.resolve_stages())
+			if (std::find(files.begin(), files.end(), stage.filename) == files.end())
+				files.push_back(stage.filename);
+		for (const auto& file : files)
+			result->files.emplace_back(file, std::filesystem::last_write_time(file));
+
+		extended_register_machine compiler(filename);
+		result->prototype = std::make_unique<compiled_program>(previous ? compiler.reload_stages(*previous->prototype) : compiler.load_stages());
+		result->instances.push_back(clone(*result->prototype));
+		return result;
+	}
+
+	// Checks if any file of the program version has changed since it was loaded
+	bool program_cache::is_outdated(const entry& entry) {
+		std::error_code error{};
+		for (const auto& [file, time] : entry.files)
+			if (std::filesystem::last_write_time(file, error) != time || error)
+				return true;
+		return false;
+	}
+
+	// Returns a new instance of the program sharing the instructions of the given one
+	std::unique_ptr<program_cache::compiled_program> program_cache::clone(const compiled_program& program) {
+		auto result = std::make_unique<compiled_program>();
+		for (const auto& stage : program)
+			result->push_back(stage->clone());
+		return result;
+	}
+
+	// Implementation of the file watcher
+
+	// Constructor
+	program_cache::watcher::watcher(program_cache& cache) : _cache(cache), _fd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)), _directories(), _programs(), _mutex(), _is_stopped(false), _thread() {
+		if (this->_fd >= 0)
+			this->_thread = std::thread(&watcher::work, this);
+	}
+
+	// Destructor: stops the thread
+	program_cache::watcher::~watcher() {
+		this->_is_stopped = true;
+		if (this->_thread.joinable())
+			this->_thread.join();
+		if (this->_fd >= 0)
+			::close(this->_fd);
+	}
+
+	// Checks if the files are watched, otherwise the cache polls their modification times
+	bool program_cache::watcher::is_active() const noexcept {
+		return this->_fd >= 0;
+	}
+
+	// Watches the files of the program with the given canonical name
+	void program_cache::watcher::watch(const std::string& program, const std::vector<std::string>& files) {
+		if (!this->is_active())
+			return;
+
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		for (const auto& file : files) {
+			std::error_code error{};
+			auto canonical = std::filesystem::weakly_canonical(file, error);
+			if (error)
+				continue;
+
+			// A directory watched already keeps its descriptor
+			auto directory = canonical.parent_path();
+			int descriptor = ::inotify_add_watch(this->_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (descriptor >= 0)
+				this->_directories[descriptor] = directory;
+			this->_programs[canonical.string()].insert(program);
+		}
+	}
+
+	// Thread loop: reloads the programs using the changed files
+	void program_cache::watcher::work() {
+		alignas(inotify_event) char buffer[64 * 1024];
+
+		while (!this->_is_stopped) {
+			pollfd descriptor{ this->_fd, POLLIN, 0 };
+			if (::poll(&descriptor, 1, POLL_INTERVAL_MS) <= 0)
+				continue;
+
+			// All pending events are read first, so that a program changed by several writes is reloaded once
+			std::unordered_set<std::string> changed{};
+			ssize_t size{ 0 };
+			while ((size = ::read(this->_fd, buffer, sizeof(buffer))) > 0) {
+				std::lock_guard<std::mutex> lock(this->_mutex);
+				for (char* position = buffer; position < buffer + size; ) {
+					const auto* event = reinterpret_cast<const inotify_event*>(position);
+					position += sizeof(inotify_event) + event->len;
+
+					auto directory = this->_directories.find(event->wd);
+					if (event->len == 0 || directory == this->_directories.end())
+						continue;
+					auto programs = this->_programs.find((directory->second / event->name).string());
+					if (programs != this->_programs.end())
+						changed.insert(programs->second.begin(), programs->second.end());
+				}
+			}
+
+			for (const auto& program : changed) {
+				std::shared_ptr<entry> current{};
+				{
+					std::lock_guard<std::mutex> lock(this->_cache._mutex);
+					auto it = this->_cache._entries.find(program);
+					if (it != this->_cache._entries.end())
+						current = it->second;
+				}
+
+				try { // A program that fails to load keeps being served in its previous version
+					this->_cache.reload(program, current);
+				}
+				catch (const std::exception& e) {
+					static auto& errors = metrics_registry::global().get_counter("rm_cache_reload_errors_total");
+					errors.add();
+					if (this->_cache._log)
+						*this->_cache._log << "Reload error: " << e.what() << std::endl;
+				}
+			}
+		}
+	}
+
+	// Implementation of the server
+
+	// Constructor
+	server::server(std::string_view socket_path, size_t workers, const execution_limits& limits) : _socket_path(socket_path), _workers(std::max<size_t>(workers, 1)), _limits(limits), _cache(&std::cerr), _connections(), _idle(), _wake{ -1, -1 }, _mutex(), _condition() {}
+
+	// Launch of the server, does not return
+	void server::run() {
+		int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listener < 0)
+			throw std::runtime_error("Error creating a socket: "s + std::strerror(errno));
+
+		auto address = make_address(this->_socket_path);
+		::unlink(this->_socket_path.c_str()); // The socket file of a previous launch is replaced
+		if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listener, SOMAXCONN) < 0) {
+			::close(listener);
+			throw std::runtime_error("Error listening on " + this->_socket_path + ": " + std::strerror(errno));
+		}
+
+		if (::pipe2(this->_wake, O_NONBLOCK | O_CLOEXEC) < 0) {
+			::close(listener);
+			throw std::runtime_error("Error creating a pipe: "s + std::strerror(errno));
+		}
+
+		for (size_t i{ 0 }; i < this->_workers; ++i)
+			std::thread(&server::work, this).detach();
+
+		// The idle connections are polled here, so a worker is busy only while a request is executed
+		std::vector<pollfd> descriptors{};
+		while (true) {
+			descriptors.assign({ { listener, POLLIN, 0 }, { this->_wake[0], POLLIN, 0 } });
+			{
+				std::lock_guard<std::mutex> lock(this->_mutex);
+				for (int fd : this->_idle)
+					descriptors.push_back({ fd, POLLIN, 0 });
+			}
+
+			if (::poll(descriptors.data(), descriptors.size(), -1) < 0) {
+				if (errno == EINTR) continue;
+				throw std::runtime_error("Error polling the connections: "s + std::strerror(errno));
+			}
+
+			if (descriptors[1].revents & POLLIN) {
+				char buffer[64];
+				while (::read(this->_wake[0], buffer, sizeof(buffer)) > 0);
+			}
+
+			std::vector<int> ready{};
+			for (size_t i{ 2 }; i < descriptors.size(); ++i)
+				if (descriptors[i].revents != 0) // Closed or failed connections are detected by the worker
+					ready.push_back(descriptors[i].fd);
+
+			if (descriptors[0].revents & POLLIN) {
+				int fd = ::accept(listener, nullptr, nullptr);
+				if (fd >= 0) {
+					std::lock_guard<std::mutex> lock(this->_mutex);
+					this->_idle.push_back(fd);
+				}
+				else if (errno != EINTR && errno != ECONNABORTED)
+					throw std::runtime_error("Error accepting a connection: "s + std::strerror(errno));
+			}
+
+			if (ready.empty())
+				continue;
+			{
+				std::lock_guard<std::mutex> lock(this->_mutex);
+				for (int fd : ready) {
+					this->_idle.erase(std::find(this->_idle.begin(), this->_idle.end(), fd));
+					this->_connections.push(fd);
+				}
+			}
+			this->_condition.notify_all();
+		}
+	}
+
+	// Worker loop: serves pending requests one at a time
+	void server::work() {
+		while (true) {
+			int fd{ -1 };
+			{
+				std::unique_lock<std::mutex> lock(this->_mutex);
+				this->_condition.wait(lock, [this]() { return !this->_connections.empty(); });
+				fd = this->_connections.front();
+				this->_connections.pop();
+			}
+
+			if (!this->serve(fd)) {
+				::close(fd);
+				continue;
+			}
+			{
+				std::lock_guard<std::mutex> lock(this->_mutex);
+				this->_idle.push_back(fd);
+			}
+			char signal{ 0 };
+			while (::write(this->_wake[1], &signal, 1) < 0 && errno == EINTR); // A full pipe already wakes the loop
+		}
+	}
+
+	// Serves one request of a connection, returns false if the connection is over
+	bool server::serve(int fd) {
+		try {
+			std::string request{};
+			if (!protocol::receive_frame(fd, request))
+				return false;
+			protocol::send_frame(fd, this->handle(request));
+			return true;
+		}
+		catch (const std::exception& e) { // A broken connection does not affect the other ones
+			std::cerr << "Connection error: " << e.what() << std::endl;
+			return false;
+		}
+	}
+
+	// Executes a request, returns the response payload
+	std::string server::handle(const std::string& request) {
+		std::string response{};
+		uint64_t hash{ 0 };
+
+		try {
+			protocol::reader reader(request);
+
+			auto kind = static_cast<protocol::program_kind>(reader.read_u8());
+			std::optional<program_cache::lease> lease{};
+			if (kind == protocol::program_kind::path)
+				lease.emplace(this->_cache.acquire(reader.read_string()));
+			else if (kind == protocol::program_kind::hash)
+				lease.emplace(this->_cache.acquire(reader.read_u64()));
+			else
+				throw std::runtime_error("Unknown program kind: " + std::to_string(static_cast<int>(kind)));
+			hash = lease->hash();
+
+			// Sizes come from the client, so they are checked against the payload before anything is allocated
+			uint32_t count = reader.read_u32();
+			if (count > reader.remaining() / 4)
+				throw std::runtime_error("Tuple count exceeds the request size: " + std::to_string(count));
+			std::string body{};
+			protocol::write_u32(body, count);
+			for (uint32_t i{ 0 }; i < count; ++i) {
+				uint32_t arity = reader.read_u32();
+				if (arity > reader.remaining() / 4)
+					throw std::runtime_error("Tuple arity exceeds the request size: " + std::to_string(arity));
+				std::vector<int> arguments(arity);
+				for (auto& x : arguments)
+					x = reader.read_i32();
+
+				auto result = lease->evaluate(arguments, this->_limits);
+				protocol::write_u64(body, result.steps);
+				protocol::write_u32(body, static_cast<uint32_t>(result.outputs.size()));
+				for (auto x : result.outputs)
+					protocol::write_i32(body, x);
+			}
+
+			if (!reader.eof())
+				throw std::runtime_error("Unexpected data at the end of the request");
+
+			protocol::write_u8(response, static_cast<uint8_t>(protocol::status::ok));
+			protocol::write_u64(response, hash);
+			response.append(body);
+		}
+		catch (const std::exception& e) {
+			response.clear();
+			protocol::write_u8(response, static_cast<uint8_t>(protocol::status::error));
+			protocol::write_u64(response, hash);
+			protocol::write_string(response, e.what());
+		}
+
+		return response;
+	}
+
+	// Implementation of the client
+
+	// Constructor
+	client::client(std::string_view socket_path) : _fd(-1), _hash(0) {
+		this->_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (this->_fd < 0)
+			throw std::runtime_error("Error creating a socket: "s + std::strerror(errno));
+
+		auto address = make_address(socket_path);
+		if (::connect(this->_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+			::close(this->_fd);
+			throw std::runtime_error("Error connecting to " + std::string(socket_path) + ": " + std::strerror(errno));
+		}
+	}
+
+	// Destructor
+	client::~client() {
+		::close(this->_fd);
+	}
+
+	// Launch of the program with the given file name on a batch of input tuples
+	std::vector<protocol::result> client::run(std::string_view filename, const std::vector<std::vector<int>>& inputs) {
+		std::string request{};
+		protocol::write_u8(request, static_cast<uint8_t>(protocol::program_kind::path));
+		protocol::write_string(request, filename);
+		protocol::write_u32(request, static_cast<uint32_t>(inputs.size()));
+		for (const auto& input : inputs) {
+			protocol::write_u32(request, static_cast<uint32_t>(input.size()));
+			for (auto x : input)
+				protocol::write_i32(request, x);
+		}
+		return this->exchange(request);
+	}
+
+	// Launch of the program with the given hash on a batch of input tuples
+	std::vector<protocol::result> client::run(uint64_t hash, const std::vector<std::vector<int>>& inputs) {
+		std::string request{};
+		protocol::write_u8(request, static_cast<uint8_t>(protocol::program_kind::hash));
+		protocol::write_u64(request, hash);
+		protocol::write_u32(request, static_cast<uint32_t>(inputs.size()));
+		for (const auto& input : inputs) {
+			protocol::write_u32(request, static_cast<uint32_t>(input.size()));
+			for (auto x : input)
+				protocol::write_i32(request, x);
+		}
+		return this->exchange(request);
+	}
+
+	// Returns the hash of the last program executed by the server
+	uint64_t client::hash() const noexcept {
+		return this->_hash;
+	}
+
+	// Sends a request and parses the response
+	std::vector<protocol::result> client::exchange(const std::string& request) {
+		protocol::send_frame(this->_fd, request);
+
+		std::string response{};
+		if (!protocol::receive_frame(this->_fd, response))
+			throw std::runtime_error("The server closed the connection");
+
+		protocol::reader reader(response);
+		auto status = static_cast<protocol::status>(reader.read_u8());
+		this->_hash = reader.read_u64();
+		if (status != protocol::status::ok)
+			throw std::runtime_error("Server error: " + reader.read_string());
+
+		std::vector<protocol::result> results(reader.read_u32());
+		for (auto& result : results) {
+			result.steps = reader.read_u64();
+			result.outputs.resize(reader.read_u32());
+			for (auto& x : result.outputs)
+				x = reader.read_i32();
+		}
+		return results;
+	}
+
+	// Implementation of the load generator
+
+	// Load generator: sends run requests from several connections and prints request latency percentiles
+	void generate_load(std::string_view socket_path, const std::string& filename, const std::vector<std::vector<int>>& inputs, size_t requests, size_t connections, std::ostream& os) {
+		if (inputs.empty())
+			throw std::runtime_error("The load generator needs at least one input tuple");
+		connections = std::max<size_t>(connections, 1);
+
+		std::vector<std::vector<double>> latencies(connections); // Microseconds, per connection
+		std::vector<std::exception_ptr> errors(connections);
+		std::vector<std::thread> threads{};
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i{ 0 }; i < connections; ++i) {
+			threads.emplace_back([&, i]() {
+				try {
+					client connection(socket_path);
+					connection.run(filename, { inputs.front() }); // Warm-up request: the program is compiled and its hash is known
+					auto hash = connection.hash();
+
+					std::mt19937 generator(static_cast<unsigned>(i));
+					std::uniform_int_distribution<size_t> distribution(0, inputs.size() - 1);
+					size_t count = requests / connections + (i < requests % connections ? 1 : 0);
+
+					for (size_t j{ 0 }; j < count; ++j) {
+						const auto& input = inputs[distribution(generator)];
+						auto request_start = std::chrono::steady_clock::now();
+						connection.run(hash, { input });
+						auto request_end = std::chrono::steady_clock::now();
+						latencies[i].push_back(std::chrono::duration<double, std::micro>(request_end - request_start).count());
+					}
+				}
+				catch (...) {
+					errors[i] = std::current_exception();
+				}
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		for (const auto& error : errors)
+			if (error)
+				std::rethrow_exception(error);
+
+		std::vector<double> all{};
+		for (const auto& x : latencies)
+			all.insert(all.end(), x.begin(), x.end());
+		std::sort(all.begin(), all.end());
+
+		auto percentile = [&](double p) {
+			if (all.empty()) return 0.0;
+			return all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))];
+		};
+
+		os << std::fixed << std::setprecision(1);
+		os << "requests: " << all.size() << " connections: " << connections << " throughput: " << all.size() / elapsed << " req/s" << std::endl;
+		os << "latency, us: p50 " << percentile(0.50) << " p90 " << percentile(0.90) << " p99 " << percentile(0.99) << " p99.9 " << percentile(0.999) << " max " << (all.empty() ? 0.0 : all.back()) << std::endl;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,336 @@
+﻿#ifndef __REGISTER_MACHINE_SERVER_
+#define __REGISTER_MACHINE_SERVER_
+
+#include "register_machine.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace IMD {
+
+	// Protocol of the RM server
+	//
+	// Every message is a frame: u32 payload length followed by the payload, integers are little-endian
+	// Request payload:  u8 program kind (0 - path, 1 - hash), then u32 length + path bytes or u64 hash,
+	//                   u32 number of tuples, every tuple is u32 arity followed by i32 values
+	// Response payload: u8 status (0 - ok, 1 - error), u64 program hash,
+	//                   ok: u32 number of tuples, every tuple is u64 steps, u32 arity followed by i32 values
+	//                   error: u32 length + message bytes
+	namespace protocol {
+
+		// Kind of the program reference in a request
+		enum class program_kind : uint8_t {
+			path = 0,
+			hash = 1
+		};
+
+		// Response status
+		enum class status : uint8_t {
+			ok = 0,
+			error = 1
+		};
+
+		// Maximum payload size of a frame
+		constexpr uint32_t MAX_FRAME_SIZE{ 64u << 20 };
+
+		// Output tuple of a single run
+		struct result {
+			std::vector<int> outputs;
+			uint64_t steps;
+		};
+
+		// Appends an unsigned integer to the message
+		void write_u8(std::string& message, uint8_t value);
+		void write_u32(std::string& message, uint32_t value);
+		void write_u64(std::string& message, uint64_t value);
+		// Appends a signed integer to the message
+		void write_i32(std::string& message, int32_t value);
+		// Appends a length-prefixed string to the message
+		void write_string(std::string& message, std::string_view value);
+
+		// Sequential reader of a message
+		class reader {
+		private:
+			// Message being read
+			std::string_view _message;
+			// Position of the next byte
+			size_t _carriage;
+
+		public:
+			// Constructor
+			explicit reader(std::string_view message) noexcept;
+
+			// Destructor
+			~reader() noexcept = default;
+
+			// Read values of the given size
+			uint8_t read_u8();
+			uint32_t read_u32();
+			uint64_t read_u64();
+			int32_t read_i32();
+			std::string read_string();
+
+			// Checks for the end of a message
+			bool eof() const noexcept;
+			// Number of bytes left unread
+			size_t remaining() const noexcept;
+
+		private:
+			// Reads an unsigned little-endian integer of the given size
+			uint64_t read_bytes(size_t size);
+		};
+
+		// Sends a frame to the socket
+		void send_frame(int fd, const std::string& payload);
+		// Receives a frame from the socket, returns false if the peer closed the connection
+		bool receive_frame(int fd, std::string& payload);
+	}
+
+	// Cache of compiled programs resident in the server memory
+	// A program is reloaded when any file of its composition changes: the files are watched with inotify and a changed
+	// program is reloaded in the background, only its changed lines are parsed again (polling of the modification times
+	// on every request is the fallback without inotify). The new version is swapped in for new requests,
+	// the requests holding instances of the old version finish on it
+	class program_cache {
+	public:
+		// Register machines of all composition stages of a program
+		using compiled_program = std::vector<std::unique_ptr<extended_register_machine>>;
+
+	private:
+		// Cached version of a program
+		struct entry {
+			// Canonical name of the program file
+			std::string filename;
+			// Program hash: identifies the program in requests
+			uint64_t hash;
+			// Files of the composition and their modification times at load
+			std::vector<std::pair<std::string, std::filesystem::file_time_type>> files;
+			// Instance that is never leased: the other instances are cloned from it, the next version is reloaded from it
+			std::unique_ptr<compiled_program> prototype;
+			// Compiled instances that are not used by any worker right now
+			std::vector<std::unique_ptr<compiled_program>> instances;
+			// Mutex guarding instances
+			std::mutex mutex;
+		};
+
+	public:
+		// Compiled instance of a program borrowed by a worker, returned to the cache on destruction
+		class lease {
+		private:
+			// Version of the program the instance belongs to
+			std::shared_ptr<entry> _entry;
+			// Borrowed instance
+			std::unique_ptr<compiled_program> _program;
+
+		public:
+			// Constructor
+			explicit lease(std::shared_ptr<entry> entry, std::unique_ptr<compiled_program> program) noexcept;
+
+			// Copy constructor
+			lease(const lease&) = delete;
+			// Assignment operator
+			lease& operator=(const lease&) = delete;
+			// Move constructor
+			lease(lease&&) noexcept = default;
+
+			// Destructor
+			~lease();
+
+			// Returns the program hash
+			uint64_t hash() const noexcept;
+
+			// Launch of the program on the given values of the input registers under resource limits,
+			// throws if the launch fails or exceeds a limit
+			protocol::result evaluate(const std::vector<int>& arguments, const execution_limits& limits = {});
+		};
+
+	private:
+		// Watcher of the program files: a change of a file reloads every program whose composition uses it
+		// Directories are watched rather than files, so that editors replacing a file by renaming it are noticed too
+		class watcher {
+		private:
+			// Interval of checking the shutdown flag while waiting for events
+			static constexpr int POLL_INTERVAL_MS{ 100 };
+
+			// Cache reloading the programs
+			program_cache& _cache;
+			// inotify descriptor, -1 if inotify is unavailable
+			int _fd;
+			// Watched directories by watch descriptor
+			std::unordered_map<int, std::filesystem::path> _directories;
+			// Canonical names of the programs using a file, by canonical file name
+			std::unordered_map<std::string, std::unordered_set<std::string>> _programs;
+			// Mutex guarding the dictionaries
+			std::mutex _mutex;
+			// Flag of the watcher shutdown
+			std::atomic<bool> _is_stopped;
+			// Thread waiting for the events
+			std::thread _thread;
+
+		public:
+			// Constructor
+			explicit watcher(program_cache& cache);
+
+			// Copy constructor
+			watcher(const watcher&) = delete;
+			// Assignment operator
+			watcher& operator=(const watcher&) = delete;
+
+			// Destructor: stops the thread
+			~watcher();
+
+			// Checks if the files are watched, otherwise the cache polls their modification times
+			bool is_active() const noexcept;
+			// Watches the files of the program with the given canonical name
+			void watch(const std::string& program, const std::vector<std::string>& files);
+
+		private:
+			// Thread loop: reloads the programs using the changed files
+			void work();
+		};
+
+	private:
+		// Current versions of programs by canonical file name
+		std::unordered_map<std::string, std::shared_ptr<entry>> _entries;
+		// Canonical file names by program hash
+		std::unordered_map<uint64_t, std::string> _filenames;
+		// Mutex guarding the dictionaries
+		std::mutex _mutex;
+		// Mutex serializing the reloads, so that a version is reloaded once
+		std::mutex _reload_mutex;
+		// Stream reporting the failed background reloads, nullptr if they are only counted by the metrics
+		std::ostream* _log;
+		// Watcher of the program files, declared last to be stopped first
+		watcher _watcher;
+
+	public:
+		// Constructor
+		explicit program_cache(std::ostream* log = nullptr);
+
+		// Copy constructor
+		program_cache(const program_cache&) = delete;
+		// Assignment operator
+		program_cache& operator=(const program_cache&) = delete;
+
+		// Destructor
+		~program_cache() = default;
+
+		// Borrows a compiled instance of the program with the given file name
+		lease acquire(const std::string& filename);
+		// Borrows a compiled instance of the program with the given hash
+		lease acquire(uint64_t hash);
+
+		// Checks if the files are watched, otherwise the modification times are checked on every request
+		bool is_watched() const noexcept;
+
+	private:
+		// Borrows a compiled instance of the program with the given canonical file name
+		lease acquire_canonical(const std::string& canonical);
+		// Replaces the given version of the program by a new one, returns the current version
+		// If another thread has replaced the version already, its replacement is returned
+		std::shared_ptr<entry> reload(const std::string& canonical, const std::shared_ptr<entry>& outdated);
+		// Loads a new version of the program, the lines unchanged since the previous version are not parsed again
+		std::shared_ptr<entry> load(const std::string& filename, const entry* previous);
+		// Checks if any file of the program version has changed since it was loaded
+		static bool is_outdated(const entry& entry);
+		// Returns a new instance of the program sharing the instructions of the given one
+		static std::unique_ptr<compiled_program> clone(const compiled_program& program);
+	};
+
+	// RM server: keeps compiled programs resident and executes requests received over a Unix domain socket
+	class server {
+	private:
+		// Path of the socket
+		std::string _socket_path;
+		// Number of workers
+		size_t _workers;
+		// Resource limits of every launch
+		execution_limits _limits;
+		// Compiled programs
+		program_cache _cache;
+		// Connections with a pending request waiting for a worker
+		std::queue<int> _connections;
+		// Connections waiting for the next request of the peer
+		std::vector<int> _idle;
+		// Pipe waking the polling loop when a connection becomes idle again
+		int _wake[2];
+		// Mutex guarding the queue and the idle connections
+		std::mutex _mutex;
+		// Notification of a pending request
+		std::condition_variable _condition;
+
+	public:
+		// Constructor
+		explicit server(std::string_view socket_path, size_t workers = std::thread::hardware_concurrency(), const execution_limits& limits = {});
+
+		// Copy constructor
+		server(const server&) = delete;
+		// Assignment operator
+		server& operator=(const server&) = delete;
+
+		// Destructor
+		~server() = default;
+
+		// Launch of the server, does not return
+		void run();
+
+	private:
+		// Worker loop: serves pending requests one at a time
+		void work();
+		// Serves one request of a connection, returns false if the connection is over
+		bool serve(int fd);
+		// Executes a request, returns the response payload
+		std::string handle(const std::string& request);
+	};
+
+	// RM server client
+	class client {
+	private:
+		// Socket of the connection
+		int _fd;
+		// Hash of the last program executed by the server
+		uint64_t _hash;
+
+	public:
+		// Constructor
+		explicit client(std::string_view socket_path);
+
+		// Copy constructor
+		client(const client&) = delete;
+		// Assignment operator
+		client& operator=(const client&) = delete;
+
+		// Destructor
+		~client();
+
+		// Launch of the program with the given file name on a batch of input tuples
+		std::vector<protocol::result> run(std::string_view filename, const std::vector<std::vector<int>>& inputs);
+		// Launch of the program with the given hash on a batch of input tuples
+		std::vector<protocol::result> run(uint64_t hash, const std::vector<std::vector<int>>& inputs);
+
+		// Returns the hash of the last program executed by the server
+		uint64_t hash() const noexcept;
+
+	private:
+		// Sends a request and parses the response
+		std::vector<protocol::result> exchange(const std::string& request);
+	};
+
+	// Load generator: sends run requests from several connections and prints request latency percentiles
+	void generate_load(std::string_view socket_path, const std::string& filename, const std::vector<std::vector<int>>& inputs, size_t requests, size_t connections, std::ostream& os);
+}
+
+#endif
\ No newline at end of file
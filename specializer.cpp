@@ -0,0 +1,392 @@
+﻿#include "specializer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+
+namespace IMD {
+
+	// Number of a position not known yet
+	static constexpr size_t npos{ std::numeric_limits<size_t>::max() };
+
+	// Returns the text of the program file
+	std::string specializer::residual_program::text() const {
+		std::string text{};
+		for (const auto& x : this->inputs)
+			text += x + " ";
+		text += "\n";
+		for (size_t i{ 0 }; i < this->code.size(); ++i)
+			text += std::to_string(i) + SEPARATOR + " " + this->code[i] + "\n";
+		for (const auto& x : this->outputs)
+			text += x + " ";
+		return text + "\n";
+	}
+
+	// Writes the program file
+	void specializer::residual_program::write(const std::string& filename) const {
+		std::ofstream ofs(filename, std::ios::trunc);
+		ofs << this->text();
+		if (!ofs)
+			throw std::runtime_error("Filename: " + filename + ". Error writing file");
+	}
+
+	bool specializer::state::operator<(const state& other) const {
+		return std::tie(this->carriage, this->values, this->unknown) < std::tie(other.carriage, other.values, other.unknown);
+	}
+
+	// Constructor: loads the program, which must consist of a single stage without call instructions
+	specializer::specializer(const std::string& filename, size_t max_variants) :
+		_machine(), _max_variants(std::max<size_t>(max_variants, 1)), _states(), _positions(), _pending(), _variants(), _branch_variants(), _code() {
+		extended_register_machine erm(filename);
+		auto stages = erm.load_stages();
+		if (stages.size() != 1)
+			throw std::runtime_error("Filename: " + filename + ". The specialized program must not be a composition");
+
+		this->_machine = std::move(stages.front());
+		for (const auto* x : this->_machine->_instructions)
+			if (x->kind() == basic_register_machine::instruction_kind::call)
+				throw std::runtime_error("Filename: " + filename + ". The instruction is not supported by the specializer: " + x->description());
+	}
+
+	// Returns the program specialized for the given values of input registers; the values must not be negative
+	specializer::residual_program specializer::specialize(const std::unordered_map<std::string, int>& bindings) {
+		const auto& machine = *this->_machine;
+		for (const auto& [name, value] : bindings) {
+			if (std::find(machine._input_registers.begin(), machine._input_registers.end(), name) == machine._input_registers.end())
+				throw std::runtime_error("Filename: " + machine._filename + ". The register " + name + " is not an input register");
+			if (value < 0)
+				throw std::runtime_error("Filename: " + machine._filename + ". The value of the register " + name + " must not be negative");
+		}
+
+		this->_states.clear();
+		this->_positions.clear();
+		this->_pending.clear();
+		this->_variants.clear();
+		this->_branch_variants.clear();
+		this->_code.clear();
+
+		// The fixed inputs are known, the other inputs are unknown, the other registers hold 0
+		state initial{ 0, {}, {} };
+		std::vector<std::string> inputs{};
+		for (const auto& x : machine._input_registers) {
+			if (auto it = bindings.find(x); it != bindings.end())
+				assign(initial, x, it->second);
+			else {
+				initial.unknown.insert(x);
+				inputs.push_back(x);
+			}
+		}
+		if (inputs.empty() && !machine._input_registers.empty())
+			inputs.push_back(machine._input_registers.front());
+
+		this->enqueue(initial);
+		for (size_t i{ 0 }; i < this->_pending.size(); ++i) {
+			auto [number, s] = this->_pending[i];
+			this->emit(number, std::move(s));
+		}
+
+		return this->finish(std::move(inputs), machine._output_registers);
+	}
+
+	// Returns the number of instructions of the program
+	size_t specializer::size() const noexcept {
+		return this->_machine->_instructions.size();
+	}
+
+	// Returns the number of the state, a new state is added to the work list
+	size_t specializer::enqueue(const state& s) {
+		auto [it, is_inserted] = this->_states.try_emplace(s, this->_positions.size());
+		if (is_inserted) {
+			this->_positions.push_back(npos);
+			this->_pending.emplace_back(it->second, s);
+			++this->_variants.try_emplace(s.carriage, s, 0).first->second.second;
+			++this->_branch_variants.try_emplace(s.carriage, s, 0).first->second.second;
+		}
+		return it->second;
+	}
+
+	// Emits the code of the state and of the states it reaches without conditions of unknown outcome
+	void specializer::emit(size_t number, state s) {
+		using basic = basic_register_machine;
+		const auto& machine = *this->_machine;
+
+		this->_positions[number] = this->_code.size();
+		const auto& [first, count] = this->_branch_variants.at(s.carriage);
+		if (count > BRANCH_VARIANTS && this->generalize(s, first) && !this->enter(s))
+			return;
+
+		for (;;) {
+			const auto* pointer = machine._instructions.at(s.carriage);
+			std::optional<bool> outcome{};
+			std::string condition{};
+
+			if (auto copy = dynamic_cast<const basic::copy_assignment_instruction*>(pointer)) {
+				auto text = this->copy_assignment(s, *copy);
+				if (!text.empty())
+					this->_code.push_back({ text, {} });
+				++s.carriage;
+			}
+			else if (auto move = dynamic_cast<const basic::move_assignment_instruction*>(pointer)) {
+				const auto& to = move->to_register();
+				const auto& from = move->from_register();
+				if (s.unknown.count(from)) {
+					this->_code.push_back({ move->description(), {} });
+					s.values.erase(to);
+					s.unknown.insert(to);
+				}
+				else
+					assign(s, to, known(s, from).value_or(0));
+				assign(s, from, 0);
+				++s.carriage;
+			}
+			else if (auto extended_condition = dynamic_cast<const basic::extended_condition_instruction*>(pointer)) {
+				// The register is compared as size_t, as the instruction does
+				const auto& compared = extended_condition->compared_register();
+				if (auto value = known(s, compared))
+					outcome = static_cast<size_t>(*value) == extended_condition->compared_value();
+				else
+					condition = IF + " " + compared + " " + EQUAL + " " + std::to_string(extended_condition->compared_value());
+			}
+			else if (auto comparison = dynamic_cast<const basic::comparison_instruction*>(pointer)) {
+				// A known compared register with an unknown operand is compared the other way round: x < y as y > x
+				static const std::string symbols[] = { EQUAL, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+				static const basic::relation reversed[] = { basic::relation::equal, basic::relation::not_equal, basic::relation::greater,
+					basic::relation::greater_equal, basic::relation::less, basic::relation::less_equal };
+				const auto& compared = comparison->compared_register();
+				const auto& operand = comparison->compared_operand();
+				auto relation = comparison->relation_type();
+				auto left = known(s, compared);
+				auto right = known(s, operand);
+				if (left && right)
+					outcome = basic::comparison_instruction::holds(relation, *left, *right);
+				else if (left)
+					condition = IF + " " + operand + " " + symbols[static_cast<size_t>(reversed[static_cast<size_t>(relation)])] + " " + std::to_string(*left);
+				else
+					condition = IF + " " + compared + " " + symbols[static_cast<size_t>(relation)] + " " + residual_operand(s, operand);
+			}
+			else if (auto basic_condition = dynamic_cast<const basic::condition_instruction*>(pointer)) {
+				const auto& compared = basic_condition->compared_register();
+				if (auto value = known(s, compared))
+					outcome = *value == 0;
+				else
+					condition = IF + " " + compared + " " + EQUAL + " 0";
+			}
+			else if (auto jump = dynamic_cast<const basic::goto_instruction*>(pointer))
+				s.carriage = jump->target_mark();
+			else if (dynamic_cast<const basic::stop_instruction*>(pointer)) {
+				// The known values of the output registers are written before the stop
+				for (const auto& x : machine._output_registers)
+					if (!s.unknown.count(x))
+						this->_code.push_back({ x + " " + COPY + " " + std::to_string(known(s, x).value_or(0)), {} });
+				this->_code.push_back({ STOP, {} });
+				return;
+			}
+			else
+				throw std::runtime_error("Filename: " + machine._filename + ". The instruction is not supported by the specializer: " + pointer->description());
+
+			if (auto condition_instruction = dynamic_cast<const basic::condition_instruction*>(pointer)) {
+				if (!outcome) { // Both outcomes are specialized later
+					auto on_true = s;
+					on_true.carriage = condition_instruction->goto_true();
+					auto on_false = std::move(s);
+					on_false.carriage = condition_instruction->goto_false();
+					auto goto_true = this->enqueue(on_true);
+					auto goto_false = this->enqueue(on_false);
+					this->_code.push_back({ condition, { goto_true, goto_false } });
+					return;
+				}
+				s.carriage = *outcome ? condition_instruction->goto_true() : condition_instruction->goto_false();
+			}
+
+			if (!this->enter(s))
+				return;
+		}
+	}
+
+	// Registers the state continuing the current code: returns false and emits a jump if the state is already emitted;
+	// the state is generalized first when its instruction has too many states
+	bool specializer::enter(state& s) {
+		for (;;) {
+			if (auto it = this->_states.find(s); it != this->_states.end()) {
+				this->_code.push_back({ GOTO, { it->second } });
+				return false;
+			}
+			auto it = this->_variants.find(s.carriage);
+			if (it == this->_variants.end() || it->second.second < this->_max_variants || !this->generalize(s, it->second.first))
+				break;
+		}
+
+		auto number = this->_positions.size();
+		this->_states.emplace(s, number);
+		this->_positions.push_back(this->_code.size());
+		++this->_variants.try_emplace(s.carriage, s, 0).first->second.second;
+		return true;
+	}
+
+	// Writes the known values differing from the first state into their registers, returns true if the state has changed
+	bool specializer::generalize(state& s, const state& first) {
+		std::vector<std::string> differing{};
+		for (const auto& [name, value] : s.values)
+			if (auto x = first.values.find(name); x == first.values.end() || x->second != value)
+				differing.push_back(name);
+		for (const auto& x : differing)
+			this->materialize(s, x);
+		return !differing.empty();
+	}
+
+	// Writes the known value of the register into it and makes it unknown
+	void specializer::materialize(state& s, const std::string& name) {
+		this->_code.push_back({ name + " " + COPY + " " + std::to_string(known(s, name).value_or(0)), {} });
+		s.values.erase(name);
+		s.unknown.insert(name);
+	}
+
+	// Returns the known value of the operand: a literal or a register with a known value
+	std::optional<int> specializer::known(const state& s, const std::string& operand) {
+		if (is_non_negative_literal(operand)) {
+			int value{ 0 };
+			if (std::from_chars(operand.data(), operand.data() + operand.size(), value).ec != std::errc())
+				return std::nullopt;
+			return value;
+		}
+		if (s.unknown.count(operand))
+			return std::nullopt;
+		auto it = s.values.find(operand);
+		return it == s.values.end() ? 0 : it->second;
+	}
+
+	// Returns the operand as it is read by the residual program: the known value as a literal, otherwise the name
+	std::string specializer::residual_operand(const state& s, const std::string& operand) {
+		if (is_non_negative_literal(operand) || s.unknown.count(operand))
+			return operand;
+		return std::to_string(known(s, operand).value_or(0));
+	}
+
+	// Sets the known value of the register
+	void specializer::assign(state& s, const std::string& name, int value) {
+		s.unknown.erase(name);
+		if (value == 0)
+			s.values.erase(name);
+		else
+			s.values[name] = value;
+	}
+
+	// Specializes a copy assignment, returns the text of the residual instruction or an empty string
+	// A negative result is left to the residual program: the known values are written as literals, which are not negative
+	std::string specializer::copy_assignment(state& s, const basic_register_machine::copy_assignment_instruction& x) {
+		using operation = basic_register_machine::operation;
+		static const std::string symbols[] = { " "s, PLUS, MINUS, MULTIPLY, DIVIDE, MODULO };
+
+		const auto& target = x.target_register();
+		auto op = x.operation_type();
+		auto left = known(s, x.left_operand());
+		auto right = op == operation::none ? left : known(s, x.right_operand());
+
+		if (left && right) {
+			auto value = op == operation::none ? *left : basic_register_machine::copy_assignment_instruction::apply(op, *left, *right);
+			if (value >= 0) {
+				assign(s, target, value);
+				return "";
+			}
+		}
+		else if ((op == operation::multiply && ((left && *left == 0) || (right && *right == 0))) || (op == operation::modulo && right && *right == 1)) {
+			assign(s, target, 0);
+			return "";
+		}
+
+		// Operations with a neutral known operand are copies: x + 0, 0 + x, x * 1, 1 * x and x / 1
+		auto left_text = residual_operand(s, x.left_operand());
+		auto right_text = op == operation::none ? ""s : residual_operand(s, x.right_operand());
+		std::optional<std::string> copied{};
+		if (op == operation::none)
+			copied = left_text;
+		else if ((op == operation::plus && right && *right == 0) || ((op == operation::multiply || op == operation::divide) && right && *right == 1))
+			copied = left_text;
+		else if ((op == operation::plus && left && *left == 0) || (op == operation::multiply && left && *left == 1))
+			copied = right_text;
+
+		if (copied && *copied == target && s.unknown.count(target))
+			return "";
+
+		s.values.erase(target);
+		s.unknown.insert(target);
+		if (copied)
+			return target + " " + COPY + " " + *copied;
+		return target + " " + COPY + " " + left_text + " " + symbols[static_cast<size_t>(op)] + " " + right_text;
+	}
+
+	// Removes jumps to jumps, unreachable instructions and jumps to the next instruction, returns the program
+	specializer::residual_program specializer::finish(std::vector<std::string> inputs, std::vector<std::string> outputs) const {
+		auto size = this->_code.size();
+		auto is_jump = [this](size_t i) { return this->_code[i].targets.size() == 1; };
+
+		// Jump targets as positions, a chain of jumps is followed to its end
+		std::vector<std::vector<size_t>> targets(size);
+		for (size_t i{ 0 }; i < size; ++i)
+			for (auto number : this->_code[i].targets) {
+				auto target = this->_positions[number];
+				for (size_t n{ 0 }; is_jump(target) && n < size; ++n)
+					target = this->_positions[this->_code[target].targets.front()];
+				targets[i].push_back(target);
+			}
+
+		std::vector<bool> is_reachable(size, false);
+		std::vector<size_t> stack{ 0 };
+		bool has_stop{ false };
+		while (!stack.empty()) {
+			auto i = stack.back();
+			stack.pop_back();
+			if (is_reachable[i])
+				continue;
+			is_reachable[i] = true;
+			if (this->_code[i].text == STOP)
+				has_stop = true;
+			else if (targets[i].empty())
+				stack.push_back(i + 1);
+			else
+				stack.insert(stack.end(), targets[i].begin(), targets[i].end());
+		}
+		if (!has_stop)
+			throw std::runtime_error("Filename: " + this->_machine->_filename + ". The program does not stop for the given values");
+
+		// A jump to the next kept instruction is removed and replaced by its target, which is not a jump
+		std::vector<bool> is_kept(is_reachable);
+		size_t next{ npos };
+		for (size_t i{ size }; i-- > 0; ) {
+			if (!is_kept[i])
+				continue;
+			if (is_jump(i) && targets[i].front() == next)
+				is_kept[i] = false;
+			else
+				next = i;
+		}
+
+		std::vector<size_t> numbers(size, npos);
+		size_t count{ 0 };
+		for (size_t i{ 0 }; i < size; ++i)
+			if (is_kept[i])
+				numbers[i] = count++;
+		auto number = [&](size_t i) {
+			while (!is_kept[i])
+				i = targets[i].front();
+			return numbers[i];
+		};
+
+		residual_program result{ std::move(inputs), {}, std::move(outputs) };
+		for (size_t i{ 0 }; i < size; ++i) {
+			if (!is_kept[i])
+				continue;
+			const auto& x = this->_code[i];
+			if (targets[i].empty())
+				result.code.push_back(x.text);
+			else if (is_jump(i))
+				result.code.push_back(GOTO + " " + std::to_string(number(targets[i].front())));
+			else
+				result.code.push_back(x.text + " " + THEN + " " + GOTO + " " + std::to_string(number(targets[i][0])) + " " + ELSE + " " + GOTO + " " + std::to_string(number(targets[i][1])));
+		}
+		return result;
+	}
+}
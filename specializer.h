@@ -0,0 +1,130 @@
+﻿#ifndef __REGISTER_MACHINE_SPECIALIZER_
+#define __REGISTER_MACHINE_SPECIALIZER_
+
+#include "register_machine.h"
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace IMD {
+
+	// Partial evaluator: specializes a program for the fixed values of some of its input registers
+	// The program is executed symbolically on states <instruction number, known register values, unknown registers>:
+	// instructions depending only on known values are evaluated, conditions on them are decided and loops over them are unrolled,
+	// the other instructions are emitted into the residual program with the known operands replaced by literals.
+	// Every state is emitted once, a state reached again becomes a jump; once an instruction has been reached in max_variants
+	// states, the known values differing from its first state are written into their registers and become unknown,
+	// so that a loop over a fixed counter is unrolled at most max_variants times and specialization always finishes.
+	// States reached through conditions of unknown outcome are generalized after BRANCH_VARIANTS of them: a known value
+	// changed by a loop with an unknown number of iterations becomes unknown instead of unrolling the loop
+	class specializer {
+	public:
+		// Residual program
+		struct residual_program {
+			// Names of the input registers: the inputs of the program that are not fixed
+			// The list of a program file must not be empty: when every input is fixed, the first one is kept and its value is not used
+			std::vector<std::string> inputs;
+			// Instructions in the order of their numbers, without the numbers
+			std::vector<std::string> code;
+			// Names of the output registers
+			std::vector<std::string> outputs;
+
+			// Returns the text of the program file
+			std::string text() const;
+			// Writes the program file
+			void write(const std::string& filename) const;
+		};
+
+	private:
+		// Symbolic state: the registers absent from both sets hold 0
+		struct state {
+			// Number of the instruction
+			size_t carriage;
+			// Known values of the registers, not equal to 0 and not negative
+			std::map<std::string, int> values;
+			// Registers with unknown values, held by the residual program
+			std::set<std::string> unknown;
+
+			bool operator<(const state& other) const;
+		};
+
+		// Residual instruction, its jump targets are numbers of states until the positions of the states are known
+		struct residual_instruction {
+			// Text of the instruction before the jump targets: the whole instruction if it has no targets
+			std::string text;
+			// Numbers of the states the instruction jumps to: one for an unconditional jump, two for a condition
+			std::vector<size_t> targets;
+		};
+
+		// Maximum number of states per instruction reached through conditions of unknown outcome
+		static constexpr size_t BRANCH_VARIANTS{ 4 };
+
+		// Machine holding the loaded instructions
+		std::unique_ptr<extended_register_machine> _machine;
+		// Maximum number of states per instruction before its known values are generalized
+		size_t _max_variants;
+
+		// Numbers of the states met during specialization
+		std::map<state, size_t> _states;
+		// Positions of the states in the residual code, npos for the states waiting in the work list
+		std::vector<size_t> _positions;
+		// States reached by a condition of unknown outcome and not specialized yet
+		std::vector<std::pair<size_t, state>> _pending;
+		// First state of every instruction and the number of its states: all states and the states reached through conditions
+		std::unordered_map<size_t, std::pair<state, size_t>> _variants;
+		std::unordered_map<size_t, std::pair<state, size_t>> _branch_variants;
+		// Residual code
+		std::vector<residual_instruction> _code;
+
+	public:
+		// Constructor: loads the program, which must consist of a single stage without call instructions
+		explicit specializer(const std::string& filename, size_t max_variants = 1000);
+
+		// Copy constructor
+		specializer(const specializer&) = delete;
+		// Assignment operator
+		specializer& operator=(const specializer&) = delete;
+
+		// Destructor
+		~specializer() = default;
+
+		// Returns the program specialized for the given values of input registers; the values must not be negative
+		residual_program specialize(const std::unordered_map<std::string, int>& bindings);
+
+		// Returns the number of instructions of the program
+		size_t size() const noexcept;
+
+	private:
+		// Returns the number of the state, a new state is added to the work list
+		size_t enqueue(const state& s);
+		// Emits the code of the state and of the states it reaches without conditions of unknown outcome
+		void emit(size_t number, state s);
+		// Registers the state continuing the current code: returns false and emits a jump if the state is already emitted;
+		// the state is generalized first when its instruction has too many states
+		bool enter(state& s);
+		// Writes the known values differing from the first state into their registers, returns true if the state has changed
+		bool generalize(state& s, const state& first);
+		// Writes the known value of the register into it and makes it unknown
+		void materialize(state& s, const std::string& name);
+
+		// Returns the known value of the operand: a literal or a register with a known value
+		static std::optional<int> known(const state& s, const std::string& operand);
+		// Returns the operand as it is read by the residual program: the known value as a literal, otherwise the name
+		static std::string residual_operand(const state& s, const std::string& operand);
+		// Sets the known value of the register
+		static void assign(state& s, const std::string& name, int value);
+
+		// Specializes a copy assignment, returns the text of the residual instruction or an empty string
+		std::string copy_assignment(state& s, const basic_register_machine::copy_assignment_instruction& x);
+		// Removes jumps to jumps, unreachable instructions and jumps to the next instruction, returns the program
+		residual_program finish(std::vector<std::string> inputs, std::vector<std::string> outputs) const;
+	};
+}
+
+#endif
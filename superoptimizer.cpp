@@ -0,0 +1,534 @@
+﻿#include "superoptimizer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace IMD {
+
+	using opcode = generated_instruction::opcode;
+
+	// Spellings of the relations in the order of their enumeration
+	static const std::string relation_symbols[] = { EQUAL, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+
+	// Returns true for the instructions passing control elsewhere than the next instruction
+	static bool is_control(opcode code) noexcept {
+		return code == opcode::branch || code == opcode::compare || code == opcode::jump || code == opcode::stop;
+	}
+
+	// Returns true for the copy assignments
+	static bool is_arithmetic(opcode code) noexcept {
+		return code == opcode::assign || code == opcode::plus || code == opcode::minus || code == opcode::multiply || code == opcode::divide || code == opcode::modulo;
+	}
+
+	// Returns the arithmetic operation of a copy assignment
+	static grammar::operation operation_of(opcode code) noexcept {
+		switch (code) {
+		case opcode::plus:
+			return grammar::operation::plus;
+		case opcode::minus:
+			return grammar::operation::minus;
+		case opcode::multiply:
+			return grammar::operation::multiply;
+		case opcode::divide:
+			return grammar::operation::divide;
+		case opcode::modulo:
+			return grammar::operation::modulo;
+		default:
+			return grammar::operation::none;
+		}
+	}
+
+	// Constructor: loads the program, which must consist of a single stage without call instructions
+	superoptimizer::superoptimizer(const std::string& filename) :
+		_filename(filename), _names(), _numbers(), _inputs(0), _outputs(), _literals{ 0, 1, 2 }, _is_basic(true), _original(), _tests(), _expected(), _steps() {
+		using basic = basic_register_machine;
+
+		extended_register_machine erm(filename);
+		auto stages = erm.load_stages();
+		if (stages.size() != 1)
+			throw std::runtime_error("Filename: " + filename + ". The superoptimized program must not be a composition");
+		const auto& machine = *stages.front();
+
+		for (const auto& x : machine._input_registers)
+			this->number(x);
+		this->_inputs = this->_names.size();
+		for (const auto& x : machine._output_registers)
+			this->_outputs.push_back(this->number(x));
+
+		for (const auto* pointer : machine._instructions) {
+			candidate_instruction x{ opcode::stop, 0, { true, 0 }, { true, 0 }, grammar::relation::equal, 0, 0 };
+			if (auto copy = dynamic_cast<const basic::copy_assignment_instruction*>(pointer)) {
+				static const opcode codes[] = { opcode::assign, opcode::plus, opcode::minus, opcode::multiply, opcode::divide, opcode::modulo };
+				x.code = codes[static_cast<size_t>(copy->operation_type())];
+				x.target = this->number(copy->target_register());
+				x.left = this->operand_of(copy->left_operand());
+				if (x.code != opcode::assign)
+					x.right = this->operand_of(copy->right_operand());
+			}
+			else if (auto move = dynamic_cast<const basic::move_assignment_instruction*>(pointer)) {
+				x.code = opcode::move;
+				x.target = this->number(move->to_register());
+				x.left = { false, static_cast<int>(this->number(move->from_register())) };
+			}
+			else if (auto condition = dynamic_cast<const basic::condition_instruction*>(pointer)) {
+				x.code = opcode::compare;
+				x.target = this->number(condition->compared_register());
+				if (auto extended_condition = dynamic_cast<const basic::extended_condition_instruction*>(pointer))
+					x.right = { true, static_cast<int>(extended_condition->compared_value()) };
+				else if (auto comparison = dynamic_cast<const basic::comparison_instruction*>(pointer)) {
+					x.relation = comparison->relation_type();
+					x.right = this->operand_of(comparison->compared_operand());
+				}
+				x.goto_true = condition->goto_true();
+				x.goto_false = condition->goto_false();
+				// A comparison with 0 is the condition of the basic RM
+				if (x.relation == grammar::relation::equal && x.right == operand{ true, 0 })
+					x.code = opcode::branch;
+			}
+			else if (auto jump = dynamic_cast<const basic::goto_instruction*>(pointer)) {
+				x.code = opcode::jump;
+				x.goto_true = jump->target_mark();
+			}
+			else if (!dynamic_cast<const basic::stop_instruction*>(pointer))
+				throw std::runtime_error("Filename: " + filename + ". The instruction is not supported by the superoptimizer: " + pointer->description());
+
+			this->_is_basic = this->_is_basic && is_basic(x);
+			this->_original.push_back(x);
+		}
+
+		if (this->_names.size() > MAX_REGISTERS)
+			throw std::runtime_error("Filename: " + filename + ". The superoptimized program must have at most " + std::to_string(MAX_REGISTERS) + " registers");
+		std::sort(this->_literals.begin(), this->_literals.end());
+		this->_literals.erase(std::unique(this->_literals.begin(), this->_literals.end()), this->_literals.end());
+	}
+
+	// Searches for an optimized program, returns the program itself if nothing better is valid
+	superoptimizer::result superoptimizer::optimize(const options& settings) {
+		std::mt19937_64 random(settings.seed);
+
+		// The test inputs: zeros, ones and random values, mostly small
+		this->_tests.clear();
+		this->_expected.clear();
+		this->_steps.clear();
+		for (size_t i{ 0 }; i < std::max<size_t>(settings.tests, 2); ++i) {
+			std::vector<int> input(this->_inputs, i == 0 ? 0 : 1);
+			if (i > 1)
+				for (auto& x : input)
+					x = static_cast<int>(random() % 4 == 0 ? random() % 1001 : random() % 11);
+
+			std::vector<int> outputs{};
+			size_t steps{ 0 };
+			if (!this->run(this->_original, input, MAX_STEPS, outputs, steps))
+				continue;
+			this->_tests.push_back(std::move(input));
+			this->_expected.push_back(std::move(outputs));
+			this->_steps.push_back(steps);
+		}
+		if (this->_tests.empty())
+			throw std::runtime_error("Filename: " + this->_filename + ". The program does not stop in " + std::to_string(MAX_STEPS) + " steps on the test inputs");
+
+		int bound{ settings.bound };
+		auto inputs = this->validation_inputs(settings, bound);
+		auto original = this->stage(this->_original);
+		std::vector<reference_result> expected{};
+		for (const auto& x : inputs)
+			expected.push_back(interpret({ this->_is_basic, 0, false, { original } }, x, MAX_STEPS));
+		auto original_steps = validate(original, inputs, expected);
+		size_t count{ 0 };
+		for (const auto& x : expected)
+			count += x.state == execution_state::halted;
+		auto mean = [count](size_t steps) { return count == 0 ? 0.0 : static_cast<double>(steps) / count; };
+
+		result outcome{ this->text(this->_original), this->_original.size(), this->_original.size(), mean(original_steps), mean(original_steps), bound, false };
+
+		// A cached result is taken if it is still valid; the hash of the text is the one of the standard library
+		std::filesystem::path cached{};
+		if (!settings.cache.empty()) {
+			std::ostringstream oss{};
+			oss << std::hex << std::hash<std::string>{}(outcome.program.text());
+			cached = settings.cache / (oss.str() + ".txt");
+			if (std::filesystem::exists(cached) && is_accepted(cached.string())) {
+				superoptimizer previous(cached.string());
+				auto steps = validate(previous.stage(previous._original), inputs, expected);
+				if (steps != std::numeric_limits<size_t>::max()) {
+					outcome.program = previous.text(previous._original);
+					outcome.optimized_size = previous._original.size();
+					outcome.optimized_steps = mean(steps);
+					outcome.is_cached = true;
+					return outcome;
+				}
+			}
+		}
+
+		// The removals are tried first, the chains start from the program and from the best removal
+		auto candidates = this->reduce();
+		auto threads = settings.threads != 0 ? settings.threads : std::max<size_t>(1, std::thread::hardware_concurrency());
+		std::vector<std::thread> workers{};
+		std::mutex mutex{};
+		std::exception_ptr error{};
+		auto best_reduction = candidates.empty() ? this->_original : *std::min_element(candidates.begin(), candidates.end(),
+			[this](const candidate& x, const candidate& y) { return this->evaluate(x).value < this->evaluate(y).value; });
+		for (size_t i{ 0 }; i < threads; ++i)
+			workers.emplace_back([&, i]() {
+				try {
+					auto found = this->search(i % 2 == 0 ? this->_original : best_reduction, settings.seed + i + 1, settings.iterations);
+					std::lock_guard lock(mutex);
+					candidates.insert(candidates.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+				}
+				catch (...) {
+					std::lock_guard lock(mutex);
+					error = std::current_exception();
+				}
+			});
+		for (auto& x : workers)
+			x.join();
+		if (error)
+			std::rethrow_exception(error);
+
+		// The candidates are validated from the cheapest one, the first valid one accepted by the machine is taken
+		std::vector<std::pair<double, candidate>> ranked{};
+		for (auto& x : candidates)
+			ranked.emplace_back(this->evaluate(x).value, std::move(x));
+		std::sort(ranked.begin(), ranked.end(), [](const auto& x, const auto& y) { return x.first < y.first; });
+		ranked.erase(std::unique(ranked.begin(), ranked.end(), [](const auto& x, const auto& y) { return x.second == y.second; }), ranked.end());
+
+		auto original_value = this->evaluate(this->_original).value;
+		auto temporary = std::filesystem::temp_directory_path() / ("rm-superoptimizer-" + std::to_string(std::hash<std::string>{}(this->_filename)) + ".txt");
+		for (size_t i{ 0 }; i < std::min(ranked.size(), MAX_VALIDATED) && ranked[i].first < original_value; ++i) {
+			const auto& code = ranked[i].second;
+			auto steps = validate(this->stage(code), inputs, expected);
+			if (steps == std::numeric_limits<size_t>::max())
+				continue;
+
+			auto program = this->text(code);
+			program.write(temporary.string());
+			auto is_valid = is_accepted(temporary.string());
+			std::filesystem::remove(temporary);
+			if (!is_valid)
+				continue;
+
+			outcome.program = std::move(program);
+			outcome.optimized_size = code.size();
+			outcome.optimized_steps = mean(steps);
+			break;
+		}
+
+		if (!cached.empty()) {
+			std::filesystem::create_directories(settings.cache);
+			outcome.program.write(cached.string());
+		}
+		return outcome;
+	}
+
+	// Returns the number of the register, a new register is numbered after the others
+	size_t superoptimizer::number(const std::string& name) {
+		auto [it, is_inserted] = this->_numbers.try_emplace(name, this->_names.size());
+		if (is_inserted)
+			this->_names.push_back(name);
+		return it->second;
+	}
+
+	// Returns the operand of a name: a literal or a register
+	superoptimizer::operand superoptimizer::operand_of(const std::string& name) {
+		if (auto value = grammar::literal_value(name)) {
+			this->_literals.push_back(*value);
+			return { true, *value };
+		}
+		return { false, static_cast<int>(this->number(name)) };
+	}
+
+	// Returns the candidate as a stage of a generated program
+	generated_stage superoptimizer::stage(const candidate& code) const {
+		auto name = [this](const operand& x) { return x.is_literal ? std::to_string(x.value) : this->_names[x.value]; };
+
+		generated_stage result{};
+		result.inputs.assign(this->_names.begin(), this->_names.begin() + this->_inputs);
+		for (auto x : this->_outputs)
+			result.outputs.push_back(this->_names[x]);
+		for (const auto& x : code)
+			result.code.push_back({ x.code, this->_names[x.target], name(x.left), x.code == opcode::assign || x.code == opcode::move ? "" : name(x.right),
+				x.goto_true, x.goto_false, x.code == opcode::compare ? relation_symbols[static_cast<size_t>(x.relation)] : "" });
+		return result;
+	}
+
+	// Returns the candidate as the text of a program file
+	specializer::residual_program superoptimizer::text(const candidate& code) const {
+		auto generated = this->stage(code);
+		specializer::residual_program result{ generated.inputs, {}, generated.outputs };
+		for (const auto& x : generated.code)
+			result.code.push_back(x.text());
+		return result;
+	}
+
+	// Returns true if the instruction belongs to the syntax of the basic RM: increments, decrements, literal assignments,
+	// conditions and the stop instruction
+	bool superoptimizer::is_basic(const candidate_instruction& x) noexcept {
+		switch (x.code) {
+		case opcode::assign:
+			return x.left.is_literal;
+		case opcode::plus:
+		case opcode::minus:
+			return x.left == operand{ false, static_cast<int>(x.target) } && x.right == operand{ true, 1 };
+		case opcode::branch:
+		case opcode::stop:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Runs the candidate for at most max_steps instructions, returns false if it does not stop in time
+	bool superoptimizer::run(const candidate& code, const std::vector<int>& arguments, size_t max_steps, std::vector<int>& outputs, size_t& steps) const {
+		std::vector<int> registers(this->_names.size(), 0);
+		std::copy(arguments.begin(), arguments.end(), registers.begin());
+		auto value = [&registers](const operand& x) { return x.is_literal ? x.value : registers[x.value]; };
+
+		size_t carriage{ 0 };
+		for (steps = 0; steps < max_steps; ++steps) {
+			if (carriage >= code.size())
+				return false;
+
+			const auto& x = code[carriage];
+			switch (x.code) {
+			case opcode::move: {
+				auto moved = registers[x.left.value];
+				registers[x.target] = moved;
+				registers[x.left.value] = 0;
+				++carriage;
+				break;
+			}
+			case opcode::branch:
+				carriage = registers[x.target] == 0 ? x.goto_true : x.goto_false;
+				break;
+			case opcode::compare:
+				carriage = grammar::holds(x.relation, registers[x.target], value(x.right)) ? x.goto_true : x.goto_false;
+				break;
+			case opcode::jump:
+				carriage = x.goto_true;
+				break;
+			case opcode::stop:
+				++steps;
+				outputs.clear();
+				for (auto y : this->_outputs)
+					outputs.push_back(registers[y]);
+				return true;
+			default:
+				registers[x.target] = grammar::apply(operation_of(x.code), value(x.left), x.code == opcode::assign ? 0 : value(x.right));
+				++carriage;
+				break;
+			}
+		}
+		return false;
+	}
+
+	// Returns the cost of the candidate on the test inputs
+	// A launch not stopping within twice the steps of the program counts as all bits of the outputs differing
+	superoptimizer::cost superoptimizer::evaluate(const candidate& code) const {
+		cost result{ 0, 0.0 };
+		double steps_total{ 0.0 };
+		std::vector<int> outputs{};
+		for (size_t i{ 0 }; i < this->_tests.size(); ++i) {
+			size_t steps{ 0 };
+			auto max_steps = 2 * this->_steps[i] + 64;
+			if (!this->run(code, this->_tests[i], max_steps, outputs, steps)) {
+				result.errors += 32 * std::max<size_t>(this->_outputs.size(), 1);
+				steps_total += static_cast<double>(max_steps);
+				continue;
+			}
+			for (size_t j{ 0 }; j < outputs.size(); ++j)
+				result.errors += std::popcount(static_cast<uint32_t>(outputs[j] ^ this->_expected[i][j]));
+			steps_total += static_cast<double>(steps);
+		}
+		result.value = ERROR_WEIGHT * static_cast<double>(result.errors) + steps_total / static_cast<double>(this->_tests.size()) + SIZE_WEIGHT * static_cast<double>(code.size());
+		return result;
+	}
+
+	// Returns a mutation of the candidate, the same candidate if the mutation does not apply
+	// The mutations remove an instruction, replace an operand, an operation, a relation, a target register or a jump target,
+	// or swap two neighbouring assignments; a candidate of a basic program stays in the basic syntax
+	superoptimizer::candidate superoptimizer::mutate(const candidate& code, std::mt19937_64& random) const {
+		static const opcode arithmetic[] = { opcode::assign, opcode::plus, opcode::minus, opcode::multiply, opcode::divide, opcode::modulo };
+
+		auto uniform = [&random](size_t bound) { return static_cast<size_t>(random() % bound); };
+		auto any_register = [&]() { return operand{ false, static_cast<int>(uniform(this->_names.size())) }; };
+		auto any_operand = [&]() { return uniform(2) == 0 ? any_register() : operand{ true, this->_literals[uniform(this->_literals.size())] }; };
+
+		auto number = uniform(code.size());
+		auto result = code;
+		auto& x = result[number];
+		switch (uniform(6)) {
+		case 0:
+			if (code.size() > 1)
+				return remove(code, number);
+			break;
+		case 1:
+			if (is_arithmetic(x.code) && (x.code == opcode::assign || uniform(2) == 0))
+				x.left = any_operand();
+			else if (is_arithmetic(x.code) || x.code == opcode::compare)
+				x.right = any_operand();
+			else if (x.code == opcode::move)
+				x.left = any_register();
+			break;
+		case 2:
+			if (is_arithmetic(x.code)) {
+				x.code = arithmetic[uniform(std::size(arithmetic))];
+				if (x.code != opcode::assign && x.right == operand{ true, 0 })
+					x.right = { true, 1 };
+			}
+			else if (x.code == opcode::compare || x.code == opcode::branch) {
+				x.code = opcode::compare;
+				x.relation = static_cast<grammar::relation>(uniform(std::size(relation_symbols)));
+			}
+			break;
+		case 3:
+			if (!is_control(x.code) || x.code == opcode::branch || x.code == opcode::compare)
+				x.target = uniform(this->_names.size());
+			break;
+		case 4:
+			if (number + 1 < result.size() && !is_control(x.code) && !is_control(result[number + 1].code))
+				std::swap(x, result[number + 1]);
+			break;
+		default:
+			if (x.code == opcode::branch || x.code == opcode::compare || x.code == opcode::jump)
+				(uniform(2) == 0 ? x.goto_true : x.goto_false) = uniform(code.size());
+			if (x.code == opcode::jump)
+				x.goto_false = x.goto_true;
+			break;
+		}
+
+		if (this->_is_basic && !is_basic(x))
+			return code;
+		return result;
+	}
+
+	// Removes the instruction, the jumps to it lead to the next one
+	superoptimizer::candidate superoptimizer::remove(const candidate& code, size_t number) {
+		auto result = code;
+		result.erase(result.begin() + number);
+		for (auto& x : result) {
+			if (x.goto_true > number)
+				--x.goto_true;
+			if (x.goto_false > number)
+				--x.goto_false;
+		}
+		return result;
+	}
+
+	// Searches with a stochastic chain, returns the correct verified candidates improving on each other
+	// A mutation is accepted if it lowers the cost, otherwise with the probability exp(-increase), so that the chain
+	// passes through incorrect candidates on its way to better correct ones
+	std::vector<superoptimizer::candidate> superoptimizer::search(const candidate& start, uint64_t seed, size_t iterations) const {
+		std::mt19937_64 random(seed);
+		std::uniform_real_distribution<double> probability(0.0, 1.0);
+
+		auto current = start;
+		auto current_cost = this->evaluate(current);
+		auto best = current_cost.errors == 0 ? current_cost.value : std::numeric_limits<double>::max();
+		std::vector<candidate> found{};
+		for (size_t i{ 0 }; i < iterations; ++i) {
+			auto proposal = this->mutate(current, random);
+			if (proposal == current)
+				continue;
+
+			auto proposal_cost = this->evaluate(proposal);
+			if (proposal_cost.value > current_cost.value && probability(random) >= std::exp(current_cost.value - proposal_cost.value))
+				continue;
+
+			current = std::move(proposal);
+			current_cost = proposal_cost;
+			if (current_cost.errors == 0 && current_cost.value < best && is_verified(this->stage(current))) {
+				best = current_cost.value;
+				found.push_back(current);
+			}
+		}
+		return found;
+	}
+
+	// Returns the correct verified candidates left by every removal of one or two instructions
+	std::vector<superoptimizer::candidate> superoptimizer::reduce() const {
+		std::vector<candidate> found{};
+		auto original_value = this->evaluate(this->_original).value;
+		auto attempt = [&](candidate code) {
+			auto c = this->evaluate(code);
+			if (c.errors == 0 && c.value < original_value && is_verified(this->stage(code)))
+				found.push_back(std::move(code));
+		};
+
+		auto size = this->_original.size();
+		for (size_t i{ 0 }; i < size && size > 1; ++i) {
+			auto removed = remove(this->_original, i);
+			attempt(removed);
+			for (size_t j{ i }; j + 1 < size && size > 2; ++j)
+				attempt(remove(removed, j));
+		}
+		return found;
+	}
+
+	// Validates the candidate by the reference interpreter on the inputs with the results of the program
+	size_t superoptimizer::validate(const generated_stage& candidate, const std::vector<std::vector<int>>& inputs, const std::vector<reference_result>& expected) {
+		generated_program program{ false, 0, false, { candidate } };
+		size_t total{ 0 };
+		for (size_t i{ 0 }; i < inputs.size(); ++i) {
+			if (expected[i].state != execution_state::halted)
+				continue;
+			auto actual = interpret(program, inputs[i], 2 * expected[i].steps + 64);
+			if (actual.state != execution_state::halted || actual.outputs != expected[i].outputs)
+				return std::numeric_limits<size_t>::max();
+			total += actual.steps;
+		}
+		return total;
+	}
+
+	// Returns the validation inputs: the random ones and every tuple up to the bound, lowered to fit MAX_EXHAUSTIVE
+	std::vector<std::vector<int>> superoptimizer::validation_inputs(const options& settings, int& bound) const {
+		std::mt19937_64 random(settings.seed ^ 0x5EED);
+		std::vector<std::vector<int>> inputs{};
+		for (size_t i{ 0 }; i < settings.validations; ++i) {
+			std::vector<int> input(this->_inputs);
+			for (auto& x : input)
+				x = static_cast<int>(random() % 2 == 0 ? random() % 101 : random() % 10001);
+			inputs.push_back(std::move(input));
+		}
+
+		// The number of tuples is (bound + 1) to the power of the number of inputs
+		auto tuples = [this](int bound) {
+			double count{ std::pow(bound + 1.0, static_cast<double>(this->_inputs)) };
+			return count;
+		};
+		while (bound >= 0 && tuples(bound) > static_cast<double>(MAX_EXHAUSTIVE))
+			--bound;
+		if (bound < 0)
+			return inputs;
+
+		std::vector<int> input(this->_inputs, 0);
+		for (;;) {
+			inputs.push_back(input);
+			size_t i{ 0 };
+			for (; i < input.size() && input[i] == bound; ++i)
+				input[i] = 0;
+			if (i == input.size())
+				break;
+			++input[i];
+		}
+		return inputs;
+	}
+
+	// Loads the candidate from the file of the program text and returns true if the machine accepts it
+	bool superoptimizer::is_accepted(const std::string& filename) {
+		try {
+			extended_register_machine erm(filename);
+			auto stages = erm.load_stages();
+			return stages.size() == 1;
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+	}
+}
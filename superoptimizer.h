@@ -0,0 +1,173 @@
+﻿#ifndef __REGISTER_MACHINE_SUPEROPTIMIZER_
+#define __REGISTER_MACHINE_SUPEROPTIMIZER_
+
+#include "differential.h"
+#include "grammar.h"
+#include "register_machine.h"
+#include "specializer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace IMD {
+
+	// Superoptimizer: searches for a program equivalent to the given one that executes fewer instructions or is shorter
+	// The search runs on the numbered registers of the program: first every removal of one or two instructions is tried,
+	// then stochastic chains, one per thread, mutate the program and accept the mutations by the Metropolis rule on a cost
+	// made of the mismatches on the test inputs, the mean number of steps and the size. The best candidates are validated
+	// by the reference interpreter on fresh random inputs and on every input tuple up to a bound, and the first valid one
+	// is loaded by the machine to pass its verifier. Results are cached by the hash of the program text
+	class superoptimizer {
+	public:
+		// Parameters of the search
+		struct options {
+			// Number of proposed mutations per chain
+			size_t iterations{ 200000 };
+			// Number of chains searching in parallel, 0 for the number of cores
+			size_t threads{ 0 };
+			// Number of the random test inputs of the search and of the validation
+			size_t tests{ 32 };
+			size_t validations{ 1000 };
+			// Input tuples with every value up to the bound are checked exhaustively, the bound is lowered for many inputs
+			int bound{ 16 };
+			// Seed of the random engines
+			uint64_t seed{ 1 };
+			// Directory of the cached results, empty for no cache
+			std::filesystem::path cache{};
+		};
+
+		// Result of the search
+		struct result {
+			// Optimized program
+			specializer::residual_program program;
+			// Numbers of instructions and mean numbers of steps on the validation inputs before and after
+			size_t size;
+			size_t optimized_size;
+			double steps;
+			double optimized_steps;
+			// Bound of the exhaustive check, -1 if it was skipped
+			int bound;
+			// The result is taken from the cache
+			bool is_cached;
+		};
+
+	private:
+		// Operand of a candidate instruction: a register number or a literal
+		struct operand {
+			bool is_literal;
+			int value;
+
+			bool operator==(const operand& other) const noexcept = default;
+		};
+
+		// Instruction of a candidate: the registers are numbered, the jump targets are instruction numbers
+		struct candidate_instruction {
+			generated_instruction::opcode code;
+			size_t target;
+			operand left;
+			operand right;
+			grammar::relation relation;
+			size_t goto_true;
+			size_t goto_false;
+
+			bool operator==(const candidate_instruction& other) const noexcept = default;
+		};
+		using candidate = std::vector<candidate_instruction>;
+
+		// Cost of a candidate
+		struct cost {
+			// Number of differing bits of the outputs and of the launches not stopping in time on the test inputs
+			size_t errors;
+			// Value minimized by the search
+			double value;
+		};
+
+		// Weights of the cost: a differing bit, an instruction of the program
+		static constexpr double ERROR_WEIGHT{ 1.0 };
+		static constexpr double SIZE_WEIGHT{ 0.25 };
+		// Maximum number of steps of the original program on a test input, longer inputs are not tested
+		static constexpr size_t MAX_STEPS{ 100000 };
+		// Maximum number of input tuples of the exhaustive check
+		static constexpr size_t MAX_EXHAUSTIVE{ 20000 };
+		// Maximum number of registers: the reference verifier tracks them by the bits of a word
+		static constexpr size_t MAX_REGISTERS{ 63 };
+		// Maximum number of the candidates validated after the search
+		static constexpr size_t MAX_VALIDATED{ 16 };
+
+		// File of the program
+		std::string _filename;
+		// Names of the registers by their numbers: the input registers first, then the output registers and the others
+		std::vector<std::string> _names;
+		std::unordered_map<std::string, size_t> _numbers;
+		size_t _inputs;
+		// Numbers of the output registers
+		std::vector<size_t> _outputs;
+		// Literals of the program and the small ones, offered to the mutations
+		std::vector<int> _literals;
+		// The program uses only the syntax of the basic RM, and so do the candidates
+		bool _is_basic;
+		// Program
+		candidate _original;
+		// Test inputs with the outputs and the numbers of steps of the program
+		std::vector<std::vector<int>> _tests;
+		std::vector<std::vector<int>> _expected;
+		std::vector<size_t> _steps;
+
+	public:
+		// Constructor: loads the program, which must consist of a single stage without call instructions
+		explicit superoptimizer(const std::string& filename);
+
+		// Copy constructor
+		superoptimizer(const superoptimizer&) = delete;
+		// Assignment operator
+		superoptimizer& operator=(const superoptimizer&) = delete;
+
+		// Destructor
+		~superoptimizer() = default;
+
+		// Searches for an optimized program, returns the program itself if nothing better is valid
+		result optimize(const options& settings);
+
+	private:
+		// Returns the number of the register, a new register is numbered after the others
+		size_t number(const std::string& name);
+		// Returns the operand of a name: a literal or a register
+		operand operand_of(const std::string& name);
+
+		// Returns the candidate as a stage of a generated program
+		generated_stage stage(const candidate& code) const;
+		// Returns the candidate as the text of a program file
+		specializer::residual_program text(const candidate& code) const;
+		// Returns true if the instruction belongs to the syntax of the basic RM
+		static bool is_basic(const candidate_instruction& x) noexcept;
+
+		// Runs the candidate for at most max_steps instructions, returns false if it does not stop in time
+		bool run(const candidate& code, const std::vector<int>& arguments, size_t max_steps, std::vector<int>& outputs, size_t& steps) const;
+		// Returns the cost of the candidate on the test inputs
+		cost evaluate(const candidate& code) const;
+		// Returns a mutation of the candidate, the same candidate if the mutation does not apply
+		candidate mutate(const candidate& code, std::mt19937_64& random) const;
+		// Removes the instruction, the jumps to it lead to the next one
+		static candidate remove(const candidate& code, size_t number);
+
+		// Searches with a stochastic chain, returns the correct verified candidates improving on each other
+		std::vector<candidate> search(const candidate& start, uint64_t seed, size_t iterations) const;
+		// Returns the correct verified candidates left by every removal of one or two instructions
+		std::vector<candidate> reduce() const;
+		// Validates the candidate by the reference interpreter on the inputs with the results of the program, returns the total
+		// number of its steps, or the maximum size_t if it differs from the program on some input; the inputs on which
+		// the program does not stop in time are skipped
+		static size_t validate(const generated_stage& candidate, const std::vector<std::vector<int>>& inputs, const std::vector<reference_result>& expected);
+		// Returns the validation inputs: the random ones and every tuple up to the bound, lowered to fit MAX_EXHAUSTIVE
+		std::vector<std::vector<int>> validation_inputs(const options& settings, int& bound) const;
+		// Loads the candidate from the file of the program text and returns true if the machine accepts it
+		static bool is_accepted(const std::string& filename);
+	};
+}
+
+#endif